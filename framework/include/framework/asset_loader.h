@@ -0,0 +1,159 @@
+/*!
+ * @file asset_loader.h
+ * @brief Asynchronous loading of files on the game's thread pool.
+ *
+ * Reading and decoding large files (images, fonts, shader sources) can take
+ * several frames. The asset loader moves this work to the game's thread pool
+ * so the main loop keeps running while files are loaded.
+ *
+ * A request is made by calling asset_load(). The file is read into memory on
+ * a worker thread and is optionally handed to a decode function, also on the
+ * worker thread. Once finished, the result is picked up on the main thread
+ * during asset_loader_dispatch(), where the completion callback is called and
+ * the **core.asset.loaded** event is fired. This is the place to do things
+ * which can only be done on the main thread, such as uploading textures to
+ * the GPU.
+ *
+ * Pending requests are handed to the thread pool in order of priority. Only a
+ * limited number of requests are ever in flight so high priority requests
+ * issued later don't have to wait for a long queue of low priority requests.
+ *
+ * Requests can be cancelled with asset_cancel(). The completion callback is
+ * never called for cancelled requests.
+ */
+
+#ifndef FRAMEWORK_ASSET_LOADER_H
+#define FRAMEWORK_ASSET_LOADER_H
+
+#include "util/pstdint.h"
+#include "util/unordered_vector.h"
+#include "thread_pool/thread_pool.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+struct asset_t;
+
+typedef enum asset_priority_e
+{
+	ASSET_PRIORITY_LOW = 0,
+	ASSET_PRIORITY_NORMAL = 1,
+	ASSET_PRIORITY_HIGH = 2
+} asset_priority_e;
+
+typedef enum asset_state_e
+{
+	ASSET_STATE_PENDING,   /* waiting to be handed to the thread pool */
+	ASSET_STATE_LOADING,   /* a worker thread is loading the file */
+	ASSET_STATE_LOADED,    /* data is ready to be used */
+	ASSET_STATE_FAILED     /* file could not be loaded or decoded */
+} asset_state_e;
+
+/*!
+ * @brief Decodes raw file contents. Called on a worker thread.
+ *
+ * The decoder must fill in asset->data and asset->size, and may fill in
+ * asset->width and asset->height. If the decoded data can't be released with
+ * FREE(), asset->free_data must be set as well. The raw buffer is owned by
+ * the asset loader and is freed after the decoder returns.
+ * @return Return 1 if successful, 0 if otherwise.
+ */
+typedef char (*asset_decode_func)(struct asset_t* asset, const void* raw, uint32_t raw_size);
+
+/*!
+ * @brief Called on the main thread when a request has finished, successfully
+ * or not. Check asset->state to find out which.
+ * @note The asset object and its data are freed after the callback returns.
+ * To keep the data, set asset->data to NULL.
+ */
+typedef void (*asset_loaded_func)(struct game_t* game, struct asset_t* asset);
+
+typedef void (*asset_free_func)(void* data);
+
+struct asset_t
+{
+	uint32_t id;
+	char* file_name;
+	asset_priority_e priority;
+	int state;                    /* asset_state_e - use atomics to modify */
+	int cancelled;                /* use atomics to modify */
+
+	void* data;                   /* raw file contents, or whatever the decoder produced */
+	uint32_t size;
+	uint32_t width;               /* filled in by decoders of image data */
+	uint32_t height;
+
+	asset_decode_func decode;
+	asset_loaded_func on_loaded;
+	asset_free_func free_data;
+	void* user_data;
+};
+
+struct asset_loader_t
+{
+	uint32_t guid;                       /* ID to give the next request */
+	uint32_t max_in_flight;              /* maximum number of requests handed to the thread pool */
+	struct unordered_vector_t pending;   /* holds struct asset_t* not yet handed to the thread pool */
+	struct unordered_vector_t in_flight; /* holds struct asset_t* handed to the thread pool */
+	struct thread_pool_counter_t jobs;   /* load jobs not yet finished */
+};
+
+char
+asset_loader_init(struct game_t* game);
+
+/*!
+ * @brief Cancels all pending requests and waits for requests in flight to
+ * finish. No callbacks are called.
+ */
+void
+asset_loader_deinit(struct game_t* game);
+
+/*!
+ * @brief Requests a file to be loaded asynchronously.
+ * @param[in] game The game object to load the file for.
+ * @param[in] file_name The file to load.
+ * @param[in] priority Pending requests with a higher priority are processed
+ * first.
+ * @param[in] decode Optional function to decode the raw file contents on the
+ * worker thread. Pass NULL to receive the raw file contents.
+ * @param[in] on_loaded Optional function to call on the main thread once the
+ * request has finished.
+ * @param[in] user_data Stored in asset->user_data.
+ * @return Returns a non-zero request ID if successful, 0 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API uint32_t
+asset_load(struct game_t* game,
+		   const char* file_name,
+		   asset_priority_e priority,
+		   asset_decode_func decode,
+		   asset_loaded_func on_loaded,
+		   void* user_data);
+
+/*!
+ * @brief Cancels a request previously made with asset_load().
+ *
+ * If the request is still pending, it is discarded immediately. If it is
+ * being loaded, the result is discarded once the worker thread finishes.
+ * @return Returns 1 if the request was found, 0 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+asset_cancel(struct game_t* game, uint32_t id);
+
+/*!
+ * @brief Finishes requests on the main thread and hands pending requests to
+ * the thread pool. Called once per frame by the main loop, while no tick
+ * listener is running.
+ */
+FRAMEWORK_PUBLIC_API void
+asset_loader_dispatch(struct game_t* game);
+
+/*!
+ * @brief Blocks until every request has been finished and dispatched.
+ */
+FRAMEWORK_PUBLIC_API void
+asset_loader_flush(struct game_t* game);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_ASSET_LOADER_H */
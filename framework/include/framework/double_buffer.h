@@ -0,0 +1,84 @@
+/*!
+ * @file double_buffer.h
+ * @brief Publishes state written by the tick event to the render event.
+ *
+ * In pipelined mode (see main_loop.h) the render event of frame N runs at
+ * the same time as the tick event of frame N+1. State that both read and
+ * write, e.g. sprite transforms, has to be kept twice: The tick event writes
+ * the back buffer, the render event reads the front buffer. Once all ticks
+ * of a frame have run, the main loop swaps the buffers of every game's
+ * double buffers that were written to.
+ *
+ * After a swap the new back buffer starts out as a copy of the new front
+ * buffer, so ticks only have to write what changed.
+ *
+ * Without pipelining the same swap happens between tick and render, so
+ * plugins don't have to care which mode is active.
+ *
+ * Double buffers must only be created, written and destroyed from the tick
+ * side (tick listeners, plugin start and stop) and only be read from the
+ * render side.
+ */
+
+#ifndef FRAMEWORK_DOUBLE_BUFFER_H
+#define FRAMEWORK_DOUBLE_BUFFER_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+
+struct double_buffer_t
+{
+	struct game_t* game;
+	uint32_t size;
+	char* buffer[2];
+	char front;         /* index of the buffer the render event reads */
+	char written;       /* the back buffer changed since the last swap */
+};
+
+/*!
+ * @brief Creates a double buffer holding size bytes, initialised to 0, and
+ * registers it with the game.
+ * @return Returns NULL if memory couldn't be allocated.
+ */
+FRAMEWORK_PUBLIC_API struct double_buffer_t*
+double_buffer_create(struct game_t* game, uint32_t size);
+
+/*!
+ * @brief Unregisters and frees a double buffer.
+ */
+FRAMEWORK_PUBLIC_API void
+double_buffer_destroy(struct double_buffer_t* buffer);
+
+/*!
+ * @brief Returns the back buffer for writing and marks it to be published
+ * at the end of the frame's ticks.
+ */
+FRAMEWORK_PUBLIC_API void*
+double_buffer_write(struct double_buffer_t* buffer);
+
+/*!
+ * @brief Returns the front buffer, i.e. what the last published tick wrote.
+ */
+#define double_buffer_read(double_buffer) \
+		((const void*)(double_buffer)->buffer[(int)(double_buffer)->front])
+
+/*!
+ * @brief Swaps all of the game's double buffers that were written to. This
+ * is called by the main loop when neither tick nor render are running.
+ */
+void
+double_buffer_publish_all(struct game_t* game);
+
+/*!
+ * @brief Frees all double buffers that are still registered with the game.
+ */
+void
+double_buffer_destroy_all(struct game_t* game);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_DOUBLE_BUFFER_H */
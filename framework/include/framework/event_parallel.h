@@ -0,0 +1,75 @@
+/*!
+ * @file event_parallel.h
+ * @brief Fork/join dispatch of thread safe event listeners.
+ *
+ * Every event that ever had a listener registered with
+ * EVENT_LISTENER_THREAD_SAFE owns an event_parallel_t object holding the
+ * state of the current fire. The callbacks themselves are read from the
+ * event's snapshot, see event_snapshot.h.
+ *
+ * When the event is fired, jobs are queued on the game's thread pool. Every
+ * job (and the firing thread itself) claims listeners one at a time until
+ * none are left. The firing thread then waits for the claimed listeners to
+ * return, running other jobs of the pool or sleeping meanwhile. Jobs that
+ * only start after that find nothing to claim and exit.
+ *
+ * Listeners are claimed with a CAS on a word holding both the sequence
+ * number of the fire and the index of the next listener, so a job that was
+ * held up can't claim a listener of a later fire with the state of an
+ * earlier one.
+ */
+
+#ifndef FRAMEWORK_EVENT_PARALLEL_H
+#define FRAMEWORK_EVENT_PARALLEL_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct event_t;
+struct event_snapshot_t;
+
+struct event_parallel_t
+{
+	struct event_t* event;
+	uint32_t thread_count;  /* number of jobs worth queueing */
+	int busy;               /* set while firing, concurrent or nested fires are serial - use atomics */
+
+	/* state of the current fire */
+	const struct event_snapshot_t* snapshot;
+	const void** argv;
+	uint64_t claim;         /* sequence number of the fire in the upper, next listener in the lower 32 bits - use atomics */
+	uint32_t count;         /* listeners that can be claimed - use atomics */
+	int remaining;          /* claimable listeners that haven't returned yet - use atomics */
+	int waiting;            /* set while the firing thread sleeps on remaining - use atomics */
+	int jobs;               /* jobs queued on the thread pool that haven't returned yet - use atomics */
+};
+
+/*!
+ * @brief Creates the event's event_parallel_t object if it doesn't have one.
+ * @return Returns 0 if memory couldn't be allocated, in which case thread
+ * safe listeners are called serially. Returns 1 if otherwise.
+ */
+char
+event_parallel_create(struct event_t* event);
+
+/*!
+ * @brief Destroys the event's event_parallel_t object, if any. Waits for
+ * queued jobs referencing it to return.
+ */
+void
+event_parallel_destroy(struct event_t* event);
+
+/*!
+ * @brief Calls all listeners in the snapshot, forking the thread safe ones
+ * onto the game's thread pool.
+ */
+void
+event_fire_parallel(struct event_t* event,
+					const struct event_snapshot_t* snapshot,
+					const void** argv);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_EVENT_PARALLEL_H */
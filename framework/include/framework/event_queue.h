@@ -0,0 +1,105 @@
+/*!
+ * @file event_queue.h
+ * @brief Deferred delivery of events.
+ *
+ * EVENT_FIREn() calls every listener immediately. This is a problem for
+ * events that are fired at a high rate, such as mouse movements, because all
+ * listeners do their work for every intermediate sample. EVENT_POSTn() copies
+ * the arguments into the game's event queue instead. The queue is drained
+ * once per iteration of the main loop, before the render and tick events are
+ * dispatched.
+ *
+ * Events can opt into coalescing with event_set_coalescing(). If a coalescing
+ * event is posted while an instance of it is already queued, the queued
+ * instance is overwritten with the new arguments, so listeners only ever see
+ * the latest state. Posts are never reordered though: Once a non-coalescing
+ * event was posted after the queued instance, e.g. a mouse click after a
+ * mouse move, the new post gets an entry of its own behind it.
+ *
+ * Arguments of known types (integers, floats, strings) are copied. Arguments
+ * of unknown types (i.e. pointers to structs) are queued by reference and
+ * must therefore stay valid until the queue is drained.
+ */
+
+#ifndef FRAMEWORK_EVENT_QUEUE_H
+#define FRAMEWORK_EVENT_QUEUE_H
+
+#include "util/pstdint.h"
+#include "util/unordered_vector.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+struct event_t;
+
+/* maximum number of arguments an event can have, see EVENT_FIRE6() */
+#define EVENT_QUEUE_MAX_ARGS 6
+
+/* default number of entries a queue can hold before posts are dropped */
+#define EVENT_QUEUE_DEFAULT_CAPACITY 4096
+
+struct event_queue_stats_t
+{
+	uint32_t capacity;      /* number of entries the queue can hold */
+	uint32_t high_water;    /* largest number of entries queued at once */
+	uint32_t posted;        /* total number of posts */
+	uint32_t coalesced;     /* posts that overwrote an already queued instance */
+	uint32_t dropped;       /* posts rejected because the queue was full */
+	uint32_t delivered;     /* entries delivered to listeners */
+};
+
+struct event_queue_t
+{
+	/* event_queue_entry_t objects. Posts go into pending, which is swapped
+	 * with delivering when the queue is drained so listeners can post again */
+	struct unordered_vector_t pending;
+	struct unordered_vector_t delivering;
+	struct event_queue_stats_t stats;
+	uint32_t barrier;   /* number of pending entries up to the last non-coalescing one */
+	int lock;   /* the tick and render side can post at once - use atomics */
+};
+
+char
+event_queue_init(struct game_t* game);
+
+void
+event_queue_deinit(struct game_t* game);
+
+/*!
+ * @brief Delivers all queued events to their listeners. Events posted by
+ * listeners during this call are delivered during the next call.
+ */
+FRAMEWORK_PUBLIC_API void
+event_queue_dispatch(struct game_t* game);
+
+/*!
+ * @brief Removes all queued instances of an event. Called when the event is
+ * destroyed.
+ */
+void
+event_queue_discard_event(struct game_t* game, const struct event_t* event);
+
+/*!
+ * @brief Sets how many entries the queue can hold. Posts exceeding this are
+ * dropped and counted in event_queue_stats_t::dropped.
+ */
+FRAMEWORK_PUBLIC_API void
+event_queue_set_capacity(struct game_t* game, uint32_t capacity);
+
+/*!
+ * @brief Returns the queue's metrics.
+ */
+FRAMEWORK_PUBLIC_API const struct event_queue_stats_t*
+event_queue_get_stats(const struct game_t* game);
+
+/*!
+ * @brief Resets the counters returned by event_queue_get_stats(). The
+ * capacity is kept.
+ */
+FRAMEWORK_PUBLIC_API void
+event_queue_reset_stats(struct game_t* game);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_EVENT_QUEUE_H */
@@ -0,0 +1,163 @@
+/*!
+ * @file event_snapshot.h
+ * @brief Immutable copies of an event's listeners, so events can be fired
+ * from any thread.
+ *
+ * Registering and unregistering listeners modifies the event's listener
+ * vector, which is only ever touched while holding the game's write lock.
+ * Every modification then publishes a new snapshot of the listeners, replacing
+ * the old one with a single pointer store. Firing reads whichever snapshot is
+ * current without taking a lock, so a listener (un)registering during a fire
+ * only affects the next fire.
+ *
+ * Replaced snapshots can't be freed right away, because a fire on another
+ * thread may still be iterating them. They're retired instead and freed
+ * using epoch based reclamation:
+ *   + Firing threads enter a read section by incrementing the reader counter
+ *     of the current epoch, and leave it by decrementing the same counter.
+ *   + Retired snapshots are tagged with the epoch they were retired in.
+ *   + The epoch can only advance once the readers of the previous epoch are
+ *     gone. Once it advanced twice past a snapshot's tag, no reader can still
+ *     be holding it.
+ */
+
+#ifndef FRAMEWORK_EVENT_SNAPSHOT_H
+#define FRAMEWORK_EVENT_SNAPSHOT_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+#include "framework/se_api.h"
+#include "framework/trace.h"
+#include "framework/profiler.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+struct event_t;
+
+/* filtered listeners with the same filter, see event_register_listener_filtered() */
+struct event_filter_bucket_t
+{
+	int64_t value;
+	uint32_t arg_index;
+	uint32_t first;             /* index of the first listener, relative to the filtered ones */
+	uint32_t count;             /* 0 if the bucket is empty */
+};
+
+struct event_snapshot_t
+{
+	struct event_snapshot_t* next_retired;
+	uint32_t retired_epoch;
+	uint32_t serial_count;      /* listeners called on the firing thread, in order */
+	uint32_t parallel_count;    /* thread safe listeners, see event_parallel.h */
+	uint32_t filtered_count;    /* filtered listeners, grouped by filter */
+	uint32_t filter_args;       /* bit n is set if a listener filters argument n */
+	uint32_t bucket_count;      /* power of two, 0 if there are no filtered listeners */
+	struct event_filter_bucket_t* bucket; /* open addressing hash index, stored after the callbacks */
+	char all_read_only;         /* all thread safe listeners are read only */
+	event_callback_func callback[1]; /* serial, then thread safe, then filtered listeners */
+};
+
+/*
+ * makes a call recorded by the tracer and the profiler, whichever are enabled.
+ * With both enabled, the cycle counter is only read once at either end and
+ * the tracer records the same span as the profiler's zone.
+ */
+#if defined(ENABLE_TRACING) && defined(ENABLE_PROFILER)
+#   define EVENT_INSTRUMENTED_CALL(kind, key, name, call) do {              \
+			uint64_t event_internal_start = profiler_begin(key, name);      \
+			call;                                                           \
+			trace_record_span(kind, key, name,                              \
+			                  event_internal_start, profiler_end());        \
+		} while(0)
+#else
+#   define EVENT_INSTRUMENTED_CALL(kind, key, name, call) do {              \
+			PROFILE_BEGIN_KEY(key, name);                                   \
+			TRACE_CALL(kind, key, name, call);                              \
+			PROFILE_END();                                                  \
+		} while(0)
+#endif
+
+/* calls a listener of a snapshot */
+#define EVENT_SNAPSHOT_CALL(callback, event, argv)                          \
+		EVENT_INSTRUMENTED_CALL(TRACE_LISTENER, (uintptr_t)(callback), NULL, \
+		                        (callback)(event, argv))
+
+struct event_epoch_t
+{
+	uint32_t epoch;             /* use atomics */
+	int readers[2];             /* readers in even and odd epochs - use atomics */
+	int write_lock;             /* serialises modifications of listeners - use atomics */
+	struct event_snapshot_t* retired; /* snapshots waiting to be freed, newest first */
+};
+
+void
+event_epoch_init(struct game_t* game);
+
+/*!
+ * @brief Frees all retired snapshots. No thread may be firing events of this
+ * game anymore.
+ */
+void
+event_epoch_deinit(struct game_t* game);
+
+/*!
+ * @brief Enters a read section. Snapshots loaded after this call stay valid
+ * until event_read_unlock() is called.
+ * @return Returns a value that has to be passed to event_read_unlock().
+ */
+int
+event_read_lock(struct game_t* game);
+
+void
+event_read_unlock(struct game_t* game, int index);
+
+/*!
+ * @brief Acquires the lock that has to be held while modifying the listeners
+ * of any event owned by the game.
+ */
+void
+event_write_lock(struct game_t* game);
+
+/*!
+ * @brief Releases the write lock and frees snapshots no reader can be holding
+ * anymore.
+ */
+void
+event_write_unlock(struct game_t* game);
+
+/*!
+ * @brief Builds a new snapshot from the event's listener vector, publishes
+ * it and retires the previous one. The write lock must be held.
+ * @return Returns 0 if memory couldn't be allocated, in which case the
+ * previous snapshot stays published. Returns 1 if otherwise.
+ */
+char
+event_snapshot_publish(struct event_t* event);
+
+/*!
+ * @brief Calls the filtered listeners in the snapshot whose filter matches
+ * the arguments.
+ */
+void
+event_snapshot_fire_filtered(struct event_t* event,
+							 const struct event_snapshot_t* snapshot,
+							 const void** argv);
+
+/*!
+ * @brief Unpublishes and retires the event's snapshot. The write lock must be
+ * held.
+ */
+void
+event_snapshot_clear(struct event_t* event);
+
+/*!
+ * @brief Frees retired snapshots no reader can be holding anymore. Called
+ * once per frame.
+ */
+void
+event_epoch_reclaim(struct game_t* game);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_EVENT_SNAPSHOT_H */
@@ -93,6 +93,42 @@
  * ```
  *
  * See event_register_listener() for more information.
+ *
+ * Parallel Listeners
+ * ------------------
+ * Normally, firing an event calls every listener one after another on the
+ * firing thread. Listeners that don't depend on other listeners of the same
+ * event (e.g. every plugin updating its own state on **tick**) can be
+ * registered with event_register_listener_ex() and EVENT_LISTENER_THREAD_SAFE.
+ * When the event is fired, these listeners are handed to the game's thread
+ * pool, and the fire doesn't return before all of them have finished.
+ *
+ * The remaining (serial) listeners are still called in order on the firing
+ * thread. They are called after the parallel listeners have finished, unless
+ * all parallel listeners are also marked EVENT_LISTENER_READ_ONLY, in which
+ * case both run at the same time.
+ *
+ * Filtered Listeners
+ * ------------------
+ * Listeners that only care about one value of an argument, e.g. a single key
+ * of **renderer_gl.key_press**, can be registered with
+ * event_register_listener_filtered(). Each event keeps a hash index from
+ * argument values to filtered listeners, so a fire only calls the filtered
+ * listeners whose value matches, instead of every listener testing the
+ * argument itself:
+ * ```
+ * event_register_listener_filtered(game, "renderer_gl.key_press", on_jump, 0, KEY_SPACE);
+ * ```
+ * Filtered listeners are always called on the firing thread, after the
+ * unfiltered ones.
+ *
+ * Threads
+ * -------
+ * Events can be fired from any thread, and listeners can be (un)registered
+ * from any thread, including from within a listener of the event being fired.
+ * A fire always calls the listeners that were registered when it started;
+ * (un)registering during a fire only affects the next one. See
+ * event_snapshot.h for how this works.
  */
 
 #ifndef FRAMEWORK_EVENTS_H
@@ -108,6 +144,8 @@ C_HEADER_BEGIN
 struct plugin_t;
 struct log_t;
 struct game_t;
+struct event_parallel_t;
+struct event_snapshot_t;
 
 struct event_t
 {
@@ -115,11 +153,49 @@ struct event_t
 	char* directory;
 	struct type_info_t* type_info;
 	struct unordered_vector_t listeners; /* holds event_listener_t objects */
+	char coalesce;              /* see event_set_coalescing() */
+	uint32_t queued_index;      /* 1-based index into the game's event queue, 0 if not queued */
+	struct event_parallel_t* parallel; /* NULL unless thread safe listeners were ever registered */
+	struct event_snapshot_t* snapshot; /* listeners seen by fires, NULL if there are none */
 };
 
+typedef enum event_listener_flags_e
+{
+	EVENT_LISTENER_DEFAULT     = 0x00,
+	/* may be called on a worker thread, concurrently with other thread safe
+	 * listeners of the same event */
+	EVENT_LISTENER_THREAD_SAFE = 0x01,
+	/* doesn't modify anything serial listeners of the same event depend on */
+	EVENT_LISTENER_READ_ONLY   = 0x02,
+	/* must be called on the firing thread, overrides EVENT_LISTENER_THREAD_SAFE */
+	EVENT_LISTENER_MAIN_THREAD = 0x04,
+	/* set by event_register_listener_filtered(), don't pass this yourself */
+	EVENT_LISTENER_FILTERED    = 0x08
+} event_listener_flags_e;
+
 struct event_listener_t
 {
 	event_callback_func exec;
+	uint32_t flags;             /* event_listener_flags_e */
+	uint32_t filter_arg;        /* only valid with EVENT_LISTENER_FILTERED */
+	int64_t filter_value;
+};
+
+/*!
+ * @brief A persistent reference to an event, resolved by directory name.
+ *
+ * Works the same way as service_handle_t: The handle is bound to the event
+ * while it exists, set to NULL when it is destroyed, and re-bound when an
+ * event is created under the same directory again. Fire it with:
+ * ```
+ * EVENT_FIRE1(handle->event, arg);
+ * ```
+ */
+struct event_handle_t
+{
+	struct event_t* event;  /* NULL while no event exists under the directory */
+	struct game_t* game;
+	uint32_t refcount;
 };
 
 /*!
@@ -176,6 +252,21 @@ event_destroy_all_matching(const char* pattern);
 FRAMEWORK_PUBLIC_API struct event_t*
 event_get(const struct game_t* game, const char* directory);
 
+/*!
+ * @brief Returns a handle to the event registered under the specified
+ * directory. The event doesn't have to exist yet.
+ * @note Handles must be released before the game is destroyed.
+ * @return Returns the handle, or NULL if memory couldn't be allocated.
+ */
+FRAMEWORK_PUBLIC_API struct event_handle_t*
+event_handle_acquire(struct game_t* game, const char* directory);
+
+/*!
+ * @brief Releases a handle previously acquired with event_handle_acquire().
+ */
+FRAMEWORK_PUBLIC_API void
+event_handle_release(struct event_handle_t* handle);
+
 /*!
  * @brief Registers a listener to the specified event.
  * @note The same callback function will not be registered twice.
@@ -189,19 +280,85 @@ event_register_listener(const struct game_t* game,
 						event_callback_func callback);
 
 /*!
- * @brief Unregisters a listener from the specified event.
+ * @brief Same as event_register_listener(), but lets the listener specify how
+ * it may be called.
+ * @param[in] flags A combination of event_listener_flags_e values. See
+ * "Parallel Listeners" above.
+ */
+FRAMEWORK_PUBLIC_API char
+event_register_listener_ex(const struct game_t* game,
+						   const char* event_directory,
+						   event_callback_func callback,
+						   uint32_t flags);
+
+/*!
+ * @brief Registers a listener that is only called if the specified argument
+ * of the event equals a value. See "Filtered Listeners" above.
+ * @note The same callback can be registered multiple times with different
+ * filters.
+ * @param[in] arg_index The index of the argument to compare. The argument
+ * must be an integer type.
+ * @param[in] value The value the argument must have. Unsigned 64-bit values
+ * are compared by their bit pattern.
+ */
+FRAMEWORK_PUBLIC_API char
+event_register_listener_filtered(const struct game_t* game,
+								 const char* event_directory,
+								 event_callback_func callback,
+								 uint32_t arg_index,
+								 int64_t value);
+
+/*!
+ * @brief Unregisters a listener from the specified event. Listeners
+ * registered with a filter are not affected.
  */
 FRAMEWORK_PUBLIC_API char
 event_unregister_listener(const struct game_t* game,
 						  const char* event_directory,
 						  event_callback_func callback);
 
+/*!
+ * @brief Unregisters a listener previously registered with
+ * event_register_listener_filtered() using the same filter.
+ */
+FRAMEWORK_PUBLIC_API char
+event_unregister_listener_filtered(const struct game_t* game,
+								   const char* event_directory,
+								   event_callback_func callback,
+								   uint32_t arg_index,
+								   int64_t value);
+
 /*!
  * @brief Unregisters all listeners from the specified event.
  */
 FRAMEWORK_PUBLIC_API void
 event_unregister_all_listeners(struct event_t* event);
 
+/*!
+ * @brief Queues an event for delivery during the next call to
+ * event_queue_dispatch(). Use the EVENT_POSTn() macros instead of calling
+ * this directly.
+ * @return Returns 1 if the event was queued, 0 if the queue was full or the
+ * arguments couldn't be copied.
+ */
+FRAMEWORK_PUBLIC_API char
+event_post(struct event_t* event, const void** argv);
+
+/*!
+ * @brief If enabled, posting an event that is already queued overwrites the
+ * queued arguments instead of adding a second entry. Useful for events that
+ * report a state, such as mouse positions.
+ */
+FRAMEWORK_PUBLIC_API void
+event_set_coalescing(struct event_t* event, char enable);
+
+/*!
+ * @brief Calls all listeners of an event. Used by EVENT_FIREn(), don't call
+ * this directly.
+ */
+FRAMEWORK_PUBLIC_API void
+event_fire(struct event_t* event, const void** argv);
+
 C_HEADER_END
 
 #endif /* FRAMEWORK_EVENTS_H */
@@ -0,0 +1,115 @@
+/*!
+ * @file frame_pacer.h
+ * @brief Decides when the main loop ticks, renders and sleeps.
+ *
+ * Ticks run at a fixed rate. Each tick is scheduled exactly one interval
+ * after the previous one, so a late iteration runs several ticks to catch
+ * up. If the loop falls behind by more than the maximum frame latency, the
+ * backlog is dropped instead, so a stall (e.g. a debugger break) doesn't
+ * cause a burst of ticks afterwards.
+ *
+ * Rendering is independent of ticking. Since renders don't coincide with
+ * ticks, the render event receives an interpolation alpha in [0, 1]: How far
+ * the current time is between the last tick and the next one. Renderers can
+ * use it to blend between the previous and the current tick's state.
+ *
+ * Between iterations the main loop sleeps until the next tick or render is
+ * due, see sleep_until_ns().
+ *
+ * The pacer doesn't read the clock itself, all functions are passed the
+ * current time from get_time_ns().
+ */
+
+#ifndef FRAMEWORK_FRAME_PACER_H
+#define FRAMEWORK_FRAME_PACER_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct ptree_t;
+
+#define FRAME_PACER_DEFAULT_TICK_RATE 60
+#define FRAME_PACER_DEFAULT_RENDER_RATE 60
+#define FRAME_PACER_DEFAULT_MAX_FRAME_LATENCY 250 /* milliseconds */
+
+struct frame_pacer_t
+{
+	uint64_t tick_interval;     /* NOTE all times are in nanoseconds */
+	uint64_t render_interval;   /* 0 doesn't limit the render rate */
+	uint64_t max_frame_latency; /* ticks further behind than this are dropped */
+	uint64_t next_tick;
+	uint64_t next_render;
+	uint64_t ticks_dropped;
+};
+
+/*!
+ * @brief Initialises the pacer with the default rates.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_init(struct frame_pacer_t* pacer);
+
+/*!
+ * @brief Sets the number of ticks per second. Values of 0 are ignored.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_set_tick_rate(struct frame_pacer_t* pacer, uint32_t ticks_per_second);
+
+/*!
+ * @brief Sets the number of renders per second. Pass 0 to render on every
+ * iteration of the main loop, e.g. if vsync already limits the rate.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_set_render_rate(struct frame_pacer_t* pacer, uint32_t renders_per_second);
+
+/*!
+ * @brief Sets how far in milliseconds ticks may fall behind before they are
+ * dropped.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_set_max_frame_latency(struct frame_pacer_t* pacer, uint32_t milliseconds);
+
+/*!
+ * @brief Reads the rates from the "main_loop" section of a settings file.
+ * Missing values are left unchanged.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_load_settings(struct frame_pacer_t* pacer, const struct ptree_t* settings);
+
+/*!
+ * @brief Schedules the first tick and render at the specified time.
+ */
+FRAMEWORK_PUBLIC_API void
+frame_pacer_reset(struct frame_pacer_t* pacer, uint64_t now);
+
+/*!
+ * @brief Returns 1 and schedules the following tick if a tick is due at the
+ * specified time. Call in a loop with the same time until it returns 0.
+ */
+FRAMEWORK_PUBLIC_API char
+frame_pacer_should_tick(struct frame_pacer_t* pacer, uint64_t now);
+
+/*!
+ * @brief Returns 1 and schedules the following render if a render is due at
+ * the specified time.
+ */
+FRAMEWORK_PUBLIC_API char
+frame_pacer_should_render(struct frame_pacer_t* pacer, uint64_t now);
+
+/*!
+ * @brief Returns how far the specified time is between the last tick and
+ * the next one, in the range [0, 1].
+ */
+FRAMEWORK_PUBLIC_API float
+frame_pacer_get_alpha(const struct frame_pacer_t* pacer, uint64_t now);
+
+/*!
+ * @brief Returns the time at which the next tick or render is due.
+ */
+FRAMEWORK_PUBLIC_API uint64_t
+frame_pacer_get_wake_time(const struct frame_pacer_t* pacer);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_FRAME_PACER_H */
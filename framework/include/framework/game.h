@@ -4,13 +4,22 @@
 #include "framework/config.h"
 #include "framework/game.h"
 #include "framework/se_api.h"
+#include "framework/asset_loader.h"
+#include "framework/event_queue.h"
+#include "framework/event_snapshot.h"
+#include "framework/service_queue.h"
+#include "framework/main_loop.h"
+#include "framework/plugin_index.h"
 #include "util/ptree.h"
 #include "util/linked_list.h"
+#include "util/unordered_vector.h"
 #include "util/bst_vector.h"
+#include "util/bst_hashed_vector.h"
 
 C_HEADER_BEGIN
 
 struct net_connection_t;
+struct thread_pool_t;
 struct context_t;
 struct plugin_t;
 
@@ -49,6 +58,8 @@ struct framework_events_t
 	struct event_t* event_destroyed;
 	struct event_t* service_created;
 	struct event_t* service_destroyed;
+
+	struct event_t* asset_loaded;
 };
 
 struct framework_services_t
@@ -56,6 +67,15 @@ struct framework_services_t
 	struct service_t* start;
 	struct service_t* pause;
 	struct service_t* stop;
+#ifdef ENABLE_TRACING
+	struct service_t* trace_dump;
+	struct service_t* trace_report;
+#endif
+#ifdef ENABLE_PROFILER
+	struct service_t* profiler_dump;
+	struct service_t* profiler_report;
+	struct service_t* profiler_get_stats;
+#endif
 };
 
 struct framework_log_t
@@ -78,10 +98,22 @@ struct game_t
 	struct framework_log_t log;
 
 	struct list_t plugins;      /* list of active plugins used by this game */
+	struct plugin_index_t plugin_index; /* plugin files available for loading */
 	struct ptree_t services;    /* service directory of this game */
 	struct ptree_t events;      /* event directory of this game */
+	struct event_queue_t event_queue; /* events posted with EVENT_POSTn(), delivered once per frame */
+	struct service_queue_t service_queue; /* calls made with SERVICE_CALL_ASYNCn() from other threads */
+	struct event_epoch_t event_epoch; /* reclaims listener snapshots of this game's events */
+	struct bsthv_t service_handles; /* maps service directories to service_handle_t objects */
+	struct bsthv_t event_handles;   /* maps event directories to event_handle_t objects */
 
 	struct bstv_t context_store;  /* maps hashed plugin names to context structs used by this game */
+
+	uintptr_t thread_id;                  /* the thread that runs the game's main loop */
+	struct main_loop_t main_loop;         /* tick rate, timers and statistics of this game */
+	struct thread_pool_t* thread_pool;    /* worker threads available to this game */
+	struct asset_loader_t asset_loader;   /* loads files asynchronously on the thread pool */
+	struct unordered_vector_t double_buffers; /* double_buffer_t pointers published after every frame's ticks */
 };
 
 FRAMEWORK_PUBLIC_API void
@@ -113,17 +145,28 @@ game_pause(struct game_t* game);
 FRAMEWORK_PUBLIC_API void
 game_exit(struct game_t* game);
 
+/*!
+ * @brief Runs the main loops of all games until every game has terminated.
+ */
 FRAMEWORK_PUBLIC_API void
 games_run_all(void);
 
 void
-game_dispatch_stats(uint32_t render_fps, uint32_t tick_fps);
+game_dispatch_events(struct game_t* game);
+
+void
+game_dispatch_stats(struct game_t* game, uint32_t render_fps, uint32_t tick_fps);
 
+/*!
+ * @brief Fires the game's render event.
+ * @param[in] alpha How far the current time is between the last tick and
+ * the next one, see frame_pacer_get_alpha().
+ */
 void
-game_dispatch_render(void);
+game_dispatch_render(struct game_t* game, float alpha);
 
 void
-game_dispatch_tick(void);
+game_dispatch_tick(struct game_t* game);
 
 #define game_add_to_context_store(game, hash, context) bstv_insert(&(game)->context_store, hash, context)
 #define game_get_from_context_store(game, hash) bstv_find(&(game)->context_store, hash)
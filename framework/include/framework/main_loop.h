@@ -1,18 +1,127 @@
+/*!
+ * @file main_loop.h
+ * @brief Drives the tick and render events of a game.
+ *
+ * Every game has its own loop state, so each game ticks at its own rate. By
+ * default all loops are run by games_run_all() on the main thread, which
+ * sleeps until the earliest of them is due. A game can instead run its loop
+ * on a dedicated thread (see the "main_loop.own_thread" setting), so a slow
+ * render of one game doesn't delay the ticks of another. Games running on
+ * different threads must only exchange data through events, services and
+ * the network layer. Since renderers usually have to run on the main
+ * thread, only games without one should use their own thread.
+ *
+ * In pipelined mode (the "main_loop.pipelined" setting) the ticks of frame
+ * N+1 run as a job on the game's thread pool while frame N renders on the
+ * loop's thread, so a frame takes about as long as the slower of the two
+ * instead of their sum. The render event sees the state published at the
+ * end of frame N's ticks (see double_buffer.h), i.e. it lags one frame
+ * behind. Tick listeners run outside of the game thread in this mode and
+ * must call services with game thread affinity through
+ * SERVICE_CALL_SYNCn() or SERVICE_CALL_ASYNCn(). The loop's thread keeps
+ * delivering those calls while it waits for the ticks to finish. Render
+ * listeners must only read state published through double buffers, and
+ * anything else they touch must not be touched by tick listeners.
+ */
+
+#ifndef FRAMEWORK_MAIN_LOOP_H
+#define FRAMEWORK_MAIN_LOOP_H
+
 #include "util/pstdint.h"
+#include "framework/config.h"
 #include "framework/se_api.h"
+#include "framework/frame_pacer.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+
+struct main_loop_statistics_t
+{
+	int64_t last_tick;
+	uint32_t tick_counter_rel;
+	uint32_t render_counter_rel;
+	uint32_t tick_frame_rate;
+	uint32_t render_frame_rate;
+};
+
+struct main_loop_t
+{
+	int64_t time_begin; /* NOTE all times are in nanoseconds */
+	struct frame_pacer_t pacer;
+	struct main_loop_statistics_t statistics;
+	char own_thread;    /* run the loop on a dedicated thread */
+	char has_thread;    /* the dedicated thread was started */
+	uintptr_t thread;   /* handle of the dedicated thread */
+	int running;        /* the dedicated thread loops while this is set - use atomics */
+	char pipelined;     /* tick on the thread pool while the previous frame renders */
+	uint32_t pending_ticks; /* number of ticks the running tick job dispatches */
+	int ticks_done;     /* the tick job has finished - use atomics */
+	int waiting;        /* the loop's thread is waiting for the tick job - use atomics */
+	int signal;         /* futex the loop's thread waits on - use atomics */
+};
+
+/*!
+ * @brief Initialises the game's loop state from its settings.
+ */
+void
+main_loop_init(struct game_t* game);
 
+/*!
+ * @brief Stops the game's dedicated thread, if any.
+ */
 void
-main_loop_init(void);
+main_loop_deinit(struct game_t* game);
 
 void
-main_loop_reset_timer(void);
+main_loop_reset_timer(struct game_t* game);
 
+/*!
+ * @brief Returns the time in nanoseconds since main_loop_reset_timer() was
+ * called.
+ */
 int64_t
-main_loop_get_elapsed_time(void);
+main_loop_get_elapsed_time(const struct game_t* game);
 
+/*!
+ * @brief Runs all of the game's ticks and the render that are due.
+ * @return Returns the time at which the next tick or render is due.
+ */
+uint64_t
+main_loop_do_loop(struct game_t* game);
+
+/*!
+ * @brief Starts running the game's loop on a dedicated thread, which also
+ * becomes the game thread (see game_t::thread_id).
+ * @return Returns 0 if the thread couldn't be created, in which case the
+ * loop has to be run by the caller. Returns 1 if otherwise.
+ */
+char
+main_loop_start_thread(struct game_t* game);
+
+/*!
+ * @brief Stops and joins the game's dedicated thread. The calling thread
+ * becomes the game thread again.
+ */
+void
+main_loop_stop_thread(struct game_t* game);
+
+/*!
+ * @brief Wakes up the loop's thread if it is waiting for the tick job, so it
+ * can deliver service calls queued for the game thread.
+ */
 void
-main_loop_do_loop(void);
+main_loop_wake(struct game_t* game);
+
+/*!
+ * @brief Returns 1 if the game's loop runs on a dedicated thread.
+ */
+#define main_loop_is_threaded(game) ((game)->main_loop.has_thread)
 
 #ifdef _DEBUG
 	EVENT_LISTENER(on_stats);
 #endif
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_MAIN_LOOP_H */
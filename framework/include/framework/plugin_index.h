@@ -0,0 +1,69 @@
+/*!
+ * @file plugin_index.h
+ * @brief Index of the plugin files available in a directory.
+ *
+ * Instead of listing the plugin directory every time a plugin is loaded, the
+ * directory is listed once and every plugin file name is split into the
+ * plugin's name and version. The entries are sorted by name, then by version
+ * in descending order, so all versions of a plugin are adjacent and the first
+ * acceptable entry is always the newest one.
+ *
+ * Plugin files are expected to be named *plugin_<name>-<version>.<ext>*,
+ * e.g. *plugins/plugin_input-0.0.1.so*. Files not following this scheme are
+ * ignored.
+ */
+
+#ifndef FRAMEWORK_PLUGIN_INDEX_H
+#define FRAMEWORK_PLUGIN_INDEX_H
+
+#include "util/pstdint.h"
+#include "util/unordered_vector.h"
+#include "framework/config.h"
+#include "framework/plugin_api.h"
+
+C_HEADER_BEGIN
+
+struct plugin_index_entry_t
+{
+	char* file_name;   /* relative path of the plugin file, e.g. "plugins/plugin_input-0.0.1.so" */
+	char* name;        /* name of the plugin, e.g. "input" */
+	uint32_t major;
+	uint32_t minor;
+	uint32_t patch;
+};
+
+struct plugin_index_t
+{
+	char is_built;
+	struct unordered_vector_t entries; /* struct plugin_index_entry_t, sorted */
+};
+
+FRAMEWORK_PUBLIC_API void
+plugin_index_init(struct plugin_index_t* index);
+
+FRAMEWORK_PUBLIC_API void
+plugin_index_deinit(struct plugin_index_t* index);
+
+/*!
+ * @brief Lists the specified directory and rebuilds the index from it.
+ * @param[in] directory The directory to list, including a trailing slash.
+ * @return Returns 1 if successful, 0 if the directory couldn't be listed.
+ */
+FRAMEWORK_PUBLIC_API char
+plugin_index_build(struct plugin_index_t* index, const char* directory);
+
+/*!
+ * @brief Searches the index for a plugin matching the requested version.
+ *
+ * With PLUGIN_VERSION_MINIMUM, the newest version satisfying the request is
+ * returned.
+ * @return Returns the matching entry, or NULL if no file is acceptable.
+ */
+FRAMEWORK_PUBLIC_API const struct plugin_index_entry_t*
+plugin_index_find(const struct plugin_index_t* index,
+				  const struct plugin_info_t* info,
+				  plugin_search_criteria_e criteria);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_PLUGIN_INDEX_H */
@@ -0,0 +1,215 @@
+/*!
+ * @file profiler.h
+ * @brief Optional hierarchical CPU profiler with per-frame statistics.
+ *
+ * The profiler is compiled in with the CMake option ENABLE_PROFILER. When it
+ * is disabled, the PROFILE_*() macros expand to no-ops (or to the wrapped
+ * code) and nothing else in this file exists.
+ *
+ * Code is instrumented with zones, which are opened with PROFILE_BEGIN() and
+ * closed with PROFILE_END() on the same thread. Zones opened while another
+ * zone is open become its children, so each thread builds a tree of zones.
+ * A zone is identified by its key and its parent. The key is the address of
+ * the name for PROFILE_BEGIN(), so the name must be a string literal or live
+ * as long as the profiler. PROFILE_BEGIN_KEY() can be used for objects that
+ * have a name of their own, such as events or plugins.
+ *
+ * Every thread gets its own profiler_thread_t buffer, see thread_ring.h. A
+ * buffer holds:
+ *   + A table of the zones seen by the thread. The name is copied the first
+ *     time a zone is entered.
+ *   + A ring of the most recent closed zones with their start and end cycle
+ *     counts, which profiler_dump_chrome() writes as a Chrome trace.
+ *
+ * profiler_end_frame() is called once per iteration of games_run_all(), so
+ * all games share one frame. It merges the zones closed by all threads since
+ * the previous frame into a single tree, where zones with the same name and
+ * the same path are one node. For every node, the time spent in it during
+ * the frame is summed and added to the node's statistics (min, mean, max and
+ * the 99th percentile over the last PROFILER_HISTORY_SIZE frames the node
+ * was entered in). Zones closed outside of the main loop, e.g. while loading
+ * plugins, count towards the next frame.
+ *
+ * A zone costs two reads of cycle_counter(), a lookup in a small hash table
+ * and a release store. The counter reads dominate, so on hardware with a
+ * fast TSC a zone stays well below 50 ns.
+ *
+ * Like trace.h, the merged tree is built from the buffers of other threads
+ * without synchronisation. A thread writing more than PROFILER_RING_SIZE
+ * zones in a single frame overwrites zones that weren't merged yet, those
+ * are counted as dropped. profiler_clear() and profiler_dump_chrome() must
+ * not be called while other threads are recording.
+ */
+
+#ifndef FRAMEWORK_PROFILER_H
+#define FRAMEWORK_PROFILER_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+#include "framework/thread_ring.h"
+
+C_HEADER_BEGIN
+
+#ifdef ENABLE_PROFILER
+
+/* number of closed zones each thread keeps, must be a power of two */
+#define PROFILER_RING_SIZE 8192
+
+/* number of distinct zones each thread can enter, must be a power of two */
+#define PROFILER_ZONE_TABLE_SIZE 512
+
+/* zones can be nested this deep, deeper zones aren't recorded */
+#define PROFILER_MAX_DEPTH 64
+
+/* number of nodes in the merged tree */
+#define PROFILER_MAX_NODES 256
+
+/* number of frames the percentile is computed over */
+#define PROFILER_HISTORY_SIZE 128
+
+/* marks the absence of a zone or node index */
+#define PROFILER_NONE 0xFFFFFFFF
+
+struct profiler_zone_t
+{
+	uintptr_t key;              /* 0 if the slot is free */
+	uint32_t parent;            /* index of the enclosing zone, or PROFILER_NONE */
+	uint32_t node;              /* merged node, only touched by profiler_end_frame() */
+	char* name;                 /* copy, NULL if the zone has no name */
+};
+
+struct profiler_thread_t
+{
+	struct thread_ring_t ring;  /* records are keyed by the index into the zone table */
+	uint32_t read_pos;          /* records merged so far, only touched by profiler_end_frame() */
+	uint32_t depth;             /* number of open zones, can exceed PROFILER_MAX_DEPTH */
+	uint32_t zone_count;
+	uint32_t zones_dropped;     /* zones not recorded because a table was full or nesting too deep */
+	uint32_t records_dropped;   /* overwritten before they were merged, only touched by profiler_end_frame() */
+	uint32_t open_zone[PROFILER_MAX_DEPTH];
+	uint64_t open_start[PROFILER_MAX_DEPTH];
+	struct profiler_zone_t zone[PROFILER_ZONE_TABLE_SIZE];
+};
+
+struct profiler_stats_t
+{
+	uint32_t frames;            /* number of frames the zone was entered in */
+	uint64_t calls;             /* number of times the zone was entered */
+	uint64_t min_ns;            /* time spent in the zone per frame */
+	uint64_t mean_ns;
+	uint64_t max_ns;
+	uint64_t p99_ns;            /* over the last PROFILER_HISTORY_SIZE frames */
+};
+
+/*!
+ * @brief Opens a zone named after a string literal. Use as a statement.
+ */
+#define PROFILE_BEGIN(name) profiler_begin((uintptr_t)(name), name)
+
+/*!
+ * @brief Opens a zone identified by the address of an object.
+ * @param key The address of the object.
+ * @param name The name of the object, or NULL. Only read the first time the
+ * zone is entered.
+ */
+#define PROFILE_BEGIN_KEY(key, name) profiler_begin(key, name)
+
+/*!
+ * @brief Closes the most recently opened zone of the calling thread.
+ */
+#define PROFILE_END() profiler_end()
+
+/*!
+ * @brief Wraps a statement in a zone. Leaving the statement with return,
+ * break or goto leaves the zone open, use PROFILE_BEGIN() and PROFILE_END()
+ * in that case.
+ */
+#define PROFILE_SCOPE(name, code) do {                                      \
+			PROFILE_BEGIN(name);                                            \
+			code;                                                           \
+			PROFILE_END();                                                  \
+		} while(0)
+
+void
+profiler_init(void);
+
+/*!
+ * @brief Frees the buffers of all threads and the merged tree. No other
+ * thread may be recording. Threads recording after this get a new buffer.
+ */
+void
+profiler_deinit(void);
+
+/*!
+ * @brief Opens a zone on the calling thread, see PROFILE_BEGIN_KEY().
+ * @return Returns the cycle count the zone starts at, so other
+ * instrumentation of the same call can reuse it.
+ */
+FRAMEWORK_PUBLIC_API uint64_t
+profiler_begin(uintptr_t key, const char* name);
+
+/*!
+ * @brief Closes the most recently opened zone on the calling thread. Does
+ * nothing if no zone is open.
+ * @return Returns the cycle count the zone ends at.
+ */
+FRAMEWORK_PUBLIC_API uint64_t
+profiler_end(void);
+
+/*!
+ * @brief Merges all zones closed since the last call into the tree and
+ * updates the statistics of every node entered in this frame. Must only be
+ * called from one thread.
+ */
+FRAMEWORK_PUBLIC_API void
+profiler_end_frame(void);
+
+/*!
+ * @brief Returns the number of frames ended since the profiler was cleared.
+ */
+FRAMEWORK_PUBLIC_API uint32_t
+profiler_get_frame_count(void);
+
+/*!
+ * @brief Looks up a node of the merged tree and copies its statistics.
+ * @param[in] path The names of the zones from the root down to the node,
+ * separated by '/', e.g. "main_loop/tick". Zones without a name can't be
+ * looked up.
+ * @param[out] stats Receives the statistics.
+ * @return Returns 0 if the node doesn't exist, 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+profiler_get_stats(const char* path, struct profiler_stats_t* stats);
+
+/*!
+ * @brief Discards all zones, records and statistics of all threads.
+ */
+FRAMEWORK_PUBLIC_API void
+profiler_clear(void);
+
+/*!
+ * @brief Logs the merged tree with the statistics of every node.
+ */
+FRAMEWORK_PUBLIC_API void
+profiler_report(void);
+
+/*!
+ * @brief Writes the records of all threads to a file in the Chrome trace
+ * event format.
+ * @return Returns 0 if the file couldn't be written, 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+profiler_dump_chrome(const char* file_name);
+
+#else /* ENABLE_PROFILER */
+#   define PROFILE_BEGIN(name) ((void)0)
+#   define PROFILE_BEGIN_KEY(key, name) ((void)0)
+#   define PROFILE_END() ((void)0)
+#   define PROFILE_SCOPE(name, code) do {                                   \
+			code;                                                           \
+		} while(0)
+#endif /* ENABLE_PROFILER */
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_PROFILER_H */
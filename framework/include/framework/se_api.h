@@ -3,8 +3,10 @@
 
 #include "framework/config.h"
 #include "framework/log.h"
+#include "framework/trace.h"
 #include "framework/plugin.h"
 #include "util/dynamic_call.h"
+#include "util/atomic.h"
 #include "util/unordered_vector.h"
 #include "util/pstdint.h"
 
@@ -22,6 +24,10 @@ struct event_t;
 
 typedef void (*service_func)(struct service_t* service, void* ret, const void** argv);
 typedef void (*event_callback_func)(struct event_t* event, const void** argv);
+typedef void (*service_batch_func)(struct service_t* service, void* ret,
+								   uint32_t count, const void** argv);
+/* native entry point of a typed service, cast to its real signature before calling */
+typedef void (*service_native_func)(void);
 
 /*!
  * @brief Makes sure a directory name contains only valid characters. This gets
@@ -57,6 +63,33 @@ directory_name_is_valid(const char* directory);
 #define SERVICE(func_name) \
 		void func_name(struct service_t* service, void* ret, const void** argv)
 
+/*!
+ * @brief Helper macro for defining the batch implementation of a service.
+ *
+ * A batch implementation performs *count* calls of the service at once. The
+ * arguments are passed as columns: argv[i] points to an array of *count*
+ * values of argument i, see EXTRACT_ARGUMENT_COLUMN(). Arguments callers pass
+ * with PTR() are columns of pointers. If the service returns a value, ret
+ * points to an array of *count* return values, or is NULL if the caller
+ * doesn't want them.
+ *
+ * Batch implementations are optional, see service_set_batch() and
+ * SERVICE_CALL_BATCHn().
+ * @param func_name The name to give the batch function.
+ */
+#define SERVICE_BATCH(func_name) \
+		void func_name(struct service_t* service, void* ret, uint32_t count, \
+					   const void** argv)
+
+/*!
+ * @brief Helper macro for extracting an argument column in a batch function.
+ * @param index The index of the argument, beginning at 0.
+ * @param var The identifier of the array.
+ * @param type The type of the argument.
+ */
+#define EXTRACT_ARGUMENT_COLUMN(index, var, type) \
+		type* var = (type*)argv[index]
+
 /*!
  * @brief Helper marco for defining an event listener function.
  *
@@ -126,6 +159,30 @@ directory_name_is_valid(const char* directory);
 #define EVENT_ITERATE_LISTENERS_END                                         \
 			UNORDERED_VECTOR_END_EACH
 
+/*
+ * Calls all listeners of an event. Safe to use from any thread, see events.h.
+ */
+#define EVENT_DISPATCH(event, argv)                                         \
+			event_fire(event, argv);
+
+/*
+ * Calls a service. If tracing is enabled, the call is recorded, see trace.h.
+ * In debug mode, calls from the wrong thread are reported, see
+ * service_set_affinity().
+ */
+#ifdef _DEBUG
+#   define SERVICE_CHECK_AFFINITY(service)                                  \
+			if((service)->affinity != SERVICE_AFFINITY_ANY_THREAD)          \
+				service_check_affinity(service);
+#else
+#   define SERVICE_CHECK_AFFINITY(service)
+#endif
+#define SERVICE_DISPATCH(service, ret_value, argv)                          \
+			SERVICE_CHECK_AFFINITY(service)                                 \
+			TRACE_CALL(TRACE_SERVICE, (uintptr_t)(service),                 \
+			           (service)->directory,                                \
+			           (service)->exec(service, ret_value, argv));
+
 /* creates and fills out the void** argument vector on the stack */
 #define GEN_ARGV_ON_STACK1(argv, arg1)                                      \
 		const void* argv[1];                                                \
@@ -178,60 +235,96 @@ directory_name_is_valid(const char* directory);
  */
 #define EVENT_FIRE0(event) do {                                             \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 0)                          \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, NULL);                            \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, NULL)                                 \
 			ELSE_REPORT_FAILURE(event, 0)                                   \
 		} while(0)
 #define EVENT_FIRE1(event, arg1) do {                                       \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 1)                          \
 				GEN_ARGV_ON_STACK1(event_internal_argv, arg1)               \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
 			ELSE_REPORT_FAILURE(event, 1)                                   \
 		} while(0)
 #define EVENT_FIRE2(event, arg1, arg2) do {                                 \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 2)                          \
 				GEN_ARGV_ON_STACK2(event_internal_argv, arg1, arg2)         \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
 			ELSE_REPORT_FAILURE(event, 2)                                   \
 		} while(0)
 #define EVENT_FIRE3(event, arg1, arg2, arg3) do {                           \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 3)                          \
 				GEN_ARGV_ON_STACK3(event_internal_argv, arg1, arg2, arg3)   \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
 			ELSE_REPORT_FAILURE(event, 3)                                   \
 		} while(0)
 #define EVENT_FIRE4(event, arg1, arg2, arg3, arg4) do {                     \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 4)                          \
 				GEN_ARGV_ON_STACK4(event_internal_argv, arg1, arg2, arg3,   \
 								   arg4)                                    \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
 			ELSE_REPORT_FAILURE(event, 4)                                   \
 		} while(0)
 #define EVENT_FIRE5(event, arg1, arg2, arg3, arg4, arg5) do {               \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 5)                          \
 				GEN_ARGV_ON_STACK5(event_internal_argv, arg1, arg2, arg3,   \
 								   arg4, arg5)                              \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
 			ELSE_REPORT_FAILURE(event, 5)                                   \
 		} while(0)
 #define EVENT_FIRE6(event, arg1, arg2, arg3, arg4, arg5, arg6) do {         \
 			IF_OBJECT_VALID_AND_HAS_ARGC(event, 6)                          \
 				GEN_ARGV_ON_STACK6(event_internal_argv, arg1, arg2, arg3,   \
 								   arg4, arg5, arg6)                        \
-				EVENT_ITERATE_LISTENERS_BEGIN(event)                        \
-					listener->exec(event, event_internal_argv);             \
-				EVENT_ITERATE_LISTENERS_END                                 \
+				EVENT_DISPATCH(event, event_internal_argv)                  \
+			ELSE_REPORT_FAILURE(event, 6)                                   \
+		} while(0)
+
+/*!
+ * @brief Queues an event for deferred delivery. Same as EVENT_FIREn(), except
+ * that the listeners are called when the game's event queue is drained at the
+ * start of the next main loop iteration. See framework/event_queue.h.
+ * @note Arguments of known types are copied into the queue. Arguments of
+ * unknown types are queued by reference and must stay valid until delivery.
+ */
+#define EVENT_POST0(event) do {                                             \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 0)                          \
+				event_post(event, NULL);                                    \
+			ELSE_REPORT_FAILURE(event, 0)                                   \
+		} while(0)
+#define EVENT_POST1(event, arg1) do {                                       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 1)                          \
+				GEN_ARGV_ON_STACK1(event_internal_argv, arg1)               \
+				event_post(event, event_internal_argv);                     \
+			ELSE_REPORT_FAILURE(event, 1)                                   \
+		} while(0)
+#define EVENT_POST2(event, arg1, arg2) do {                                 \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 2)                          \
+				GEN_ARGV_ON_STACK2(event_internal_argv, arg1, arg2)         \
+				event_post(event, event_internal_argv);                     \
+			ELSE_REPORT_FAILURE(event, 2)                                   \
+		} while(0)
+#define EVENT_POST3(event, arg1, arg2, arg3) do {                           \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 3)                          \
+				GEN_ARGV_ON_STACK3(event_internal_argv, arg1, arg2, arg3)   \
+				event_post(event, event_internal_argv);                     \
+			ELSE_REPORT_FAILURE(event, 3)                                   \
+		} while(0)
+#define EVENT_POST4(event, arg1, arg2, arg3, arg4) do {                     \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 4)                          \
+				GEN_ARGV_ON_STACK4(event_internal_argv, arg1, arg2, arg3, arg4) \
+				event_post(event, event_internal_argv);                     \
+			ELSE_REPORT_FAILURE(event, 4)                                   \
+		} while(0)
+#define EVENT_POST5(event, arg1, arg2, arg3, arg4, arg5) do {               \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 5)                          \
+				GEN_ARGV_ON_STACK5(event_internal_argv, arg1, arg2, arg3, arg4, arg5) \
+				event_post(event, event_internal_argv);                     \
+			ELSE_REPORT_FAILURE(event, 5)                                   \
+		} while(0)
+#define EVENT_POST6(event, arg1, arg2, arg3, arg4, arg5, arg6) do {         \
+			IF_OBJECT_VALID_AND_HAS_ARGC(event, 6)                          \
+				GEN_ARGV_ON_STACK6(event_internal_argv, arg1, arg2, arg3,   \
+								   arg4, arg5, arg6)                        \
+				event_post(event, event_internal_argv);                     \
 			ELSE_REPORT_FAILURE(event, 6)                                   \
 		} while(0)
 
@@ -263,32 +356,32 @@ directory_name_is_valid(const char* directory);
  */
 #define SERVICE_CALL0(service, ret_value) do {                              \
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 0)                        \
-				(service)->exec(service, ret_value, NULL);                  \
+				SERVICE_DISPATCH(service, ret_value, NULL)                  \
 			ELSE_REPORT_FAILURE(service, 0)                                 \
 			} while(0)
 #define SERVICE_CALL1(service, ret_value, arg1) do {                        \
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 1)                        \
 				GEN_ARGV_ON_STACK1(service_internal_argv, arg1)             \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 1)                                 \
 		} while(0)
 #define SERVICE_CALL2(service, ret_value, arg1, arg2) do {                  \
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 2)                        \
 				GEN_ARGV_ON_STACK2(service_internal_argv, arg1, arg2)       \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 2)                                 \
 		} while(0)
 #define SERVICE_CALL3(service, ret_value, arg1, arg2, arg3) do {            \
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 3)                        \
 				GEN_ARGV_ON_STACK3(service_internal_argv, arg1, arg2, arg3) \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 3)                                 \
 		} while(0)
 #define SERVICE_CALL4(service, ret_value, arg1, arg2, arg3, arg4) do {      \
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 4)                        \
 				GEN_ARGV_ON_STACK4(service_internal_argv, arg1, arg2, arg3, \
 								   arg4)                                    \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 4)                                 \
 		} while(0)
 #define SERVICE_CALL5(service, ret_value, arg1, arg2, arg3, arg4, arg5)     \
@@ -296,7 +389,7 @@ directory_name_is_valid(const char* directory);
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 5)                        \
 				GEN_ARGV_ON_STACK5(service_internal_argv, arg1, arg2, arg3, \
 								   arg4, arg5)                              \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 5)                                 \
 		} while(0)
 #define SERVICE_CALL6(service, ret_value, arg1, arg2, arg3, arg4, arg5,     \
@@ -304,14 +397,239 @@ directory_name_is_valid(const char* directory);
 			IF_OBJECT_VALID_AND_HAS_ARGC(service, 6)                        \
 				GEN_ARGV_ON_STACK6(service_internal_argv, arg1, arg2, arg3, \
 								   arg4, arg5, arg6)                        \
-				(service)->exec(service, ret_value, service_internal_argv); \
+				SERVICE_DISPATCH(service, ret_value, service_internal_argv) \
 			ELSE_REPORT_FAILURE(service, 6)                                 \
 		} while(0)
 
-/* used to retrieve a registered service object by name */
+/*!
+ * @brief Calls a service on the game thread without waiting for it, see
+ * service_queue.h.
+ * @param service The service object to call.
+ * @param ret_value Where to write the return value to, or NULL. Must stay
+ * valid until the call completed.
+ * @param future A pointer to a zero-initialised service_future_t, or NULL.
+ * @param arg... Arguments to pass to the service, as with SERVICE_CALLn().
+ * Arguments of known types are copied.
+ */
+#define SERVICE_CALL_ASYNC0(service, ret_value, future) do {                \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 0)                        \
+				service_call_async(service, ret_value, future, NULL);       \
+			ELSE_REPORT_FAILURE(service, 0)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC1(service, ret_value, future, arg1) do {          \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 1)                        \
+				GEN_ARGV_ON_STACK1(service_internal_argv, arg1)             \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 1)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC2(service, ret_value, future, arg1, arg2) do {    \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 2)                        \
+				GEN_ARGV_ON_STACK2(service_internal_argv, arg1, arg2)       \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 2)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC3(service, ret_value, future, arg1, arg2,         \
+						   arg3) do {                                       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 3)                        \
+				GEN_ARGV_ON_STACK3(service_internal_argv, arg1, arg2,       \
+								   arg3)                                    \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 3)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC4(service, ret_value, future, arg1, arg2,         \
+						   arg3, arg4) do {                                 \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 4)                        \
+				GEN_ARGV_ON_STACK4(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4)                              \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 4)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC5(service, ret_value, future, arg1, arg2,         \
+						   arg3, arg4, arg5) do {                           \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 5)                        \
+				GEN_ARGV_ON_STACK5(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4, arg5)                        \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 5)                                 \
+		} while(0)
+#define SERVICE_CALL_ASYNC6(service, ret_value, future, arg1, arg2,         \
+						   arg3, arg4, arg5, arg6) do {                     \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 6)                        \
+				GEN_ARGV_ON_STACK6(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4, arg5, arg6)                  \
+				service_call_async(service, ret_value, future,              \
+								   service_internal_argv);                  \
+			ELSE_REPORT_FAILURE(service, 6)                                 \
+		} while(0)
+
+/*!
+ * @brief Calls a service on the game thread and waits for it to return, see
+ * service_queue.h. The service is called directly if this is the game thread
+ * or if the service can be called from any thread.
+ * @param service The service object to call.
+ * @param ret_value Where to write the return value to, or NULL.
+ * @param arg... Arguments to pass to the service, as with SERVICE_CALLn().
+ */
+#define SERVICE_CALL_SYNC0(service, ret_value) do {                         \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 0)                        \
+				service_call_sync(service, ret_value, NULL);                \
+			ELSE_REPORT_FAILURE(service, 0)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC1(service, ret_value, arg1) do {                   \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 1)                        \
+				GEN_ARGV_ON_STACK1(service_internal_argv, arg1)             \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 1)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC2(service, ret_value, arg1, arg2) do {             \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 2)                        \
+				GEN_ARGV_ON_STACK2(service_internal_argv, arg1, arg2)       \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 2)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC3(service, ret_value, arg1, arg2, arg3) do {       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 3)                        \
+				GEN_ARGV_ON_STACK3(service_internal_argv, arg1, arg2,       \
+								   arg3)                                    \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 3)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC4(service, ret_value, arg1, arg2, arg3,            \
+						   arg4) do {                                       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 4)                        \
+				GEN_ARGV_ON_STACK4(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4)                              \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 4)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC5(service, ret_value, arg1, arg2, arg3, arg4,      \
+						   arg5) do {                                       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 5)                        \
+				GEN_ARGV_ON_STACK5(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4, arg5)                        \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 5)                                 \
+		} while(0)
+#define SERVICE_CALL_SYNC6(service, ret_value, arg1, arg2, arg3, arg4,      \
+						   arg5, arg6) do {                                 \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 6)                        \
+				GEN_ARGV_ON_STACK6(service_internal_argv, arg1, arg2,       \
+								   arg3, arg4, arg5, arg6)                  \
+				service_call_sync(service, ret_value, service_internal_argv); \
+			ELSE_REPORT_FAILURE(service, 6)                                 \
+		} while(0)
+
+/*!
+ * @brief Calls a service once for every element of the specified argument
+ * columns.
+ *
+ * Each column is an array of *count* values of the respective argument. For
+ * arguments that would be wrapped in PTR() when calling the service with
+ * SERVICE_CALLn(), the column is an array of pointers instead. If the service
+ * has a batch implementation, it is called once. If not, the service
+ * function is called *count* times. Example:
+ * ```
+ * uint32_t id[100];
+ * float x[100], y[100];
+ * ...
+ * SERVICE_CALL_BATCH3(sprite_set_position, NULL, 100, id, x, y);
+ * ```
+ * @param service The service object to call.
+ * @param ret_values If the service returns a value, an array of *count*
+ * elements to write the return values to. Otherwise NULL.
+ * @param count The number of calls, and the number of elements in each
+ * column.
+ * @param column... The argument columns.
+ * @note The number of columns must be equal to the service's number of
+ * arguments. The types of the columns must match the service's argument types
+ * exactly, since the columns are indexed by the size of the type the service
+ * was created with.
+ */
+#define SERVICE_CALL_BATCH1(service, ret_values, count, column1) do {       \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 1)                        \
+				const void* service_internal_columns[1];                    \
+				service_internal_columns[0] = column1;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 1)                                 \
+		} while(0)
+#define SERVICE_CALL_BATCH2(service, ret_values, count, column1,            \
+						   column2) do {                                    \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 2)                        \
+				const void* service_internal_columns[2];                    \
+				service_internal_columns[0] = column1;                      \
+				service_internal_columns[1] = column2;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 2)                                 \
+		} while(0)
+#define SERVICE_CALL_BATCH3(service, ret_values, count, column1,            \
+						   column2, column3) do {                           \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 3)                        \
+				const void* service_internal_columns[3];                    \
+				service_internal_columns[0] = column1;                      \
+				service_internal_columns[1] = column2;                      \
+				service_internal_columns[2] = column3;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 3)                                 \
+		} while(0)
+#define SERVICE_CALL_BATCH4(service, ret_values, count, column1,            \
+						   column2, column3, column4) do {                  \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 4)                        \
+				const void* service_internal_columns[4];                    \
+				service_internal_columns[0] = column1;                      \
+				service_internal_columns[1] = column2;                      \
+				service_internal_columns[2] = column3;                      \
+				service_internal_columns[3] = column4;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 4)                                 \
+		} while(0)
+#define SERVICE_CALL_BATCH5(service, ret_values, count, column1,            \
+						   column2, column3, column4, column5) do {         \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 5)                        \
+				const void* service_internal_columns[5];                    \
+				service_internal_columns[0] = column1;                      \
+				service_internal_columns[1] = column2;                      \
+				service_internal_columns[2] = column3;                      \
+				service_internal_columns[3] = column4;                      \
+				service_internal_columns[4] = column5;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 5)                                 \
+		} while(0)
+#define SERVICE_CALL_BATCH6(service, ret_values, count, column1,            \
+						   column2, column3, column4, column5,              \
+						   column6) do {                                    \
+			IF_OBJECT_VALID_AND_HAS_ARGC(service, 6)                        \
+				const void* service_internal_columns[6];                    \
+				service_internal_columns[0] = column1;                      \
+				service_internal_columns[1] = column2;                      \
+				service_internal_columns[2] = column3;                      \
+				service_internal_columns[3] = column4;                      \
+				service_internal_columns[4] = column5;                      \
+				service_internal_columns[5] = column6;                      \
+				service_call_batch(service, ret_values, count,              \
+				                   service_internal_columns);               \
+			ELSE_REPORT_FAILURE(service, 6)                                 \
+		} while(0)
+
+/*
+ * used to retrieve a registered service object by name. The lookup is cached
+ * per thread and call site, so the service directory is only searched again
+ * if services were created or destroyed in the meantime.
+ */
 #define SERVICE_INTERNAL_GET_AND_CHECK(game, directory)                     \
-		struct service_t* service_internal_service = service_get(game,      \
-														directory);         \
+		static THREAD_LOCAL struct service_call_cache_t                     \
+			service_internal_cache;                                         \
+		struct service_t* service_internal_service = service_get_cached(    \
+			game, directory, &service_internal_cache);                      \
 		if(!service_internal_service)                                       \
 			llog(LOG_WARNING, game, NULL, "Service \"%s\" does not exist",  \
 				directory);                                                 \
@@ -323,7 +641,8 @@ directory_name_is_valid(const char* directory);
  * @param game The game object (context) from which to retrieve the service
  * object specified by "directory".
  * @param directory The directory under which the service object has been
- * registered.
+ * registered. The result of the lookup is cached at each call site, so this
+ * should be a string literal (or at least a string that doesn't change).
  * @param ret_value If the service is supposed to return a value then it will
  * dereference this value and write to it. This means you have to specify a
  * pointer type. Example:
@@ -549,7 +868,7 @@ directory_name_is_valid(const char* directory);
 			const char* ret = STRINGIFY(ret_type);                          \
 			const char* argv[] = {STRINGIFY(arg1), STRINGIFY(arg2)};        \
 			t = dynamic_call_create_type_info(ret, 2, argv);                \
-			if(!t) { ret = NULL; break; }                                   \
+			if(!t) { serv = NULL; break; }                                  \
 			if(!(serv = SERVICE_CREATE(plugin, directory, callback, t)))    \
 				dynamic_call_destroy_type_info(t);                          \
 		} while(0)
@@ -600,6 +919,296 @@ directory_name_is_valid(const char* directory);
 				dynamic_call_destroy_type_info(t);                          \
 		} while(0)
 
+/* ------------------------------------------------------------------------- *
+ * Typed services                                                            *
+ * ------------------------------------------------------------------------- */
+
+#define SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type, arg_types)           \
+		typedef ret_type (*name##_func)arg_types;                           \
+		ret_type name arg_types;                                            \
+		SERVICE(name##_boxed)
+
+/*!
+ * @brief Declares a service with a native C signature.
+ *
+ * SERVICE_CALLn() boxes every argument into a void* vector, which the service
+ * unboxes again with EXTRACT_ARGUMENT(), and the argument count is checked at
+ * runtime. Callers that know the signature of a service at compile time can
+ * call it through SERVICE_CALL_TYPEDn() instead, which is a plain call through
+ * a function pointer and is type checked by the compiler.
+ *
+ * Every macro of this family takes the signature as the return type followed
+ * by a (kind, type) pair per argument. *kind* is PTR for arguments dynamic
+ * callers wrap in PTR() (the ones EXTRACT_ARGUMENT_PTR() would extract) and
+ * VAL for everything else. A header shared by the plugin providing the
+ * service and the plugins calling it declares the service:
+ * ```
+ * SERVICE_TYPED_DECLARE2(my_add, int, VAL, int, PTR, const char*);
+ * ```
+ * This declares:
+ *   - my_add_func : The function pointer type
+ *                   ```int (*)(struct service_t*, int, const char*)```.
+ *   - my_add      : The function implementing the service. The providing
+ *                   plugin defines it.
+ *   - my_add_boxed: A SERVICE() adapter unboxing the argument vector and
+ *                   calling my_add(). This is what dynamic callers such as
+ *                   SERVICE_CALLn(), scripts and menu actions end up calling.
+ *
+ * The providing plugin defines the adapter and the function, and creates the
+ * service with SERVICE_CREATE_TYPEDn():
+ * ```
+ * SERVICE_TYPED_ADAPTER2(my_add, int, VAL, int, PTR, const char*)
+ * int my_add(struct service_t* service, int a, const char* b)
+ * {
+ *     return a + atoi(b);
+ * }
+ *
+ * // elsewhere...
+ *
+ * SERVICE_CREATE_TYPED2(plugin, service, "example.add", my_add,
+ *                       int, VAL, int, PTR, const char*);
+ * ```
+ * Native callers can then use either of:
+ * ```
+ * int result = SERVICE_CALL_TYPED2(my_add, service, 3, "4");
+ * SERVICE_CALL2(service, &result, a, PTR(b));
+ * ```
+ * Services returning void define their adapter with
+ * SERVICE_TYPED_ADAPTER_VOIDn() instead.
+ */
+#define SERVICE_TYPED_DECLARE0(name, ret_type)                              \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*))
+#define SERVICE_TYPED_DECLARE1(name, ret_type, kind1, arg1)                 \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1))
+#define SERVICE_TYPED_DECLARE2(name, ret_type, kind1, arg1, kind2, arg2)    \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1, arg2))
+#define SERVICE_TYPED_DECLARE3(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3)                                 \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1, arg2,      \
+									   arg3))
+#define SERVICE_TYPED_DECLARE4(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4)                    \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1, arg2,      \
+									   arg3, arg4))
+#define SERVICE_TYPED_DECLARE5(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4, kind5, arg5)       \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1, arg2,      \
+									   arg3, arg4, arg5))
+#define SERVICE_TYPED_DECLARE6(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4, kind5, arg5,       \
+							   kind6, arg6)                                 \
+		SERVICE_TYPED_INTERNAL_DECLARE(name, ret_type,                      \
+									   (struct service_t*, arg1, arg2,      \
+									   arg3, arg4, arg5, arg6))
+
+#define SERVICE_TYPED_INTERNAL_UNBOX_VAL(type, index) (*(type*)argv[index])
+#define SERVICE_TYPED_INTERNAL_UNBOX_PTR(type, index) ((type)argv[index])
+#define SERVICE_TYPED_INTERNAL_UNBOX(kind, type, index)                     \
+		SERVICE_TYPED_INTERNAL_UNBOX_##kind(type, index)
+#define SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, unboxed_args)        \
+		SERVICE(name##_boxed)                                               \
+		{                                                                   \
+			ret_type service_internal_ret = name unboxed_args;              \
+			if(ret)                                                         \
+				*(ret_type*)ret = service_internal_ret;                     \
+		}
+#define SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, unboxed_args)             \
+		SERVICE(name##_boxed)                                               \
+		{                                                                   \
+			name unboxed_args;                                              \
+		}
+
+/*!
+ * @brief Defines the boxed adapter of a service declared with
+ * SERVICE_TYPED_DECLAREn(). The signature must be identical to the
+ * declaration.
+ * @note The return value is only written if the caller supplied a location
+ * for it.
+ */
+#define SERVICE_TYPED_ADAPTER0(name, ret_type)                              \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service))
+#define SERVICE_TYPED_ADAPTER1(name, ret_type, kind1, arg1)                 \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0)))
+#define SERVICE_TYPED_ADAPTER2(name, ret_type, kind1, arg1, kind2, arg2)    \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1)))
+#define SERVICE_TYPED_ADAPTER3(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3)                                 \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2)))
+#define SERVICE_TYPED_ADAPTER4(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4)                    \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3)))
+#define SERVICE_TYPED_ADAPTER5(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4, kind5, arg5)       \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind5, arg5, 4)))
+#define SERVICE_TYPED_ADAPTER6(name, ret_type, kind1, arg1, kind2, arg2,    \
+							   kind3, arg3, kind4, arg4, kind5, arg5,       \
+							   kind6, arg6)                                 \
+		SERVICE_TYPED_INTERNAL_ADAPTER(name, ret_type, (service,            \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind5, arg5, 4),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind6, arg6, 5)))
+#define SERVICE_TYPED_ADAPTER_VOID0(name)                                   \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service))
+#define SERVICE_TYPED_ADAPTER_VOID1(name, kind1, arg1)                      \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0)))
+#define SERVICE_TYPED_ADAPTER_VOID2(name, kind1, arg1, kind2, arg2)         \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1)))
+#define SERVICE_TYPED_ADAPTER_VOID3(name, kind1, arg1, kind2, arg2,         \
+									kind3, arg3)                            \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2)))
+#define SERVICE_TYPED_ADAPTER_VOID4(name, kind1, arg1, kind2, arg2,         \
+									kind3, arg3, kind4, arg4)               \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3)))
+#define SERVICE_TYPED_ADAPTER_VOID5(name, kind1, arg1, kind2, arg2,         \
+									kind3, arg3, kind4, arg4, kind5,        \
+									arg5)                                   \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind5, arg5, 4)))
+#define SERVICE_TYPED_ADAPTER_VOID6(name, kind1, arg1, kind2, arg2,         \
+									kind3, arg3, kind4, arg4, kind5,        \
+									arg5, kind6, arg6)                      \
+		SERVICE_TYPED_INTERNAL_ADAPTER_VOID(name, (service,                 \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind1, arg1, 0),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind2, arg2, 1),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind3, arg3, 2),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind4, arg4, 3),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind5, arg5, 4),                   \
+			SERVICE_TYPED_INTERNAL_UNBOX(kind6, arg6, 5)))
+
+#define SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                       \
+		if(serv) {                                                          \
+			name##_func service_internal_native = name;                     \
+			(serv)->native = (service_native_func)service_internal_native;  \
+		}
+
+/*!
+ * @brief Creates a service declared with SERVICE_TYPED_DECLAREn(). Works like
+ * SERVICE_CREATEn(), but registers name##_boxed() for dynamic callers and
+ * name() as the native entry point. The signature must be identical to the
+ * declaration.
+ */
+#define SERVICE_CREATE_TYPED0(plugin, serv, directory, name,                \
+							  ret_type) do {                                \
+			SERVICE_CREATE0(plugin, serv, directory, name##_boxed,          \
+							ret_type);                                      \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED1(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1) do {                             \
+			SERVICE_CREATE1(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1);                                \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED2(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1, kind2, arg2) do {                \
+			SERVICE_CREATE2(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1, arg2);                          \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED3(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1, kind2, arg2, kind3,              \
+							  arg3) do {                                    \
+			SERVICE_CREATE3(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1, arg2, arg3);                    \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED4(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1, kind2, arg2, kind3, arg3,        \
+							  kind4, arg4) do {                             \
+			SERVICE_CREATE4(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1, arg2, arg3, arg4);              \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED5(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1, kind2, arg2, kind3, arg3,        \
+							  kind4, arg4, kind5, arg5) do {                \
+			SERVICE_CREATE5(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1, arg2, arg3, arg4, arg5);        \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+#define SERVICE_CREATE_TYPED6(plugin, serv, directory, name, ret_type,      \
+							  kind1, arg1, kind2, arg2, kind3, arg3,        \
+							  kind4, arg4, kind5, arg5, kind6,              \
+							  arg6) do {                                    \
+			SERVICE_CREATE6(plugin, serv, directory, name##_boxed,          \
+							ret_type, arg1, arg2, arg3, arg4, arg5,         \
+							arg6);                                          \
+			SERVICE_TYPED_INTERNAL_SET_NATIVE(serv, name)                   \
+		} while(0)
+
+#define SERVICE_TYPED_INTERNAL_CALL(name, service, args)                    \
+		(((name##_func)(service)->native)args)
+
+/*!
+ * @brief Calls a service created with SERVICE_CREATE_TYPEDn() through its
+ * native entry point. This is an expression evaluating to the service's
+ * return value.
+ * @param name The name the service was declared with. The arguments are type
+ * checked against its signature.
+ * @param service The service object to call. It is evaluated twice.
+ * @note Unlike SERVICE_CALLn(), nothing is checked at runtime. The service
+ * must not be NULL and must have been created with SERVICE_CREATE_TYPEDn()
+ * from the same declaration. Calls made this way aren't traced.
+ */
+#define SERVICE_CALL_TYPED0(name, service)                                  \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service))
+#define SERVICE_CALL_TYPED1(name, service, arg1)                            \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1))
+#define SERVICE_CALL_TYPED2(name, service, arg1, arg2)                      \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1,          \
+									arg2))
+#define SERVICE_CALL_TYPED3(name, service, arg1, arg2, arg3)                \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1, arg2,    \
+									arg3))
+#define SERVICE_CALL_TYPED4(name, service, arg1, arg2, arg3, arg4)          \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1, arg2,    \
+									arg3, arg4))
+#define SERVICE_CALL_TYPED5(name, service, arg1, arg2, arg3, arg4, arg5)    \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1, arg2,    \
+									arg3, arg4, arg5))
+#define SERVICE_CALL_TYPED6(name, service, arg1, arg2, arg3, arg4, arg5,    \
+							arg6)                                           \
+		SERVICE_TYPED_INTERNAL_CALL(name, service, (service, arg1, arg2,    \
+									arg3, arg4, arg5, arg6))
+
 /*!
  * @brief Helper macro for creating listener functions with up to 4 receiving
  * function parameters.
@@ -0,0 +1,98 @@
+/*!
+ * @file service_memo.h
+ * @brief Result caching for services that are pure functions of their
+ * arguments.
+ *
+ * A service registered as pure with service_set_pure() owns a
+ * service_memo_t object. Its exec function is replaced by one that looks up
+ * the arguments in a bounded cache first and only calls the service's own
+ * implementation on a miss. The least recently used result is evicted when
+ * the cache is full.
+ *
+ * The cache key is built from the argument bytes as described by the
+ * service's type_info_t. Strings are keyed by their contents, not by their
+ * address. Services with arguments of unknown types can't be pure, since
+ * the memory behind the pointers can change without the cache noticing.
+ * Neither can services returning strings or unknown types, because the
+ * cache doesn't own the memory the pointers point to.
+ *
+ * SERVICE_CALL_TYPEDn() and batch implementations bypass the cache.
+ */
+
+#ifndef FRAMEWORK_SERVICE_MEMO_H
+#define FRAMEWORK_SERVICE_MEMO_H
+
+#include "util/pstdint.h"
+#include "util/bst_vector.h"
+#include "framework/config.h"
+#include "framework/se_api.h"
+
+C_HEADER_BEGIN
+
+struct service_t;
+struct service_memo_entry_t;
+
+struct service_memo_stats_t
+{
+	uint32_t capacity;      /* number of results the cache can hold */
+	uint32_t count;         /* number of results currently cached */
+	uint32_t hits;          /* calls answered from the cache */
+	uint32_t misses;        /* calls that had to execute the service */
+	uint32_t evictions;     /* results dropped because the cache was full */
+	uint32_t invalidations; /* calls to service_invalidate_cache() */
+};
+
+struct service_memo_t
+{
+	service_func exec;      /* the service's own implementation */
+	uint32_t ret_size;
+	struct bstv_t entries;  /* maps key hashes to service_memo_entry_t objects */
+	struct service_memo_entry_t* most_recent;
+	struct service_memo_entry_t* least_recent;
+	struct service_memo_stats_t stats;
+	uint32_t generation;    /* incremented by service_invalidate_cache() */
+	int lock;               /* services can be called from any thread - use atomics */
+};
+
+/*!
+ * @brief Registers a service as pure, i.e. its return value only depends on
+ * its arguments and it has no side effects.
+ * @param[in] capacity The number of results to cache. Pass 0 to unregister
+ * the service and discard its cache.
+ * @return Returns 0 if the service's signature can't be cached or if memory
+ * couldn't be allocated, in which case the service is left unchanged.
+ * Returns 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+service_set_pure(struct service_t* service, uint32_t capacity);
+
+/*!
+ * @brief Discards all cached results of a pure service. Call this whenever
+ * something the results depend on changed, e.g. a font was reloaded.
+ */
+FRAMEWORK_PUBLIC_API void
+service_invalidate_cache(struct service_t* service);
+
+/*!
+ * @brief Returns the cache statistics of a pure service, or NULL if the
+ * service isn't pure.
+ */
+FRAMEWORK_PUBLIC_API const struct service_memo_stats_t*
+service_get_cache_stats(const struct service_t* service);
+
+/*!
+ * @brief Resets the hit, miss, eviction and invalidation counters of a pure
+ * service.
+ */
+FRAMEWORK_PUBLIC_API void
+service_reset_cache_stats(struct service_t* service);
+
+/*!
+ * @brief Destroys the service's service_memo_t object, if any.
+ */
+void
+service_memo_destroy(struct service_t* service);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_SERVICE_MEMO_H */
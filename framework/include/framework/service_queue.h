@@ -0,0 +1,138 @@
+/*!
+ * @file service_queue.h
+ * @brief Marshalling of service calls onto the game thread.
+ *
+ * Some services may only be called from the thread running the game's main
+ * loop, e.g. because they use an OpenGL context. They are marked with
+ * SERVICE_AFFINITY_GAME_THREAD, see service_set_affinity(). Other threads
+ * (worker jobs, scripts) call them through the game's service queue instead:
+ *   + SERVICE_CALL_ASYNCn() copies the arguments into a command, pushes it
+ *     onto the queue and returns immediately. The caller can pass a
+ *     service_future_t to find out when the call completed, to wait for it
+ *     or to be called back.
+ *   + SERVICE_CALL_SYNCn() does the same, but blocks until the call
+ *     completed. If the caller is on the game thread already, or the service
+ *     can be called from any thread, the service is called directly.
+ *
+ * The queue is a lock free multiple producer, single consumer stack. It is
+ * drained once per iteration of the main loop, together with the event
+ * queue, and the commands are executed in the order they were pushed.
+ *
+ * Arguments of known types (integers, floats, strings) are copied by
+ * SERVICE_CALL_ASYNCn(). Arguments of unknown types (i.e. pointers to
+ * structs) are queued by reference and must therefore stay valid until the
+ * call completed.
+ *
+ * @warning SERVICE_CALL_SYNCn() deadlocks if the game thread is waiting for
+ * the calling thread, e.g. in thread_pool_wait_for_jobs().
+ */
+
+#ifndef FRAMEWORK_SERVICE_QUEUE_H
+#define FRAMEWORK_SERVICE_QUEUE_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+
+C_HEADER_BEGIN
+
+struct game_t;
+struct service_t;
+struct service_future_t;
+
+/* maximum number of arguments a queued call can have, see SERVICE_CALL6() */
+#define SERVICE_QUEUE_MAX_ARGS 6
+
+/*!
+ * @brief Called on the game thread after a queued service call returned.
+ * @param[in] ret The location the return value was written to, as passed to
+ * SERVICE_CALL_ASYNCn().
+ */
+typedef void (*service_done_func)(struct service_future_t* future,
+								  struct service_t* service,
+								  void* ret);
+
+/*!
+ * @brief Tracks a queued service call. Must be zero-initialised and must stay
+ * valid until the call completed.
+ */
+struct service_future_t
+{
+	service_done_func on_done;  /* optional */
+	void* user_data;
+	int done;                   /* set once the call completed or was discarded - use atomics */
+};
+
+struct service_queue_t
+{
+	struct service_command_t* pushed;     /* most recently pushed command first - use atomics */
+	struct service_command_t* pending;    /* in push order, game thread only */
+	struct service_command_t* delivering; /* being executed, game thread only */
+};
+
+char
+service_queue_init(struct game_t* game);
+
+/*!
+ * @brief Discards all queued calls without executing them. Their futures are
+ * marked as done, but no callbacks are called.
+ */
+void
+service_queue_deinit(struct game_t* game);
+
+/*!
+ * @brief Discards all queued calls to a service. Their futures are marked as
+ * done, but no callbacks are called. Must be called on the game thread.
+ */
+void
+service_queue_discard_service(struct game_t* game,
+							  const struct service_t* service);
+
+/*!
+ * @brief Executes all queued calls. Must be called on the game thread. Calls
+ * queued by the services being executed are executed during the next call.
+ */
+FRAMEWORK_PUBLIC_API void
+service_queue_dispatch(struct game_t* game);
+
+/*!
+ * @brief Queues a call to a service on the game thread of the service's game.
+ * Use SERVICE_CALL_ASYNCn() instead of calling this directly.
+ * @param[in] ret Where to write the return value to, or NULL. Must stay
+ * valid until the call completed.
+ * @param[in] future Optional, see service_future_t.
+ * @return Returns 0 if memory couldn't be allocated, in which case the service
+ * isn't called and the future isn't touched. Returns 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+service_call_async(struct service_t* service,
+				   void* ret,
+				   struct service_future_t* future,
+				   const void** argv);
+
+/*!
+ * @brief Calls a service on the game thread of the service's game and waits
+ * for it to return. Use SERVICE_CALL_SYNCn() instead of calling this
+ * directly.
+ * @return Returns 0 if memory couldn't be allocated, in which case the service
+ * isn't called. Returns 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+service_call_sync(struct service_t* service, void* ret, const void** argv);
+
+/*!
+ * @brief Returns 1 if the call tracked by the future completed, 0 if
+ * otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+service_future_is_done(struct service_future_t* future);
+
+/*!
+ * @brief Blocks until the call tracked by the future completed. Must not be
+ * called on the game thread.
+ */
+FRAMEWORK_PUBLIC_API void
+service_future_wait(struct service_future_t* future);
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_SERVICE_QUEUE_H */
@@ -2,6 +2,8 @@
 #define FRAMEWORK_SERVICES_H
 
 #include "framework/se_api.h"
+#include "framework/service_queue.h"
+#include "framework/service_memo.h"
 
 C_HEADER_BEGIN
 
@@ -9,14 +11,58 @@ struct game_t;
 struct ordered_vector_t;
 struct plugin_t;
 
+typedef enum service_affinity_e
+{
+	SERVICE_AFFINITY_ANY_THREAD = 0,  /* default, the service is thread safe */
+	SERVICE_AFFINITY_GAME_THREAD      /* may only be called on the game thread, see service_queue.h */
+} service_affinity_e;
+
 struct service_t
 {
 	struct plugin_t* plugin;    /* reference to the plugin that owns this service */
 	char* directory;
 	service_func exec;
+	service_native_func native; /* NULL unless created with SERVICE_CREATE_TYPEDn() */
+	service_batch_func batch;   /* NULL if the service has no batch implementation */
+	service_affinity_e affinity;
+	struct service_memo_t* memo; /* NULL unless the service is pure, see service_memo.h */
 	struct type_info_t* type_info;
 };
 
+/*!
+ * @brief A persistent reference to a service, resolved by directory name.
+ *
+ * Handles are obtained with service_handle_acquire() and stay valid until
+ * they are released, regardless of whether the service they refer to exists.
+ * When a service is destroyed, all handles referring to it are set to NULL.
+ * When a service is (re-)created under the same directory, e.g. because a
+ * plugin was reloaded, the handles are bound to the new service. Calling
+ * through a handle therefore costs no more than calling the service directly:
+ * ```
+ * SERVICE_CALL1(handle->service, &ret, arg);
+ * ```
+ * All handles acquired for the same directory are the same object and are
+ * reference counted.
+ */
+struct service_handle_t
+{
+	struct service_t* service;  /* NULL while no service exists under the directory */
+	struct game_t* game;
+	uint32_t refcount;
+};
+
+/*!
+ * @brief Caches the result of a service lookup at a single call site. See
+ * SERVICE_CALL_NAMEn().
+ */
+struct service_call_cache_t
+{
+	const struct game_t* game;
+	const char* directory;
+	uint32_t generation;
+	struct service_t* service;
+};
+
 /*!
  * @brief Initialises the service system. This must be called before calling any
  * other service related functions.
@@ -71,6 +117,77 @@ service_destroy_all_matching(const char* pattern);
 FRAMEWORK_PUBLIC_API struct service_t*
 service_get(struct game_t* game, const char* directory);
 
+/*!
+ * @brief Same as service_get(), but only walks the service directory if a
+ * service was created or destroyed since the last call with the same cache
+ * object, or if the game or directory changed.
+ * @note The directory is compared by address, so the string it points to
+ * must not change. String literals are fine.
+ * @param[in,out] cache Should be zero-initialised before the first call. A
+ * cache must only be used by one thread at a time, SERVICE_CALL_NAMEn() uses
+ * one per thread and call site.
+ */
+FRAMEWORK_PUBLIC_API struct service_t*
+service_get_cached(struct game_t* game,
+				   const char* directory,
+				   struct service_call_cache_t* cache);
+
+/*!
+ * @brief Returns a handle to the service registered under the specified
+ * directory. The service doesn't have to exist yet.
+ * @note Handles must be released before the game is destroyed.
+ * @return Returns the handle, or NULL if memory couldn't be allocated.
+ */
+FRAMEWORK_PUBLIC_API struct service_handle_t*
+service_handle_acquire(struct game_t* game, const char* directory);
+
+/*!
+ * @brief Releases a handle previously acquired with service_handle_acquire().
+ */
+FRAMEWORK_PUBLIC_API void
+service_handle_release(struct service_handle_t* handle);
+
+/*!
+ * @brief Sets the batch implementation of a service, see SERVICE_BATCH().
+ * @param[in] batch The batch function, or NULL to remove it again.
+ */
+FRAMEWORK_PUBLIC_API void
+service_set_batch(struct service_t* service, service_batch_func batch);
+
+/*!
+ * @brief Sets which threads a service may be called from. Should be called
+ * right after creating the service.
+ *
+ * Services with SERVICE_AFFINITY_GAME_THREAD can be called from other threads
+ * with SERVICE_CALL_SYNCn() and SERVICE_CALL_ASYNCn(). In debug builds,
+ * calling them from another thread with SERVICE_CALLn() logs an error.
+ */
+FRAMEWORK_PUBLIC_API void
+service_set_affinity(struct service_t* service, service_affinity_e affinity);
+
+/*!
+ * @brief Logs an error if the calling thread isn't allowed to call the
+ * service directly. Used by SERVICE_CALLn() in debug builds.
+ */
+FRAMEWORK_PUBLIC_API void
+service_check_affinity(const struct service_t* service);
+
+/*!
+ * @brief Calls a service once for every element of the argument columns. Use
+ * SERVICE_CALL_BATCHn() instead of calling this directly.
+ *
+ * If the service has no batch implementation, its service function is called
+ * in a loop with an argument vector pointing into the columns.
+ * @return Returns 0 if the service has no batch implementation and one of its
+ * argument or return types is unknown, so the columns can't be indexed.
+ * Nothing is called in that case. Returns 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+service_call_batch(struct service_t* service,
+				   void* ret,
+				   uint32_t count,
+				   const void** columns);
+
 C_HEADER_END
 
 #endif /* FRAMEWORK_SERVICES_H */
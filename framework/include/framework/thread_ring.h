@@ -0,0 +1,161 @@
+/*!
+ * @file thread_ring.h
+ * @brief Per-thread rings of timed records, shared by trace.h and profiler.h.
+ *
+ * Every thread recording into a list gets its own buffer, so recording never
+ * takes a lock. Each thread only ever writes to its own buffer. The list of
+ * buffers is shared, new buffers are pushed to it with a CAS.
+ *
+ * A buffer starts with a thread_ring_t, followed by whatever the owner of the
+ * list keeps per thread (e.g. a table of counters), followed by the ring of
+ * the most recent records. Records only need to be visible before the
+ * position that publishes them, so readers on other threads see complete
+ * records as long as the writer hasn't wrapped around in the meantime.
+ *
+ * The owner keeps the calling thread's buffer in a THREAD_LOCAL pointer and
+ * passes it to thread_ring_get(). thread_ring_list_deinit() frees the buffers
+ * of all threads, but can't reset the pointers other threads hold. It bumps
+ * the list's generation instead, and a pointer is only used if it was handed
+ * out in the current generation.
+ */
+
+#ifndef FRAMEWORK_THREAD_RING_H
+#define FRAMEWORK_THREAD_RING_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+
+#if defined(ENABLE_TRACING) || defined(ENABLE_PROFILER)
+
+#include "util/atomic.h"
+#include <stdio.h>
+
+C_HEADER_BEGIN
+
+struct thread_ring_record_t
+{
+	uint64_t start;             /* cycles */
+	uint64_t end;
+	uintptr_t key;              /* what was recorded, up to the owner */
+	uint32_t kind;
+};
+
+struct thread_ring_t
+{
+	struct thread_ring_t* next;
+	uint32_t thread_index;      /* used as tid in the Chrome trace */
+	uint32_t write_pos;         /* total number of records written - use atomics */
+	struct thread_ring_record_t* record;
+};
+
+struct thread_ring_list_t
+{
+	struct thread_ring_t* first;
+	uint32_t count;
+	uint32_t generation;        /* incremented by thread_ring_list_deinit() - use atomics */
+	uint32_t buffer_size;       /* size of the owner's per thread struct */
+	uint32_t ring_size;         /* records per thread, must be a power of two */
+	uint64_t start_cycles;      /* timestamps in the Chrome trace are relative to this */
+};
+
+/*!
+ * @brief Initialiser for a static thread_ring_list_t.
+ * @param buffer_size The size of the struct the owner keeps per thread. It
+ * must start with a struct thread_ring_t.
+ * @param ring_size The number of records per thread, a power of two.
+ */
+#define THREAD_RING_LIST(buffer_size, ring_size) \
+		{ NULL, 0, 0, buffer_size, ring_size, 0 }
+
+/*!
+ * @brief Called for every buffer before it is freed, so the owner can release
+ * what its part of the buffer holds.
+ */
+typedef void (*thread_ring_free_func)(struct thread_ring_t* ring);
+
+/*!
+ * @brief Writes the name of a record for the Chrome trace. Use
+ * thread_ring_write_escaped() for names that may contain quotes.
+ */
+typedef void (*thread_ring_write_name_func)(FILE* fp,
+											const struct thread_ring_t* ring,
+											const struct thread_ring_record_t* record);
+
+/*!
+ * @brief Sets the time the Chrome trace starts at.
+ */
+void
+thread_ring_list_init(struct thread_ring_list_t* list);
+
+/*!
+ * @brief Frees the buffers of all threads. No other thread may be recording.
+ * Threads recording after this get a new buffer.
+ * @param[in] free_func Optional function called for every buffer first.
+ */
+void
+thread_ring_list_deinit(struct thread_ring_list_t* list,
+						thread_ring_free_func free_func);
+
+/*!
+ * @brief Returns the calling thread's buffer, creating it if necessary.
+ * @param[in,out] local The THREAD_LOCAL pointer to the calling thread's
+ * buffer.
+ * @param[in,out] local_generation The THREAD_LOCAL generation *local was
+ * handed out in.
+ * @return Returns NULL if memory couldn't be allocated.
+ */
+struct thread_ring_t*
+thread_ring_get(struct thread_ring_list_t* list,
+				struct thread_ring_t** local,
+				uint32_t* local_generation);
+
+/*!
+ * @brief Returns 1 if a THREAD_LOCAL pointer handed out by thread_ring_get()
+ * is still valid.
+ */
+#define thread_ring_is_current(list, local, local_generation)              \
+		((local) && (local_generation) == ATOMIC_LOAD_ACQUIRE((list)->generation))
+
+/*!
+ * @brief Appends a record to the calling thread's ring, overwriting the
+ * oldest one if the ring is full.
+ */
+void
+thread_ring_push(struct thread_ring_list_t* list,
+				 struct thread_ring_t* ring,
+				 uint64_t start,
+				 uint64_t end,
+				 uintptr_t key,
+				 uint32_t kind);
+
+/*!
+ * @brief Discards all records of a ring.
+ */
+void
+thread_ring_reset(struct thread_ring_t* ring);
+
+/*!
+ * @brief Writes the records of all threads to a file in the Chrome trace
+ * event format. The file can be opened with chrome://tracing or the Perfetto
+ * UI.
+ * @param[in] kind_name The category of each record kind.
+ * @param[in] write_name Writes the name of a record.
+ * @return Returns 0 if the file couldn't be written, 1 if otherwise.
+ */
+char
+thread_ring_dump_chrome(const struct thread_ring_list_t* list,
+						const char* file_name,
+						const char* const* kind_name,
+						thread_ring_write_name_func write_name);
+
+/*!
+ * @brief Writes a string escaped for JSON.
+ */
+void
+thread_ring_write_escaped(FILE* fp, const char* str);
+
+C_HEADER_END
+
+#endif /* ENABLE_TRACING || ENABLE_PROFILER */
+
+#endif /* FRAMEWORK_THREAD_RING_H */
@@ -0,0 +1,160 @@
+/*!
+ * @file trace.h
+ * @brief Optional instrumentation of event fires, listener calls and service
+ * calls.
+ *
+ * Tracing is compiled in with the CMake option ENABLE_TRACING. When it is
+ * disabled, TRACE_CALL() expands to the call itself and nothing else in this
+ * file exists.
+ *
+ * Every thread that fires an event or calls a service gets its own
+ * trace_thread_t buffer, see thread_ring.h. A buffer holds:
+ *   + A ring of the most recent calls with their start and end cycle counts,
+ *     which trace_dump_chrome() writes as a Chrome trace.
+ *   + A table of counters per event, listener and service, holding the
+ *     number of calls, the total time spent and a log2 histogram of the
+ *     durations. trace_report() merges the tables of all threads and logs
+ *     them.
+ *
+ * Events and services are identified by their address, listeners by their
+ * callback. An event or service destroyed and created again at the same
+ * address is counted under the first name it was seen with, until
+ * trace_clear() is called.
+ *
+ * Dumping reads the buffers of other threads without synchronisation. Do so
+ * while no other thread is firing events (e.g. from a service called on the
+ * main thread), or some of the most recent records may be torn.
+ */
+
+#ifndef FRAMEWORK_TRACE_H
+#define FRAMEWORK_TRACE_H
+
+#include "util/pstdint.h"
+#include "framework/config.h"
+#include "framework/thread_ring.h"
+
+C_HEADER_BEGIN
+
+#ifdef ENABLE_TRACING
+
+/* number of records each thread keeps, must be a power of two */
+#define TRACE_RING_SIZE 16384
+
+/* number of distinct events, listeners and services each thread counts */
+#define TRACE_COUNTER_TABLE_SIZE 1024
+
+/* histogram bucket n counts calls taking [2^n, 2^(n+1)) cycles */
+#define TRACE_HISTOGRAM_BUCKETS 40
+
+typedef enum trace_kind_e
+{
+	TRACE_EVENT,
+	TRACE_LISTENER,
+	TRACE_SERVICE
+} trace_kind_e;
+
+struct trace_counter_t
+{
+	uintptr_t key;              /* 0 if the slot is free */
+	uint32_t kind;              /* trace_kind_e */
+	char* name;                 /* copy of the directory, NULL for listeners */
+	uint64_t count;
+	uint64_t cycles;            /* total time spent */
+	uint32_t histogram[TRACE_HISTOGRAM_BUCKETS];
+};
+
+struct trace_thread_t
+{
+	struct thread_ring_t ring;  /* records are keyed like the counters */
+	uint32_t counters_dropped;  /* calls not counted because the table was full */
+	struct trace_counter_t counter[TRACE_COUNTER_TABLE_SIZE];
+};
+
+/*!
+ * @brief Wraps a call so its duration is recorded. Use as a statement.
+ * @param kind One of trace_kind_e.
+ * @param key Identifies the object being called, see trace_record().
+ * @param name The name of the object, or NULL.
+ * @param call The call expression.
+ */
+#define TRACE_CALL(kind, key, name, call) do {                              \
+			uint64_t trace_internal_start = trace_now();                    \
+			call;                                                           \
+			trace_record(kind, key, name, trace_internal_start);            \
+		} while(0)
+
+void
+trace_init(void);
+
+/*!
+ * @brief Frees the buffers of all threads. No other thread may be recording.
+ * Threads recording after this get a new buffer.
+ */
+void
+trace_deinit(void);
+
+/*!
+ * @brief Returns the current cycle count (TSC on x86).
+ */
+FRAMEWORK_PUBLIC_API uint64_t
+trace_now(void);
+
+/*!
+ * @brief Records a call that started at the specified cycle count and ended
+ * now.
+ * @param[in] key The address of the event or service, or the listener's
+ * callback.
+ * @param[in] name The directory of the event or service. Copied the first
+ * time the key is seen by the calling thread. May be NULL.
+ */
+FRAMEWORK_PUBLIC_API void
+trace_record(trace_kind_e kind, uintptr_t key, const char* name, uint64_t start);
+
+/*!
+ * @brief Records a call that started and ended at the specified cycle counts,
+ * see trace_record(). Used to share the cycle counts with the profiler.
+ */
+FRAMEWORK_PUBLIC_API void
+trace_record_span(trace_kind_e kind,
+				  uintptr_t key,
+				  const char* name,
+				  uint64_t start,
+				  uint64_t end);
+
+/*!
+ * @brief Returns the number of recorded calls of the specified key, summed
+ * over all threads.
+ */
+FRAMEWORK_PUBLIC_API uint64_t
+trace_get_count(trace_kind_e kind, uintptr_t key);
+
+/*!
+ * @brief Discards all records and counters of all threads.
+ */
+FRAMEWORK_PUBLIC_API void
+trace_clear(void);
+
+/*!
+ * @brief Writes the records of all threads to a file in the Chrome trace
+ * event format.
+ * @return Returns 0 if the file couldn't be written, 1 if otherwise.
+ */
+FRAMEWORK_PUBLIC_API char
+trace_dump_chrome(const char* file_name);
+
+/*!
+ * @brief Logs the number of calls, the mean duration and a latency histogram
+ * of every event, listener and service called so far.
+ */
+FRAMEWORK_PUBLIC_API void
+trace_report(void);
+
+#else /* ENABLE_TRACING */
+#   define TRACE_CALL(kind, key, name, call) do {                           \
+			call;                                                           \
+		} while(0)
+#endif /* ENABLE_TRACING */
+
+C_HEADER_END
+
+#endif /* FRAMEWORK_TRACE_H */
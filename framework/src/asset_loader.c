@@ -0,0 +1,317 @@
+#include "framework/asset_loader.h"
+#include "framework/game.h"
+#include "framework/events.h"
+#include "framework/log.h"
+#include "util/file.h"
+#include "util/vfs.h"
+#include "util/memory.h"
+#include "util/string.h"
+#include "util/atomic.h"
+#include "thread_pool/thread_pool.h"
+#include <string.h>
+#include <assert.h>
+
+/* number of requests each worker thread may have in flight */
+#define ASSET_LOADER_REQUESTS_PER_CORE 2
+
+/*
+ * The state of a request is written by a worker thread and read by the main
+ * thread. Without a thread pool, everything happens on the main thread.
+ */
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Entry point for worker threads. Loads and decodes the file.
+ */
+static void
+asset_load_job(void* data);
+
+/*!
+ * @brief Frees an asset object and the data it holds.
+ */
+static void
+asset_free(struct asset_t* asset);
+
+/*!
+ * @brief Calls the completion callback and fires the asset.loaded event.
+ */
+static void
+asset_finish(struct game_t* game, struct asset_t* asset);
+
+/*!
+ * @brief Removes and returns the pending request with the highest priority.
+ * Requests with equal priority are returned in the order they were made.
+ */
+static struct asset_t*
+asset_loader_pop_pending(struct asset_loader_t* loader);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+char
+asset_loader_init(struct game_t* game)
+{
+	struct asset_loader_t* loader;
+
+	assert(game);
+
+	loader = &game->asset_loader;
+	loader->guid = 1;
+	loader->max_in_flight = get_number_of_cores() * ASSET_LOADER_REQUESTS_PER_CORE;
+	unordered_vector_init_vector(&loader->pending, sizeof(struct asset_t*));
+	unordered_vector_init_vector(&loader->in_flight, sizeof(struct asset_t*));
+	loader->jobs.value = 0;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+asset_loader_deinit(struct game_t* game)
+{
+	struct asset_loader_t* loader;
+
+	assert(game);
+
+	loader = &game->asset_loader;
+
+	/* discard everything that hasn't started loading yet */
+	UNORDERED_VECTOR_FOR_EACH(&loader->pending, struct asset_t*, asset)
+		asset_free(*asset);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear_free(&loader->pending);
+
+	/* workers still reference requests in flight, wait for them */
+	UNORDERED_VECTOR_FOR_EACH(&loader->in_flight, struct asset_t*, asset)
+		ATOMIC_STORE((*asset)->cancelled, 1);
+	UNORDERED_VECTOR_END_EACH
+	if(loader->in_flight.count)
+	{
+		thread_pool_wait_for_counter(game->thread_pool, &loader->jobs);
+	}
+	UNORDERED_VECTOR_FOR_EACH(&loader->in_flight, struct asset_t*, asset)
+		asset_free(*asset);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear_free(&loader->in_flight);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+asset_load(struct game_t* game,
+		   const char* file_name,
+		   asset_priority_e priority,
+		   asset_decode_func decode,
+		   asset_loaded_func on_loaded,
+		   void* user_data)
+{
+	struct asset_t* asset;
+
+	assert(game);
+	assert(file_name);
+
+	if(!(asset = (struct asset_t*)MALLOC(sizeof(struct asset_t))))
+		OUT_OF_MEMORY("asset_load()", 0);
+	memset(asset, 0, sizeof(struct asset_t));
+
+	for(;;)
+	{
+		if(!(asset->file_name = malloc_string(file_name)))
+			break;
+
+		asset->priority = priority;
+		asset->state = ASSET_STATE_PENDING;
+		asset->decode = decode;
+		asset->on_loaded = on_loaded;
+		asset->user_data = user_data;
+
+		/* the request is handed to the thread pool during the next dispatch */
+		if(!unordered_vector_push(&game->asset_loader.pending, &asset))
+			break;
+
+		asset->id = game->asset_loader.guid++;
+		return asset->id;
+	}
+
+	asset_free(asset);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+asset_cancel(struct game_t* game, uint32_t id)
+{
+	struct asset_loader_t* loader;
+
+	assert(game);
+
+	loader = &game->asset_loader;
+
+	/* pending requests can be removed immediately */
+	UNORDERED_VECTOR_FOR_EACH(&loader->pending, struct asset_t*, asset)
+		if((*asset)->id == id)
+		{
+			asset_free(*asset);
+			unordered_vector_erase_element(&loader->pending, asset);
+			return 1;
+		}
+	UNORDERED_VECTOR_END_EACH
+
+	/* requests in flight are discarded when the worker finishes */
+	UNORDERED_VECTOR_FOR_EACH(&loader->in_flight, struct asset_t*, asset)
+		if((*asset)->id == id)
+		{
+			ATOMIC_STORE((*asset)->cancelled, 1);
+			return 1;
+		}
+	UNORDERED_VECTOR_END_EACH
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+asset_loader_dispatch(struct game_t* game)
+{
+	struct asset_loader_t* loader;
+	struct asset_t* asset;
+
+	assert(game);
+
+	loader = &game->asset_loader;
+
+	/* hand pending requests to the thread pool in order of priority */
+	while(loader->pending.count && loader->in_flight.count < loader->max_in_flight)
+	{
+		if(!(asset = asset_loader_pop_pending(loader)))
+			break;
+		if(!unordered_vector_push(&loader->in_flight, &asset))
+		{
+			unordered_vector_push(&loader->pending, &asset);
+			break;
+		}
+		asset->state = ASSET_STATE_LOADING;
+		thread_pool_queue_counted(game->thread_pool, &loader->jobs, asset_load_job, asset);
+	}
+
+	/* finish requests the workers are done with */
+	UNORDERED_VECTOR_FOR_EACH(&loader->in_flight, struct asset_t*, item)
+		asset = *item;
+		if(ATOMIC_LOAD(asset->state) == ASSET_STATE_LOADING)
+			continue;
+		UNORDERED_VECTOR_ERASE_IN_FOR_LOOP(&loader->in_flight, struct asset_t*, item);
+		asset_finish(game, asset);
+	UNORDERED_VECTOR_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+void
+asset_loader_flush(struct game_t* game)
+{
+	assert(game);
+
+	asset_loader_dispatch(game);
+	while(game->asset_loader.pending.count || game->asset_loader.in_flight.count)
+	{
+		thread_pool_wait_for_counter(game->thread_pool, &game->asset_loader.jobs);
+		asset_loader_dispatch(game);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+asset_load_job(void* data)
+{
+	struct asset_t* asset = (struct asset_t*)data;
+	struct vfs_file_t file;
+	char success = 0;
+
+	for(;;)
+	{
+		/* don't bother loading if the request was cancelled in the meantime */
+		if(ATOMIC_LOAD(asset->cancelled))
+			break;
+
+		/* without a decoder, the raw file contents are the result */
+		if(!asset->decode)
+		{
+			if(!(asset->size = file_load_into_memory(asset->file_name, &asset->data, FILE_BINARY)))
+				break;
+			asset->free_data = free_file;
+			success = 1;
+			break;
+		}
+
+		/* decoders read straight out of the pack mapping, if possible */
+		if(!vfs_open(&file, asset->file_name))
+			break;
+		success = asset->decode(asset, file.data, file.size);
+		vfs_close(&file);
+		break;
+	}
+
+	/* publish result, the main thread picks it up during the next dispatch */
+	ATOMIC_STORE(asset->state, success ? ASSET_STATE_LOADED : ASSET_STATE_FAILED);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+asset_free(struct asset_t* asset)
+{
+	if(asset->data)
+	{
+		if(asset->free_data)
+			asset->free_data(asset->data);
+		else
+			FREE(asset->data);
+	}
+	if(asset->file_name)
+		free_string(asset->file_name);
+	FREE(asset);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+asset_finish(struct game_t* game, struct asset_t* asset)
+{
+	if(!ATOMIC_LOAD(asset->cancelled))
+	{
+		if(asset->state == ASSET_STATE_LOADED)
+			EVENT_FIRE2(game->event.asset_loaded, asset->id, PTR(asset->file_name));
+		else
+			llog(LOG_ERROR, game, NULL, "Failed to load asset \"%s\"", asset->file_name);
+
+		if(asset->on_loaded)
+			asset->on_loaded(game, asset);
+	}
+
+	asset_free(asset);
+}
+
+/* ------------------------------------------------------------------------- */
+static struct asset_t*
+asset_loader_pop_pending(struct asset_loader_t* loader)
+{
+	struct asset_t** best = NULL;
+	struct asset_t* asset;
+
+	UNORDERED_VECTOR_FOR_EACH(&loader->pending, struct asset_t*, item)
+		if(!best ||
+			(*item)->priority > (*best)->priority ||
+			((*item)->priority == (*best)->priority && (*item)->id < (*best)->id))
+		{
+			best = item;
+		}
+	UNORDERED_VECTOR_END_EACH
+
+	if(!best)
+		return NULL;
+
+	asset = *best;
+	unordered_vector_erase_element(&loader->pending, best);
+	return asset;
+}
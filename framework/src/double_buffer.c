@@ -0,0 +1,93 @@
+#include "framework/double_buffer.h"
+#include "framework/game.h"
+#include "framework/log.h"
+#include "util/memory.h"
+#include <string.h>
+#include <assert.h>
+
+/* the second buffer starts aligned for any type */
+#define ALIGN_UP(x, alignment) (((x) + (alignment) - 1) / (alignment) * (alignment))
+
+/* ------------------------------------------------------------------------- */
+struct double_buffer_t*
+double_buffer_create(struct game_t* game, uint32_t size)
+{
+	struct double_buffer_t* buffer;
+	uint32_t stride = ALIGN_UP(size, 8);
+
+	assert(game);
+
+	/* both buffers are allocated in the same block */
+	if(!(buffer = (struct double_buffer_t*)MALLOC(sizeof(struct double_buffer_t) + stride * 2)))
+		OUT_OF_MEMORY("double_buffer_create()", NULL);
+	buffer->game = game;
+	buffer->size = size;
+	buffer->buffer[0] = (char*)(buffer + 1);
+	buffer->buffer[1] = buffer->buffer[0] + stride;
+	buffer->front = 0;
+	buffer->written = 0;
+	memset(buffer->buffer[0], 0, stride * 2);
+
+	if(!unordered_vector_push(&game->double_buffers, &buffer))
+	{
+		FREE(buffer);
+		OUT_OF_MEMORY("double_buffer_create()", NULL);
+	}
+
+	return buffer;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+double_buffer_destroy(struct double_buffer_t* buffer)
+{
+	struct unordered_vector_t* buffers;
+
+	assert(buffer);
+
+	buffers = &buffer->game->double_buffers;
+	UNORDERED_VECTOR_FOR_EACH(buffers, struct double_buffer_t*, registered)
+		if(*registered == buffer)
+		{
+			unordered_vector_erase_element(buffers, registered);
+			break;
+		}
+	UNORDERED_VECTOR_END_EACH
+
+	FREE(buffer);
+}
+
+/* ------------------------------------------------------------------------- */
+void*
+double_buffer_write(struct double_buffer_t* buffer)
+{
+	assert(buffer);
+	buffer->written = 1;
+	return buffer->buffer[!buffer->front];
+}
+
+/* ------------------------------------------------------------------------- */
+void
+double_buffer_publish_all(struct game_t* game)
+{
+	UNORDERED_VECTOR_FOR_EACH(&game->double_buffers, struct double_buffer_t*, registered)
+		struct double_buffer_t* buffer = *registered;
+		if(!buffer->written)
+			continue;
+
+		/* the old front buffer is one publish behind, bring it up to date */
+		buffer->front = !buffer->front;
+		memcpy(buffer->buffer[!buffer->front], buffer->buffer[(int)buffer->front], buffer->size);
+		buffer->written = 0;
+	UNORDERED_VECTOR_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+void
+double_buffer_destroy_all(struct game_t* game)
+{
+	struct double_buffer_t** buffer;
+
+	while((buffer = (struct double_buffer_t**)unordered_vector_back(&game->double_buffers)))
+		double_buffer_destroy(*buffer);
+}
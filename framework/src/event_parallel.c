@@ -0,0 +1,234 @@
+#include "framework/event_parallel.h"
+#include "framework/event_snapshot.h"
+#include "framework/events.h"
+#include "framework/game.h"
+#include "framework/plugin.h"
+#include "util/memory.h"
+#include "util/atomic.h"
+#include "util/thread.h"
+#include "thread_pool/thread_pool.h"
+#include <string.h>
+#include <assert.h>
+
+/*
+ * The counters are shared with worker threads and other firing threads.
+ * Without multithreading, jobs are executed immediately by the queueing
+ * thread.
+ */
+
+/* the lower half of a claim once every listener of a fire returned */
+#define CLAIM_CLOSED 0xFFFFFFFFu
+#define CLAIM_MAKE(sequence, next) (((uint64_t)(sequence) << 32) | (uint32_t)(next))
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Entry point for worker threads.
+ */
+static void
+event_parallel_job(void* data);
+
+/*!
+ * @brief Claims and calls listeners until there are none left.
+ */
+static void
+event_parallel_run(struct event_parallel_t* parallel);
+
+/*!
+ * @brief Waits for the claimed listeners to return, running other jobs of
+ * the thread pool in the meantime.
+ */
+static void
+event_parallel_join(struct event_parallel_t* parallel);
+
+/*!
+ * @brief Atomically replaces the claim. A plain 64 bit store isn't atomic
+ * everywhere.
+ */
+static void
+event_parallel_set_claim(struct event_parallel_t* parallel, uint64_t claim);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+char
+event_parallel_create(struct event_t* event)
+{
+	struct event_parallel_t* parallel;
+
+	assert(event);
+
+	if(event->parallel)
+		return 1;
+
+	if(!(parallel = (struct event_parallel_t*)MALLOC(sizeof(struct event_parallel_t))))
+		return 0;
+	memset(parallel, 0, sizeof(struct event_parallel_t));
+	parallel->event = event;
+	parallel->thread_count = get_number_of_cores();
+	event->parallel = parallel;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_parallel_destroy(struct event_t* event)
+{
+	struct event_parallel_t* parallel;
+	struct thread_pool_t* pool;
+
+	assert(event);
+
+	if(!(parallel = event->parallel))
+		return;
+
+	/* jobs queued during earlier fires may not have started yet */
+	pool = event->plugin->game->thread_pool;
+	while(pool && ATOMIC_LOAD(parallel->jobs))
+	{
+		thread_pool_wait_for_jobs(pool);
+	}
+
+	FREE(parallel);
+	event->parallel = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_fire_parallel(struct event_t* event,
+					const struct event_snapshot_t* snapshot,
+					const void** argv)
+{
+	struct event_parallel_t* parallel;
+	uint32_t i, count, sequence;
+	int wanted, jobs;
+
+	assert(event);
+	assert(snapshot);
+
+	/*
+	 * Without a parallel object, or if another thread (or a listener of
+	 * this very event) is already firing it, call everything in order.
+	 */
+	parallel = event->parallel;
+	if(!parallel || !ATOMIC_CAS(parallel->busy, 0, 1))
+	{
+		for(i = 0; i != snapshot->serial_count + snapshot->parallel_count; ++i)
+			EVENT_SNAPSHOT_CALL(snapshot->callback[i], event, argv);
+		return;
+	}
+
+	/*
+	 * Publish the fire, the claim is written last so workers see everything
+	 * else. Until then the previous fire is closed and nothing can be
+	 * claimed.
+	 */
+	count = snapshot->parallel_count;
+	sequence = (uint32_t)(ATOMIC_LOAD(parallel->claim) >> 32) + 1;
+	parallel->snapshot = snapshot;
+	parallel->argv = argv;
+	ATOMIC_STORE(parallel->count, count);
+	ATOMIC_STORE(parallel->remaining, (int)count);
+	event_parallel_set_claim(parallel, CLAIM_MAKE(sequence, 0));
+
+	/* fork, jobs from earlier fires that haven't started yet count as well */
+	wanted = (count < parallel->thread_count ? (int)count : (int)parallel->thread_count);
+	for(jobs = ATOMIC_LOAD(parallel->jobs); jobs < wanted; ++jobs)
+	{
+		ATOMIC_ADD(parallel->jobs, 1);
+		thread_pool_queue(event->plugin->game->thread_pool, event_parallel_job, parallel);
+	}
+
+	if(snapshot->all_read_only)
+		for(i = 0; i != snapshot->serial_count; ++i)
+			EVENT_SNAPSHOT_CALL(snapshot->callback[i], event, argv);
+
+	/* join, helping out until every listener is claimed */
+	event_parallel_run(parallel);
+	event_parallel_join(parallel);
+
+	/* close the fire before the next one overwrites count */
+	event_parallel_set_claim(parallel, CLAIM_MAKE(sequence, CLAIM_CLOSED));
+
+	if(!snapshot->all_read_only)
+		for(i = 0; i != snapshot->serial_count; ++i)
+			EVENT_SNAPSHOT_CALL(snapshot->callback[i], event, argv);
+
+	ATOMIC_STORE(parallel->busy, 0);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+event_parallel_job(void* data)
+{
+	struct event_parallel_t* parallel = (struct event_parallel_t*)data;
+	event_parallel_run(parallel);
+	ATOMIC_ADD(parallel->jobs, -1);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_parallel_run(struct event_parallel_t* parallel)
+{
+	const struct event_snapshot_t* snapshot;
+	uint64_t claim;
+	uint32_t i;
+
+	for(;;)
+	{
+		/*
+		 * A claim never takes the same value twice and the fire is closed
+		 * before count changes. If the CAS succeeds, the claim didn't change
+		 * since it was read, so count belongs to the same fire.
+		 */
+		claim = ATOMIC_LOAD(parallel->claim);
+		i = (uint32_t)claim;
+		if(i >= ATOMIC_LOAD(parallel->count))
+			break;
+		if(!ATOMIC_CAS(parallel->claim, claim, claim + 1))
+			continue;
+
+		/* the firing thread keeps the snapshot alive until everything returned */
+		snapshot = parallel->snapshot;
+		EVENT_SNAPSHOT_CALL(snapshot->callback[snapshot->serial_count + i], parallel->event, parallel->argv);
+		if(ATOMIC_DECREMENT(parallel->remaining) == 0 && ATOMIC_LOAD(parallel->waiting))
+			futex_wake_all(&parallel->remaining);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_parallel_join(struct event_parallel_t* parallel)
+{
+	int remaining;
+
+	while((remaining = ATOMIC_LOAD(parallel->remaining)))
+	{
+		if(thread_pool_help(parallel->event->plugin->game->thread_pool))
+			continue;
+
+		/*
+		 * Whoever returns last either sees waiting set and wakes us up, or
+		 * already decremented remaining and futex_wait() returns at once.
+		 */
+		ATOMIC_STORE(parallel->waiting, 1);
+		futex_wait(&parallel->remaining, remaining);
+		ATOMIC_STORE(parallel->waiting, 0);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_parallel_set_claim(struct event_parallel_t* parallel, uint64_t claim)
+{
+	uint64_t old;
+	do
+	{
+		old = ATOMIC_LOAD(parallel->claim);
+	} while(!ATOMIC_CAS(parallel->claim, old, claim));
+}
@@ -0,0 +1,386 @@
+#include "framework/event_queue.h"
+#include "framework/events.h"
+#include "framework/game.h"
+#include "framework/log.h"
+#include "util/memory.h"
+#include "util/string.h"
+#include "util/atomic.h"
+#include <string.h>
+#include <assert.h>
+
+/*
+ * In pipelined mode (see main_loop.h) the tick and render sides can post at
+ * the same time. The lock is never held while listeners run.
+ */
+
+/* holds one argument of a known type by value */
+union event_queue_value_t
+{
+	int8_t    i8;
+	int16_t   i16;
+	int32_t   i32;
+	int64_t   i64;
+	intptr_t  iptr;
+	float     f;
+	double    d;
+};
+
+struct event_queue_entry_t
+{
+	struct event_t* event;
+	union event_queue_value_t value[EVENT_QUEUE_MAX_ARGS]; /* copies of arguments of known types */
+	void* ref[EVENT_QUEUE_MAX_ARGS];  /* copied strings, or references to arguments of unknown types */
+};
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Copies the arguments into the entry. Frees any strings the entry
+ * held before.
+ * @return Returns 0 if a string couldn't be copied, 1 if otherwise.
+ */
+static char
+event_queue_entry_set(struct event_queue_entry_t* entry,
+					  const struct event_t* event,
+					  const void** argv);
+
+/*!
+ * @brief Frees the strings held by an entry.
+ */
+static void
+event_queue_entry_free(struct event_queue_entry_t* entry);
+
+/*!
+ * @brief Frees all entries in a vector and empties it, keeping its memory.
+ */
+static void
+event_queue_clear(struct unordered_vector_t* entries);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+char
+event_queue_init(struct game_t* game)
+{
+	struct event_queue_t* queue;
+
+	assert(game);
+
+	queue = &game->event_queue;
+	unordered_vector_init_vector(&queue->pending, sizeof(struct event_queue_entry_t));
+	unordered_vector_init_vector(&queue->delivering, sizeof(struct event_queue_entry_t));
+	memset(&queue->stats, 0, sizeof(struct event_queue_stats_t));
+	queue->barrier = 0;
+	queue->lock = 0;
+	queue->stats.capacity = EVENT_QUEUE_DEFAULT_CAPACITY;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_queue_deinit(struct game_t* game)
+{
+	struct event_queue_t* queue;
+
+	assert(game);
+
+	queue = &game->event_queue;
+	event_queue_clear(&queue->pending);
+	event_queue_clear(&queue->delivering);
+	unordered_vector_clear_free(&queue->pending);
+	unordered_vector_clear_free(&queue->delivering);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_post(struct event_t* event, const void** argv)
+{
+	struct event_queue_t* queue;
+	struct event_queue_entry_t* entry;
+	char result = 0;
+
+	assert(event);
+	assert(event->plugin);
+	assert(event->plugin->game);
+
+	queue = &event->plugin->game->event_queue;
+	SPIN_LOCK(queue->lock);
+	++queue->stats.posted;
+
+	for(;;)
+	{
+		/* overwrite the queued instance of coalescing events, unless that
+		 * would move it past a later non-coalescing event */
+		if(event->queued_index > queue->barrier)
+		{
+			entry = (struct event_queue_entry_t*)unordered_vector_get_element(
+				&queue->pending, event->queued_index - 1);
+			assert(entry && entry->event == event);
+			++queue->stats.coalesced;
+			result = event_queue_entry_set(entry, event, argv);
+			break;
+		}
+
+		if(queue->pending.count >= queue->stats.capacity)
+		{
+			++queue->stats.dropped;
+			break;
+		}
+
+		if(!(entry = (struct event_queue_entry_t*)unordered_vector_push_emplace(&queue->pending)))
+		{
+			++queue->stats.dropped;
+			break;
+		}
+		memset(entry, 0, sizeof(struct event_queue_entry_t));
+		entry->event = event;
+		if(!event_queue_entry_set(entry, event, argv))
+		{
+			unordered_vector_pop(&queue->pending);
+			++queue->stats.dropped;
+			break;
+		}
+
+		if(event->coalesce)
+			event->queued_index = queue->pending.count;
+		else
+			queue->barrier = queue->pending.count;
+		if(queue->pending.count > queue->stats.high_water)
+			queue->stats.high_water = queue->pending.count;
+
+		result = 1;
+		break;
+	}
+
+	SPIN_UNLOCK(queue->lock);
+	return result;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_set_coalescing(struct event_t* event, char enable)
+{
+	assert(event);
+	event->coalesce = enable;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_queue_dispatch(struct game_t* game)
+{
+	struct event_queue_t* queue;
+	struct unordered_vector_t swap;
+
+	assert(game);
+
+	queue = &game->event_queue;
+	if(!queue->pending.count)
+		return;
+
+	/* listeners are allowed to post, those go into the (now empty) pending
+	 * vector and are delivered next time */
+	SPIN_LOCK(queue->lock);
+	swap = queue->delivering;
+	queue->delivering = queue->pending;
+	queue->pending = swap;
+	queue->barrier = 0;
+
+	/* the instances are no longer pending, new posts get a new entry */
+	UNORDERED_VECTOR_FOR_EACH(&queue->delivering, struct event_queue_entry_t, entry)
+		entry->event->queued_index = 0;
+	UNORDERED_VECTOR_END_EACH
+	SPIN_UNLOCK(queue->lock);
+
+	UNORDERED_VECTOR_FOR_EACH(&queue->delivering, struct event_queue_entry_t, entry)
+		struct event_t* event = entry->event;
+		const void* argv[EVENT_QUEUE_MAX_ARGS];
+		uint32_t i;
+
+		/* NULL if the event was destroyed in the meantime */
+		if(!event)
+			continue;
+
+		for(i = 0; i != event->type_info->argc; ++i)
+		{
+			switch(event->type_info->argv_type[i])
+			{
+				case TYPE_STRING:
+				case TYPE_WSTRING:
+				case TYPE_UNKNOWN:
+					argv[i] = entry->ref[i];
+					break;
+				default:
+					argv[i] = &entry->value[i];
+					break;
+			}
+		}
+
+		EVENT_DISPATCH(event, argv)
+		++queue->stats.delivered;
+	UNORDERED_VECTOR_END_EACH
+
+	event_queue_clear(&queue->delivering);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_queue_discard_event(struct game_t* game, const struct event_t* event)
+{
+	struct event_queue_t* queue;
+
+	assert(game);
+	assert(event);
+
+	queue = &game->event_queue;
+
+	/* entries currently being delivered are skipped by event_queue_dispatch() */
+	UNORDERED_VECTOR_FOR_EACH(&queue->delivering, struct event_queue_entry_t, entry)
+		if(entry->event == event)
+		{
+			event_queue_entry_free(entry);
+			entry->event = NULL;
+		}
+	UNORDERED_VECTOR_END_EACH
+
+	/* pending entries are removed, but the order of the remaining entries has
+	 * to be preserved */
+	SPIN_LOCK(queue->lock);
+	{
+		struct event_queue_entry_t* entries = (struct event_queue_entry_t*)queue->pending.data;
+		uint32_t read, write = 0;
+		queue->barrier = 0;
+		for(read = 0; read != queue->pending.count; ++read)
+		{
+			if(entries[read].event == event)
+			{
+				event_queue_entry_free(&entries[read]);
+				continue;
+			}
+			if(write != read)
+				entries[write] = entries[read];
+			if(entries[write].event->queued_index)
+				entries[write].event->queued_index = write + 1;
+			if(!entries[write].event->coalesce)
+				queue->barrier = write + 1;
+			++write;
+		}
+		queue->pending.count = write;
+	}
+	SPIN_UNLOCK(queue->lock);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_queue_set_capacity(struct game_t* game, uint32_t capacity)
+{
+	assert(game);
+	game->event_queue.stats.capacity = capacity;
+}
+
+/* ------------------------------------------------------------------------- */
+const struct event_queue_stats_t*
+event_queue_get_stats(const struct game_t* game)
+{
+	assert(game);
+	return &game->event_queue.stats;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_queue_reset_stats(struct game_t* game)
+{
+	uint32_t capacity;
+
+	assert(game);
+
+	capacity = game->event_queue.stats.capacity;
+	memset(&game->event_queue.stats, 0, sizeof(struct event_queue_stats_t));
+	game->event_queue.stats.capacity = capacity;
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static char
+event_queue_entry_set(struct event_queue_entry_t* entry,
+					  const struct event_t* event,
+					  const void** argv)
+{
+	uint32_t i;
+
+	event_queue_entry_free(entry);
+
+	for(i = 0; i != event->type_info->argc; ++i)
+	{
+		union event_queue_value_t* value = &entry->value[i];
+		switch(event->type_info->argv_type[i])
+		{
+			case TYPE_INT8:
+			case TYPE_UINT8:   memcpy(value, argv[i], sizeof(int8_t));   break;
+			case TYPE_INT16:
+			case TYPE_UINT16:  memcpy(value, argv[i], sizeof(int16_t));  break;
+			case TYPE_INT32:
+			case TYPE_UINT32:  memcpy(value, argv[i], sizeof(int32_t));  break;
+			case TYPE_INT64:
+			case TYPE_UINT64:  memcpy(value, argv[i], sizeof(int64_t));  break;
+			case TYPE_INTPTR:
+			case TYPE_UINTPTR: memcpy(value, argv[i], sizeof(intptr_t)); break;
+			case TYPE_FLOAT:   memcpy(value, argv[i], sizeof(float));    break;
+			case TYPE_DOUBLE:  memcpy(value, argv[i], sizeof(double));   break;
+
+			case TYPE_STRING:
+				if(!(entry->ref[i] = malloc_string((const char*)argv[i])))
+					return 0;
+				break;
+			case TYPE_WSTRING:
+				if(!(entry->ref[i] = malloc_wstring((const wchar_t*)argv[i])))
+					return 0;
+				break;
+
+			/* can't know the size of unknown types, queue a reference */
+			default:
+				entry->ref[i] = (void*)argv[i];
+				break;
+		}
+	}
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_queue_entry_free(struct event_queue_entry_t* entry)
+{
+	uint32_t i;
+
+	if(!entry->event)
+		return;
+
+	for(i = 0; i != entry->event->type_info->argc; ++i)
+	{
+		switch(entry->event->type_info->argv_type[i])
+		{
+			case TYPE_STRING:
+			case TYPE_WSTRING:
+				if(entry->ref[i])
+					free_string(entry->ref[i]);
+				break;
+			default:
+				break;
+		}
+		entry->ref[i] = NULL;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_queue_clear(struct unordered_vector_t* entries)
+{
+	UNORDERED_VECTOR_FOR_EACH(entries, struct event_queue_entry_t, entry)
+		event_queue_entry_free(entry);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear(entries);
+}
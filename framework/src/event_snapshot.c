@@ -0,0 +1,366 @@
+#include "framework/event_snapshot.h"
+#include "framework/events.h"
+#include "framework/game.h"
+#include "framework/plugin.h"
+#include "util/memory.h"
+#include "util/atomic.h"
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Without multithreading, every event is fired and modified on the same
+ * thread and none of this needs to be atomic.
+ */
+
+#define LISTENER_IS_PARALLEL(listener)                                      \
+		(((listener)->flags & EVENT_LISTENER_THREAD_SAFE) &&                \
+		!((listener)->flags & EVENT_LISTENER_MAIN_THREAD))
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Tags a snapshot with the current epoch and adds it to the list of
+ * snapshots to free.
+ */
+static void
+event_snapshot_retire(struct event_epoch_t* epoch, struct event_snapshot_t* snapshot);
+
+/*!
+ * @brief Advances the epoch if no reader of the previous epoch is left.
+ */
+static void
+event_epoch_try_advance(struct event_epoch_t* epoch);
+
+/*!
+ * @brief Frees retired snapshots that were retired at least two epochs ago.
+ * The write lock must be held.
+ */
+static void
+event_epoch_free_retired(struct event_epoch_t* epoch);
+
+/*!
+ * @brief Returns the bucket of the specified filter, or the empty bucket
+ * where it would be inserted.
+ */
+static struct event_filter_bucket_t*
+event_snapshot_find_bucket(const struct event_snapshot_t* snapshot,
+						   uint32_t arg_index,
+						   int64_t value);
+
+/*!
+ * @brief Reads an integer argument of any size as a 64-bit value.
+ */
+static int64_t
+event_read_integer(type_e type, const void* arg);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+event_epoch_init(struct game_t* game)
+{
+	assert(game);
+	memset(&game->event_epoch, 0, sizeof(struct event_epoch_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_epoch_deinit(struct game_t* game)
+{
+	struct event_snapshot_t* snapshot;
+
+	assert(game);
+
+	while((snapshot = game->event_epoch.retired))
+	{
+		game->event_epoch.retired = snapshot->next_retired;
+		FREE(snapshot);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+int
+event_read_lock(struct game_t* game)
+{
+	struct event_epoch_t* epoch = &game->event_epoch;
+	uint32_t current;
+
+	/*
+	 * If the epoch advanced between reading it and registering, the reader
+	 * might have been missed by the writer. Register again in the new epoch.
+	 */
+	for(;;)
+	{
+		current = ATOMIC_LOAD(epoch->epoch);
+		ATOMIC_ADD(epoch->readers[current & 1], 1);
+		if(ATOMIC_LOAD(epoch->epoch) == current)
+			return (int)(current & 1);
+		ATOMIC_ADD(epoch->readers[current & 1], -1);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_read_unlock(struct game_t* game, int index)
+{
+	ATOMIC_ADD(game->event_epoch.readers[index], -1);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_write_lock(struct game_t* game)
+{
+	assert(game);
+	SPIN_LOCK(game->event_epoch.write_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_write_unlock(struct game_t* game)
+{
+	assert(game);
+	event_epoch_free_retired(&game->event_epoch);
+	SPIN_UNLOCK(game->event_epoch.write_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_snapshot_publish(struct event_t* event)
+{
+	struct event_snapshot_t* snapshot;
+	struct event_snapshot_t* old;
+	struct event_filter_bucket_t* bucket;
+	event_callback_func* filtered;
+	uint32_t count, filtered_count = 0, bucket_count = 0, i;
+	uint32_t serial = 0, parallel = 0;
+	uintptr_t callbacks_size;
+
+	assert(event);
+
+	count = event->listeners.count;
+	if(!count)
+	{
+		event_snapshot_clear(event);
+		return 1;
+	}
+
+	UNORDERED_VECTOR_FOR_EACH(&event->listeners, struct event_listener_t, listener)
+		if(listener->flags & EVENT_LISTENER_FILTERED)
+			++filtered_count;
+	UNORDERED_VECTOR_END_EACH
+	if(filtered_count)
+		for(bucket_count = 4; bucket_count < filtered_count * 2; bucket_count <<= 1) {}
+
+	/* the hash index is stored in the same block, after the callbacks */
+	callbacks_size = sizeof(struct event_snapshot_t) + (count - 1) * sizeof(event_callback_func);
+	callbacks_size = (callbacks_size + sizeof(int64_t) - 1) & ~(uintptr_t)(sizeof(int64_t) - 1);
+	snapshot = (struct event_snapshot_t*)MALLOC(callbacks_size +
+		bucket_count * sizeof(struct event_filter_bucket_t));
+	if(!snapshot)
+		return 0;
+	memset(snapshot, 0, callbacks_size + bucket_count * sizeof(struct event_filter_bucket_t));
+	snapshot->all_read_only = 1;
+	snapshot->filtered_count = filtered_count;
+	snapshot->bucket_count = bucket_count;
+	if(bucket_count)
+		snapshot->bucket = (struct event_filter_bucket_t*)((char*)snapshot + callbacks_size);
+
+	/*
+	 * Count first, so parallel listeners can be placed after the serial ones
+	 * and filtered listeners can be grouped by filter.
+	 */
+	UNORDERED_VECTOR_FOR_EACH(&event->listeners, struct event_listener_t, listener)
+		if(listener->flags & EVENT_LISTENER_FILTERED)
+		{
+			bucket = event_snapshot_find_bucket(snapshot, listener->filter_arg, listener->filter_value);
+			bucket->arg_index = listener->filter_arg;
+			bucket->value = listener->filter_value;
+			++bucket->count;
+			snapshot->filter_args |= (uint32_t)1 << listener->filter_arg;
+		}
+		else if(LISTENER_IS_PARALLEL(listener))
+		{
+			++snapshot->parallel_count;
+			if(!(listener->flags & EVENT_LISTENER_READ_ONLY))
+				snapshot->all_read_only = 0;
+		}
+		else
+			++snapshot->serial_count;
+	UNORDERED_VECTOR_END_EACH
+
+	/* point past the end of each group, the groups are filled back to front */
+	for(i = 0; i != bucket_count; ++i)
+	{
+		serial += snapshot->bucket[i].count;
+		snapshot->bucket[i].first = serial;
+	}
+	serial = 0;
+
+	filtered = snapshot->callback + snapshot->serial_count + snapshot->parallel_count;
+	UNORDERED_VECTOR_FOR_EACH(&event->listeners, struct event_listener_t, listener)
+		if(listener->flags & EVENT_LISTENER_FILTERED)
+		{
+			bucket = event_snapshot_find_bucket(snapshot, listener->filter_arg, listener->filter_value);
+			filtered[--bucket->first] = listener->exec;
+		}
+		else if(LISTENER_IS_PARALLEL(listener))
+			snapshot->callback[snapshot->serial_count + parallel++] = listener->exec;
+		else
+			snapshot->callback[serial++] = listener->exec;
+	UNORDERED_VECTOR_END_EACH
+
+	old = event->snapshot;
+	ATOMIC_STORE(event->snapshot, snapshot);
+	if(old)
+		event_snapshot_retire(&event->plugin->game->event_epoch, old);
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_snapshot_fire_filtered(struct event_t* event,
+							 const struct event_snapshot_t* snapshot,
+							 const void** argv)
+{
+	const struct event_filter_bucket_t* bucket;
+	const event_callback_func* filtered;
+	uint32_t arg_index, i;
+
+	assert(event);
+	assert(snapshot);
+
+	filtered = snapshot->callback + snapshot->serial_count + snapshot->parallel_count;
+	for(arg_index = 0; arg_index != 32; ++arg_index)
+	{
+		if(!(snapshot->filter_args & ((uint32_t)1 << arg_index)))
+			continue;
+
+		bucket = event_snapshot_find_bucket(snapshot, arg_index,
+			event_read_integer(event->type_info->argv_type[arg_index], argv[arg_index]));
+		for(i = 0; i != bucket->count; ++i)
+			EVENT_SNAPSHOT_CALL(filtered[bucket->first + i], event, argv);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_snapshot_clear(struct event_t* event)
+{
+	struct event_snapshot_t* old;
+
+	assert(event);
+
+	if(!(old = event->snapshot))
+		return;
+	ATOMIC_STORE(event->snapshot, NULL);
+	event_snapshot_retire(&event->plugin->game->event_epoch, old);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_epoch_reclaim(struct game_t* game)
+{
+	event_write_lock(game);
+	event_write_unlock(game);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+event_snapshot_retire(struct event_epoch_t* epoch, struct event_snapshot_t* snapshot)
+{
+	/* readers loading the snapshot pointer from now on get the new one */
+	snapshot->retired_epoch = ATOMIC_LOAD(epoch->epoch);
+	snapshot->next_retired = epoch->retired;
+	epoch->retired = snapshot;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_epoch_try_advance(struct event_epoch_t* epoch)
+{
+	uint32_t current = ATOMIC_LOAD(epoch->epoch);
+
+	/* the previous epoch has the same parity as the next one */
+	if(ATOMIC_LOAD(epoch->readers[(current + 1) & 1]) == 0)
+		ATOMIC_STORE(epoch->epoch, current + 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_epoch_free_retired(struct event_epoch_t* epoch)
+{
+	struct event_snapshot_t** link;
+	struct event_snapshot_t* snapshot;
+	uint32_t current;
+
+	if(!epoch->retired)
+		return;
+
+	/* if nobody is reading, this frees everything right away */
+	event_epoch_try_advance(epoch);
+	event_epoch_try_advance(epoch);
+
+	current = ATOMIC_LOAD(epoch->epoch);
+	link = &epoch->retired;
+	while((snapshot = *link))
+	{
+		if(current - snapshot->retired_epoch >= 2)
+		{
+			*link = snapshot->next_retired;
+			FREE(snapshot);
+		}
+		else
+			link = &snapshot->next_retired;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static struct event_filter_bucket_t*
+event_snapshot_find_bucket(const struct event_snapshot_t* snapshot,
+						   uint32_t arg_index,
+						   int64_t value)
+{
+	struct event_filter_bucket_t* bucket;
+	uint32_t mask = snapshot->bucket_count - 1;
+	uint32_t i;
+
+	/*
+	 * Knuth's multiplicative hash, folding the high bits down because the
+	 * mask only keeps the low ones. Probes linearly, buckets are never full.
+	 */
+	i = ((uint32_t)value ^ (uint32_t)((uint64_t)value >> 32) ^ arg_index) * 2654435761u;
+	i ^= i >> 16;
+	for(;; ++i)
+	{
+		bucket = snapshot->bucket + (i & mask);
+		if(!bucket->count)
+			return bucket;
+		if(bucket->arg_index == arg_index && bucket->value == value)
+			return bucket;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static int64_t
+event_read_integer(type_e type, const void* arg)
+{
+	switch(type)
+	{
+		case TYPE_INT8   : return *(const int8_t*)arg;
+		case TYPE_UINT8  : return *(const uint8_t*)arg;
+		case TYPE_INT16  : return *(const int16_t*)arg;
+		case TYPE_UINT16 : return *(const uint16_t*)arg;
+		case TYPE_INT32  : return *(const int32_t*)arg;
+		case TYPE_UINT32 : return *(const uint32_t*)arg;
+		case TYPE_INT64  : return *(const int64_t*)arg;
+		case TYPE_UINT64 : return (int64_t)*(const uint64_t*)arg;
+		case TYPE_INTPTR : return *(const intptr_t*)arg;
+		case TYPE_UINTPTR: return (int64_t)*(const uintptr_t*)arg;
+		default          : return 0;
+	}
+}
@@ -1,7 +1,11 @@
 #include "framework/config.h"
 #include "framework/events.h"
+#include "framework/event_queue.h"
+#include "framework/event_parallel.h"
+#include "framework/event_snapshot.h"
 #include "framework/game.h"
 #include "framework/plugin.h"
+#include "framework/profiler.h"
 #include "framework/log.h"
 #include "util/hash.h"
 #include "util/memory.h"
@@ -29,6 +33,47 @@ event_create_no_fire_notification(struct plugin_t* plugin,
 								  const char* directory,
 								  struct type_info_t* type_info);
 
+/*!
+ * @brief Calls the listeners of a snapshot, which may be NULL.
+ */
+static void
+event_call_listeners(struct event_t* event,
+					 const struct event_snapshot_t* snapshot,
+					 const void** argv);
+
+/*!
+ * @brief Adds a copy of the listener to the specified event and publishes a
+ * new snapshot.
+ */
+static char
+event_add_listener(const struct game_t* game,
+				   const char* event_directory,
+				   const struct event_listener_t* new_listener);
+
+/*!
+ * @brief Removes the listener matching the specified one (same callback and
+ * same filter) from the specified event and publishes a new snapshot.
+ */
+static char
+event_remove_listener(const struct game_t* game,
+					  const char* event_directory,
+					  const struct event_listener_t* match);
+
+/*!
+ * @brief Returns 1 if both listeners have the same callback and filter.
+ */
+static char
+event_listener_equal(const struct event_listener_t* a,
+					 const struct event_listener_t* b);
+
+/*!
+ * @brief Points the handle of the specified directory, if any, to an event.
+ */
+static void
+event_handle_bind(struct game_t* game,
+				  const char* directory,
+				  struct event_t* event);
+
 /* ----------------------------------------------------------------------------
  * Exported functions
  * ------------------------------------------------------------------------- */
@@ -40,6 +85,9 @@ events_init(struct game_t* game)
 
 	/* this holds all of the game's events */
 	ptree_init_ptree(&game->events, NULL);
+	bsthv_init_bsthv(&game->event_handles);
+	event_epoch_init(game);
+	event_queue_init(game);
 
 	/* ----------------------------
 	 * Register built-in events
@@ -66,10 +114,12 @@ events_init(struct game_t* game)
 		EVENT_CREATE0(game->core, game->event.pause, "pause"); CHECK(pause)
 		EVENT_CREATE0(game->core, game->event.stop,  "stop");  CHECK(stop)
 
-		/* main loop events (game update and render updates) */
+		/* main loop events (game update and render updates), render is passed
+		 * the interpolation alpha between the last and the next tick */
 		EVENT_CREATE0(game->core, game->event.tick,   "tick");                      CHECK(tick)
-		EVENT_CREATE0(game->core, game->event.render, "render");                    CHECK(render)
+		EVENT_CREATE1(game->core, game->event.render, "render", float);             CHECK(render)
 		EVENT_CREATE2(game->core, game->event.stats,  "stats", uint32_t, uint32_t); CHECK(stats)
+		event_set_coalescing(game->event.stats, 1);
 
 		/* The log will fire these events appropriately whenever something is logged */
 		EVENT_CREATE2(game->core, game->event.log,          "log", uint32_t, const char*); CHECK(log)
@@ -82,6 +132,9 @@ events_init(struct game_t* game)
 		EVENT_CREATE1(game->core, game->event.service_created,   "service.created",   const char*); CHECK(service_created);
 		EVENT_CREATE1(game->core, game->event.service_destroyed, "service.destroyed", const char*); CHECK(service_destroyed);
 
+		/* fired when the asset loader has finished loading a file */
+		EVENT_CREATE2(game->core, game->event.asset_loaded, "asset.loaded", uint32_t, const char*); CHECK(asset_loaded);
+
 #undef EVENT_CREATE
 #pragma pop_macro("EVENT_CREATE")
 #undef CHECK
@@ -100,7 +153,17 @@ events_init(struct game_t* game)
 void
 events_deinit(struct game_t* game)
 {
+	/* drop queued events before the events they refer to are freed */
+	event_queue_deinit(game);
 	ptree_destroy_keep_root(&game->events);
+	event_epoch_deinit(game);
+
+	/* handles that weren't released would point to destroyed events */
+	BSTHV_FOR_EACH(&game->event_handles, struct event_handle_t, directory, handle)
+		llog(LOG_WARNING, NULL, NULL, "Event handle \"%s\" was never released", directory);
+		FREE(handle);
+	BSTHV_END_EACH
+	bsthv_clear_free(&game->event_handles);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -164,6 +227,9 @@ event_create_no_fire_notification(struct plugin_t* plugin,
 		 * nodes easier */
 		ptree_set_free_func(node, (ptree_free_func)event_free);
 
+		/* existing handles now refer to this event */
+		event_handle_bind(plugin->game, directory, event);
+
 		/* success! */
 		return event;
 	}
@@ -198,6 +264,8 @@ event_destroy(struct event_t* event)
 	EVENT_FIRE1(event->plugin->game->event.event_destroyed,
 				PTR(event->directory));
 
+	event_handle_bind(event->plugin->game, event->directory, NULL);
+
 	/* destroying the node will call event_free() automatically */
 	ptree_destroy(node);
 }
@@ -218,18 +286,189 @@ event_get(const struct game_t* game, const char* directory)
 	return (struct event_t*)node->value;
 }
 
+/* ------------------------------------------------------------------------- */
+struct event_handle_t*
+event_handle_acquire(struct game_t* game, const char* directory)
+{
+	struct event_handle_t* handle;
+
+	assert(game);
+	assert(directory);
+
+	/* share existing handle */
+	if((handle = (struct event_handle_t*)bsthv_find(&game->event_handles, directory)))
+	{
+		++handle->refcount;
+		return handle;
+	}
+
+	if(!(handle = (struct event_handle_t*)MALLOC(sizeof(struct event_handle_t))))
+		OUT_OF_MEMORY("event_handle_acquire()", NULL);
+	handle->game = game;
+	handle->refcount = 1;
+	handle->event = event_get(game, directory);
+
+	if(!bsthv_insert(&game->event_handles, directory, handle))
+	{
+		FREE(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_handle_release(struct event_handle_t* handle)
+{
+	assert(handle);
+	assert(handle->refcount);
+
+	if(--handle->refcount)
+		return;
+
+	bsthv_erase_element(&handle->game->event_handles, handle);
+	FREE(handle);
+}
+
 /* ------------------------------------------------------------------------- */
 char
 event_register_listener(const struct game_t* game,
 						const char* event_directory,
 						event_callback_func callback)
+{
+	return event_register_listener_ex(game, event_directory, callback, EVENT_LISTENER_DEFAULT);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_register_listener_ex(const struct game_t* game,
+						   const char* event_directory,
+						   event_callback_func callback,
+						   uint32_t flags)
+{
+	struct event_listener_t listener;
+
+	assert(callback);
+
+	memset(&listener, 0, sizeof(struct event_listener_t));
+	listener.exec = callback;
+	listener.flags = flags & ~EVENT_LISTENER_FILTERED;
+	return event_add_listener(game, event_directory, &listener);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_register_listener_filtered(const struct game_t* game,
+								 const char* event_directory,
+								 event_callback_func callback,
+								 uint32_t arg_index,
+								 int64_t value)
+{
+	struct event_listener_t listener;
+
+	assert(callback);
+
+	listener.exec = callback;
+	listener.flags = EVENT_LISTENER_FILTERED;
+	listener.filter_arg = arg_index;
+	listener.filter_value = value;
+	return event_add_listener(game, event_directory, &listener);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_unregister_listener(const struct game_t* game,
+						  const char* event_directory,
+						  event_callback_func callback)
+{
+	struct event_listener_t listener;
+
+	memset(&listener, 0, sizeof(struct event_listener_t));
+	listener.exec = callback;
+	return event_remove_listener(game, event_directory, &listener);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+event_unregister_listener_filtered(const struct game_t* game,
+								   const char* event_directory,
+								   event_callback_func callback,
+								   uint32_t arg_index,
+								   int64_t value)
+{
+	struct event_listener_t listener;
+
+	listener.exec = callback;
+	listener.flags = EVENT_LISTENER_FILTERED;
+	listener.filter_arg = arg_index;
+	listener.filter_value = value;
+	return event_remove_listener(game, event_directory, &listener);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_unregister_all_listeners(struct event_t* event)
+{
+	event_write_lock(event->plugin->game);
+	unordered_vector_clear_free(&event->listeners);
+	event_snapshot_clear(event);
+	event_write_unlock(event->plugin->game);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+event_fire(struct event_t* event, const void** argv)
+{
+	struct game_t* game = event->plugin->game;
+	int epoch;
+
+	/* the snapshot can't be freed until the read section is left */
+	epoch = event_read_lock(game);
+	EVENT_INSTRUMENTED_CALL(TRACE_EVENT, (uintptr_t)event, event->directory,
+			event_call_listeners(event, event->snapshot, argv));
+	event_read_unlock(game, epoch);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+event_handle_bind(struct game_t* game,
+				  const char* directory,
+				  struct event_t* event)
+{
+	struct event_handle_t* handle;
+	if((handle = (struct event_handle_t*)bsthv_find(&game->event_handles, directory)))
+		handle->event = event;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+event_free(struct event_t* event)
+{
+	event_queue_discard_event(event->plugin->game, event);
+	event_unregister_all_listeners(event);
+	event_parallel_destroy(event);
+	free_string(event->directory);
+	unordered_vector_clear_free(&event->listeners);
+	dynamic_call_destroy_type_info(event->type_info);
+	FREE(event);
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+event_add_listener(const struct game_t* game,
+				   const char* event_directory,
+				   const struct event_listener_t* new_listener)
 {
 	struct event_t* event;
-	struct event_listener_t* new_listener;
+	struct event_listener_t* listener_copy;
+	uint32_t flags = new_listener->flags;
+	type_e type;
 
 	assert(game);
 	assert(event_directory);
-	assert(callback);
 
 	/* make sure event exists */
 	if(!(event = event_get(game, event_directory)))
@@ -239,10 +478,34 @@ event_register_listener(const struct game_t* game,
 		return 0;
 	}
 
+	/* filters compare the argument's value, so it must be an integer */
+	if(flags & EVENT_LISTENER_FILTERED)
+	{
+		if(new_listener->filter_arg >= event->type_info->argc ||
+			new_listener->filter_arg >= 32)
+		{
+			llog(LOG_WARNING, game, NULL, "Tried to register a filtered "
+				"listener to event \"%s\", but the event has no argument %u",
+				event_directory, new_listener->filter_arg);
+			return 0;
+		}
+		type = event->type_info->argv_type[new_listener->filter_arg];
+		if(type < TYPE_INT8 || type > TYPE_UINTPTR)
+		{
+			llog(LOG_WARNING, game, NULL, "Tried to register a filtered "
+				"listener to event \"%s\", but argument %u is not an integer",
+				event_directory, new_listener->filter_arg);
+			return 0;
+		}
+	}
+
+	event_write_lock(event->plugin->game);
+
 	/* make sure listener hasn't already registered to this event */
 	UNORDERED_VECTOR_FOR_EACH(&event->listeners, struct event_listener_t, listener)
-		if(listener->exec == callback)
+		if(event_listener_equal(listener, new_listener))
 		{
+			event_write_unlock(event->plugin->game);
 			llog(LOG_WARNING, game, NULL, "Already registered as a listener"
 				" to event \"%s\"", event->directory);
 			return 0;
@@ -250,17 +513,34 @@ event_register_listener(const struct game_t* game,
 	UNORDERED_VECTOR_END_EACH
 
 	/* create event listener object */
-	new_listener = (struct event_listener_t*) unordered_vector_push_emplace(&event->listeners);
-	new_listener->exec = callback;
+	if(!(listener_copy = (struct event_listener_t*) unordered_vector_push_emplace(&event->listeners)))
+	{
+		event_write_unlock(event->plugin->game);
+		OUT_OF_MEMORY("event_register_listener()", 0);
+	}
+	memcpy(listener_copy, new_listener, sizeof(struct event_listener_t));
 
+	/* thread safe listeners are called serially if this fails */
+	if((flags & EVENT_LISTENER_THREAD_SAFE) && !(flags & EVENT_LISTENER_MAIN_THREAD))
+		event_parallel_create(event);
+
+	/* fires see the new listener from now on */
+	if(!event_snapshot_publish(event))
+	{
+		unordered_vector_pop(&event->listeners);
+		event_write_unlock(event->plugin->game);
+		OUT_OF_MEMORY("event_register_listener()", 0);
+	}
+
+	event_write_unlock(event->plugin->game);
 	return 1;
 }
 
 /* ------------------------------------------------------------------------- */
-char
-event_unregister_listener(const struct game_t* game,
-						  const char* event_directory,
-						  event_callback_func callback)
+static char
+event_remove_listener(const struct game_t* game,
+					  const char* event_directory,
+					  const struct event_listener_t* match)
 {
 	struct event_t* event;
 
@@ -271,13 +551,21 @@ event_unregister_listener(const struct game_t* game,
 		return 0;
 	}
 
+	event_write_lock(event->plugin->game);
 	UNORDERED_VECTOR_FOR_EACH(&event->listeners, struct event_listener_t, listener)
-		if(listener->exec == callback)
+		if(event_listener_equal(listener, match))
 		{
 			unordered_vector_erase_element(&event->listeners, listener);
+			if(!event_snapshot_publish(event))
+			{
+				llog(LOG_ERROR, game, NULL, "Not enough memory to unregister from"
+					" event \"%s\", the listener will still be called", event_directory);
+			}
+			event_write_unlock(event->plugin->game);
 			return 1;
 		}
 	UNORDERED_VECTOR_END_EACH
+	event_write_unlock(event->plugin->game);
 
 	llog(LOG_WARNING, game, NULL, "Tried to unregister from event \"%s\", but "
 		"the listener was not found.", event_directory);
@@ -286,21 +574,35 @@ event_unregister_listener(const struct game_t* game,
 }
 
 /* ------------------------------------------------------------------------- */
-void
-event_unregister_all_listeners(struct event_t* event)
+static char
+event_listener_equal(const struct event_listener_t* a,
+					 const struct event_listener_t* b)
 {
-	unordered_vector_clear_free(&event->listeners);
+	if(a->exec != b->exec)
+		return 0;
+	if((a->flags & EVENT_LISTENER_FILTERED) != (b->flags & EVENT_LISTENER_FILTERED))
+		return 0;
+	if(!(a->flags & EVENT_LISTENER_FILTERED))
+		return 1;
+	return a->filter_arg == b->filter_arg && a->filter_value == b->filter_value;
 }
 
-/* ----------------------------------------------------------------------------
- * Static functions
- * ------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------- */
 static void
-event_free(struct event_t* event)
+event_call_listeners(struct event_t* event,
+					 const struct event_snapshot_t* snapshot,
+					 const void** argv)
 {
-	event_unregister_all_listeners(event);
-	free_string(event->directory);
-	unordered_vector_clear_free(&event->listeners);
-	dynamic_call_destroy_type_info(event->type_info);
-	FREE(event);
+	uint32_t i;
+
+	if(!snapshot)
+		return;
+
+	if(snapshot->parallel_count)
+		event_fire_parallel(event, snapshot, argv);
+	else
+		for(i = 0; i != snapshot->serial_count; ++i)
+			EVENT_SNAPSHOT_CALL(snapshot->callback[i], event, argv);
+	if(snapshot->filter_args)
+		event_snapshot_fire_filtered(event, snapshot, argv);
 }
@@ -0,0 +1,139 @@
+#include "framework/frame_pacer.h"
+#include "util/yaml.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_init(struct frame_pacer_t* pacer)
+{
+	assert(pacer);
+
+	pacer->tick_interval = 1000000000u / FRAME_PACER_DEFAULT_TICK_RATE;
+	pacer->render_interval = 1000000000u / FRAME_PACER_DEFAULT_RENDER_RATE;
+	pacer->max_frame_latency = (uint64_t)FRAME_PACER_DEFAULT_MAX_FRAME_LATENCY * 1000000u;
+	pacer->next_tick = 0;
+	pacer->next_render = 0;
+	pacer->ticks_dropped = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_set_tick_rate(struct frame_pacer_t* pacer, uint32_t ticks_per_second)
+{
+	assert(pacer);
+	if(ticks_per_second)
+		pacer->tick_interval = 1000000000u / ticks_per_second;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_set_render_rate(struct frame_pacer_t* pacer, uint32_t renders_per_second)
+{
+	assert(pacer);
+	pacer->render_interval = (renders_per_second ? 1000000000u / renders_per_second : 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_set_max_frame_latency(struct frame_pacer_t* pacer, uint32_t milliseconds)
+{
+	assert(pacer);
+	pacer->max_frame_latency = (uint64_t)milliseconds * 1000000u;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_load_settings(struct frame_pacer_t* pacer, const struct ptree_t* settings)
+{
+	const char* value;
+
+	assert(pacer);
+
+	if(!settings)
+		return;
+
+	if((value = yaml_get_value(settings, "main_loop.tick_rate")))
+		frame_pacer_set_tick_rate(pacer, (uint32_t)atoi(value));
+	if((value = yaml_get_value(settings, "main_loop.render_rate")))
+		frame_pacer_set_render_rate(pacer, (uint32_t)atoi(value));
+	if((value = yaml_get_value(settings, "main_loop.max_frame_latency")))
+		frame_pacer_set_max_frame_latency(pacer, (uint32_t)atoi(value));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+frame_pacer_reset(struct frame_pacer_t* pacer, uint64_t now)
+{
+	assert(pacer);
+	pacer->next_tick = now;
+	pacer->next_render = now;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+frame_pacer_should_tick(struct frame_pacer_t* pacer, uint64_t now)
+{
+	assert(pacer);
+
+	if(now < pacer->next_tick)
+		return 0;
+
+	/* too far behind to catch up, drop the backlog */
+	if(now - pacer->next_tick > pacer->max_frame_latency)
+	{
+		pacer->ticks_dropped += (now - pacer->next_tick) / pacer->tick_interval;
+		pacer->next_tick = now;
+	}
+
+	pacer->next_tick += pacer->tick_interval;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+frame_pacer_should_render(struct frame_pacer_t* pacer, uint64_t now)
+{
+	assert(pacer);
+
+	if(!pacer->render_interval)
+		return 1;
+	if(now < pacer->next_render)
+		return 0;
+
+	/* renders are never caught up on, a late one delays the following ones */
+	pacer->next_render += pacer->render_interval;
+	if(pacer->next_render <= now)
+		pacer->next_render = now + pacer->render_interval;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+float
+frame_pacer_get_alpha(const struct frame_pacer_t* pacer, uint64_t now)
+{
+	uint64_t last_tick;
+
+	assert(pacer);
+
+	last_tick = pacer->next_tick - pacer->tick_interval;
+	if(now <= last_tick)
+		return 0.0f;
+	if(now >= pacer->next_tick)
+		return 1.0f;
+	return (float)((double)(now - last_tick) / (double)pacer->tick_interval);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+frame_pacer_get_wake_time(const struct frame_pacer_t* pacer)
+{
+	assert(pacer);
+
+	/* an unlimited render rate means there is no reason to sleep */
+	if(!pacer->render_interval)
+		return 0;
+	if(pacer->next_render < pacer->next_tick)
+		return pacer->next_render;
+	return pacer->next_tick;
+}
@@ -5,11 +5,16 @@
 #include "framework/events.h"
 #include "framework/log.h"
 #include "framework/main_loop.h"
+#include "framework/double_buffer.h"
+#include "framework/asset_loader.h"
+#include "framework/profiler.h"
 #include "util/memory.h"
 #include "util/string.h"
 #include "util/net.h"
 #include "util/hash.h"
 #include "util/yaml.h"
+#include "util/thread.h"
+#include "util/time.h"
 #include "thread_pool/thread_pool.h"
 #include <string.h>
 #include <assert.h>
@@ -17,11 +22,23 @@
 
 static struct bsthv_t g_games;
 
+/* how often games_run_all() checks threaded games for termination */
+#define GAMES_POLL_INTERVAL 10000000
+
 /* ------------------------------------------------------------------------- */
 void
 game_init(void)
 {
 	bsthv_init_bsthv(&g_games);
+
+	/* frame timing and profiling convert cycles to time */
+	cycle_counter_calibrate();
+#ifdef ENABLE_TRACING
+	trace_init();
+#endif
+#ifdef ENABLE_PROFILER
+	profiler_init();
+#endif
 }
 
 /* ------------------------------------------------------------------------- */
@@ -30,6 +47,12 @@ game_deinit(void)
 {
 	/* TODO free any left over games */
 	bsthv_clear_free(&g_games);
+#ifdef ENABLE_TRACING
+	trace_deinit();
+#endif
+#ifdef ENABLE_PROFILER
+	profiler_deinit();
+#endif
 }
 
 /* ------------------------------------------------------------------------- */
@@ -61,6 +84,7 @@ game_create(const char* name,
 	for(;;)
 	{
 		game->network_role = net_role;
+		game->thread_id = get_thread_id();
 
 		/* load settings */
 		if(settings_yml_file)
@@ -74,6 +98,7 @@ game_create(const char* name,
 
 		/* initialise the game's global data container */
 		bstv_init_bstv(&game->context_store);
+		unordered_vector_init_vector(&game->double_buffers, sizeof(struct double_buffer_t*));
 
 		/* The initial state of the game is paused. The user must call
 		 * game_start() to launch the game */
@@ -115,6 +140,26 @@ game_create(const char* name,
 			llog(LOG_ERROR, NULL, NULL, "Failed to initialise events");
 			break;
 		}
+		if(!service_queue_init(game))
+		{
+			llog(LOG_ERROR, NULL, NULL, "Failed to initialise service queue");
+			break;
+		}
+
+		/* worker threads and asynchronous asset loading */
+		if(!(game->thread_pool = thread_pool_create(0, 0)))
+		{
+			llog(LOG_ERROR, NULL, NULL, "Failed to create thread pool");
+			break;
+		}
+		if(!asset_loader_init(game))
+		{
+			llog(LOG_ERROR, NULL, NULL, "Failed to initialise asset loader");
+			break;
+		}
+
+		/* tick rate, timers and statistics */
+		main_loop_init(game);
 
 		/* add to global list of games */
 		if(!bsthv_insert(&g_games, name, game))
@@ -139,13 +184,30 @@ game_destroy(struct game_t* game)
 	/* remove game from global list */
 	bsthv_erase(&g_games, game->name);
 
+	/* nothing may run on the game's thread while it is being torn down */
+	main_loop_deinit(game);
+
 	/* disconnect the game */
 	game_disconnect(game);
 
+	/* workers may still be executing code owned by plugins, so this has to
+	 * happen before the plugins are unloaded */
+	if(game->thread_pool)
+	{
+		asset_loader_deinit(game);
+		/* parallel event listeners may have queued jobs that haven't run yet */
+		thread_pool_wait_for_jobs(game->thread_pool);
+		thread_pool_destroy(game->thread_pool);
+		game->thread_pool = NULL;
+	}
+
 	/* deinit plugin manager, services, and events (in reverse order) */
 	plugin_manager_deinit(game);
+	double_buffer_destroy_all(game);
+	unordered_vector_clear_free(&game->double_buffers);
 	events_deinit(game);
 	service_deinit(game);
+	service_queue_deinit(game);
 
 	/* clean up data held by game object */
 	bstv_clear_free(&game->context_store);
@@ -203,10 +265,34 @@ game_exit(struct game_t* game)
 void
 games_run_all(void)
 {
+	uint64_t wake_time, game_wake_time;
+
 	while(g_games.vector.count)
 	{
-		/* update indiviual game loops */
-		main_loop_do_loop();
+		/*
+		 * Update individual game loops. Games with their own thread are only
+		 * checked for termination, the others are run here.
+		 */
+		wake_time = get_time_ns() + GAMES_POLL_INTERVAL;
+		BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
+			if(game->main_loop.own_thread && !main_loop_is_threaded(game))
+				main_loop_start_thread(game);
+			if(!main_loop_is_threaded(game))
+			{
+				game_wake_time = main_loop_do_loop(game);
+				if(game_wake_time < wake_time)
+					wake_time = game_wake_time;
+			}
+		BSTHV_END_EACH
+
+#ifdef ENABLE_PROFILER
+		/*
+		 * One frame for all games and threads, so frames don't interleave.
+		 * Zones closed by games on their own thread count towards the frame
+		 * they were closed in.
+		 */
+		profiler_end_frame();
+#endif
 
 		/* if the game wishes to terminate, destroy it */
 		BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
@@ -224,37 +310,47 @@ games_run_all(void)
 		if(bsthv_count(&g_games) == 1)
 		{
 			BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
+				main_loop_stop_thread(game);
 				game_exit(game);
 			BSTHV_END_EACH
 		}
+
+		/* don't burn the CPU until the next tick or render is due */
+		sleep_until_ns(wake_time);
 	}
 }
 
 /* ------------------------------------------------------------------------- */
 void
-game_dispatch_stats(uint32_t render_fps, uint32_t tick_fps)
+game_dispatch_events(struct game_t* game)
+{
+	/* finished assets are handed over on the tick side, the completion
+	 * callbacks may write state the render event reads */
+	asset_loader_dispatch(game);
+	event_queue_dispatch(game);
+	service_queue_dispatch(game);
+	event_epoch_reclaim(game);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+game_dispatch_stats(struct game_t* game, uint32_t render_fps, uint32_t tick_fps)
 {
-	BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
-		EVENT_FIRE2(game->event.stats, render_fps, tick_fps);
-	BSTHV_END_EACH
+	EVENT_POST2(game->event.stats, render_fps, tick_fps);
 }
 
 /* ------------------------------------------------------------------------- */
 void
-game_dispatch_render(void)
+game_dispatch_render(struct game_t* game, float alpha)
 {
-	BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
-		EVENT_FIRE0(game->event.render);
-	BSTHV_END_EACH
+	EVENT_FIRE1(game->event.render, alpha);
 }
 
 /* ------------------------------------------------------------------------- */
 void
-game_dispatch_tick(void)
+game_dispatch_tick(struct game_t* game)
 {
-	BSTHV_FOR_EACH(&g_games, struct game_t, key, game)
-		EVENT_FIRE0(game->event.tick);
-	BSTHV_END_EACH
+	EVENT_FIRE0(game->event.tick);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1,118 +1,353 @@
 #include "framework/main_loop.h"
+#include "framework/frame_pacer.h"
+#include "framework/double_buffer.h"
+#include "framework/service_queue.h"
 #include "framework/events.h"
 #include "framework/log.h"
 #include "framework/game.h"
+#include "framework/profiler.h"
+#include "util/thread.h"
 #include "util/time.h"
+#include "util/yaml.h"
+#include "util/atomic.h"
+#include "thread_pool/thread_pool.h"
 #include <stdio.h>
+#include <string.h>
+#include <assert.h>
 
-struct main_loop_statistics_t
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Fires the stats event once a second.
+ */
+static void
+main_loop_update_statistics(struct game_t* game);
+
+/*!
+ * @brief One iteration of the loop, ticking and rendering on this thread.
+ */
+static uint64_t
+main_loop_do_serial(struct game_t* game);
+
+/*!
+ * @brief One iteration of the loop in pipelined mode.
+ */
+static uint64_t
+main_loop_do_pipelined(struct game_t* game);
+
+/*!
+ * @brief Dispatches the ticks counted by main_loop_do_pipelined() on a
+ * thread pool worker.
+ */
+static void
+main_loop_tick_job(void* data);
+
+/*!
+ * @brief Blocks until the tick job has finished, delivering service calls
+ * queued for the game thread in the meantime.
+ */
+static void
+main_loop_wait_for_ticks(struct game_t* game);
+
+#ifdef ENABLE_MULTITHREADING
+/*!
+ * @brief Entry point of a game's dedicated thread.
+ */
+static void
+main_loop_thread(void* data);
+#endif
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+main_loop_init(struct game_t* game)
+{
+	struct main_loop_t* loop = &game->main_loop;
+	const char* value;
+
+	memset(loop, 0, sizeof(struct main_loop_t));
+	frame_pacer_init(&loop->pacer);
+	frame_pacer_load_settings(&loop->pacer, game->settings);
+
+	if(game->settings && (value = yaml_get_value(game->settings, "main_loop.own_thread")))
+		loop->own_thread = (strcmp(value, "true") == 0);
+	if(game->settings && (value = yaml_get_value(game->settings, "main_loop.pipelined")))
+		loop->pipelined = (strcmp(value, "true") == 0);
+#ifndef ENABLE_MULTITHREADING
+	if(loop->own_thread)
+	{
+		llog(LOG_WARNING, game, NULL, "main_loop.own_thread requires "
+			"multithreading, the loop will run on the main thread");
+		loop->own_thread = 0;
+	}
+#endif
+#ifndef ENABLE_THREAD_POOL
+	/* the tick job would run inline, adding a frame of latency for nothing */
+	if(loop->pipelined)
+	{
+		llog(LOG_WARNING, game, NULL, "main_loop.pipelined requires the "
+			"thread pool, ticks and renders will run in series");
+		loop->pipelined = 0;
+	}
+#endif
+
+	main_loop_reset_timer(game);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+main_loop_deinit(struct game_t* game)
+{
+	main_loop_stop_thread(game);
+	main_loop_wait_for_ticks(game);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+main_loop_reset_timer(struct game_t* game)
+{
+	struct main_loop_t* loop = &game->main_loop;
+
+	loop->time_begin = (int64_t)get_time_ns();
+	frame_pacer_reset(&loop->pacer, (uint64_t)loop->time_begin);
+	loop->statistics.last_tick = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+int64_t
+main_loop_get_elapsed_time(const struct game_t* game)
+{
+	return (int64_t)get_time_ns() - game->main_loop.time_begin;
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+main_loop_do_loop(struct game_t* game)
 {
-	int64_t last_tick;
-	uint32_t tick_counter_rel;
-	uint32_t render_counter_rel;
-	uint32_t tick_frame_rate;
-	uint32_t render_frame_rate;
-};
-
-struct main_loop_t
+	uint64_t wake_time;
+
+	PROFILE_BEGIN("main_loop");
+	if(game->main_loop.pipelined)
+		wake_time = main_loop_do_pipelined(game);
+	else
+		wake_time = main_loop_do_serial(game);
+	PROFILE_END();
+
+	return wake_time;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+main_loop_start_thread(struct game_t* game)
 {
-	char is_looping;
-	uint32_t fps;
-	int64_t time_begin; /* NOTE all times are in microseconds */
-	int64_t time_between_ticks;
-	int64_t tick_counter;
-	struct main_loop_statistics_t statistics;
-};
+#ifdef ENABLE_MULTITHREADING
+	struct main_loop_t* loop = &game->main_loop;
+
+	if(loop->has_thread)
+		return 1;
 
-static struct main_loop_t g_loop;
+	ATOMIC_STORE(loop->running, 1);
+	if(!thread_start(&loop->thread, main_loop_thread, game))
+	{
+		llog(LOG_ERROR, game, NULL, "Failed to create thread for the main loop");
+		ATOMIC_STORE(loop->running, 0);
+		loop->own_thread = 0; /* don't try again, the caller runs the loop */
+		return 0;
+	}
+	loop->has_thread = 1;
+	return 1;
+#else
+	return 0;
+#endif
+}
 
 /* ------------------------------------------------------------------------- */
 void
-main_loop_init(void)
+main_loop_stop_thread(struct game_t* game)
 {
-	g_loop.is_looping = 0;
-	g_loop.fps = 60;
-	g_loop.time_begin = 0;
-	g_loop.time_between_ticks = 1000000 / 60;
-	g_loop.tick_counter = 0;
-	g_loop.statistics.last_tick = 0;
-	g_loop.statistics.render_counter_rel = 0;
-	g_loop.statistics.render_frame_rate = 0;
-	g_loop.statistics.tick_counter_rel = 0;
-	g_loop.statistics.tick_frame_rate = 0;
+	struct main_loop_t* loop = &game->main_loop;
+
+	if(!loop->has_thread)
+		return;
+
+	ATOMIC_STORE(loop->running, 0);
+	thread_join(loop->thread);
+	loop->has_thread = 0;
+	game->thread_id = get_thread_id();
 }
 
 /* ------------------------------------------------------------------------- */
-static char
-is_time_to_update(void)
+void
+main_loop_wake(struct game_t* game)
+{
+	struct main_loop_t* loop = &game->main_loop;
+
+	if(!ATOMIC_LOAD(loop->waiting))
+		return;
+	ATOMIC_ADD(loop->signal, 1);
+	futex_wake_all(&loop->signal);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+main_loop_update_statistics(struct game_t* game)
 {
-	int64_t elapsed_time = main_loop_get_elapsed_time();
+	struct main_loop_statistics_t* statistics = &game->main_loop.statistics;
+	int64_t elapsed_time = main_loop_get_elapsed_time(game);
 
 	/* update internal statistics every second */
-	if(elapsed_time - g_loop.statistics.last_tick >= 1000000)
+	if(elapsed_time - statistics->last_tick >= 1000000000)
 	{
 		/* calculate render frame rate and update frame rate */
-		g_loop.statistics.render_frame_rate = g_loop.statistics.render_counter_rel;
-		g_loop.statistics.tick_frame_rate = g_loop.statistics.tick_counter_rel;
-		g_loop.statistics.render_counter_rel = 0;
-		g_loop.statistics.tick_counter_rel = 0;
+		statistics->render_frame_rate = statistics->render_counter_rel;
+		statistics->tick_frame_rate = statistics->tick_counter_rel;
+		statistics->render_counter_rel = 0;
+		statistics->tick_counter_rel = 0;
 
 		/* reset timer */
-		g_loop.statistics.last_tick = elapsed_time;
-		game_dispatch_stats(g_loop.statistics.render_frame_rate, g_loop.statistics.tick_frame_rate);
+		statistics->last_tick = elapsed_time;
+		game_dispatch_stats(game, statistics->render_frame_rate, statistics->tick_frame_rate);
 	}
+}
+
+/* ------------------------------------------------------------------------- */
+static uint64_t
+main_loop_do_serial(struct game_t* game)
+{
+	struct main_loop_t* loop = &game->main_loop;
+	uint64_t now;
 
-	/* calling this function means a render update occurred */
+	/* deliver events posted since the last frame */
+	PROFILE_SCOPE("dispatch_events", game_dispatch_events(game));
 
+	/* dispatch game loop event, once for every tick interval that passed */
+	now = get_time_ns();
+	while(frame_pacer_should_tick(&loop->pacer, now))
+	{
+		game_dispatch_tick(game);
+		++loop->statistics.tick_counter_rel;
+	}
+	PROFILE_SCOPE("publish", double_buffer_publish_all(game));
 
-	/*
-	 * If time that has passed is smaller than the time that should have passed,
-	 * it's not time to update yet.
-	 */
-	if(elapsed_time < g_loop.tick_counter * g_loop.time_between_ticks)
-		return 0;
+	/* dispatch render events */
+	now = get_time_ns();
+	if(frame_pacer_should_render(&loop->pacer, now))
+	{
+		game_dispatch_render(game, frame_pacer_get_alpha(&loop->pacer, now));
+		++loop->statistics.render_counter_rel;
+	}
 
-	/* game loop needs to be updated, increment counter and return non-zero */
-	++g_loop.tick_counter;
-	++g_loop.statistics.tick_counter_rel;
-	return 1;
+	main_loop_update_statistics(game);
+
+	return frame_pacer_get_wake_time(&loop->pacer);
 }
 
 /* ------------------------------------------------------------------------- */
-void
-main_loop_reset_timer(void)
+static uint64_t
+main_loop_do_pipelined(struct game_t* game)
 {
-	g_loop.tick_counter = 0;
-	g_loop.time_begin = get_time_in_microseconds();
-	g_loop.statistics.last_tick = 0;
+	struct main_loop_t* loop = &game->main_loop;
+	uint64_t now;
+	float alpha;
+
+	/* the ticks started during the last iteration have to finish before
+	 * their state can be published */
+	PROFILE_SCOPE("wait_for_ticks", main_loop_wait_for_ticks(game));
+
+	/* no tick is running, so this is still the tick side and is published
+	 * together with the ticks */
+	PROFILE_SCOPE("dispatch_events", game_dispatch_events(game));
+	PROFILE_SCOPE("publish", double_buffer_publish_all(game));
+	main_loop_update_statistics(game);
+
+	/* the published state is up to date with all ticks scheduled so far */
+	now = get_time_ns();
+	alpha = frame_pacer_get_alpha(&loop->pacer, now);
+
+	/* the next frame's ticks run on a worker while this one renders */
+	loop->pending_ticks = 0;
+	while(frame_pacer_should_tick(&loop->pacer, now))
+		++loop->pending_ticks;
+	if(loop->pending_ticks)
+	{
+		loop->statistics.tick_counter_rel += loop->pending_ticks;
+		ATOMIC_STORE(loop->ticks_done, 0);
+		thread_pool_queue(game->thread_pool, main_loop_tick_job, game);
+	}
+
+	if(frame_pacer_should_render(&loop->pacer, now))
+	{
+		game_dispatch_render(game, alpha);
+		++loop->statistics.render_counter_rel;
+	}
+
+	return frame_pacer_get_wake_time(&loop->pacer);
 }
 
 /* ------------------------------------------------------------------------- */
-int64_t
-main_loop_get_elapsed_time(void)
+static void
+main_loop_tick_job(void* data)
 {
-	return get_time_in_microseconds() - g_loop.time_begin;
+	struct game_t* game = (struct game_t*)data;
+	struct main_loop_t* loop = &game->main_loop;
+	uint32_t i;
+
+	for(i = 0; i != loop->pending_ticks; ++i)
+		game_dispatch_tick(game);
+
+	ATOMIC_STORE(loop->ticks_done, 1);
+	ATOMIC_ADD(loop->signal, 1);
+	futex_wake_all(&loop->signal);
 }
 
 /* ------------------------------------------------------------------------- */
-void
-main_loop_do_loop(void)
+static void
+main_loop_wait_for_ticks(struct game_t* game)
 {
-	int updates = 0;
+	struct main_loop_t* loop = &game->main_loop;
+	int signal;
 
-	/* dispatch render events */
-	game_dispatch_render();
-	++g_loop.statistics.render_counter_rel;
+	if(!loop->pending_ticks)
+		return;
 
-	/* dispatch game loop event */
-	while(is_time_to_update())
+	/*
+	 * Ticks may be blocked in SERVICE_CALL_SYNCn() waiting for this thread,
+	 * so the service queue is dispatched until the job is done. The signal
+	 * is read before checking, so a wake up in between isn't missed.
+	 */
+	ATOMIC_STORE(loop->waiting, 1);
+	for(;;)
 	{
-		game_dispatch_tick();
-		if(++updates >= 20) /* don't allow more than 20 update loops without
-								a render update */
+		signal = ATOMIC_LOAD(loop->signal);
+		service_queue_dispatch(game);
+		if(ATOMIC_LOAD(loop->ticks_done))
 			break;
+		futex_wait(&loop->signal, signal);
 	}
+	ATOMIC_STORE(loop->waiting, 0);
+	loop->pending_ticks = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+#ifdef ENABLE_MULTITHREADING
+static void
+main_loop_thread(void* data)
+{
+	struct game_t* game = (struct game_t*)data;
+
+	/* services with game thread affinity are now called on this thread */
+	game->thread_id = get_thread_id();
+	main_loop_reset_timer(game);
+
+	while(ATOMIC_LOAD(game->main_loop.running))
+		sleep_until_ns(main_loop_do_loop(game));
 }
+#endif
 
 /* ------------------------------------------------------------------------- */
 #ifdef _DEBUG
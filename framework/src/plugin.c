@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <ctype.h>
 
 #define PLUGIN_FREE_INFO_STRING(plugin, strname)        \
 	if((plugin)->info.strname)                          \
@@ -145,9 +146,15 @@ plugin_extract_version_from_string(const char* file,
 			break;
 		pch = strtok(NULL, delim);
 	}
-	/* the following numbers must be major, minor, and patch numbers */
+	/* the following numbers must be major, minor, and patch numbers. The
+	 * major number is preceded by the plugin name, e.g. "plugin_foo-1" */
 	if(pch != NULL)
-		*major = atoi(pch);
+	{
+		const char* digits = pch + strlen(pch);
+		while(digits != pch && isdigit((unsigned char)digits[-1]))
+			--digits;
+		*major = atoi(digits);
+	}
 	if((pch = strtok(NULL, delim)) != NULL)
 		*minor = atoi(pch);
 	if((pch = strtok(NULL, delim)) != NULL)
@@ -0,0 +1,249 @@
+#include "framework/plugin_index.h"
+#include "framework/plugin.h"
+#include "util/linked_list.h"
+#include "util/string.h"
+#include "util/memory.h"
+#include "util/dir.h"
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#define PLUGIN_FILE_PREFIX "plugin_"
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Splits a plugin file name into name and version and adds it to the
+ * index. Files not following the naming scheme are silently ignored.
+ * @return Returns 0 if an allocation failed, 1 if otherwise.
+ */
+static char
+plugin_index_add_file(struct plugin_index_t* index, const char* file_name);
+
+/*!
+ * @brief Frees the strings of all entries and empties the index.
+ */
+static void
+plugin_index_clear(struct plugin_index_t* index);
+
+/*!
+ * @brief qsort() callback, sorts by name ascending, then version descending.
+ */
+static int
+plugin_index_entry_compare(const void* a, const void* b);
+
+/*!
+ * @brief Returns <0, 0 or >0 if the entry's version is less than, equal to or
+ * greater than the requested version.
+ */
+static int
+plugin_index_compare_version(const struct plugin_index_entry_t* entry,
+							 const struct plugin_info_t* info);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+plugin_index_init(struct plugin_index_t* index)
+{
+	assert(index);
+
+	index->is_built = 0;
+	unordered_vector_init_vector(&index->entries, sizeof(struct plugin_index_entry_t));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+plugin_index_deinit(struct plugin_index_t* index)
+{
+	assert(index);
+
+	plugin_index_clear(index);
+	unordered_vector_clear_free(&index->entries);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+plugin_index_build(struct plugin_index_t* index, const char* directory)
+{
+	struct list_t* list;
+	char success = 1;
+
+	assert(index);
+	assert(directory);
+
+	plugin_index_clear(index);
+
+	if(!(list = list_create()))
+		return 0;
+	if(!get_directory_listing(list, directory))
+		success = 0;
+
+	/*
+	 * get_directory_listing() allocates the strings it pushes into the linked
+	 * list, and it is up to us to free them.
+	 */
+	LIST_FOR_EACH(list, char, file_name)
+		if(success && !plugin_index_add_file(index, file_name))
+			success = 0;
+		free_string(file_name);
+	LIST_END_EACH
+	list_destroy(list);
+
+	if(!success)
+	{
+		plugin_index_clear(index);
+		return 0;
+	}
+
+	/* all versions of a plugin become adjacent, newest first */
+	if(index->entries.count)
+	{
+		qsort(index->entries.data,
+			  index->entries.count,
+			  sizeof(struct plugin_index_entry_t),
+			  plugin_index_entry_compare);
+	}
+
+	index->is_built = 1;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+const struct plugin_index_entry_t*
+plugin_index_find(const struct plugin_index_t* index,
+				  const struct plugin_info_t* info,
+				  plugin_search_criteria_e criteria)
+{
+	const struct plugin_index_entry_t* entries;
+	uint32_t low, high, mid;
+
+	assert(index);
+	assert(info);
+
+	entries = (const struct plugin_index_entry_t*)index->entries.data;
+
+	/* binary search for the first entry with a matching name */
+	low = 0;
+	high = index->entries.count;
+	while(low < high)
+	{
+		mid = low + (high - low) / 2;
+		if(strcmp(entries[mid].name, info->name) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	/* versions are sorted in descending order */
+	for(; low != index->entries.count && strcmp(entries[low].name, info->name) == 0; ++low)
+	{
+		int cmp = plugin_index_compare_version(&entries[low], info);
+		if(criteria == PLUGIN_VERSION_MINIMUM)
+			return (cmp >= 0 ? &entries[low] : NULL);
+		if(cmp == 0)
+			return &entries[low];
+		if(cmp < 0)
+			break;
+	}
+
+	return NULL;
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static char
+plugin_index_add_file(struct plugin_index_t* index, const char* file_name)
+{
+	struct plugin_index_entry_t* entry;
+	const char* base_name;
+	const char* name_end;
+	const char* p;
+
+	/* strip directory */
+	base_name = file_name;
+	for(p = file_name; *p; ++p)
+		if(*p == '/' || *p == '\\')
+			base_name = p + 1;
+
+	/* expect plugin_<name>-<version> */
+	if(strncmp(base_name, PLUGIN_FILE_PREFIX, sizeof(PLUGIN_FILE_PREFIX) - 1) != 0)
+		return 1;
+	base_name += sizeof(PLUGIN_FILE_PREFIX) - 1;
+	if(!(name_end = strchr(base_name, '-')) || name_end == base_name)
+		return 1;
+
+	if(!(entry = (struct plugin_index_entry_t*)unordered_vector_push_emplace(&index->entries)))
+		return 0;
+	memset(entry, 0, sizeof(struct plugin_index_entry_t));
+
+	/* use the same parser plugin_load() uses to verify the version later on */
+	if(!plugin_extract_version_from_string(file_name, &entry->major, &entry->minor, &entry->patch))
+	{
+		unordered_vector_pop(&index->entries);
+		return 1;
+	}
+
+	if(!(entry->file_name = malloc_string(file_name)) ||
+	   !(entry->name = (char*)MALLOC((name_end - base_name + 1) * sizeof(char))))
+	{
+		if(entry->file_name)
+			free_string(entry->file_name);
+		unordered_vector_pop(&index->entries);
+		return 0;
+	}
+	memcpy(entry->name, base_name, name_end - base_name);
+	entry->name[name_end - base_name] = '\0';
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+plugin_index_clear(struct plugin_index_t* index)
+{
+	UNORDERED_VECTOR_FOR_EACH(&index->entries, struct plugin_index_entry_t, entry)
+		free_string(entry->file_name);
+		FREE(entry->name);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear(&index->entries);
+	index->is_built = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+plugin_index_entry_compare(const void* a, const void* b)
+{
+	const struct plugin_index_entry_t* entry_a = (const struct plugin_index_entry_t*)a;
+	const struct plugin_index_entry_t* entry_b = (const struct plugin_index_entry_t*)b;
+	int cmp;
+
+	if((cmp = strcmp(entry_a->name, entry_b->name)) != 0)
+		return cmp;
+
+	/* newest version first */
+	if(entry_a->major != entry_b->major)
+		return (entry_a->major > entry_b->major ? -1 : 1);
+	if(entry_a->minor != entry_b->minor)
+		return (entry_a->minor > entry_b->minor ? -1 : 1);
+	if(entry_a->patch != entry_b->patch)
+		return (entry_a->patch > entry_b->patch ? -1 : 1);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+plugin_index_compare_version(const struct plugin_index_entry_t* entry,
+							 const struct plugin_info_t* info)
+{
+	if(entry->major != info->version.major)
+		return (entry->major > info->version.major ? 1 : -1);
+	if(entry->minor != info->version.minor)
+		return (entry->minor > info->version.minor ? 1 : -1);
+	if(entry->patch != info->version.patch)
+		return (entry->patch > info->version.patch ? 1 : -1);
+	return 0;
+}
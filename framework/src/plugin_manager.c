@@ -5,17 +5,25 @@
 #include "framework/services.h"
 #include "framework/events.h"
 #include "framework/plugin.h"
+#include "framework/plugin_index.h"
 #include "framework/game.h"
+#include "framework/profiler.h"
 #include "util/config.h"
 #include "util/linked_list.h"
 #include "util/unordered_vector.h"
 #include "util/string.h"
 #include "util/module_loader.h"
-#include "util/dir.h"
 #include "util/memory.h"
 #include "util/yaml.h"
+#include "util/time.h"
 #include "framework/log.h"
 
+#if defined(LIGHTSHIP_PLATFORM_WINDOWS)
+static const char* plugin_directory = "plugins\\";
+#else
+static const char* plugin_directory = "plugins/";
+#endif
+
 /*!
  * @brief Evaluates whether the specified file is an acceptable plugin to load
  * based on the specified info and criteria.
@@ -30,7 +38,8 @@ plugin_version_acceptable(const struct plugin_info_t* info,
 						  const plugin_search_criteria_e criteria);
 
 /*!
- * @brief Scans the plugin directory for a suitable plugin to load.
+ * @brief Searches the game's plugin index for a suitable plugin to load. The
+ * index is built if this hasn't happened yet.
  * @param[in] game Game object to find plugins fore.
  * @param[in] info The requested plugin to try and match.
  * @param[in] criteria The criteria to use.
@@ -49,6 +58,7 @@ plugin_manager_init(struct game_t* game)
 	/* init game's plugin container - this keeps track of all of the loaded
 	 * plugins */
 	list_init_list(&game->plugins);
+	plugin_index_init(&game->plugin_index);
 
 	/* init core plugin */
 	game->core = plugin_create(game,
@@ -77,6 +87,8 @@ plugin_manager_deinit(struct game_t* game)
 	/* destroy core plugin if it exists */
 	if(game->core)
 		plugin_destroy(game->core);
+
+	plugin_index_deinit(&game->plugin_index);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -215,16 +227,27 @@ load_plugins_from_yaml(struct game_t* game, const struct ptree_t* plugins_node)
 	char index_key_str[sizeof(int)*8+1];
 	uint32_t index_key;
 	char success = 1;
+	/* timing breakdown, in microseconds */
+	int64_t time_begin, time_index, time_load = 0, time_start;
 
 	/* holds a list of successfully loaded plugins that haven't been started */
 	unordered_vector_init_vector(&new_plugins, sizeof(struct plugin_t*));
 
+	/*
+	 * List the plugin directory once for all plugins about to be loaded. If
+	 * this fails, find_plugin() will report the error.
+	 */
+	time_begin = get_time_in_microseconds();
+	plugin_index_build(&game->plugin_index, plugin_directory);
+	time_index = get_time_in_microseconds() - time_begin;
+
 	/* load all plugins listed in the plugins node */
 	index_key = 0;
 	YAML_FOR_EACH(plugins_node, ".", key, value)
 
 		struct plugin_t* plugin;
 		struct ptree_t* plugin_node;
+		int64_t time_plugin;
 		plugin_search_criteria_e criteria;
 		const char* version_str;
 		const char* policy_str;
@@ -296,7 +319,10 @@ load_plugins_from_yaml(struct game_t* game, const struct ptree_t* plugins_node)
 		}
 
 		/* load plugin, and add to the list of loaded plugins */
-		plugin = plugin_load(game, &target, criteria);
+		time_plugin = get_time_in_microseconds();
+		PROFILE_SCOPE("plugin_load", plugin = plugin_load(game, &target, criteria));
+		time_plugin = get_time_in_microseconds() - time_plugin;
+		time_load += time_plugin;
 		if(!plugin)
 		{
 			/* this plugin was not optional, success cannot be achieved */
@@ -309,20 +335,31 @@ load_plugins_from_yaml(struct game_t* game, const struct ptree_t* plugins_node)
 			continue;
 		}
 
+		llog(LOG_INFO, game, NULL, "plugin \"%s\" took %.2f ms to load",
+			target.name, (double)time_plugin / 1000.0);
 		unordered_vector_push(&new_plugins, &plugin);
 
 	YAML_END_EACH
 	load_plugins_from_yaml_break:
 
 	/* start loaded plugins */
+	time_start = get_time_in_microseconds();
+	PROFILE_BEGIN("plugin_start");
 	if(success)
 	{
 		UNORDERED_VECTOR_FOR_EACH(&new_plugins, struct plugin_t*, pluginp)
+			char started;
+
+			/* each plugin gets a zone of its own */
+			PROFILE_BEGIN_KEY((uintptr_t)*pluginp, (*pluginp)->info.name);
+			started = plugin_start(game, *pluginp);
+			PROFILE_END();
+
 			/*
 			* If any of the plugins fail to start, abort starting further plugins
 			* and return an error.
 			*/
-			if(!plugin_start(game, *pluginp))
+			if(!started)
 			{
 				llog(LOG_ERROR, game, NULL, "Failed to start plugin \"%s\"",
 						(*pluginp)->info.name);
@@ -331,6 +368,15 @@ load_plugins_from_yaml(struct game_t* game, const struct ptree_t* plugins_node)
 			}
 		UNORDERED_VECTOR_END_EACH
 	}
+	PROFILE_END();
+	time_start = get_time_in_microseconds() - time_start;
+
+	llog(LOG_INFO, game, NULL, "loading plugins took %.2f ms (indexing: %.2f ms, "
+		"loading: %.2f ms, starting: %.2f ms)",
+		(double)(get_time_in_microseconds() - time_begin) / 1000.0,
+		(double)time_index / 1000.0,
+		(double)time_load / 1000.0,
+		(double)time_start / 1000.0);
 
 	/* clean up */
 	unordered_vector_clear_free(&new_plugins);
@@ -421,10 +467,8 @@ find_plugin(struct game_t* game,
 			const struct plugin_info_t* info,
 			const plugin_search_criteria_e criteria)
 {
-	/* local variables */
-	struct list_t* list;
 	static const char* crit_info[] = {"minimum version ", "exact version "};
-	char* file_found = NULL;
+	const struct plugin_index_entry_t* entry;
 
 	llog(LOG_INFO, game, NULL, "looking for plugin \"%s\", %s %d.%d.%d",
 			info->name,
@@ -433,36 +477,19 @@ find_plugin(struct game_t* game,
 			info->version.minor,
 			info->version.patch);
 
-	/*
-	 * Get list of files in various plugin directories.
-	 */
-	list = list_create();
-#if defined(LIGHTSHIP_PLATFORM_WINDOWS)
-	get_directory_listing(list, "plugins\\");
-#else
-	get_directory_listing(list, "plugins/");
-#endif
-
-	/* search for plugin file name matching criteria */
-	LIST_FOR_EACH(list, char, name)
-		if(!file_found &&
-			strstr(name, info->name) &&
-			plugin_version_acceptable(info, name, criteria))
-		{
-			file_found = name;
-		}
-		else
+	/* the plugin directory is only listed once, not for every plugin */
+	if(!game->plugin_index.is_built)
+	{
+		if(!plugin_index_build(&game->plugin_index, plugin_directory))
 		{
-			/*
-			 * get_directory_listing() allocates the strings it pushes into
-			 * the linked list, and it is up to us to free them.
-			 */
-			free_string(name);
+			llog(LOG_ERROR, game, NULL, "Failed to list plugin directory \"%s\"", plugin_directory);
+			return NULL;
 		}
-	LIST_END_EACH
+	}
 
-	/* free list of directories */
-	list_destroy(list);
+	if(!(entry = plugin_index_find(&game->plugin_index, info, criteria)))
+		return NULL;
 
-	return file_found;
+	/* caller frees the returned string */
+	return malloc_string(entry->file_name);
 }
@@ -0,0 +1,577 @@
+#include "framework/profiler.h"
+#include "framework/log.h"
+#include "util/string.h"
+#include "util/time.h"
+#include "util/atomic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* a zone table is considered full at 3/4 so probing stays short */
+#define ZONE_TABLE_LIMIT (PROFILER_ZONE_TABLE_SIZE / 4 * 3)
+
+struct profiler_node_t
+{
+	char* name;                 /* copy, NULL for zones without a name */
+	uintptr_t key;              /* identifies zones without a name */
+	uint32_t parent;
+	uint32_t first_child;
+	uint32_t next_sibling;
+	uint32_t next_entered;      /* list of nodes entered in the current frame */
+	uint32_t frame_calls;
+	uint64_t frame_cycles;
+	uint32_t frames;
+	uint64_t calls;
+	uint64_t min_cycles;
+	uint64_t max_cycles;
+	uint64_t total_cycles;
+	uint64_t history[PROFILER_HISTORY_SIZE]; /* cycles per frame, indexed by frames */
+};
+
+static struct thread_ring_list_t g_profiler_rings =
+		THREAD_RING_LIST(sizeof(struct profiler_thread_t), PROFILER_RING_SIZE);
+static THREAD_LOCAL struct thread_ring_t* t_profiler_ring = NULL;
+static THREAD_LOCAL uint32_t t_profiler_generation = 0;
+
+static struct profiler_node_t g_profiler_nodes[PROFILER_MAX_NODES];
+static uint32_t g_profiler_node_count = 0;
+static uint32_t g_profiler_first_root = PROFILER_NONE;
+static uint32_t g_profiler_nodes_dropped = 0;
+static uint32_t g_profiler_frame_count = 0;
+
+/* the merged tree is only touched while holding the lock */
+static int g_profiler_lock = 0;
+
+static const char* g_profiler_kind_name[] = {"zone"};
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Returns the index of the zone with the specified key and parent in
+ * the thread's table, inserting it if necessary.
+ * @return Returns PROFILER_NONE if the table is full.
+ */
+static uint32_t
+profiler_find_zone(struct profiler_thread_t* thread,
+				   uintptr_t key,
+				   uint32_t parent,
+				   const char* name);
+
+/*!
+ * @brief Returns the merged node of a zone, creating it and the nodes of its
+ * parents if necessary.
+ * @return Returns PROFILER_NONE if the zone was cleared or the tree is full.
+ */
+static uint32_t
+profiler_map_zone(struct profiler_thread_t* thread, uint32_t zone_index);
+
+/*!
+ * @brief Returns the child node of parent matching the name or, if the name
+ * is NULL, the key. Creates it if it doesn't exist.
+ * @return Returns PROFILER_NONE if the tree is full.
+ */
+static uint32_t
+profiler_find_node(uint32_t parent, uintptr_t key, const char* name);
+
+/*!
+ * @brief Adds the time spent in a node during the current frame to its
+ * statistics.
+ */
+static void
+profiler_update_node(struct profiler_node_t* node);
+
+/*!
+ * @brief Converts the statistics of a node to nanoseconds.
+ */
+static void
+profiler_get_node_stats(const struct profiler_node_t* node,
+						struct profiler_stats_t* stats);
+
+/*!
+ * @brief Logs a node and all of its children.
+ */
+static void
+profiler_report_node(uint32_t node_index, uint32_t depth);
+
+/*!
+ * @brief Frees the zone names of the thread and resets its buffer.
+ */
+static void
+profiler_clear_thread(struct thread_ring_t* ring);
+
+/*!
+ * @brief Frees the names of the merged nodes and resets the tree.
+ */
+static void
+profiler_clear_nodes(void);
+
+/*!
+ * @brief Writes the name of a record's zone for the Chrome trace.
+ */
+static void
+profiler_write_name(FILE* fp,
+					const struct thread_ring_t* ring,
+					const struct thread_ring_record_t* record);
+
+/*!
+ * @brief Used with qsort() to sort the history of a node.
+ */
+static int
+profiler_compare_cycles(const void* a, const void* b);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+profiler_init(void)
+{
+	thread_ring_list_init(&g_profiler_rings);
+	g_profiler_first_root = PROFILER_NONE;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+profiler_deinit(void)
+{
+	thread_ring_list_deinit(&g_profiler_rings, profiler_clear_thread);
+	t_profiler_ring = NULL;
+
+	profiler_clear_nodes();
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+profiler_begin(uintptr_t key, const char* name)
+{
+	struct profiler_thread_t* thread;
+	uint32_t depth, parent, zone;
+
+	if(!(thread = (struct profiler_thread_t*)thread_ring_get(&g_profiler_rings, &t_profiler_ring, &t_profiler_generation)))
+		return cycle_counter();
+
+	depth = thread->depth++;
+	if(depth >= PROFILER_MAX_DEPTH)
+	{
+		++thread->zones_dropped;
+		return cycle_counter();
+	}
+
+	/* children of a dropped zone are dropped too, they'd end up at the root */
+	parent = (depth ? thread->open_zone[depth - 1] : PROFILER_NONE);
+	if(depth && parent == PROFILER_NONE)
+		zone = PROFILER_NONE;
+	else if((zone = profiler_find_zone(thread, key, parent, name)) == PROFILER_NONE)
+		++thread->zones_dropped;
+
+	thread->open_zone[depth] = zone;
+	return (thread->open_start[depth] = cycle_counter());
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+profiler_end(void)
+{
+	uint64_t end = cycle_counter();
+	struct profiler_thread_t* thread = (struct profiler_thread_t*)t_profiler_ring;
+	uint32_t depth;
+
+	if(!thread_ring_is_current(&g_profiler_rings, t_profiler_ring, t_profiler_generation) ||
+	   !thread->depth)
+		return end;
+
+	depth = --thread->depth;
+	if(depth >= PROFILER_MAX_DEPTH || thread->open_zone[depth] == PROFILER_NONE)
+		return end;
+
+	thread_ring_push(&g_profiler_rings, &thread->ring,
+					 thread->open_start[depth], end, thread->open_zone[depth], 0);
+	return end;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+profiler_end_frame(void)
+{
+	struct thread_ring_t* ring;
+	struct profiler_thread_t* thread;
+	const struct thread_ring_record_t* record;
+	struct profiler_node_t* node;
+	uint32_t end, node_index, first_entered = PROFILER_NONE;
+
+	SPIN_LOCK(g_profiler_lock);
+
+	/* sum up the time spent in each node */
+	for(ring = g_profiler_rings.first; ring; ring = ring->next)
+	{
+		thread = (struct profiler_thread_t*)ring;
+		end = ATOMIC_LOAD(ring->write_pos);
+		if(end - thread->read_pos > PROFILER_RING_SIZE)
+		{
+			/* the thread overwrote records that weren't merged yet */
+			thread->records_dropped += end - thread->read_pos - PROFILER_RING_SIZE;
+			thread->read_pos = end - PROFILER_RING_SIZE;
+		}
+
+		for(; thread->read_pos != end; ++thread->read_pos)
+		{
+			record = ring->record + (thread->read_pos & (PROFILER_RING_SIZE - 1));
+			if((node_index = profiler_map_zone(thread, (uint32_t)record->key)) == PROFILER_NONE)
+				continue;
+
+			node = g_profiler_nodes + node_index;
+			if(!node->frame_calls)
+			{
+				node->next_entered = first_entered;
+				first_entered = node_index;
+			}
+			++node->frame_calls;
+			node->frame_cycles += record->end - record->start;
+		}
+	}
+
+	/* nodes that weren't entered keep their statistics */
+	for(node_index = first_entered; node_index != PROFILER_NONE; node_index = node->next_entered)
+	{
+		node = g_profiler_nodes + node_index;
+		profiler_update_node(node);
+	}
+
+	++g_profiler_frame_count;
+
+	SPIN_UNLOCK(g_profiler_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+profiler_get_frame_count(void)
+{
+	return g_profiler_frame_count;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+profiler_get_stats(const char* path, struct profiler_stats_t* stats)
+{
+	const struct profiler_node_t* node;
+	const char* end;
+	uint32_t node_index, len;
+
+	assert(path);
+	assert(stats);
+
+	SPIN_LOCK(g_profiler_lock);
+
+	node = NULL;
+	node_index = g_profiler_first_root;
+	for(;;)
+	{
+		/* find the child matching the next component of the path */
+		if(!(end = strchr(path, '/')))
+			end = path + strlen(path);
+		len = (uint32_t)(end - path);
+		for(; node_index != PROFILER_NONE; node_index = node->next_sibling)
+		{
+			node = g_profiler_nodes + node_index;
+			if(node->name && strncmp(node->name, path, len) == 0 && node->name[len] == '\0')
+				break;
+		}
+		if(node_index == PROFILER_NONE)
+		{
+			SPIN_UNLOCK(g_profiler_lock);
+			return 0;
+		}
+
+		if(!*end)
+			break;
+		path = end + 1;
+		node_index = node->first_child;
+	}
+
+	profiler_get_node_stats(node, stats);
+
+	SPIN_UNLOCK(g_profiler_lock);
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+profiler_clear(void)
+{
+	struct thread_ring_t* ring;
+
+	SPIN_LOCK(g_profiler_lock);
+	for(ring = g_profiler_rings.first; ring; ring = ring->next)
+		profiler_clear_thread(ring);
+	profiler_clear_nodes();
+	SPIN_UNLOCK(g_profiler_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+profiler_report(void)
+{
+	const struct thread_ring_t* ring;
+	const struct profiler_thread_t* thread;
+	uint32_t node_index;
+
+	SPIN_LOCK(g_profiler_lock);
+
+	llog(LOG_INFO, NULL, NULL, "Profiler report (%u frames, %u threads), "
+		"time per frame min/mean/max/p99:",
+		g_profiler_frame_count, g_profiler_rings.count);
+
+	for(ring = g_profiler_rings.first; ring; ring = ring->next)
+	{
+		thread = (const struct profiler_thread_t*)ring;
+		if(thread->zones_dropped || thread->records_dropped)
+			llog(LOG_WARNING, NULL, NULL, "  thread %u: %u zones not recorded, "
+				"%u overwritten before the end of the frame",
+				ring->thread_index, thread->zones_dropped, thread->records_dropped);
+	}
+	if(g_profiler_nodes_dropped)
+		llog(LOG_WARNING, NULL, NULL, "  %u zones not merged, the tree is full",
+			g_profiler_nodes_dropped);
+
+	for(node_index = g_profiler_first_root;
+		node_index != PROFILER_NONE;
+		node_index = g_profiler_nodes[node_index].next_sibling)
+	{
+		profiler_report_node(node_index, 1);
+	}
+
+	SPIN_UNLOCK(g_profiler_lock);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+profiler_dump_chrome(const char* file_name)
+{
+	return thread_ring_dump_chrome(&g_profiler_rings, file_name, g_profiler_kind_name, profiler_write_name);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static uint32_t
+profiler_find_zone(struct profiler_thread_t* thread,
+				   uintptr_t key,
+				   uint32_t parent,
+				   const char* name)
+{
+	struct profiler_zone_t* zone;
+	uint32_t i, index;
+
+	/* Knuth's multiplicative hash, probing linearly */
+	i = ((uint32_t)key ^ (parent * 0x9E3779B9u)) * 2654435761u;
+	i ^= i >> 16;
+	for(;; ++i)
+	{
+		index = i & (PROFILER_ZONE_TABLE_SIZE - 1);
+		zone = thread->zone + index;
+		if(zone->key == key && zone->parent == parent)
+			return index;
+		if(!zone->key)
+			break;
+	}
+
+	/* first time this thread enters the zone */
+	if(thread->zone_count == ZONE_TABLE_LIMIT)
+		return PROFILER_NONE;
+	if(name && !(zone->name = malloc_string(name)))
+		return PROFILER_NONE;
+	zone->parent = parent;
+	zone->node = PROFILER_NONE;
+	zone->key = key;
+	++thread->zone_count;
+
+	return index;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+profiler_map_zone(struct profiler_thread_t* thread, uint32_t zone_index)
+{
+	struct profiler_zone_t* zone = thread->zone + zone_index;
+	uint32_t parent = PROFILER_NONE;
+
+	if(!zone->key)
+		return PROFILER_NONE;
+	if(zone->node != PROFILER_NONE)
+		return zone->node;
+
+	if(zone->parent != PROFILER_NONE &&
+	   (parent = profiler_map_zone(thread, zone->parent)) == PROFILER_NONE)
+		return PROFILER_NONE;
+
+	zone->node = profiler_find_node(parent, zone->key, zone->name);
+	return zone->node;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+profiler_find_node(uint32_t parent, uintptr_t key, const char* name)
+{
+	struct profiler_node_t* node = NULL;
+	uint32_t* link;
+	uint32_t node_index;
+
+	/* zones with a name are merged by name, so threads share nodes */
+	link = (parent == PROFILER_NONE ? &g_profiler_first_root : &g_profiler_nodes[parent].first_child);
+	for(; (node_index = *link) != PROFILER_NONE; link = &node->next_sibling)
+	{
+		node = g_profiler_nodes + node_index;
+		if(name ? (node->name && strcmp(node->name, name) == 0) : (!node->name && node->key == key))
+			return node_index;
+	}
+
+	if(g_profiler_node_count == PROFILER_MAX_NODES)
+	{
+		++g_profiler_nodes_dropped;
+		return PROFILER_NONE;
+	}
+
+	/* append, so children are reported in the order they were first seen */
+	node_index = g_profiler_node_count;
+	node = g_profiler_nodes + node_index;
+	memset(node, 0, sizeof(struct profiler_node_t));
+	if(name && !(node->name = malloc_string(name)))
+		return PROFILER_NONE;
+	node->key = key;
+	node->parent = parent;
+	node->first_child = PROFILER_NONE;
+	node->next_sibling = PROFILER_NONE;
+	++g_profiler_node_count;
+	*link = node_index;
+
+	return node_index;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_update_node(struct profiler_node_t* node)
+{
+	uint64_t cycles = node->frame_cycles;
+
+	if(!node->frames || cycles < node->min_cycles)
+		node->min_cycles = cycles;
+	if(cycles > node->max_cycles)
+		node->max_cycles = cycles;
+	node->total_cycles += cycles;
+	node->calls += node->frame_calls;
+	node->history[node->frames % PROFILER_HISTORY_SIZE] = cycles;
+	++node->frames;
+
+	node->frame_calls = 0;
+	node->frame_cycles = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_get_node_stats(const struct profiler_node_t* node,
+						struct profiler_stats_t* stats)
+{
+	uint64_t history[PROFILER_HISTORY_SIZE];
+	uint32_t count;
+
+	memset(stats, 0, sizeof(struct profiler_stats_t));
+	if(!node->frames)
+		return;
+
+	/* nearest rank percentile of the frames still in the history */
+	count = (node->frames < PROFILER_HISTORY_SIZE ? node->frames : PROFILER_HISTORY_SIZE);
+	memcpy(history, node->history, count * sizeof(uint64_t));
+	qsort(history, count, sizeof(uint64_t), profiler_compare_cycles);
+
+	stats->frames = node->frames;
+	stats->calls = node->calls;
+	stats->min_ns = cycles_to_ns(node->min_cycles);
+	stats->mean_ns = cycles_to_ns(node->total_cycles / node->frames);
+	stats->max_ns = cycles_to_ns(node->max_cycles);
+	stats->p99_ns = cycles_to_ns(history[(count * 99 + 99) / 100 - 1]);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_report_node(uint32_t node_index, uint32_t depth)
+{
+	const struct profiler_node_t* node = g_profiler_nodes + node_index;
+	struct profiler_stats_t stats;
+	uint32_t child;
+
+	profiler_get_node_stats(node, &stats);
+	if(node->name)
+		llog(LOG_INFO, NULL, NULL, "%*s%s: %.3f / %.3f / %.3f / %.3f us, %.2f calls per frame",
+			depth * 2, "", node->name,
+			(double)stats.min_ns / 1000.0, (double)stats.mean_ns / 1000.0,
+			(double)stats.max_ns / 1000.0, (double)stats.p99_ns / 1000.0,
+			stats.frames ? (double)stats.calls / (double)stats.frames : 0.0);
+	else
+		llog(LOG_INFO, NULL, NULL, "%*s0x%lx: %.3f / %.3f / %.3f / %.3f us, %.2f calls per frame",
+			depth * 2, "", (unsigned long)node->key,
+			(double)stats.min_ns / 1000.0, (double)stats.mean_ns / 1000.0,
+			(double)stats.max_ns / 1000.0, (double)stats.p99_ns / 1000.0,
+			stats.frames ? (double)stats.calls / (double)stats.frames : 0.0);
+
+	for(child = node->first_child; child != PROFILER_NONE; child = g_profiler_nodes[child].next_sibling)
+		profiler_report_node(child, depth + 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_clear_thread(struct thread_ring_t* ring)
+{
+	struct profiler_thread_t* thread = (struct profiler_thread_t*)ring;
+	uint32_t i;
+
+	for(i = 0; i != PROFILER_ZONE_TABLE_SIZE; ++i)
+		if(thread->zone[i].name)
+			free_string(thread->zone[i].name);
+	memset(thread->zone, 0, sizeof(thread->zone));
+	thread->zone_count = 0;
+	thread->zones_dropped = 0;
+	thread->records_dropped = 0;
+	thread->read_pos = 0;
+	thread_ring_reset(ring);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_clear_nodes(void)
+{
+	uint32_t i;
+
+	for(i = 0; i != g_profiler_node_count; ++i)
+		if(g_profiler_nodes[i].name)
+			free_string(g_profiler_nodes[i].name);
+	g_profiler_node_count = 0;
+	g_profiler_first_root = PROFILER_NONE;
+	g_profiler_nodes_dropped = 0;
+	g_profiler_frame_count = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+profiler_write_name(FILE* fp,
+					const struct thread_ring_t* ring,
+					const struct thread_ring_record_t* record)
+{
+	const struct profiler_zone_t* zone =
+			((const struct profiler_thread_t*)ring)->zone + record->key;
+
+	if(zone->name)
+		thread_ring_write_escaped(fp, zone->name);
+	else
+		fprintf(fp, "0x%lx", (unsigned long)zone->key);
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+profiler_compare_cycles(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,416 @@
+#include "framework/service_memo.h"
+#include "framework/services.h"
+#include "framework/game.h"
+#include "framework/log.h"
+#include "framework/plugin.h"
+#include "util/hash.h"
+#include "util/memory.h"
+#include "util/atomic.h"
+#include <string.h>
+#include <wchar.h>
+#include <assert.h>
+
+/*
+ * Pure services can be called from several threads at once. The lock is only
+ * held while looking up and inserting results, never while the service runs.
+ */
+
+/* keys up to this size are built on the stack */
+#define KEY_STACK_SIZE 256
+
+/* holds a return value of a known type */
+union service_memo_value_t
+{
+	int8_t    i8;
+	int16_t   i16;
+	int32_t   i32;
+	int64_t   i64;
+	intptr_t  iptr;
+	float     f;
+	double    d;
+};
+
+struct service_memo_entry_t
+{
+	struct service_memo_entry_t* newer;
+	struct service_memo_entry_t* older;
+	uint32_t hash;
+	uint32_t key_size;
+	union service_memo_value_t ret;
+	/* followed by key_size bytes of key */
+};
+
+#define ENTRY_KEY(entry) ((char*)((entry) + 1))
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Replaces the exec function of pure services.
+ */
+static void
+service_memo_exec(struct service_t* service, void* ret, const void** argv);
+
+/*!
+ * @brief Writes the cache key of the arguments into key.
+ * @return Returns the size of the key in bytes. If this is larger than
+ * key_capacity, nothing was written.
+ */
+static uint32_t
+service_memo_build_key(const struct type_info_t* type_info,
+					   const void** argv,
+					   char* key,
+					   uint32_t key_capacity);
+
+/*!
+ * @brief Removes an entry from the LRU list.
+ */
+static void
+service_memo_unlink(struct service_memo_t* memo,
+					struct service_memo_entry_t* entry);
+
+/*!
+ * @brief Inserts an entry at the most recently used end of the LRU list.
+ */
+static void
+service_memo_link(struct service_memo_t* memo,
+				  struct service_memo_entry_t* entry);
+
+/*!
+ * @brief Unlinks, erases and frees an entry.
+ */
+static void
+service_memo_remove(struct service_memo_t* memo,
+					struct service_memo_entry_t* entry);
+
+/*!
+ * @brief Frees all entries of the cache.
+ */
+static void
+service_memo_clear(struct service_memo_t* memo);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+char
+service_set_pure(struct service_t* service, uint32_t capacity)
+{
+	struct service_memo_t* memo;
+	uint32_t i;
+
+	assert(service);
+
+	if(!capacity)
+	{
+		service_memo_destroy(service);
+		return 1;
+	}
+
+	if(service->memo)
+	{
+		SPIN_LOCK(service->memo->lock);
+		while(service->memo->stats.count > capacity)
+		{
+			service_memo_remove(service->memo, service->memo->least_recent);
+			++service->memo->stats.evictions;
+		}
+		service->memo->stats.capacity = capacity;
+		SPIN_UNLOCK(service->memo->lock);
+		return 1;
+	}
+
+	/* see service_memo.h for why these can't be cached */
+	switch(service->type_info->ret_type)
+	{
+		case TYPE_STRING:
+		case TYPE_WSTRING:
+		case TYPE_UNKNOWN:
+			llog(LOG_ERROR, service->plugin->game, NULL, "Service \"%s\" can't "
+				"be pure, its return type isn't a value", service->directory);
+			return 0;
+		default:
+			break;
+	}
+	for(i = 0; i != service->type_info->argc; ++i)
+	{
+		if(service->type_info->argv_type[i] == TYPE_UNKNOWN)
+		{
+			llog(LOG_ERROR, service->plugin->game, NULL, "Service \"%s\" can't "
+				"be pure, argument %u has an unknown type", service->directory, i);
+			return 0;
+		}
+	}
+
+	if(!(memo = (struct service_memo_t*)MALLOC(sizeof(struct service_memo_t))))
+		OUT_OF_MEMORY("service_set_pure()", 0);
+	memset(memo, 0, sizeof(struct service_memo_t));
+	memo->exec = service->exec;
+	memo->ret_size = dynamic_call_get_type_size(service->type_info->ret_type);
+	memo->stats.capacity = capacity;
+	bstv_init_bstv(&memo->entries);
+
+	service->memo = memo;
+	service->exec = service_memo_exec;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_invalidate_cache(struct service_t* service)
+{
+	assert(service);
+
+	if(!service->memo)
+		return;
+
+	SPIN_LOCK(service->memo->lock);
+	service_memo_clear(service->memo);
+	++service->memo->generation;
+	++service->memo->stats.invalidations;
+	SPIN_UNLOCK(service->memo->lock);
+}
+
+/* ------------------------------------------------------------------------- */
+const struct service_memo_stats_t*
+service_get_cache_stats(const struct service_t* service)
+{
+	assert(service);
+	if(!service->memo)
+		return NULL;
+	return &service->memo->stats;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_reset_cache_stats(struct service_t* service)
+{
+	assert(service);
+
+	if(!service->memo)
+		return;
+
+	SPIN_LOCK(service->memo->lock);
+	service->memo->stats.hits = 0;
+	service->memo->stats.misses = 0;
+	service->memo->stats.evictions = 0;
+	service->memo->stats.invalidations = 0;
+	SPIN_UNLOCK(service->memo->lock);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_memo_destroy(struct service_t* service)
+{
+	struct service_memo_t* memo;
+
+	assert(service);
+
+	if(!(memo = service->memo))
+		return;
+
+	service->exec = memo->exec;
+	service->memo = NULL;
+	service_memo_clear(memo);
+	bstv_clear_free(&memo->entries);
+	FREE(memo);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+service_memo_exec(struct service_t* service, void* ret, const void** argv)
+{
+	struct service_memo_t* memo = service->memo;
+	struct service_memo_entry_t* entry;
+	union service_memo_value_t value;
+	char stack_key[KEY_STACK_SIZE];
+	char* key = stack_key;
+	uint32_t key_size, hash, generation;
+
+	key_size = service_memo_build_key(service->type_info, argv, key, KEY_STACK_SIZE);
+	if(key_size > KEY_STACK_SIZE)
+	{
+		/* without memory for the key, the service can still be called */
+		if(!(key = (char*)MALLOC(key_size)))
+		{
+			memo->exec(service, ret, argv);
+			return;
+		}
+		service_memo_build_key(service->type_info, argv, key, key_size);
+	}
+	hash = hash_jenkins_oaat(key, key_size);
+
+	/* hit */
+	SPIN_LOCK(memo->lock);
+	entry = (struct service_memo_entry_t*)bstv_find(&memo->entries, hash);
+	if(entry && entry->key_size == key_size && memcmp(ENTRY_KEY(entry), key, key_size) == 0)
+	{
+		if(ret)
+			memcpy(ret, &entry->ret, memo->ret_size);
+		service_memo_unlink(memo, entry);
+		service_memo_link(memo, entry);
+		++memo->stats.hits;
+		SPIN_UNLOCK(memo->lock);
+		if(key != stack_key)
+			FREE(key);
+		return;
+	}
+	++memo->stats.misses;
+	generation = memo->generation;
+	SPIN_UNLOCK(memo->lock);
+
+	/* miss, the service may call other services so it runs without the lock */
+	memset(&value, 0, sizeof(value));
+	memo->exec(service, &value, argv);
+	if(ret)
+		memcpy(ret, &value, memo->ret_size);
+
+	/* the entry isn't cached if memory can't be allocated */
+	if((entry = (struct service_memo_entry_t*)MALLOC(sizeof(struct service_memo_entry_t) + key_size)))
+	{
+		entry->hash = hash;
+		entry->key_size = key_size;
+		entry->ret = value;
+		memcpy(ENTRY_KEY(entry), key, key_size);
+
+		SPIN_LOCK(memo->lock);
+		/* the result may depend on something invalidated during the call */
+		if(memo->generation == generation)
+		{
+			/* a colliding key or another thread's result for the same key */
+			struct service_memo_entry_t* existing;
+			if((existing = (struct service_memo_entry_t*)bstv_find(&memo->entries, hash)))
+				service_memo_remove(memo, existing);
+
+			if(memo->stats.count >= memo->stats.capacity)
+			{
+				service_memo_remove(memo, memo->least_recent);
+				++memo->stats.evictions;
+			}
+			if(bstv_insert(&memo->entries, hash, entry))
+			{
+				service_memo_link(memo, entry);
+				++memo->stats.count;
+				entry = NULL;
+			}
+		}
+		SPIN_UNLOCK(memo->lock);
+
+		if(entry)
+			FREE(entry);
+	}
+
+	if(key != stack_key)
+		FREE(key);
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+service_memo_build_key(const struct type_info_t* type_info,
+					   const void** argv,
+					   char* key,
+					   uint32_t key_capacity)
+{
+	uint32_t i, size, key_size = 0;
+
+	/* compute the size first, so nothing is written if it doesn't fit */
+	for(i = 0; i != type_info->argc; ++i)
+	{
+		switch(type_info->argv_type[i])
+		{
+			case TYPE_STRING:
+				key_size += (uint32_t)strlen((const char*)argv[i]) + 1;
+				break;
+			case TYPE_WSTRING:
+				key_size += (uint32_t)((wcslen((const wchar_t*)argv[i]) + 1) * sizeof(wchar_t));
+				break;
+			default:
+				key_size += dynamic_call_get_type_size(type_info->argv_type[i]);
+				break;
+		}
+	}
+	if(key_size > key_capacity)
+		return key_size;
+
+	/* strings are 0 terminated, so "a" "bc" and "ab" "c" produce different keys */
+	for(i = 0; i != type_info->argc; ++i)
+	{
+		switch(type_info->argv_type[i])
+		{
+			case TYPE_STRING:
+				size = (uint32_t)strlen((const char*)argv[i]) + 1;
+				break;
+			case TYPE_WSTRING:
+				size = (uint32_t)((wcslen((const wchar_t*)argv[i]) + 1) * sizeof(wchar_t));
+				break;
+			default:
+				size = dynamic_call_get_type_size(type_info->argv_type[i]);
+				break;
+		}
+		memcpy(key, argv[i], size);
+		key += size;
+	}
+
+	return key_size;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_memo_unlink(struct service_memo_t* memo,
+					struct service_memo_entry_t* entry)
+{
+	if(entry->newer)
+		entry->newer->older = entry->older;
+	else
+		memo->most_recent = entry->older;
+	if(entry->older)
+		entry->older->newer = entry->newer;
+	else
+		memo->least_recent = entry->newer;
+	entry->newer = NULL;
+	entry->older = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_memo_link(struct service_memo_t* memo,
+				  struct service_memo_entry_t* entry)
+{
+	entry->newer = NULL;
+	entry->older = memo->most_recent;
+	if(memo->most_recent)
+		memo->most_recent->newer = entry;
+	else
+		memo->least_recent = entry;
+	memo->most_recent = entry;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_memo_remove(struct service_memo_t* memo,
+					struct service_memo_entry_t* entry)
+{
+	service_memo_unlink(memo, entry);
+	bstv_erase(&memo->entries, entry->hash);
+	--memo->stats.count;
+	FREE(entry);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_memo_clear(struct service_memo_t* memo)
+{
+	struct service_memo_entry_t* entry;
+
+	while((entry = memo->most_recent))
+	{
+		memo->most_recent = entry->older;
+		FREE(entry);
+	}
+	memo->least_recent = NULL;
+	memo->stats.count = 0;
+	bstv_clear(&memo->entries);
+}
@@ -0,0 +1,380 @@
+#include "framework/service_queue.h"
+#include "framework/services.h"
+#include "framework/game.h"
+#include "framework/log.h"
+#include "framework/plugin.h"
+#include "util/memory.h"
+#include "util/string.h"
+#include "util/thread.h"
+#include "util/atomic.h"
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Commands are pushed by any thread and futures are completed by the game
+ * thread. Without multithreading, every call is made directly.
+ */
+
+/* holds one argument of a known type by value */
+union service_queue_value_t
+{
+	int8_t    i8;
+	int16_t   i16;
+	int32_t   i32;
+	int64_t   i64;
+	intptr_t  iptr;
+	float     f;
+	double    d;
+};
+
+struct service_command_t
+{
+	struct service_command_t* next;
+	struct service_t* service;      /* NULL if the service was destroyed while the command was being delivered */
+	void* ret;
+	struct service_future_t* future;
+	const void* argv[SERVICE_QUEUE_MAX_ARGS];
+	union service_queue_value_t value[SERVICE_QUEUE_MAX_ARGS]; /* copies of arguments of known types */
+	char copied_string[SERVICE_QUEUE_MAX_ARGS]; /* argv[i] is a string owned by the command */
+};
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Allocates a command and points its arguments at the caller's.
+ */
+static struct service_command_t*
+service_command_create(struct service_t* service,
+					   void* ret,
+					   struct service_future_t* future,
+					   const void** argv);
+
+/*!
+ * @brief Copies the arguments of known types into the command.
+ * @return Returns 0 if a string couldn't be copied, 1 if otherwise.
+ */
+static char
+service_command_copy_arguments(struct service_command_t* command);
+
+/*!
+ * @brief Frees the command and the arguments it owns and marks its future as
+ * done.
+ */
+static void
+service_command_complete(struct service_command_t* command);
+
+/*!
+ * @brief Pushes a command onto the queue of the service's game.
+ */
+static void
+service_queue_push(struct service_command_t* command);
+
+/*!
+ * @brief Moves all pushed commands to the end of the pending list, restoring
+ * the order they were pushed in.
+ */
+static void
+service_queue_collect(struct service_queue_t* queue);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+char
+service_queue_init(struct game_t* game)
+{
+	assert(game);
+	memset(&game->service_queue, 0, sizeof(struct service_queue_t));
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_queue_deinit(struct game_t* game)
+{
+	struct service_queue_t* queue;
+	struct service_command_t* command;
+
+	assert(game);
+
+	queue = &game->service_queue;
+	service_queue_collect(queue);
+	while((command = queue->pending))
+	{
+		queue->pending = command->next;
+		service_command_complete(command);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_queue_discard_service(struct game_t* game,
+							  const struct service_t* service)
+{
+	struct service_queue_t* queue;
+	struct service_command_t** link;
+	struct service_command_t* command;
+
+	assert(game);
+	assert(service);
+
+	queue = &game->service_queue;
+
+	/* commands currently being delivered are skipped by service_queue_dispatch() */
+	for(command = queue->delivering; command; command = command->next)
+		if(command->service == service)
+			command->service = NULL;
+
+	service_queue_collect(queue);
+	link = &queue->pending;
+	while((command = *link))
+	{
+		if(command->service == service)
+		{
+			*link = command->next;
+			service_command_complete(command);
+		}
+		else
+			link = &command->next;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_queue_dispatch(struct game_t* game)
+{
+	struct service_queue_t* queue;
+	struct service_command_t* command;
+
+	assert(game);
+
+	queue = &game->service_queue;
+	service_queue_collect(queue);
+	if(!queue->pending)
+		return;
+
+	/* services are allowed to queue calls, those are executed next time */
+	queue->delivering = queue->pending;
+	queue->pending = NULL;
+
+	while((command = queue->delivering))
+	{
+		if(command->service)
+		{
+			SERVICE_DISPATCH(command->service, command->ret, command->argv)
+			if(command->future && command->future->on_done)
+				command->future->on_done(command->future, command->service, command->ret);
+		}
+		queue->delivering = command->next;
+		service_command_complete(command);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+char
+service_call_async(struct service_t* service,
+				   void* ret,
+				   struct service_future_t* future,
+				   const void** argv)
+{
+	struct service_command_t* command;
+
+	assert(service);
+	assert(service->type_info->argc <= SERVICE_QUEUE_MAX_ARGS);
+
+	if(!(command = service_command_create(service, ret, future, argv)))
+		return 0;
+	if(!service_command_copy_arguments(command))
+	{
+		command->future = NULL;
+		service_command_complete(command);
+		return 0;
+	}
+
+	service_queue_push(command);
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+service_call_sync(struct service_t* service, void* ret, const void** argv)
+{
+#ifdef ENABLE_MULTITHREADING
+	struct service_command_t* command;
+	struct service_future_t future;
+
+	assert(service);
+	assert(service->type_info->argc <= SERVICE_QUEUE_MAX_ARGS);
+
+	if(service->affinity == SERVICE_AFFINITY_GAME_THREAD &&
+		get_thread_id() != service->plugin->game->thread_id)
+	{
+		/* the caller's arguments stay valid until the call completed */
+		memset(&future, 0, sizeof(struct service_future_t));
+		if(!(command = service_command_create(service, ret, &future, argv)))
+			return 0;
+		service_queue_push(command);
+		service_future_wait(&future);
+		return 1;
+	}
+#endif
+
+	SERVICE_DISPATCH(service, ret, argv)
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+service_future_is_done(struct service_future_t* future)
+{
+	assert(future);
+	return ATOMIC_LOAD(future->done) != 0;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_future_wait(struct service_future_t* future)
+{
+	assert(future);
+	while(!ATOMIC_LOAD(future->done))
+		futex_wait(&future->done, 0);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static struct service_command_t*
+service_command_create(struct service_t* service,
+					   void* ret,
+					   struct service_future_t* future,
+					   const void** argv)
+{
+	struct service_command_t* command;
+	uint32_t i;
+
+	if(!(command = (struct service_command_t*)MALLOC(sizeof(struct service_command_t))))
+		OUT_OF_MEMORY("service_command_create()", NULL);
+	memset(command, 0, sizeof(struct service_command_t));
+	command->service = service;
+	command->ret = ret;
+	command->future = future;
+	for(i = 0; i != service->type_info->argc; ++i)
+		command->argv[i] = argv[i];
+
+	return command;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+service_command_copy_arguments(struct service_command_t* command)
+{
+	uint32_t i;
+
+	for(i = 0; i != command->service->type_info->argc; ++i)
+	{
+		union service_queue_value_t* value = &command->value[i];
+		const void* arg = command->argv[i];
+		switch(command->service->type_info->argv_type[i])
+		{
+			case TYPE_INT8:
+			case TYPE_UINT8:   memcpy(value, arg, sizeof(int8_t));   break;
+			case TYPE_INT16:
+			case TYPE_UINT16:  memcpy(value, arg, sizeof(int16_t));  break;
+			case TYPE_INT32:
+			case TYPE_UINT32:  memcpy(value, arg, sizeof(int32_t));  break;
+			case TYPE_INT64:
+			case TYPE_UINT64:  memcpy(value, arg, sizeof(int64_t));  break;
+			case TYPE_INTPTR:
+			case TYPE_UINTPTR: memcpy(value, arg, sizeof(intptr_t)); break;
+			case TYPE_FLOAT:   memcpy(value, arg, sizeof(float));    break;
+			case TYPE_DOUBLE:  memcpy(value, arg, sizeof(double));   break;
+
+			case TYPE_STRING:
+				if(!(command->argv[i] = malloc_string((const char*)arg)))
+					return 0;
+				command->copied_string[i] = 1;
+				continue;
+			case TYPE_WSTRING:
+				if(!(command->argv[i] = malloc_wstring((const wchar_t*)arg)))
+					return 0;
+				command->copied_string[i] = 1;
+				continue;
+
+			/* can't know the size of unknown types, queue a reference */
+			default:
+				continue;
+		}
+		command->argv[i] = value;
+	}
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_command_complete(struct service_command_t* command)
+{
+	struct service_future_t* future;
+	uint32_t i;
+
+	for(i = 0; i != SERVICE_QUEUE_MAX_ARGS; ++i)
+		if(command->copied_string[i])
+			free_string((void*)command->argv[i]);
+
+	future = command->future;
+	FREE(command);
+
+	/* the future may go out of scope as soon as done is set */
+	if(future)
+	{
+		ATOMIC_STORE(future->done, 1);
+		futex_wake_all(&future->done);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_queue_push(struct service_command_t* command)
+{
+	struct service_queue_t* queue = &command->service->plugin->game->service_queue;
+	struct service_command_t* head;
+
+	do
+	{
+		head = ATOMIC_LOAD_PTR(queue->pushed);
+		command->next = head;
+	} while(!ATOMIC_CAS(queue->pushed, head, command));
+
+	/* the game thread may be waiting for a pipelined tick to finish */
+	main_loop_wake(command->service->plugin->game);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_queue_collect(struct service_queue_t* queue)
+{
+	struct service_command_t* command;
+	struct service_command_t* reversed = NULL;
+	struct service_command_t** tail;
+
+	/* take the whole stack at once, popping single commands would be prone
+	 * to ABA */
+	do
+	{
+		command = ATOMIC_LOAD_PTR(queue->pushed);
+	} while(command && !ATOMIC_CAS(queue->pushed, command, NULL));
+
+	while(command)
+	{
+		struct service_command_t* next = command->next;
+		command->next = reversed;
+		reversed = command;
+		command = next;
+	}
+
+	for(tail = &queue->pending; *tail; tail = &(*tail)->next)
+	{
+	}
+	*tail = reversed;
+}
@@ -2,18 +2,39 @@
 #include "framework/game.h"
 #include "framework/log.h"
 #include "framework/plugin.h"
+#include "framework/profiler.h"
 #include "framework/services.h"
 #include "util/hash.h"
 #include "util/memory.h"
 #include "util/string.h"
+#include "util/thread.h"
+#include "util/atomic.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <wchar.h>
 
+/*
+ * Incremented whenever a service is created or destroyed in any game. This
+ * invalidates all service_call_cache_t objects. Caches are read by any
+ * thread, so this is only modified with atomics.
+ */
+static uint32_t g_service_generation = 0;
+
+/* batch calls of services with more arguments than this allocate */
+#define BATCH_STACK_ARGC 8
+
 static void
 service_free(struct service_t* service);
 
+/*!
+ * @brief Points the handle of the specified directory, if any, to a service.
+ */
+static void
+service_handle_bind(struct game_t* game,
+					const char* directory,
+					struct service_t* service);
+
 /*!
  * @brief Same as service_create, but it doesn't fire service.created when
  * called.
@@ -24,6 +45,46 @@ service_create_no_fire_notification(struct plugin_t* plugin,
 									const service_func exec,
 									struct type_info_t* type_info);
 
+/*!
+ * @brief Calls the service function once for every element of the columns.
+ * Used for services without a batch implementation.
+ */
+static char
+service_call_batch_loop(struct service_t* service,
+						void* ret,
+						uint32_t count,
+						const void** columns);
+
+#ifdef ENABLE_TRACING
+/*!
+ * @brief Writes a Chrome trace to the specified file, see trace_dump_chrome().
+ */
+static SERVICE(trace_dump_wrapper);
+
+/*!
+ * @brief Logs call counts and latency histograms, see trace_report().
+ */
+static SERVICE(trace_report_wrapper);
+#endif
+
+#ifdef ENABLE_PROFILER
+/*!
+ * @brief Writes the recorded zones as a Chrome trace, see
+ * profiler_dump_chrome().
+ */
+static SERVICE(profiler_dump_wrapper);
+
+/*!
+ * @brief Logs the per-frame statistics of all zones, see profiler_report().
+ */
+static SERVICE(profiler_report_wrapper);
+
+/*!
+ * @brief Copies the per-frame statistics of a zone, see profiler_get_stats().
+ */
+static SERVICE(profiler_get_stats_wrapper);
+#endif
+
 /* ------------------------------------------------------------------------- */
 char
 service_init(struct game_t* game)
@@ -31,6 +92,7 @@ service_init(struct game_t* game)
 	assert(game);
 
 	ptree_init_ptree(&game->services, NULL);
+	bsthv_init_bsthv(&game->service_handles);
 
 	/* ------------------------------------------------------------------------
 	 * Register built-in services
@@ -57,6 +119,19 @@ service_init(struct game_t* game)
 		SERVICE_CREATE0(game->core, game->service.pause, "pause", game_pause_wrapper, void); CHECK(pause)
 		SERVICE_CREATE0(game->core, game->service.stop,  "stop",  game_exit_wrapper,  void); CHECK(stop)
 
+#ifdef ENABLE_TRACING
+		/* tracing, see trace.h */
+		SERVICE_CREATE1(game->core, game->service.trace_dump, "trace_dump", trace_dump_wrapper, char, const char*); CHECK(trace_dump)
+		SERVICE_CREATE0(game->core, game->service.trace_report, "trace_report", trace_report_wrapper, void); CHECK(trace_report)
+#endif
+
+#ifdef ENABLE_PROFILER
+		/* profiling, see profiler.h */
+		SERVICE_CREATE1(game->core, game->service.profiler_dump, "profiler_dump", profiler_dump_wrapper, char, const char*); CHECK(profiler_dump)
+		SERVICE_CREATE0(game->core, game->service.profiler_report, "profiler_report", profiler_report_wrapper, void); CHECK(profiler_report)
+		SERVICE_CREATE2(game->core, game->service.profiler_get_stats, "profiler_get_stats", profiler_get_stats_wrapper, char, const char*, struct profiler_stats_t*); CHECK(profiler_get_stats)
+#endif
+
 #undef SERVICE_CREATE
 #pragma pop_macro("SERVICE_CREATE")
 #undef CHECK
@@ -72,6 +147,14 @@ void
 service_deinit(struct game_t* game)
 {
 	ptree_destroy_keep_root(&game->services);
+	ATOMIC_INCREMENT(g_service_generation);
+
+	/* handles that weren't released would point to destroyed services */
+	BSTHV_FOR_EACH(&game->service_handles, struct service_handle_t, directory, handle)
+		llog(LOG_WARNING, NULL, NULL, "Service handle \"%s\" was never released", directory);
+		FREE(handle);
+	BSTHV_END_EACH
+	bsthv_clear_free(&game->service_handles);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -142,6 +225,10 @@ service_create_no_fire_notification(struct plugin_t* plugin,
 		 * nodes easier */
 		ptree_set_free_func(node, (ptree_free_func)service_free);
 
+		/* existing handles and cached lookups now refer to this service */
+		service_handle_bind(plugin->game, directory, service);
+		ATOMIC_INCREMENT(g_service_generation);
+
 		/* success! */
 		return service;
 	}
@@ -204,6 +291,9 @@ service_destroy(struct service_t* service)
 	EVENT_FIRE1(service->plugin->game->event.service_destroyed,
 				PTR(service->directory));
 
+	service_handle_bind(game, service->directory, NULL);
+	ATOMIC_INCREMENT(g_service_generation);
+
 	/* destroying the node will free the service using ptree's free function */
 	ptree_destroy(node);
 }
@@ -216,6 +306,8 @@ service_free(struct service_t* service)
 	assert(service->directory);
 	assert(service->type_info);
 
+	service_queue_discard_service(service->plugin->game, service);
+	service_memo_destroy(service);
 	free_string(service->directory);
 	dynamic_call_destroy_type_info(service->type_info);
 	FREE(service);
@@ -242,3 +334,245 @@ service_get(struct game_t* game, const char* directory)
 	assert(node->value);
 	return (struct service_t*)node->value;
 }
+
+/* ------------------------------------------------------------------------- */
+struct service_t*
+service_get_cached(struct game_t* game,
+				   const char* directory,
+				   struct service_call_cache_t* cache)
+{
+	uint32_t generation;
+
+	assert(cache);
+
+	/*
+	 * Read before the lookup: if a service is created or destroyed during
+	 * it, the cached result is already out of date and the next call looks
+	 * it up again.
+	 */
+	generation = ATOMIC_LOAD_ACQUIRE(g_service_generation);
+	if(cache->game == game &&
+	   cache->directory == directory &&
+	   cache->generation == generation)
+	{
+		return cache->service;
+	}
+
+	cache->service = service_get(game, directory);
+	cache->game = game;
+	cache->directory = directory;
+	cache->generation = generation;
+	return cache->service;
+}
+
+/* ------------------------------------------------------------------------- */
+struct service_handle_t*
+service_handle_acquire(struct game_t* game, const char* directory)
+{
+	struct service_handle_t* handle;
+
+	assert(game);
+	assert(directory);
+
+	/* share existing handle */
+	if((handle = (struct service_handle_t*)bsthv_find(&game->service_handles, directory)))
+	{
+		++handle->refcount;
+		return handle;
+	}
+
+	if(!(handle = (struct service_handle_t*)MALLOC(sizeof(struct service_handle_t))))
+		OUT_OF_MEMORY("service_handle_acquire()", NULL);
+	handle->game = game;
+	handle->refcount = 1;
+	handle->service = service_get(game, directory);
+
+	if(!bsthv_insert(&game->service_handles, directory, handle))
+	{
+		FREE(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_handle_release(struct service_handle_t* handle)
+{
+	assert(handle);
+	assert(handle->refcount);
+
+	if(--handle->refcount)
+		return;
+
+	bsthv_erase_element(&handle->game->service_handles, handle);
+	FREE(handle);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_set_batch(struct service_t* service, service_batch_func batch)
+{
+	assert(service);
+	service->batch = batch;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_set_affinity(struct service_t* service, service_affinity_e affinity)
+{
+	assert(service);
+	service->affinity = affinity;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+service_check_affinity(const struct service_t* service)
+{
+	struct game_t* game;
+
+	assert(service);
+
+	game = service->plugin->game;
+	if(service->affinity == SERVICE_AFFINITY_GAME_THREAD &&
+		get_thread_id() != game->thread_id)
+	{
+		llog(LOG_ERROR, game, NULL, "Service \"%s\" was called from outside "
+			"of the game thread, use SERVICE_CALL_SYNCn() or "
+			"SERVICE_CALL_ASYNCn() instead", service->directory);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+char
+service_call_batch(struct service_t* service,
+				   void* ret,
+				   uint32_t count,
+				   const void** columns)
+{
+	char result = 1;
+
+	assert(service);
+	assert(columns || !service->type_info->argc);
+
+	if(service->batch)
+		TRACE_CALL(TRACE_SERVICE, (uintptr_t)service, service->directory,
+		           service->batch(service, ret, count, columns));
+	else
+		TRACE_CALL(TRACE_SERVICE, (uintptr_t)service, service->directory,
+		           result = service_call_batch_loop(service, ret, count, columns));
+
+	return result;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+service_handle_bind(struct game_t* game,
+					const char* directory,
+					struct service_t* service)
+{
+	struct service_handle_t* handle;
+	if((handle = (struct service_handle_t*)bsthv_find(&game->service_handles, directory)))
+		handle->service = service;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+service_call_batch_loop(struct service_t* service,
+						void* ret,
+						uint32_t count,
+						const void** columns)
+{
+	const struct type_info_t* type_info = service->type_info;
+	const void* argv_stack[BATCH_STACK_ARGC];
+	uint32_t stride_stack[BATCH_STACK_ARGC];
+	const void** argv = argv_stack;
+	uint32_t* stride = stride_stack;
+	uint32_t ret_stride = 0;
+	uint32_t i, k;
+
+	/* argument vector and the size of each column's elements */
+	if(type_info->argc > BATCH_STACK_ARGC)
+	{
+		argv = (const void**)MALLOC(type_info->argc * (sizeof(void*) + sizeof(uint32_t)));
+		if(!argv)
+			OUT_OF_MEMORY("service_call_batch()", 0);
+		stride = (uint32_t*)(argv + type_info->argc);
+	}
+
+	for(;;)
+	{
+		for(i = 0; i != type_info->argc; ++i)
+			if(!(stride[i] = dynamic_call_get_type_size(type_info->argv_type[i])))
+				break;
+		if(i != type_info->argc)
+			break;
+		if(ret && type_info->ret_type != TYPE_VOID)
+			if(!(ret_stride = dynamic_call_get_type_size(type_info->ret_type)))
+				break;
+
+		for(k = 0; k != count; ++k)
+		{
+			for(i = 0; i != type_info->argc; ++i)
+			{
+				/* strings are passed by value, see PTR() */
+				if(type_info->argv_type[i] == TYPE_STRING ||
+				   type_info->argv_type[i] == TYPE_WSTRING)
+					argv[i] = ((const void* const*)columns[i])[k];
+				else
+					argv[i] = (const char*)columns[i] + k * stride[i];
+			}
+			service->exec(service, ret_stride ? (char*)ret + k * ret_stride : NULL, argv);
+		}
+
+		if(argv != argv_stack)
+			FREE(argv);
+		return 1;
+	}
+
+	llog(LOG_ERROR, service->plugin->game, NULL, "Can't batch call service "
+		"\"%s\": it has arguments or a return value of unknown size and no "
+		"batch implementation", service->directory);
+	if(argv != argv_stack)
+		FREE(argv);
+	return 0;
+}
+
+#ifdef ENABLE_TRACING
+/* ------------------------------------------------------------------------- */
+static SERVICE(trace_dump_wrapper)
+{
+	EXTRACT_ARGUMENT_PTR(0, file_name, const char*);
+	RETURN(trace_dump_chrome(file_name), char);
+}
+
+/* ------------------------------------------------------------------------- */
+static SERVICE(trace_report_wrapper)
+{
+	trace_report();
+}
+#endif
+
+#ifdef ENABLE_PROFILER
+/* ------------------------------------------------------------------------- */
+static SERVICE(profiler_dump_wrapper)
+{
+	EXTRACT_ARGUMENT_PTR(0, file_name, const char*);
+	RETURN(profiler_dump_chrome(file_name), char);
+}
+
+/* ------------------------------------------------------------------------- */
+static SERVICE(profiler_report_wrapper)
+{
+	profiler_report();
+}
+
+/* ------------------------------------------------------------------------- */
+static SERVICE(profiler_get_stats_wrapper)
+{
+	EXTRACT_ARGUMENT_PTR(0, path, const char*);
+	EXTRACT_ARGUMENT_PTR(1, stats, struct profiler_stats_t*);
+	RETURN(profiler_get_stats(path, stats), char);
+}
+#endif
@@ -0,0 +1,186 @@
+#include "framework/thread_ring.h"
+#include "framework/log.h"
+#include "util/memory.h"
+#include "util/time.h"
+#include "util/atomic.h"
+#include <string.h>
+#include <assert.h>
+
+/* the ring starts aligned for its records */
+#define ALIGN_UP(x, alignment) (((x) + (alignment) - 1) / (alignment) * (alignment))
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Converts cycle_counter() cycles to microseconds.
+ */
+static double
+thread_ring_cycles_to_us(uint64_t cycles);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+thread_ring_list_init(struct thread_ring_list_t* list)
+{
+	assert(list);
+	list->start_cycles = cycle_counter();
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_ring_list_deinit(struct thread_ring_list_t* list,
+						thread_ring_free_func free_func)
+{
+	struct thread_ring_t* ring;
+
+	assert(list);
+
+	ATOMIC_INCREMENT(list->generation);
+	while((ring = list->first))
+	{
+		list->first = ring->next;
+		if(free_func)
+			free_func(ring);
+		FREE(ring);
+	}
+	list->count = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+struct thread_ring_t*
+thread_ring_get(struct thread_ring_list_t* list,
+				struct thread_ring_t** local,
+				uint32_t* local_generation)
+{
+	struct thread_ring_t* ring;
+	uint32_t generation = ATOMIC_LOAD_ACQUIRE(list->generation);
+	uint32_t records_offset = ALIGN_UP(list->buffer_size, 8);
+
+	if(*local && *local_generation == generation)
+		return *local;
+
+	assert(list->buffer_size >= sizeof(struct thread_ring_t));
+	assert((list->ring_size & (list->ring_size - 1)) == 0);
+
+	if(!(ring = (struct thread_ring_t*)MALLOC(records_offset +
+			list->ring_size * sizeof(struct thread_ring_record_t))))
+		return NULL;
+	memset(ring, 0, list->buffer_size);
+	ring->record = (struct thread_ring_record_t*)((char*)ring + records_offset);
+	ring->thread_index = ATOMIC_INCREMENT(list->count) - 1;
+
+	do
+	{
+		ring->next = list->first;
+	} while(!ATOMIC_CAS(list->first, ring->next, ring));
+
+	*local = ring;
+	*local_generation = generation;
+	return ring;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_ring_push(struct thread_ring_list_t* list,
+				 struct thread_ring_t* ring,
+				 uint64_t start,
+				 uint64_t end,
+				 uintptr_t key,
+				 uint32_t kind)
+{
+	struct thread_ring_record_t* record;
+
+	/* the ring is only written by this thread, publish the position last */
+	record = ring->record + (ring->write_pos & (list->ring_size - 1));
+	record->start = start;
+	record->end = end;
+	record->key = key;
+	record->kind = kind;
+	ATOMIC_PUBLISH(ring->write_pos, ring->write_pos + 1);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_ring_reset(struct thread_ring_t* ring)
+{
+	ATOMIC_PUBLISH(ring->write_pos, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+thread_ring_dump_chrome(const struct thread_ring_list_t* list,
+						const char* file_name,
+						const char* const* kind_name,
+						thread_ring_write_name_func write_name)
+{
+	struct thread_ring_t* ring;
+	const struct thread_ring_record_t* record;
+	uint32_t pos, end;
+	char first = 1;
+	FILE* fp;
+
+	assert(list);
+	assert(file_name);
+	assert(kind_name);
+	assert(write_name);
+
+	if(!(fp = fopen(file_name, "w")))
+	{
+		llog(LOG_ERROR, NULL, NULL, "Failed to open trace file \"%s\"", file_name);
+		return 0;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for(ring = list->first; ring; ring = ring->next)
+	{
+		/* only the last ring_size records are still there */
+		end = ATOMIC_LOAD(ring->write_pos);
+		pos = (end > list->ring_size ? end - list->ring_size : 0);
+		for(; pos != end; ++pos)
+		{
+			record = ring->record + (pos & (list->ring_size - 1));
+			fprintf(fp, "%s\n{\"name\":\"", first ? "" : ",");
+			write_name(fp, ring, record);
+			fprintf(fp, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+				kind_name[record->kind],
+				thread_ring_cycles_to_us(record->start - list->start_cycles),
+				thread_ring_cycles_to_us(record->end - record->start),
+				ring->thread_index);
+			first = 0;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+
+	if(fclose(fp) != 0)
+	{
+		llog(LOG_ERROR, NULL, NULL, "Failed to write trace file \"%s\"", file_name);
+		return 0;
+	}
+
+	llog(LOG_INFO, NULL, NULL, "Wrote trace to \"%s\"", file_name);
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_ring_write_escaped(FILE* fp, const char* str)
+{
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\')
+			fputc('\\', fp);
+		fputc(*str, fp);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static double
+thread_ring_cycles_to_us(uint64_t cycles)
+{
+	return (double)cycles_to_ns(cycles) / 1000.0;
+}
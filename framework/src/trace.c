@@ -0,0 +1,279 @@
+#include "framework/trace.h"
+#include "framework/log.h"
+#include "util/string.h"
+#include "util/time.h"
+#include "util/atomic.h"
+#include <stdio.h>
+#include <string.h>
+
+static struct thread_ring_list_t g_trace_rings =
+		THREAD_RING_LIST(sizeof(struct trace_thread_t), TRACE_RING_SIZE);
+static THREAD_LOCAL struct thread_ring_t* t_trace_ring = NULL;
+static THREAD_LOCAL uint32_t t_trace_generation = 0;
+
+static const char* g_trace_kind_name[] = {"event", "listener", "service"};
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Returns the counter of the specified key in the thread's table, or
+ * the free slot where it would be inserted.
+ * @return Returns NULL if the key doesn't exist and the table is full.
+ */
+static struct trace_counter_t*
+trace_find_counter(const struct trace_thread_t* thread,
+				   trace_kind_e kind,
+				   uintptr_t key);
+
+/*!
+ * @brief Frees the names held by the thread's counters and resets them.
+ */
+static void
+trace_clear_thread(struct thread_ring_t* ring);
+
+/*!
+ * @brief Converts cycle_counter() cycles to microseconds.
+ */
+static double
+trace_cycles_to_us(uint64_t cycles);
+
+/*!
+ * @brief Writes the name of a record for the Chrome trace.
+ */
+static void
+trace_write_name(FILE* fp,
+				 const struct thread_ring_t* ring,
+				 const struct thread_ring_record_t* record);
+
+/* ----------------------------------------------------------------------------
+ * Exported functions
+ * ------------------------------------------------------------------------- */
+void
+trace_init(void)
+{
+	thread_ring_list_init(&g_trace_rings);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+trace_deinit(void)
+{
+	thread_ring_list_deinit(&g_trace_rings, trace_clear_thread);
+	t_trace_ring = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+trace_now(void)
+{
+	return cycle_counter();
+}
+
+/* ------------------------------------------------------------------------- */
+void
+trace_record(trace_kind_e kind, uintptr_t key, const char* name, uint64_t start)
+{
+	trace_record_span(kind, key, name, start, cycle_counter());
+}
+
+/* ------------------------------------------------------------------------- */
+void
+trace_record_span(trace_kind_e kind,
+				  uintptr_t key,
+				  const char* name,
+				  uint64_t start,
+				  uint64_t end)
+{
+	struct trace_thread_t* thread;
+	struct trace_counter_t* counter;
+	uint64_t duration = end - start;
+	uint32_t bucket;
+
+	if(!(thread = (struct trace_thread_t*)thread_ring_get(&g_trace_rings, &t_trace_ring, &t_trace_generation)))
+		return;
+
+	thread_ring_push(&g_trace_rings, &thread->ring, start, end, key, kind);
+
+	if(!(counter = trace_find_counter(thread, kind, key)))
+	{
+		++thread->counters_dropped;
+		return;
+	}
+	if(!counter->key)
+	{
+		/* first call seen by this thread, name is allowed to stay NULL */
+		counter->kind = kind;
+		counter->name = (name ? malloc_string(name) : NULL);
+		counter->key = key;
+	}
+	++counter->count;
+	counter->cycles += duration;
+	for(bucket = 0; duration > 1 && bucket != TRACE_HISTOGRAM_BUCKETS - 1; duration >>= 1)
+		++bucket;
+	++counter->histogram[bucket];
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+trace_get_count(trace_kind_e kind, uintptr_t key)
+{
+	struct thread_ring_t* ring;
+	const struct trace_counter_t* counter;
+	uint64_t count = 0;
+
+	for(ring = g_trace_rings.first; ring; ring = ring->next)
+		if((counter = trace_find_counter((struct trace_thread_t*)ring, kind, key)) && counter->key)
+			count += counter->count;
+
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+trace_clear(void)
+{
+	struct thread_ring_t* ring;
+	for(ring = g_trace_rings.first; ring; ring = ring->next)
+		trace_clear_thread(ring);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+trace_dump_chrome(const char* file_name)
+{
+	return thread_ring_dump_chrome(&g_trace_rings, file_name, g_trace_kind_name, trace_write_name);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+trace_report(void)
+{
+	struct thread_ring_t* ring;
+	struct thread_ring_t* other_ring;
+	const struct trace_thread_t* thread;
+	const struct trace_counter_t* counter;
+	const struct trace_counter_t* other_counter;
+	uint64_t count, cycles, histogram[TRACE_HISTOGRAM_BUCKETS];
+	uint32_t i, bucket;
+	char seen_before;
+
+	llog(LOG_INFO, NULL, NULL, "Trace report (%u threads):", g_trace_rings.count);
+
+	/*
+	 * Merge counters of the same key across threads. Each key is reported
+	 * by the first thread that has it.
+	 */
+	for(ring = g_trace_rings.first; ring; ring = ring->next)
+	{
+		thread = (const struct trace_thread_t*)ring;
+		if(thread->counters_dropped)
+			llog(LOG_WARNING, NULL, NULL, "  thread %u: %u calls not counted, the counter table is full",
+				ring->thread_index, thread->counters_dropped);
+
+		for(i = 0; i != TRACE_COUNTER_TABLE_SIZE; ++i)
+		{
+			counter = thread->counter + i;
+			if(!counter->key)
+				continue;
+
+			seen_before = 0;
+			for(other_ring = g_trace_rings.first; other_ring != ring; other_ring = other_ring->next)
+				if((other_counter = trace_find_counter((const struct trace_thread_t*)other_ring, (trace_kind_e)counter->kind, counter->key)) && other_counter->key)
+					seen_before = 1;
+			if(seen_before)
+				continue;
+
+			count = 0;
+			cycles = 0;
+			memset(histogram, 0, sizeof(histogram));
+			for(other_ring = ring; other_ring; other_ring = other_ring->next)
+			{
+				other_counter = trace_find_counter((const struct trace_thread_t*)other_ring, (trace_kind_e)counter->kind, counter->key);
+				if(!other_counter || !other_counter->key)
+					continue;
+				count += other_counter->count;
+				cycles += other_counter->cycles;
+				for(bucket = 0; bucket != TRACE_HISTOGRAM_BUCKETS; ++bucket)
+					histogram[bucket] += other_counter->histogram[bucket];
+			}
+
+			if(counter->name)
+				llog(LOG_INFO, NULL, NULL, "  %s \"%s\": %lu calls, mean %.3f us",
+					g_trace_kind_name[counter->kind], counter->name,
+					(unsigned long)count, trace_cycles_to_us(cycles) / (double)count);
+			else
+				llog(LOG_INFO, NULL, NULL, "  %s 0x%lx: %lu calls, mean %.3f us",
+					g_trace_kind_name[counter->kind], (unsigned long)counter->key,
+					(unsigned long)count, trace_cycles_to_us(cycles) / (double)count);
+
+			for(bucket = 0; bucket != TRACE_HISTOGRAM_BUCKETS; ++bucket)
+				if(histogram[bucket])
+					llog(LOG_INFO, NULL, NULL, "    < %10.3f us: %lu",
+						trace_cycles_to_us((uint64_t)2 << bucket),
+						(unsigned long)histogram[bucket]);
+		}
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static struct trace_counter_t*
+trace_find_counter(const struct trace_thread_t* thread,
+				   trace_kind_e kind,
+				   uintptr_t key)
+{
+	const struct trace_counter_t* counter;
+	uint32_t i, probe;
+
+	/* Knuth's multiplicative hash, probing linearly */
+	i = ((uint32_t)key ^ (uint32_t)kind) * 2654435761u;
+	i ^= i >> 16;
+	for(probe = 0; probe != TRACE_COUNTER_TABLE_SIZE; ++probe, ++i)
+	{
+		counter = thread->counter + (i & (TRACE_COUNTER_TABLE_SIZE - 1));
+		if(!counter->key || (counter->key == key && counter->kind == (uint32_t)kind))
+			return (struct trace_counter_t*)counter;
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+trace_clear_thread(struct thread_ring_t* ring)
+{
+	struct trace_thread_t* thread = (struct trace_thread_t*)ring;
+	uint32_t i;
+
+	for(i = 0; i != TRACE_COUNTER_TABLE_SIZE; ++i)
+		if(thread->counter[i].name)
+			free_string(thread->counter[i].name);
+	memset(thread->counter, 0, sizeof(thread->counter));
+	thread->counters_dropped = 0;
+	thread_ring_reset(ring);
+}
+
+/* ------------------------------------------------------------------------- */
+static double
+trace_cycles_to_us(uint64_t cycles)
+{
+	return (double)cycles_to_ns(cycles) / 1000.0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+trace_write_name(FILE* fp,
+				 const struct thread_ring_t* ring,
+				 const struct thread_ring_record_t* record)
+{
+	const struct trace_counter_t* counter;
+
+	counter = trace_find_counter((const struct trace_thread_t*)ring, (trace_kind_e)record->kind, record->key);
+	if(counter && counter->key && counter->name)
+		thread_ring_write_escaped(fp, counter->name);
+	else
+		fprintf(fp, "%s 0x%lx", g_trace_kind_name[record->kind], (unsigned long)record->key);
+}
@@ -5,6 +5,7 @@
 #include "framework/log.h"
 #include "util/memory.h"
 #include "util/yaml.h"
+#include "util/vfs.h"
 
 struct ptree_t;
 
@@ -14,6 +15,9 @@ static const char* yml_settings = "../../lightship/cfg/settings_d.yml";
 static const char* yml_settings = "cfg/settings.yml";
 #endif
 
+/* optional archive holding all assets, loose files are used if it doesn't exist */
+static const char* pack_file = "data.pak";
+
 /* -------------------------------------------------------------------------- */
 char
 load_core_plugins(struct game_t* game)
@@ -58,8 +62,15 @@ init()
 	 * Initialise global stuff.
 	 */
 	yaml_init();
+	vfs_init();
 	game_init();
 
+	/*
+	 * Map packed assets so they don't have to be opened individually.
+	 */
+	if(vfs_mount(pack_file))
+		llog(LOG_INFO, NULL, NULL, "Mounted \"%s\"", pack_file);
+
 	return 1;
 }
 
@@ -133,6 +144,7 @@ deinit(void)
 	 * De-init global stuff
 	 */
 	game_deinit();
+	vfs_deinit();
 	yaml_deinit();
 
 	/*
@@ -1,8 +1,10 @@
 #include "plugin_renderer_gl/glutils.h"
+#include "plugin_renderer_gl/sprite_size.h"
 #include "util/pstdint.h"
 #include "framework/se_api.h"
 
 struct context_t;
+struct double_buffer_t;
 
 typedef enum sprite_animation_e
 {
@@ -25,17 +27,24 @@ struct sprite_gl_t
 	GLuint tex;
 };
 
+/* written by the tick side, read by sprite_draw() once published */
+struct sprite_transform_t
+{
+	struct vec2_t pos;
+	struct vec2_t size;
+};
+
 struct sprite_t
 {
 	uint32_t id;
+	uint32_t asset_id;  /* non-zero while the image is being loaded */
 
-	struct vec2_t pos;
-	struct vec2_t size;
+	struct double_buffer_t* transform; /* holds a struct sprite_transform_t */
 	struct vec2_t frame_size;
 	struct sprite_animation_t animation;
 	struct sprite_gl_t gl;
 
-	float aspect_ratio;
+	struct sprite_size_t size; /* resolved into transform by the size functions */
 	char is_visible;
 };
 
@@ -43,7 +52,7 @@ char
 sprite_init(struct context_t* context);
 
 void
-sprite_deinit(void);
+sprite_deinit(struct context_t* context);
 
 struct sprite_t*
 sprite_create(struct context_t* context,
@@ -54,7 +63,8 @@ sprite_create(struct context_t* context,
 			  uint32_t* id);
 
 struct sprite_t*
-sprite_create_from_memory(const unsigned char* pixel_buffer,
+sprite_create_from_memory(struct context_t* context,
+						  const unsigned char* pixel_buffer,
 						  uint16_t img_width,
 						  uint16_t img_height,
 						  uint16_t x_frame_count,
@@ -98,5 +108,7 @@ sprite_draw(void);
 SERVICE(sprite_create_wrapper);
 SERVICE(sprite_create_from_memory_wrapper);
 SERVICE(sprite_destroy_wrapper);
-SERVICE(sprite_position_wrapper);
-SERVICE(sprite_scale_wrapper);
+SERVICE_TYPED_DECLARE3(sprite_position_wrapper, void, VAL, uint32_t, VAL, float, VAL, float);
+SERVICE_BATCH(sprite_position_batch_wrapper);
+SERVICE_TYPED_DECLARE2(sprite_scale_wrapper, void, VAL, uint32_t, VAL, float);
+SERVICE_BATCH(sprite_scale_batch_wrapper);
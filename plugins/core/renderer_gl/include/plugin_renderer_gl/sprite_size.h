@@ -0,0 +1,58 @@
+/*!
+ * @file sprite_size.h
+ * @brief Works out the size a sprite is drawn with.
+ *
+ * By default a sprite is 1.0 along the longer axis of its image. Callers can
+ * scale it or give it an explicit size. Sprites loaded from a file show a
+ * square placeholder until the image arrives, so the caller's requests are
+ * stored here and the size is resolved again once the image's aspect ratio
+ * is known.
+ */
+
+#ifndef PLUGIN_RENDERER_GL_SPRITE_SIZE
+#define PLUGIN_RENDERER_GL_SPRITE_SIZE
+
+#include "util/config.h"
+
+C_HEADER_BEGIN
+
+struct sprite_size_t
+{
+	float aspect_ratio; /* width / height of the image, 1 for the placeholder */
+	float width;        /* explicit size, 0 if the image's aspect ratio is used */
+	float height;
+	float scale;        /* product of the factors passed to sprite_size_scale() */
+};
+
+void
+sprite_size_init(struct sprite_size_t* size);
+
+/*!
+ * @brief Sets the aspect ratio of the sprite's image. Scaling and explicit
+ * sizes requested earlier still apply.
+ */
+void
+sprite_size_set_aspect_ratio(struct sprite_size_t* size, float aspect_ratio);
+
+/*!
+ * @brief Sets an explicit size, replacing any earlier scaling. The sprite
+ * keeps this size when its image arrives.
+ */
+void
+sprite_size_set(struct sprite_size_t* size, float width, float height);
+
+/*!
+ * @brief Scales the sprite by factor, relative to its current size.
+ */
+void
+sprite_size_scale(struct sprite_size_t* size, float factor);
+
+/*!
+ * @brief Returns the size to draw the sprite with.
+ */
+void
+sprite_size_get(const struct sprite_size_t* size, float* width, float* height);
+
+C_HEADER_END
+
+#endif /* PLUGIN_RENDERER_GL_SPRITE_SIZE */
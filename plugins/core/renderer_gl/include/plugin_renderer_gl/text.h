@@ -6,18 +6,28 @@
 
 struct text_group_t;
 struct context_t;
+struct double_buffer_t;
+
+/* written by the tick side, applied to the mesh by text_draw() once published */
+struct text_state_t
+{
+	struct vec2_t pos;
+	char visible;
+};
 
 struct text_t
 {
 	/* reference to group this text object belongs to */
 	struct text_group_t* group;
-	/* mesh data of this text instance */
+	/* mesh data of this text instance, only touched by the render side once
+	 * the text was created */
 	struct ordered_vector_t vertex_buffer;
 	struct ordered_vector_t index_buffer;
-	struct vec2_t pos;
+	struct vec2_t pos;      /* position the mesh currently has */
+	char visible;           /* the mesh is part of the group's mesh */
+	struct double_buffer_t* state; /* holds a struct text_state_t */
 	wchar_t* string;
 	char is_centered;
-	char visible;
 };
 
 /*!
@@ -56,8 +66,20 @@ text_destroy(struct text_t* text);
 void
 text_set_centered(struct text_t* text, char centered);
 
+void
+text_set_position(struct text_t* text, GLfloat x, GLfloat y);
+
 void
 text_show(struct text_t* text);
 
 void
 text_hide(struct text_t* text);
+
+/*!
+ * @brief Brings the text's mesh up to date with the last published position
+ * and visibility. Called by the render side.
+ * @return Returns 1 if the text group's mesh has to be re-uploaded, 0 if
+ * otherwise.
+ */
+char
+text_apply_state(struct text_t* text);
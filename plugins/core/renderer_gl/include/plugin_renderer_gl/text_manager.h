@@ -6,6 +6,7 @@
 #include "util/ordered_vector.h"
 #include "util/unordered_vector.h"
 #include "util/bst_vector.h"
+#include "util/vfs.h"
 #include <GL/glew.h>
 #include "ft2build.h"
 #include FT_FREETYPE_H
@@ -39,6 +40,7 @@ struct char_info_t
 struct text_group_t
 {
 	FT_Face face;
+	struct vfs_file_t font_file; /* must outlive the face, freetype reads from it on demand */
 	struct text_gl_t gl;
 	/* maps character codes to instances of text_manager_char_info_t */
 	struct bstv_t char_info;
@@ -20,6 +20,7 @@ SERVICE(text_create_wrapper);
 SERVICE(text_destroy_wrapper);
 SERVICE(text_set_centered_wrapper);
 SERVICE(text_set_position_wrapper);
+SERVICE_BATCH(text_set_position_batch_wrapper);
 SERVICE(text_set_string_wrapper);
 SERVICE(text_show_wrapper);
 SERVICE(text_hide_wrapper);
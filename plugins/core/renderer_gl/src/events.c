@@ -21,6 +21,10 @@ register_events(struct plugin_t* plugin)
 	EVENT_CREATE1(plugin, evt_mouse_button_press,   PLUGIN_NAME ".mouse_button_press", uint32_t);
 	EVENT_CREATE1(plugin, evt_mouse_button_release, PLUGIN_NAME ".mouse_button_release", uint32_t);
 	EVENT_CREATE2(plugin, evt_mouse_scroll,         PLUGIN_NAME ".mouse_scroll", uint32_t, uint32_t);
+
+	/* glfw reports many mouse positions per frame, listeners only need the last one */
+	if(evt_mouse_move)
+		event_set_coalescing(evt_mouse_move, 1);
 }
 
 void
@@ -23,25 +23,27 @@ key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 void
 mouse_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
-	/* convert to GL screen space, then fire */
+	/* convert to GL screen space, then post */
 	double norm_x, norm_y;
 	norm_x = (xpos * 2.0 / (double)window_width()) - 1.0;
 	norm_y = 1.0 - (ypos * 2.0 / (double)window_height());
-	EVENT_FIRE2(evt_mouse_move, norm_x, norm_y);
+	EVENT_POST2(evt_mouse_move, norm_x, norm_y);
 }
 
 /* ------------------------------------------------------------------------- */
 void
 mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
 {
+	/* posted behind any queued mouse moves, so listeners see the position
+	 * the button was pressed at */
 	uint32_t button_cast = (uint32_t)button;
 	if(action == GLFW_PRESS)
 	{
-		EVENT_FIRE1(evt_mouse_button_press, button_cast);
+		EVENT_POST1(evt_mouse_button_press, button_cast);
 	}
 	if(action == GLFW_RELEASE)
 	{
-		EVENT_FIRE1(evt_mouse_button_release, button_cast);
+		EVENT_POST1(evt_mouse_button_release, button_cast);
 	}
 }
 
@@ -51,5 +53,5 @@ scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	uint32_t xoffset_cast = (uint32_t)xoffset;
 	uint32_t yoffset_cast = (uint32_t)yoffset;
-	EVENT_FIRE2(evt_mouse_scroll, xoffset_cast, yoffset_cast);
+	EVENT_POST2(evt_mouse_scroll, xoffset_cast, yoffset_cast);
 }
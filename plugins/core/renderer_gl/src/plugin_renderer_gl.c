@@ -104,7 +104,7 @@ PLUGIN_RENDERER_GL_PUBLIC_API PLUGIN_STOP()
 	if(game->network_role == GAME_HOST)
 		return;
 
-	sprite_deinit();
+	sprite_deinit(get_context(game));
 	text_wrapper_deinit();
 	text_manager_deinit();
 	deinit_2d();
@@ -7,6 +7,7 @@
 #include "plugin_renderer_gl/text.h"
 #include "plugin_renderer_gl/window.h"
 #include "framework/services.h"
+#include "framework/plugin_api.h"
 
 void
 register_services(struct plugin_t* plugin)
@@ -25,6 +26,10 @@ register_services(struct plugin_t* plugin)
 	SERVICE_CREATE4(plugin, s, PLUGIN_NAME ".sprite_create",                  sprite_create_wrapper, uint32_t, char*, uint16_t, uint16_t, uint16_t);
 	SERVICE_CREATE6(plugin, s, PLUGIN_NAME ".sprite_create_from_memory",      sprite_create_from_memory_wrapper, uint32_t, unsigned char*, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t);
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".sprite_destroy",                 sprite_destroy_wrapper, void, uint32_t);
+	SERVICE_CREATE_TYPED3(plugin, s, PLUGIN_NAME ".sprite_set_position",      sprite_position_wrapper, void, VAL, uint32_t, VAL, float, VAL, float);
+	if(s) service_set_batch(s, sprite_position_batch_wrapper);
+	SERVICE_CREATE_TYPED2(plugin, s, PLUGIN_NAME ".sprite_scale",             sprite_scale_wrapper, void, VAL, uint32_t, VAL, float);
+	if(s) service_set_batch(s, sprite_scale_batch_wrapper);
 
 	SERVICE_CREATE2(plugin, s, PLUGIN_NAME ".text_group_create",              text_group_create_wrapper, uint32_t, const char*, uint32_t);
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".text_group_destroy",             text_group_destroy_wrapper, void, uint32_t);
@@ -34,7 +39,14 @@ register_services(struct plugin_t* plugin)
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".text_destroy",                   text_destroy_wrapper, void, uint32_t);
 	SERVICE_CREATE2(plugin, s, PLUGIN_NAME ".text_set_centered",              text_set_centered_wrapper, void, uint32_t, char);
 	SERVICE_CREATE3(plugin, s, PLUGIN_NAME ".text_set_position",              text_set_position_wrapper, void, uint32_t, float, float);
+	if(s) service_set_batch(s, text_set_position_batch_wrapper);
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".text_set_string",                text_set_string_wrapper, void, const wchar_t*);
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".text_show",                      text_show_wrapper, void, uint32_t);
 	SERVICE_CREATE1(plugin, s, PLUGIN_NAME ".text_hide",                      text_hide_wrapper, void, uint32_t);
+
+	/* everything here talks to the GL context, which is current on the game
+	 * thread only */
+	UNORDERED_VECTOR_FOR_EACH(&plugin->services, struct service_t*, servp)
+		service_set_affinity(*servp, SERVICE_AFFINITY_GAME_THREAD);
+	UNORDERED_VECTOR_END_EACH
 }
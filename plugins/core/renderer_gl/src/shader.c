@@ -2,6 +2,7 @@
 #include "plugin_renderer_gl/shader.h"
 #include "plugin_renderer_gl/context.h"
 #include "framework/log.h"
+#include "framework/profiler.h"
 #include "util/file.h"
 #include "util/memory.h"
 #include "util/string.h"
@@ -100,19 +101,21 @@ load_shader_pair(struct context_t* context,
 	char* fsh_code = NULL;
 
 	/* compile shaders */
+	PROFILE_BEGIN("shader_compile");
 	vsh_ID = glCreateShader(GL_VERTEX_SHADER);
 	fsh_ID = glCreateShader(GL_FRAGMENT_SHADER);
 	vsh_code = load_and_compile_shader(context, vsh_ID, vertex_shader);
 	check_shader(context, vsh_ID);
 	fsh_code = load_and_compile_shader(context, fsh_ID, fragment_shader);
 	check_shader(context, fsh_ID);
+	PROFILE_END();
 
 	/* link program */
 	llog(LOG_INFO, context->game, PLUGIN_NAME, "linking program");
 	program_ID = glCreateProgram();
 	glAttachShader(program_ID, vsh_ID);
 	glAttachShader(program_ID, fsh_ID);
-	glLinkProgram(program_ID);
+	PROFILE_SCOPE("shader_link", glLinkProgram(program_ID));
 	if(!check_program(context, program_ID))
 	{
 		if(vsh_code)
@@ -5,6 +5,8 @@
 #include "framework/plugin.h"
 #include "framework/game.h"
 #include "framework/services.h"
+#include "framework/asset_loader.h"
+#include "framework/double_buffer.h"
 #include "framework/log.h"
 #include "util/memory.h"
 #include <assert.h>
@@ -19,6 +21,7 @@ static GLuint g_vao;
 static GLuint g_vbo;
 static GLuint g_ibo;
 static GLuint g_sprite_shader_id;
+static GLuint g_placeholder_tex;
 
 static GLuint g_uniform_sprite_position_location;
 static GLuint g_uniform_sprite_size_location;
@@ -41,6 +44,31 @@ static const char* sprite_shader_file = "../../plugins/core/renderer_gl/fx/sprit
 static const char* sprite_shader_file = "fx/sprite";
 #endif
 
+/* shown in place of a sprite's image while it is being loaded */
+static const unsigned char g_placeholder_pixel[4] = {0, 0, 0, 0};
+
+static struct sprite_t*
+sprite_alloc(struct context_t* context,
+			 uint16_t x_frame_count,
+			 uint16_t y_frame_count,
+			 uint16_t total_frame_count,
+			 uint32_t* id);
+
+static void
+sprite_upload_image(struct sprite_t* sprite,
+					const unsigned char* pixel_buffer,
+					uint16_t img_width,
+					uint16_t img_height);
+
+static void
+sprite_update_size(struct sprite_t* sprite);
+
+static char
+sprite_decode_image(struct asset_t* asset, const void* raw, uint32_t raw_size);
+
+static void
+on_sprite_image_loaded(struct game_t* game, struct asset_t* asset);
+
 /* ------------------------------------------------------------------------- */
 char
 sprite_init(struct context_t* context)
@@ -62,13 +90,25 @@ sprite_init(struct context_t* context)
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(g_quad_index_data), g_quad_index_data, GL_STATIC_DRAW);
 	glBindVertexArray(0);
 
+	glGenTextures(1, &g_placeholder_tex);printOpenGLError();
+	glBindTexture(GL_TEXTURE_2D, g_placeholder_tex);printOpenGLError();
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, g_placeholder_pixel);printOpenGLError();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);printOpenGLError();
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);printOpenGLError();
+
 	return 1;
 }
 
 /* ------------------------------------------------------------------------- */
 void
-sprite_deinit(void)
+sprite_deinit(struct context_t* context)
 {
+	/* images still being loaded would otherwise call back into this plugin */
+	BSTV_FOR_EACH(&g_sprites, struct sprite_t, key, sprite)
+		if(sprite->asset_id)
+			asset_cancel(context->game, sprite->asset_id);
+	BSTV_END_EACH
+
 	while(g_sprites.vector.count)
 	{
 		sprite_destroy(
@@ -76,6 +116,8 @@ sprite_deinit(void)
 		);
 	}
 	bstv_clear_free(&g_sprites);
+
+	glDeleteTextures(1, &g_placeholder_tex);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -87,8 +129,6 @@ sprite_create(struct context_t* context,
 			  uint16_t total_frame_count,
 			  uint32_t* id)
 {
-	unsigned char* pixel_buffer;
-	int x, y, n;
 	struct sprite_t* sprite;
 
 	assert(file_name);
@@ -96,23 +136,35 @@ sprite_create(struct context_t* context,
 	assert(y_frame_count >= 1);
 	assert(total_frame_count >= 1);
 
-	/* force 4 channel data for easy texture upload */
-	pixel_buffer = stbi_load(file_name, &x, &y, &n, 4);
-	if(!pixel_buffer)
+	/*
+	 * The sprite is usable immediately and shows the placeholder texture
+	 * until the image has been loaded and decoded on the thread pool.
+	 */
+	sprite = sprite_alloc(context, x_frame_count, y_frame_count, total_frame_count, id);
+	if(!sprite)
+		return NULL;
+	sprite->gl.tex = g_placeholder_tex;
+
+	sprite->asset_id = asset_load(context->game,
+								  file_name,
+								  ASSET_PRIORITY_NORMAL,
+								  sprite_decode_image,
+								  on_sprite_image_loaded,
+								  (void*)(intptr_t)*id);
+	if(!sprite->asset_id)
 	{
 		llog(LOG_ERROR, context->game, PLUGIN_NAME, "Failed to load image: \"%s\"", file_name);
+		sprite_destroy(sprite);
 		return NULL;
 	}
 
-	sprite = sprite_create_from_memory(pixel_buffer, x, y, x_frame_count, y_frame_count, total_frame_count, id);
-	stbi_image_free(pixel_buffer);
-
 	return sprite;
 }
 
 /* ------------------------------------------------------------------------- */
 struct sprite_t*
-sprite_create_from_memory(const unsigned char* pixel_buffer,
+sprite_create_from_memory(struct context_t* context,
+						  const unsigned char* pixel_buffer,
 						  uint16_t img_width,
 						  uint16_t img_height,
 						  uint16_t x_frame_count,
@@ -123,42 +175,129 @@ sprite_create_from_memory(const unsigned char* pixel_buffer,
 	struct sprite_t* sprite;
 
 	assert(pixel_buffer);
+
+	sprite = sprite_alloc(context, x_frame_count, y_frame_count, total_frame_count, id);
+	if(!sprite)
+		return NULL;
+	sprite_upload_image(sprite, pixel_buffer, img_width, img_height);
+
+	return sprite;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct sprite_t*
+sprite_alloc(struct context_t* context,
+			 uint16_t x_frame_count,
+			 uint16_t y_frame_count,
+			 uint16_t total_frame_count,
+			 uint32_t* id)
+{
+	struct sprite_t* sprite;
+	struct sprite_transform_t* transform;
+
 	assert(x_frame_count >= 1);
 	assert(y_frame_count >= 1);
 	assert(total_frame_count >= 1);
 
 	/* create and set up sprite object */
-	sprite = (struct sprite_t*)MALLOC(sizeof(struct sprite_t));
+	if(!(sprite = (struct sprite_t*)MALLOC(sizeof(struct sprite_t))))
+		OUT_OF_MEMORY("sprite_alloc()", NULL);
 	memset(sprite, 0, sizeof(struct sprite_t));
-	*id = guid++;
-	bstv_insert(&g_sprites, *id, sprite);
-
-	sprite->animation.state = SPRITE_ANIMATION_STOP;
-	sprite->animation.frame_b = total_frame_count;
-	sprite->animation.total_frame_count = total_frame_count;
-	sprite->aspect_ratio = (float)img_width / (float)img_height;
-	if(img_width > img_height)
+	/* the render side sees the sprite once its first transform is published */
+	if(!(sprite->transform = double_buffer_create(context->game, sizeof(struct sprite_transform_t))))
 	{
-		sprite->size.x = 1.0;
-		sprite->size.y = sprite->size.x / sprite->aspect_ratio;
+		FREE(sprite);
+		return NULL;
 	}
-	else
+	sprite->id = guid++;
+	if(!bstv_insert(&g_sprites, sprite->id, sprite))
 	{
-		sprite->size.y = 1.0;
-		sprite->size.x = sprite->size.y * sprite->aspect_ratio;
+		double_buffer_destroy(sprite->transform);
+		FREE(sprite);
+		return NULL;
 	}
-	sprite->frame_size.x = sprite->size.x;
-	sprite->frame_size.y = sprite->size.y;
+	*id = sprite->id;
+
+	sprite->animation.state = SPRITE_ANIMATION_STOP;
+	sprite->animation.frame_b = total_frame_count;
+	sprite->animation.total_frame_count = total_frame_count;
+	sprite_size_init(&sprite->size);
+	sprite_update_size(sprite);
+	transform = (struct sprite_transform_t*)double_buffer_write(sprite->transform);
+	sprite->frame_size = transform->size;
 	sprite->is_visible = 1;
 
+	return sprite;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+sprite_upload_image(struct sprite_t* sprite,
+					const unsigned char* pixel_buffer,
+					uint16_t img_width,
+					uint16_t img_height)
+{
+	/* scaling or sizing done while the placeholder was shown still applies */
+	sprite_size_set_aspect_ratio(&sprite->size, (float)img_width / (float)img_height);
+	sprite_update_size(sprite);
+	sprite->frame_size = ((struct sprite_transform_t*)double_buffer_write(sprite->transform))->size;
+
 	/* create GL texture and hand over pixel data */
 	glGenTextures(1, &sprite->gl.tex);printOpenGLError();
 	glBindTexture(GL_TEXTURE_2D, sprite->gl.tex);printOpenGLError();
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img_width, img_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel_buffer);printOpenGLError();
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);printOpenGLError();
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);printOpenGLError();
+}
 
-	return sprite;
+/* ------------------------------------------------------------------------- */
+static void
+sprite_update_size(struct sprite_t* sprite)
+{
+	struct sprite_transform_t* transform =
+		(struct sprite_transform_t*)double_buffer_write(sprite->transform);
+	sprite_size_get(&sprite->size, &transform->size.x, &transform->size.y);
+}
+
+/* ------------------------------------------------------------------------- */
+/* called on a worker thread */
+static char
+sprite_decode_image(struct asset_t* asset, const void* raw, uint32_t raw_size)
+{
+	int x, y, n;
+
+	/* force 4 channel data for easy texture upload */
+	asset->data = stbi_load_from_memory((const stbi_uc*)raw, (int)raw_size, &x, &y, &n, 4);
+	if(!asset->data)
+		return 0;
+
+	asset->size = x * y * 4;
+	asset->width = x;
+	asset->height = y;
+	asset->free_data = stbi_image_free;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* called on the main thread */
+static void
+on_sprite_image_loaded(struct game_t* game, struct asset_t* asset)
+{
+	struct sprite_t* sprite = bstv_find(&g_sprites, (uint32_t)(intptr_t)asset->user_data);
+
+	/* sprite may have been destroyed in the meantime */
+	if(!sprite || sprite->asset_id != asset->id)
+		return;
+	sprite->asset_id = 0;
+
+	if(asset->state != ASSET_STATE_LOADED)
+	{
+		llog(LOG_ERROR, game, PLUGIN_NAME, "Failed to load image: \"%s\"", asset->file_name);
+		return;
+	}
+
+	sprite_upload_image(sprite, (const unsigned char*)asset->data, asset->width, asset->height);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -167,8 +306,10 @@ sprite_destroy(struct sprite_t* sprite)
 {
 	assert(sprite);
 
-	glDeleteTextures(1, &sprite->gl.tex);
+	if(sprite->gl.tex != g_placeholder_tex)
+		glDeleteTextures(1, &sprite->gl.tex);
 	bstv_erase_element(&g_sprites, sprite);
+	double_buffer_destroy(sprite->transform);
 	FREE(sprite);
 }
 
@@ -206,25 +347,26 @@ sprite_set_fps(struct sprite_t* sprite, float fps)
 void
 sprite_set_position(struct sprite_t* sprite, float x, float y)
 {
-	sprite->pos.x = x;
-	sprite->pos.y = y;
+	struct sprite_transform_t* transform =
+		(struct sprite_transform_t*)double_buffer_write(sprite->transform);
+	transform->pos.x = x;
+	transform->pos.y = y;
 }
 
 /* ------------------------------------------------------------------------- */
 void
 sprite_set_size(struct sprite_t* sprite, float x, float y)
 {
-	sprite->size.x = x;
-	sprite->size.y = y;
-	sprite->aspect_ratio = x / y;
+	sprite_size_set(&sprite->size, x, y);
+	sprite_update_size(sprite);
 }
 
 /* ------------------------------------------------------------------------- */
 void
 sprite_scale(struct sprite_t* sprite, float factor)
 {
-	sprite->size.y *= factor;
-	sprite->size.x = sprite->size.y * sprite->aspect_ratio;
+	sprite_size_scale(&sprite->size, factor);
+	sprite_update_size(sprite);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -241,9 +383,11 @@ sprite_draw(void)
 	glUseProgram(g_sprite_shader_id);printOpenGLError();
 	glBindVertexArray(g_vao);printOpenGLError();
 	BSTV_FOR_EACH(&g_sprites, struct sprite_t, key, sprite)
+		const struct sprite_transform_t* transform =
+			(const struct sprite_transform_t*)double_buffer_read(sprite->transform);
 		glBindTexture(GL_TEXTURE_2D, sprite->gl.tex);printOpenGLError();
-		glUniform2f(g_uniform_sprite_position_location, sprite->pos.x, sprite->pos.y);
-		glUniform2f(g_uniform_sprite_size_location, sprite->size.x, sprite->size.y);
+		glUniform2f(g_uniform_sprite_position_location, transform->pos.x, transform->pos.y);
+		glUniform2f(g_uniform_sprite_size_location, transform->size.x, transform->size.y);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL);printOpenGLError();
 	BSTV_END_EACH
 	glBindVertexArray(0);printOpenGLError();
@@ -278,8 +422,9 @@ SERVICE(sprite_create_from_memory_wrapper)
 	EXTRACT_ARGUMENT(4, y_frame_count, uint16_t, uint16_t);
 	EXTRACT_ARGUMENT(5, total_frame_count, uint16_t, uint16_t);
 	uint32_t id;
+	struct context_t* context = get_context(service->plugin->game);
 
-	if(sprite_create_from_memory(pixel_buffer, img_width, img_height, x_frame_count, y_frame_count, total_frame_count, &id))
+	if(sprite_create_from_memory(context, pixel_buffer, img_width, img_height, x_frame_count, y_frame_count, total_frame_count, &id))
 		RETURN(id, uint32_t);
 	RETURN(0, uint32_t);
 }
@@ -290,15 +435,58 @@ SERVICE(sprite_destroy_wrapper)
 	EXTRACT_ARGUMENT(0, id, uint32_t, uint32_t);
 	struct sprite_t* sprite = bstv_find(&g_sprites, id);
 	if(sprite)
+	{
+		if(sprite->asset_id)
+			asset_cancel(service->plugin->game, sprite->asset_id);
 		sprite_destroy(sprite);
+	}
 }
 
 /* ------------------------------------------------------------------------- */
-SERVICE(sprite_position_wrapper)
+SERVICE_TYPED_ADAPTER_VOID3(sprite_position_wrapper, VAL, uint32_t, VAL, float, VAL, float)
+void
+sprite_position_wrapper(struct service_t* service, uint32_t id, float x, float y)
 {
+	struct sprite_t* sprite = bstv_find(&g_sprites, id);
+	if(sprite)
+		sprite_set_position(sprite, x, y);
 }
 
 /* ------------------------------------------------------------------------- */
-SERVICE(sprite_scale_wrapper)
+SERVICE_BATCH(sprite_position_batch_wrapper)
 {
+	EXTRACT_ARGUMENT_COLUMN(0, id, uint32_t);
+	EXTRACT_ARGUMENT_COLUMN(1, x, float);
+	EXTRACT_ARGUMENT_COLUMN(2, y, float);
+	uint32_t i;
+	for(i = 0; i != count; ++i)
+	{
+		struct sprite_t* sprite = bstv_find(&g_sprites, id[i]);
+		if(sprite)
+			sprite_set_position(sprite, x[i], y[i]);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+SERVICE_TYPED_ADAPTER_VOID2(sprite_scale_wrapper, VAL, uint32_t, VAL, float)
+void
+sprite_scale_wrapper(struct service_t* service, uint32_t id, float factor)
+{
+	struct sprite_t* sprite = bstv_find(&g_sprites, id);
+	if(sprite)
+		sprite_scale(sprite, factor);
+}
+
+/* ------------------------------------------------------------------------- */
+SERVICE_BATCH(sprite_scale_batch_wrapper)
+{
+	EXTRACT_ARGUMENT_COLUMN(0, id, uint32_t);
+	EXTRACT_ARGUMENT_COLUMN(1, factor, float);
+	uint32_t i;
+	for(i = 0; i != count; ++i)
+	{
+		struct sprite_t* sprite = bstv_find(&g_sprites, id[i]);
+		if(sprite)
+			sprite_scale(sprite, factor[i]);
+	}
 }
@@ -0,0 +1,68 @@
+#include "plugin_renderer_gl/sprite_size.h"
+#include <assert.h>
+
+/* ------------------------------------------------------------------------- */
+void
+sprite_size_init(struct sprite_size_t* size)
+{
+	assert(size);
+	size->aspect_ratio = 1.0f;
+	size->width = 0.0f;
+	size->height = 0.0f;
+	size->scale = 1.0f;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sprite_size_set_aspect_ratio(struct sprite_size_t* size, float aspect_ratio)
+{
+	assert(size);
+	assert(aspect_ratio > 0.0f);
+	size->aspect_ratio = aspect_ratio;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sprite_size_set(struct sprite_size_t* size, float width, float height)
+{
+	assert(size);
+	size->width = width;
+	size->height = height;
+	size->scale = 1.0f;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sprite_size_scale(struct sprite_size_t* size, float factor)
+{
+	assert(size);
+	size->scale *= factor;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sprite_size_get(const struct sprite_size_t* size, float* width, float* height)
+{
+	assert(size);
+	assert(width);
+	assert(height);
+
+	if(size->width != 0.0f && size->height != 0.0f)
+	{
+		*width = size->width;
+		*height = size->height;
+	}
+	else if(size->aspect_ratio > 1.0f)
+	{
+		*width = 1.0f;
+		*height = 1.0f / size->aspect_ratio;
+	}
+	else
+	{
+		*height = 1.0f;
+		*width = size->aspect_ratio;
+	}
+
+	*width *= size->scale;
+	*height *= size->scale;
+}
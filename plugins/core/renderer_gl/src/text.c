@@ -3,7 +3,9 @@
 #include "plugin_renderer_gl/text.h"
 #include "plugin_renderer_gl/window.h"
 #include "plugin_renderer_gl/context.h"
+#include "framework/double_buffer.h"
 #include "framework/log.h"
+#include "framework/profiler.h"
 #include "util/memory.h"
 #include "util/string.h"
 #include "glfw3.h"
@@ -22,18 +24,35 @@ text_create(struct context_t* context,
 			const wchar_t* str)
 {
 	struct text_t* text;
-	text = (struct text_t*)MALLOC(sizeof(struct text_t));
+	struct text_state_t* state;
+
+	if(!(text = (struct text_t*)MALLOC(sizeof(struct text_t))))
+		OUT_OF_MEMORY("text_create()", NULL);
+	if(!(text->state = double_buffer_create(context->game, sizeof(struct text_state_t))))
+	{
+		FREE(text);
+		return NULL;
+	}
 	text->string = malloc_wstring(str);
-	text->pos.x = x;
-	text->pos.y = y;
 	text->is_centered = centered;
-	text->visible = 1;
+
+	/*
+	 * The mesh is generated at the origin and stays hidden. text_draw()
+	 * moves and shows it once the state below is published.
+	 */
+	text->pos.x = 0;
+	text->pos.y = 0;
+	text->visible = 0;
+	state = (struct text_state_t*)double_buffer_write(text->state);
+	state->pos.x = x;
+	state->pos.y = y;
+	state->visible = 1;
 
 	ordered_vector_init_vector(&text->vertex_buffer, sizeof(struct vertex_quad_t));
 	ordered_vector_init_vector(&text->index_buffer, sizeof(INDEX_DATA_TYPE));
 
 	text_group_add_text_object(text_group, text);
-	text_generate_mesh(context, text);
+	PROFILE_SCOPE("text_generate_mesh", text_generate_mesh(context, text));
 
 	return text;
 }
@@ -47,6 +66,7 @@ text_destroy(struct text_t* text)
 
 	ordered_vector_clear_free(&text->vertex_buffer);
 	ordered_vector_clear_free(&text->index_buffer);
+	double_buffer_destroy(text->state);
 
 	free_string(text->string);
 	FREE(text);
@@ -62,30 +82,61 @@ text_set_string(struct text_t* text, const wchar_t* string)
 void
 text_set_position(struct text_t* text, GLfloat x, GLfloat y)
 {
+	struct text_state_t* state = (struct text_state_t*)double_buffer_write(text->state);
+	state->pos.x = x;
+	state->pos.y = y;
 }
 
 /* ------------------------------------------------------------------------- */
 void
 text_set_centered(struct text_t* text, char centered)
 {
+	/* takes effect when the mesh is generated */
 	text->is_centered = centered;
-	text_group_inform_updated_text_object(text->group);
 }
 
 /* ------------------------------------------------------------------------- */
 void
 text_show(struct text_t* text)
 {
-	text->visible = 1;
-	text_group_inform_updated_text_object(text->group);
+	((struct text_state_t*)double_buffer_write(text->state))->visible = 1;
 }
 
 /* ------------------------------------------------------------------------- */
 void
 text_hide(struct text_t* text)
 {
-	text->visible = 0;
-	text_group_inform_updated_text_object(text->group);
+	((struct text_state_t*)double_buffer_write(text->state))->visible = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+text_apply_state(struct text_t* text)
+{
+	const struct text_state_t* state =
+		(const struct text_state_t*)double_buffer_read(text->state);
+	GLfloat dx = state->pos.x - text->pos.x;
+	GLfloat dy = state->pos.y - text->pos.y;
+	char changed = 0;
+
+	/* the position only offsets the mesh, so move it instead of regenerating it */
+	if(dx != 0 || dy != 0)
+	{
+		ORDERED_VECTOR_FOR_EACH(&text->vertex_buffer, struct vertex_quad_t, vertex)
+			vertex->position[0] += dx;
+			vertex->position[1] += dy;
+		ORDERED_VECTOR_END_EACH
+		text->pos = state->pos;
+		changed = text->visible;
+	}
+
+	if(text->visible != state->visible)
+	{
+		text->visible = state->visible;
+		changed = 1;
+	}
+
+	return changed;
 }
 
 /* ------------------------------------------------------------------------- */
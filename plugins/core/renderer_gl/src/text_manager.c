@@ -7,6 +7,7 @@
 #include "plugin_renderer_gl/window.h"
 #include "util/unordered_vector.h"
 #include "framework/log.h"
+#include "framework/profiler.h"
 #include "util/memory.h"
 #include "GL/glew.h"
 #include FT_BITMAP_H
@@ -204,6 +205,7 @@ text_group_destroy(uint32_t id)
 
 	/* clean up freetype stuff */
 	FT_Done_Face(group->face);
+	vfs_close(&group->font_file);
 
 	/* finally, destroy font object */
 	FREE(group);
@@ -313,9 +315,15 @@ text_draw(void)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);printOpenGLError();
 	glUseProgram(g_text_shader_id);printOpenGLError();
 	BSTV_FOR_EACH(&g_text_groups, struct text_group_t, key, group)
+		/* pick up what the tick side published since the last frame */
+		UNORDERED_VECTOR_FOR_EACH(&group->texts, struct text_t*, ptext)
+			if(text_apply_state(*ptext))
+				group->mesh_needs_reuploading = 1;
+		UNORDERED_VECTOR_END_EACH
+
 		/* if any text objects were updated, then mesh needs re-uploading */
 		if(group->mesh_needs_reuploading)
-			text_group_sync_with_gpu(group);
+			PROFILE_SCOPE("text_sync", text_group_sync_with_gpu(group));
 
 		/* render */
 		glBindVertexArray(group->gl.vao);printOpenGLError();
@@ -336,19 +344,32 @@ text_group_load_font(struct context_t* context,
 {
 	FT_Error error;
 
+	/* read font through the virtual file system, this is zero-copy if packed */
+	if(!vfs_open(&group->font_file, filename))
+	{
+		llog(LOG_ERROR, context->game, PLUGIN_NAME, "Failed to open font file \"%s\"", filename);
+		return 0;
+	}
+
 	/* load face */
-	error = FT_New_Face(g_lib, filename, 0, &group->face);
+	error = FT_New_Memory_Face(g_lib,
+							   (const FT_Byte*)group->font_file.data,
+							   (FT_Long)group->font_file.size,
+							   0,
+							   &group->face);
 	if(error == FT_Err_Unknown_File_Format)
 	{
 		llog(LOG_ERROR, context->game, PLUGIN_NAME, "The font file \"%s\" could be "
 			"opened and read, but it appears that its font format is unsupported",
 			filename
 		);
+		vfs_close(&group->font_file);
 		return 0;
 	}
 	else if(error)
 	{
 		llog(LOG_ERROR, context->game, PLUGIN_NAME, "Failed to open font file \"%s\"", filename);
+		vfs_close(&group->font_file);
 		return 0;
 	}
 
@@ -357,6 +378,8 @@ text_group_load_font(struct context_t* context,
 	if(error)
 	{
 		llog(LOG_ERROR, context->game, PLUGIN_NAME, "Failed to set the character size");
+		FT_Done_Face(group->face);
+		vfs_close(&group->font_file);
 		return 0;
 	}
 
@@ -82,7 +82,10 @@ SERVICE(text_create_wrapper)
 
 	struct text_group_t* group = text_group_get(group_id);
 	struct text_t* text = text_create(context, group, centered, x, y, string);
-	uint32_t text_id = guid++;
+	uint32_t text_id;
+	if(!text)
+		RETURN(0, uint32_t);
+	text_id = guid++;
 	bstv_insert(&g_texts, text_id, text);
 
 	RETURN(text_id, uint32_t);
@@ -114,6 +117,31 @@ SERVICE(text_set_centered_wrapper)
 /* ------------------------------------------------------------------------- */
 SERVICE(text_set_position_wrapper)
 {
+	EXTRACT_ARGUMENT(0, text_id, uint32_t, uint32_t);
+	EXTRACT_ARGUMENT(1, x, float, GLfloat);
+	EXTRACT_ARGUMENT(2, y, float, GLfloat);
+
+	struct text_t* text = bstv_find(&g_texts, text_id);
+	if(!text)
+		return;
+
+	text_set_position(text, x, y);
+}
+
+/* ------------------------------------------------------------------------- */
+SERVICE_BATCH(text_set_position_batch_wrapper)
+{
+	EXTRACT_ARGUMENT_COLUMN(0, text_id, uint32_t);
+	EXTRACT_ARGUMENT_COLUMN(1, x, float);
+	EXTRACT_ARGUMENT_COLUMN(2, y, float);
+	uint32_t i;
+
+	for(i = 0; i != count; ++i)
+	{
+		struct text_t* text = bstv_find(&g_texts, text_id[i]);
+		if(text)
+			text_set_position(text, x[i], y[i]);
+	}
 }
 
 /* ------------------------------------------------------------------------- */
@@ -0,0 +1,143 @@
+#!/usr/bin/env python
+# Generates the minimal perfect hash table used by
+# dynamic_call_get_type_from_string() in util/src/util/dynamic_call.c.
+#
+# The keys are type spellings after normalisation (qualifiers removed, one
+# space between words, no space before '*'). "short" and "long" are only
+# accepted when followed by "int", as the parser always did. Edit TYPE_NAMES,
+# run this script and paste its output between the "generated" markers in
+# dynamic_call.c.
+import sys
+
+TYPE_NAMES = [
+    ('void',              'TYPE_VOID'),
+
+    ('char',              'TYPE_INT8'),
+    ('signed char',       'TYPE_INT8'),
+    ('int8_t',            'TYPE_INT8'),
+    ('int8',              'TYPE_INT8'),
+    ('unsigned char',     'TYPE_UINT8'),
+    ('uint8_t',           'TYPE_UINT8'),
+    ('uint8',             'TYPE_UINT8'),
+    ('unsigned int8_t',   'TYPE_UINT8'),
+
+    ('int16_t',           'TYPE_INT16'),
+    ('int16',             'TYPE_INT16'),
+    ('uint16_t',          'TYPE_UINT16'),
+    ('uint16',            'TYPE_UINT16'),
+    ('unsigned int16_t',  'TYPE_UINT16'),
+    ('short int',         'TYPE_INT16'),
+    ('signed short int',  'TYPE_INT16'),
+    ('unsigned short int', 'TYPE_UINT16'),
+
+    ('int',               'TYPE_INT32'),
+    ('signed',            'TYPE_INT32'),
+    ('signed int',        'TYPE_INT32'),
+    ('int32_t',           'TYPE_INT32'),
+    ('int32',             'TYPE_INT32'),
+    ('unsigned',          'TYPE_UINT32'),
+    ('unsigned int',      'TYPE_UINT32'),
+    ('uint32_t',          'TYPE_UINT32'),
+    ('uint32',            'TYPE_UINT32'),
+    ('unsigned int32_t',  'TYPE_UINT32'),
+    ('uint',              'TYPE_UINT32'),
+
+    ('int64_t',           'TYPE_INT64'),
+    ('int64',             'TYPE_INT64'),
+    ('uint64_t',          'TYPE_UINT64'),
+    ('uint64',            'TYPE_UINT64'),
+    ('unsigned int64_t',  'TYPE_UINT64'),
+    ('long long int',     'TYPE_INT64'),
+    ('signed long long int', 'TYPE_INT64'),
+    ('unsigned long long int', 'TYPE_UINT64'),
+
+    # the size of these depends on the platform, see TYPE_NAME_INT()
+    ('long int',          'TYPE_NAME_INT(sizeof(long))'),
+    ('signed long int',   'TYPE_NAME_INT(sizeof(long))'),
+    ('unsigned long int', 'TYPE_NAME_UINT(sizeof(long))'),
+    ('int_least8_t',      'TYPE_NAME_INT(sizeof(int_least8_t))'),
+    ('int_least16_t',     'TYPE_NAME_INT(sizeof(int_least16_t))'),
+    ('int_least32_t',     'TYPE_NAME_INT(sizeof(int_least32_t))'),
+    ('int_least64_t',     'TYPE_NAME_INT(sizeof(int_least64_t))'),
+    ('uint_least8_t',     'TYPE_NAME_UINT(sizeof(uint_least8_t))'),
+    ('uint_least16_t',    'TYPE_NAME_UINT(sizeof(uint_least16_t))'),
+    ('uint_least32_t',    'TYPE_NAME_UINT(sizeof(uint_least32_t))'),
+    ('uint_least64_t',    'TYPE_NAME_UINT(sizeof(uint_least64_t))'),
+    ('int_fast8_t',       'TYPE_NAME_INT(sizeof(int_fast8_t))'),
+    ('int_fast16_t',      'TYPE_NAME_INT(sizeof(int_fast16_t))'),
+    ('int_fast32_t',      'TYPE_NAME_INT(sizeof(int_fast32_t))'),
+    ('int_fast64_t',      'TYPE_NAME_INT(sizeof(int_fast64_t))'),
+    ('uint_fast8_t',      'TYPE_NAME_UINT(sizeof(uint_fast8_t))'),
+    ('uint_fast16_t',     'TYPE_NAME_UINT(sizeof(uint_fast16_t))'),
+    ('uint_fast32_t',     'TYPE_NAME_UINT(sizeof(uint_fast32_t))'),
+    ('uint_fast64_t',     'TYPE_NAME_UINT(sizeof(uint_fast64_t))'),
+
+    ('intptr_t',          'TYPE_INTPTR'),
+    ('uintptr_t',         'TYPE_UINTPTR'),
+
+    ('float',             'TYPE_FLOAT'),
+    ('double',            'TYPE_DOUBLE'),
+
+    ('char*',             'TYPE_STRING'),
+    ('signed char*',      'TYPE_STRING'),
+    ('unsigned char*',    'TYPE_STRING'),
+    ('wchar_t*',          'TYPE_WSTRING'),
+    ('char16_t*',         'TYPE_NAME_WSTRING(2)'),
+    ('char32_t*',         'TYPE_NAME_WSTRING(4)'),
+]
+
+# must match TYPE_NAME_HASH_ADD() in dynamic_call.c (32-bit FNV-1a)
+def type_name_hash(name):
+    h = 2166136261
+    for c in name.encode('ascii'):
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+# must match TYPE_NAME_SLOT() in dynamic_call.c (murmur3 finaliser)
+def type_name_slot(h, seed, n):
+    h ^= seed
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h % n
+
+def generate(names):
+    n = len(names)
+    buckets = [[] for _ in range(n)]
+    for name, type_e in names:
+        buckets[type_name_hash(name) % n].append((name, type_e))
+
+    # place the largest buckets first, searching a seed that maps every key
+    # of the bucket to a free slot
+    slots = [None] * n
+    displacement = [0] * n
+    for index in sorted(range(n), key=lambda i: -len(buckets[i])):
+        bucket = buckets[index]
+        if not bucket:
+            continue
+        for seed in range(0, 256):
+            wanted = [type_name_slot(type_name_hash(name), seed, n) for name, _ in bucket]
+            if len(set(wanted)) == len(wanted) and all(slots[s] is None for s in wanted):
+                break
+        else:
+            sys.exit('no seed found, try a different hash')
+        displacement[index] = seed
+        for slot, entry in zip(wanted, bucket):
+            slots[slot] = entry
+    return slots, displacement
+
+if __name__ == '__main__':
+    slots, displacement = generate(TYPE_NAMES)
+    print('#define TYPE_NAME_MAX_LENGTH %d' % max(len(name) for name, _ in TYPE_NAMES))
+    print('#define TYPE_NAME_COUNT %d' % len(slots))
+    print('static const uint8_t g_type_name_seeds[TYPE_NAME_COUNT] = {')
+    for i in range(0, len(displacement), 16):
+        print('\t' + ', '.join('%d' % d for d in displacement[i:i + 16]) + ',')
+    print('};')
+    print('static const struct type_name_t g_type_names[TYPE_NAME_COUNT] = {')
+    for name, type_e in slots:
+        print('\t{%-26s %s},' % ('"%s",' % name, type_e))
+    print('};')
@@ -1,6 +1,7 @@
 #include "gmock/gmock.h"
 #include "util/memory.h"
 #include "util/yaml.h"
+#include "util/vfs.h"
 #include "framework/game.h"
 
 using testing::Eq;
@@ -15,12 +16,14 @@ public:
         testing::FLAGS_gtest_death_test_style = "threadsafe";
         memory_init();
         yaml_init();
+        vfs_init();
         game_init();
     }
 
     virtual void TearDown()
     {
         game_deinit();
+        vfs_deinit();
         yaml_deinit();
         EXPECT_THAT(memory_deinit(), Eq(0)) << "Number of memory leaks";
     }
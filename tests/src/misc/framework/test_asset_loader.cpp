@@ -0,0 +1,170 @@
+#include "gmock/gmock.h"
+#include "framework/asset_loader.h"
+#include "framework/events.h"
+#include "framework/game.h"
+#include "util/memory.h"
+#include "util/string.h"
+#include <string.h>
+#include <ctype.h>
+
+#define NAME asset_loader
+
+#define FILE_A "tests/test_dir/files/file_a.txt"
+#define FILE_A_CONTENTS "Some Random Message\n"
+#define FILE_INVALID "tests/test_dir/files/invalid.txt"
+
+using namespace testing;
+
+static int g_loaded_count;
+static uint32_t g_loaded_order[3];
+static int g_last_state;
+static char* g_last_data;
+
+static void
+on_loaded(struct game_t* game, struct asset_t* asset)
+{
+	if(g_loaded_count < 3)
+		g_loaded_order[g_loaded_count] = asset->id;
+	++g_loaded_count;
+	g_last_state = asset->state;
+	if(asset->state == ASSET_STATE_LOADED)
+	{
+		if(g_last_data)
+			FREE(g_last_data);
+		g_last_data = (char*)MALLOC(asset->size + 1);
+		memcpy(g_last_data, asset->data, asset->size);
+		g_last_data[asset->size] = '\0';
+	}
+}
+
+static char
+decode_upper_case(struct asset_t* asset, const void* raw, uint32_t raw_size)
+{
+	uint32_t i;
+	char* data = (char*)MALLOC(raw_size);
+	for(i = 0; i != raw_size; ++i)
+		data[i] = toupper(((const char*)raw)[i]);
+	asset->data = data;
+	asset->size = raw_size;
+	return 1;
+}
+
+class NAME : public Test
+{
+public:
+
+	virtual void SetUp()
+	{
+		g_loaded_count = 0;
+		g_last_state = -1;
+		g_last_data = NULL;
+		game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+	}
+
+	virtual void TearDown()
+	{
+		if(g_last_data)
+			FREE(g_last_data);
+		game_destroy(game);
+	}
+
+	struct game_t* game;
+};
+
+TEST_F(NAME, load_raw_file)
+{
+	uint32_t id = asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+	ASSERT_THAT(id, Ne(0u));
+
+	asset_loader_flush(game);
+
+	EXPECT_THAT(g_loaded_count, Eq(1));
+	EXPECT_THAT(g_last_state, Eq(ASSET_STATE_LOADED));
+	ASSERT_THAT(g_last_data, NotNull());
+	EXPECT_THAT(g_last_data, StrEq(FILE_A_CONTENTS));
+}
+
+TEST_F(NAME, load_with_decoder)
+{
+	asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, decode_upper_case, on_loaded, NULL);
+
+	asset_loader_flush(game);
+
+	ASSERT_THAT(g_last_data, NotNull());
+	EXPECT_THAT(g_last_data, StrEq("SOME RANDOM MESSAGE\n"));
+}
+
+TEST_F(NAME, callback_is_never_called_before_dispatch)
+{
+	asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+	EXPECT_THAT(g_loaded_count, Eq(0));
+	asset_loader_flush(game);
+	EXPECT_THAT(g_loaded_count, Eq(1));
+}
+
+TEST_F(NAME, load_invalid_file_reports_failure)
+{
+	asset_load(game, FILE_INVALID, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+
+	asset_loader_flush(game);
+
+	EXPECT_THAT(g_loaded_count, Eq(1));
+	EXPECT_THAT(g_last_state, Eq(ASSET_STATE_FAILED));
+	EXPECT_THAT(g_last_data, IsNull());
+}
+
+TEST_F(NAME, cancelled_request_is_never_finished)
+{
+	uint32_t id = asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+
+	EXPECT_THAT(asset_cancel(game, id), Eq(1));
+	EXPECT_THAT(asset_cancel(game, id), Eq(0));
+	asset_loader_flush(game);
+
+	EXPECT_THAT(g_loaded_count, Eq(0));
+}
+
+TEST_F(NAME, pending_requests_are_processed_by_priority)
+{
+	uint32_t low, normal, high;
+
+	/* one request at a time makes the order deterministic */
+	game->asset_loader.max_in_flight = 1;
+
+	low    = asset_load(game, FILE_A, ASSET_PRIORITY_LOW,    NULL, on_loaded, NULL);
+	normal = asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+	high   = asset_load(game, FILE_A, ASSET_PRIORITY_HIGH,   NULL, on_loaded, NULL);
+
+	asset_loader_flush(game);
+
+	ASSERT_THAT(g_loaded_count, Eq(3));
+	EXPECT_THAT(g_loaded_order[0], Eq(high));
+	EXPECT_THAT(g_loaded_order[1], Eq(normal));
+	EXPECT_THAT(g_loaded_order[2], Eq(low));
+}
+
+static uint32_t g_asset_loaded_event_id;
+EVENT_LISTENER(on_asset_loaded)
+{
+	EXTRACT_ARGUMENT(0, id, uint32_t, uint32_t);
+	g_asset_loaded_event_id = id;
+}
+TEST_F(NAME, finished_request_fires_asset_loaded)
+{
+	g_asset_loaded_event_id = 0;
+	event_register_listener(game, "asset.loaded", on_asset_loaded);
+
+	uint32_t id = asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, NULL, NULL);
+	asset_loader_flush(game);
+
+	EXPECT_THAT(g_asset_loaded_event_id, Eq(id));
+}
+
+TEST_F(NAME, unfinished_requests_are_released_on_destroy)
+{
+	asset_load(game, FILE_A, ASSET_PRIORITY_NORMAL, NULL, on_loaded, NULL);
+	asset_load(game, FILE_A, ASSET_PRIORITY_LOW, NULL, on_loaded, NULL);
+	game->asset_loader.max_in_flight = 1;
+	asset_loader_dispatch(game);
+}
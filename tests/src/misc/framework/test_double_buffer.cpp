@@ -0,0 +1,85 @@
+#include "gmock/gmock.h"
+#include "framework/double_buffer.h"
+#include "framework/game.h"
+
+#define NAME double_buffer
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+	virtual void SetUp()
+	{
+		game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+	}
+
+	virtual void TearDown()
+	{
+		game_destroy(game);
+	}
+
+	struct game_t* game;
+};
+
+TEST_F(NAME, writes_are_visible_after_publish)
+{
+	struct double_buffer_t* buffer = double_buffer_create(game, sizeof(int));
+	ASSERT_THAT(buffer, NotNull());
+	EXPECT_THAT(*(const int*)double_buffer_read(buffer), Eq(0));
+
+	*(int*)double_buffer_write(buffer) = 5;
+	EXPECT_THAT(*(const int*)double_buffer_read(buffer), Eq(0));
+
+	double_buffer_publish_all(game);
+	EXPECT_THAT(*(const int*)double_buffer_read(buffer), Eq(5));
+
+	double_buffer_destroy(buffer);
+}
+
+TEST_F(NAME, back_buffer_starts_as_copy_of_front)
+{
+	struct double_buffer_t* buffer = double_buffer_create(game, sizeof(int) * 2);
+	int* back;
+	ASSERT_THAT(buffer, NotNull());
+
+	back = (int*)double_buffer_write(buffer);
+	back[0] = 1;
+	back[1] = 2;
+	double_buffer_publish_all(game);
+
+	/* only write one of the two values */
+	back = (int*)double_buffer_write(buffer);
+	EXPECT_THAT(back[0], Eq(1));
+	EXPECT_THAT(back[1], Eq(2));
+	back[1] = 3;
+	double_buffer_publish_all(game);
+
+	EXPECT_THAT(((const int*)double_buffer_read(buffer))[0], Eq(1));
+	EXPECT_THAT(((const int*)double_buffer_read(buffer))[1], Eq(3));
+
+	double_buffer_destroy(buffer);
+}
+
+TEST_F(NAME, unwritten_buffers_are_not_swapped)
+{
+	struct double_buffer_t* buffer = double_buffer_create(game, sizeof(int));
+	ASSERT_THAT(buffer, NotNull());
+
+	*(int*)double_buffer_write(buffer) = 7;
+	double_buffer_publish_all(game);
+	const void* front = double_buffer_read(buffer);
+	double_buffer_publish_all(game);
+	EXPECT_THAT(double_buffer_read(buffer), Eq(front));
+
+	double_buffer_destroy(buffer);
+}
+
+TEST_F(NAME, left_over_buffers_are_freed_with_the_game)
+{
+	EXPECT_THAT(double_buffer_create(game, 16), NotNull());
+	EXPECT_THAT(double_buffer_create(game, 3), NotNull());
+	EXPECT_THAT(game->double_buffers.count, Eq(2u));
+}
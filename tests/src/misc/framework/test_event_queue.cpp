@@ -0,0 +1,259 @@
+#include "gmock/gmock.h"
+#include "framework/events.h"
+#include "framework/event_queue.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include <string>
+
+#define NAME event_queue
+
+using namespace testing;
+
+static int g_calls;
+static int32_t g_last_value;
+static std::string g_last_string;
+
+EVENT_LISTENER(queue_listener)
+{
+	EXTRACT_ARGUMENT(0, value, int32_t, int32_t);
+	EXTRACT_ARGUMENT_PTR(1, str, const char*);
+
+	++g_calls;
+	g_last_value = value;
+	g_last_string = str;
+}
+
+static struct event_t* g_repost;
+
+EVENT_LISTENER(reposting_listener)
+{
+	EXTRACT_ARGUMENT(0, value, int32_t, int32_t);
+	const char* str = "reposted";
+
+	++g_calls;
+	g_last_value = value;
+
+	/* post once, while the queue is being dispatched */
+	if(g_repost)
+	{
+		struct event_t* event = g_repost;
+		g_repost = NULL;
+		value = 9;
+		EVENT_POST2(event, value, PTR(str));
+	}
+}
+
+static int32_t g_mouse_position;
+static int32_t g_mouse_clicked_at;
+
+EVENT_LISTENER(mouse_move_listener)
+{
+	EXTRACT_ARGUMENT(0, x, int32_t, int32_t);
+	g_mouse_position = x;
+}
+
+EVENT_LISTENER(mouse_click_listener)
+{
+	g_mouse_clicked_at = g_mouse_position;
+}
+
+class NAME : public Test
+{
+public:
+
+	virtual void SetUp()
+	{
+		game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+		plugin = plugin_create(game, "test", "test", "test", "test", "test");
+		ASSERT_THAT(plugin, NotNull());
+
+		EVENT_CREATE2(plugin, event, "test.queue", int32_t, const char*);
+		ASSERT_THAT(event, NotNull());
+		ASSERT_THAT(event_register_listener(game, "test.queue", queue_listener), Eq(1));
+
+		event_queue_reset_stats(game);
+		g_calls = 0;
+		g_last_value = 0;
+		g_last_string = "";
+	}
+
+	virtual void TearDown()
+	{
+		plugin_destroy(plugin);
+		game_destroy(game);
+	}
+
+	struct game_t* game;
+	struct plugin_t* plugin;
+	struct event_t* event;
+};
+
+TEST_F(NAME, posted_events_are_delivered_on_dispatch)
+{
+	int32_t value = 5;
+	const char* str = "hello";
+
+	EVENT_POST2(event, value, PTR(str));
+	EXPECT_THAT(g_calls, Eq(0));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(g_last_value, Eq(5));
+	EXPECT_THAT(g_last_string, StrEq("hello"));
+
+	/* queue is empty now */
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(event_queue_get_stats(game)->posted, Eq(1u));
+	EXPECT_THAT(event_queue_get_stats(game)->delivered, Eq(1u));
+}
+
+TEST_F(NAME, arguments_are_copied)
+{
+	int32_t value = 1;
+	char str[] = "before";
+
+	EVENT_POST2(event, value, PTR(str));
+	value = 2;
+	str[0] = 'X';
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_last_value, Eq(1));
+	EXPECT_THAT(g_last_string, StrEq("before"));
+}
+
+TEST_F(NAME, without_coalescing_every_post_is_delivered)
+{
+	const char* str = "a";
+	for(int32_t i = 0; i != 3; ++i)
+		EVENT_POST2(event, i, PTR(str));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(3));
+	EXPECT_THAT(g_last_value, Eq(2));
+	EXPECT_THAT(event_queue_get_stats(game)->high_water, Eq(3u));
+}
+
+TEST_F(NAME, coalescing_delivers_latest_arguments_once)
+{
+	const char* strs[] = {"first", "second", "third"};
+
+	event_set_coalescing(event, 1);
+	for(int32_t i = 0; i != 3; ++i)
+		EVENT_POST2(event, i, PTR(strs[i]));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(g_last_value, Eq(2));
+	EXPECT_THAT(g_last_string, StrEq("third"));
+	EXPECT_THAT(event_queue_get_stats(game)->posted, Eq(3u));
+	EXPECT_THAT(event_queue_get_stats(game)->coalesced, Eq(2u));
+
+	/* after dispatching, a new post creates a new entry */
+	int32_t value = 7;
+	EVENT_POST2(event, value, PTR(strs[0]));
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(2));
+	EXPECT_THAT(g_last_value, Eq(7));
+}
+
+TEST_F(NAME, posts_exceeding_capacity_are_dropped)
+{
+	const char* str = "a";
+
+	event_queue_set_capacity(game, 2);
+	for(int32_t i = 0; i != 4; ++i)
+		EVENT_POST2(event, i, PTR(str));
+
+	EXPECT_THAT(event_queue_get_stats(game)->dropped, Eq(2u));
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(2));
+	EXPECT_THAT(g_last_value, Eq(1));
+}
+
+TEST_F(NAME, destroying_event_discards_queued_instances)
+{
+	struct event_t* other;
+	int32_t value = 3;
+	const char* str = "other";
+
+	EVENT_CREATE2(plugin, other, "test.queue2", int32_t, const char*);
+	ASSERT_THAT(other, NotNull());
+	ASSERT_THAT(event_register_listener(game, "test.queue2", queue_listener), Eq(1));
+	event_set_coalescing(other, 1);
+
+	EVENT_POST2(event, value, PTR(str));
+	EVENT_POST2(other, value, PTR(str));
+	value = 4;
+	EVENT_POST2(event, value, PTR(str));
+	event_destroy(event);
+
+	/* the remaining entry can still be coalesced after moving */
+	value = 5;
+	EVENT_POST2(other, value, PTR(str));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(g_last_value, Eq(5));
+}
+
+TEST_F(NAME, events_can_be_posted_while_dispatching)
+{
+	struct event_t* other;
+	int32_t value = 3;
+	const char* str = "other";
+
+	EVENT_CREATE2(plugin, other, "test.queue2", int32_t, const char*);
+	ASSERT_THAT(other, NotNull());
+	ASSERT_THAT(event_unregister_listener(game, "test.queue", queue_listener), Eq(1));
+	ASSERT_THAT(event_register_listener(game, "test.queue", reposting_listener), Eq(1));
+	ASSERT_THAT(event_register_listener(game, "test.queue2", queue_listener), Eq(1));
+	event_set_coalescing(event, 1);
+	event_set_coalescing(other, 1);
+
+	/* other is still queued behind event when the listener posts it */
+	g_repost = other;
+	EVENT_POST2(event, value, PTR(str));
+	EVENT_POST2(other, value, PTR(str));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(2));
+	EXPECT_THAT(g_last_value, Eq(3));
+	EXPECT_THAT(event_queue_get_stats(game)->coalesced, Eq(0u));
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(3));
+	EXPECT_THAT(g_last_value, Eq(9));
+	EXPECT_THAT(g_last_string, StrEq("reposted"));
+}
+
+TEST_F(NAME, coalescing_posts_are_not_moved_past_later_posts)
+{
+	struct event_t* move;
+	struct event_t* click;
+	int32_t x;
+
+	EVENT_CREATE1(plugin, move, "test.mouse_move", int32_t);
+	EVENT_CREATE0(plugin, click, "test.mouse_click");
+	ASSERT_THAT(move, NotNull());
+	ASSERT_THAT(click, NotNull());
+	ASSERT_THAT(event_register_listener(game, "test.mouse_move", mouse_move_listener), Eq(1));
+	ASSERT_THAT(event_register_listener(game, "test.mouse_click", mouse_click_listener), Eq(1));
+	event_set_coalescing(move, 1);
+	g_mouse_position = 0;
+	g_mouse_clicked_at = 0;
+
+	/* move, click and move again within the same frame */
+	x = 1; EVENT_POST1(move, x);
+	x = 2; EVENT_POST1(move, x);
+	EVENT_POST0(click);
+	x = 3; EVENT_POST1(move, x);
+	x = 4; EVENT_POST1(move, x);
+
+	event_queue_dispatch(game);
+	EXPECT_THAT(g_mouse_clicked_at, Eq(2));
+	EXPECT_THAT(g_mouse_position, Eq(4));
+	EXPECT_THAT(event_queue_get_stats(game)->coalesced, Eq(2u));
+	EXPECT_THAT(event_queue_get_stats(game)->delivered, Eq(3u));
+}
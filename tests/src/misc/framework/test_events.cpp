@@ -1,10 +1,13 @@
 #include "gmock/gmock.h"
 #include "framework/events.h"
+#include "framework/event_parallel.h"
+#include "framework/event_snapshot.h"
 #include "framework/services.h"
 #include "framework/plugin.h"
 #include "framework/game.h"
 #include "framework/log.h"
 #include "util/string.h"
+#include "util/atomic.h"
 
 #define NAME event
 
@@ -241,3 +244,279 @@ TEST_F(NAME, unregister_all_listeners)
 
 	event_destroy(event); /* required so the event is deleted before the mock object */
 }
+
+TEST_F(NAME, handle_is_bound_when_event_is_created_and_destroyed)
+{
+	struct event_t* event;
+	struct event_handle_t* handle = event_handle_acquire(game, "test.event");
+	ASSERT_THAT(handle, NotNull());
+	EXPECT_THAT(handle->event, IsNull());
+	EXPECT_THAT(event_handle_acquire(game, "test.event"), Eq(handle));
+
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	EXPECT_THAT(handle->event, Eq(event));
+
+	event_destroy(event);
+	EXPECT_THAT(handle->event, IsNull());
+
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	EXPECT_THAT(handle->event, Eq(event));
+
+	event_handle_release(handle);
+	event_handle_release(handle);
+	EXPECT_THAT(bsthv_find(&game->event_handles, "test.event"), IsNull());
+}
+
+static int g_parallel_calls;
+static int g_parallel_calls_seen_by_serial;
+#define PARALLEL_LISTENER(n)                                                \
+	EVENT_LISTENER(parallel_listener##n)                                    \
+	{                                                                       \
+		ATOMIC_ADD(g_parallel_calls, 1);                                    \
+	}
+PARALLEL_LISTENER(1) PARALLEL_LISTENER(2) PARALLEL_LISTENER(3) PARALLEL_LISTENER(4)
+PARALLEL_LISTENER(5) PARALLEL_LISTENER(6) PARALLEL_LISTENER(7) PARALLEL_LISTENER(8)
+static event_callback_func g_parallel_listeners[] = {
+	parallel_listener1, parallel_listener2, parallel_listener3, parallel_listener4,
+	parallel_listener5, parallel_listener6, parallel_listener7, parallel_listener8
+};
+
+EVENT_LISTENER(serial_listener)
+{
+	g_parallel_calls_seen_by_serial = ATOMIC_LOAD(g_parallel_calls);
+}
+
+TEST_F(NAME, thread_safe_listeners_finish_before_fire_returns)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	for(int i = 0; i != 8; ++i)
+		ASSERT_THAT(event_register_listener_ex(game, "test.event", g_parallel_listeners[i],
+			EVENT_LISTENER_THREAD_SAFE), Eq(1));
+	ASSERT_THAT(event->parallel, NotNull());
+	ASSERT_THAT(event->snapshot, NotNull());
+	EXPECT_THAT(event->snapshot->parallel_count, Eq(8u));
+
+	g_parallel_calls = 0;
+	for(int i = 0; i != 100; ++i)
+	{
+		EVENT_FIRE0(event);
+		ASSERT_THAT(g_parallel_calls, Eq((i + 1) * 8));
+	}
+}
+
+TEST_F(NAME, consecutive_fires_only_call_their_own_listeners)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	/* every fire has a different number of listeners than the one before */
+	g_parallel_calls = 0;
+	for(int i = 0; i != 10; ++i)
+	{
+		int count = (i % 2 ? 8 : 2);
+		for(int j = 0; j != count; ++j)
+			ASSERT_THAT(event_register_listener_ex(game, "test.event", g_parallel_listeners[j],
+				EVENT_LISTENER_THREAD_SAFE), Eq(1));
+
+		EVENT_FIRE0(event);
+		ASSERT_THAT(g_parallel_calls, Eq(count));
+		g_parallel_calls = 0;
+
+		for(int j = 0; j != count; ++j)
+			ASSERT_THAT(event_unregister_listener(game, "test.event", g_parallel_listeners[j]), Eq(1));
+	}
+}
+
+TEST_F(NAME, serial_listeners_run_after_thread_safe_listeners)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	ASSERT_THAT(event_register_listener(game, "test.event", serial_listener), Eq(1));
+	for(int i = 0; i != 8; ++i)
+		ASSERT_THAT(event_register_listener_ex(game, "test.event", g_parallel_listeners[i],
+			EVENT_LISTENER_THREAD_SAFE), Eq(1));
+
+	g_parallel_calls = 0;
+	g_parallel_calls_seen_by_serial = -1;
+	EVENT_FIRE0(event);
+	EXPECT_THAT(g_parallel_calls_seen_by_serial, Eq(8));
+}
+
+TEST_F(NAME, main_thread_affinity_overrides_thread_safe)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	ASSERT_THAT(event_register_listener_ex(game, "test.event", parallel_listener1,
+		EVENT_LISTENER_THREAD_SAFE | EVENT_LISTENER_MAIN_THREAD), Eq(1));
+	EXPECT_THAT(event->parallel, IsNull());
+	ASSERT_THAT(event->snapshot, NotNull());
+	EXPECT_THAT(event->snapshot->serial_count, Eq(1u));
+	EXPECT_THAT(event->snapshot->parallel_count, Eq(0u));
+
+	g_parallel_calls = 0;
+	EVENT_FIRE0(event);
+	EXPECT_THAT(g_parallel_calls, Eq(1));
+}
+
+TEST_F(NAME, unregistering_last_thread_safe_listener_reverts_to_serial)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	ASSERT_THAT(event_register_listener(game, "test.event", serial_listener), Eq(1));
+	ASSERT_THAT(event_register_listener_ex(game, "test.event", parallel_listener1,
+		EVENT_LISTENER_THREAD_SAFE | EVENT_LISTENER_READ_ONLY), Eq(1));
+	ASSERT_THAT(event->snapshot, NotNull());
+	EXPECT_THAT(event->snapshot->all_read_only, Eq(1));
+
+	ASSERT_THAT(event_unregister_listener(game, "test.event", parallel_listener1), Eq(1));
+	ASSERT_THAT(event->snapshot, NotNull());
+	EXPECT_THAT(event->snapshot->parallel_count, Eq(0u));
+
+	g_parallel_calls = 0;
+	g_parallel_calls_seen_by_serial = -1;
+	EVENT_FIRE0(event);
+	EXPECT_THAT(g_parallel_calls_seen_by_serial, Eq(0));
+}
+
+static struct game_t* g_snapshot_game;
+static int g_snapshot_victim_calls;
+
+EVENT_LISTENER(snapshot_victim)
+{
+	++g_snapshot_victim_calls;
+}
+
+EVENT_LISTENER(snapshot_unregisters_victim)
+{
+	event_unregister_listener(g_snapshot_game, "test.event", snapshot_victim);
+}
+
+TEST_F(NAME, event_without_listeners_has_no_snapshot)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	EXPECT_THAT(event->snapshot, IsNull());
+
+	ASSERT_THAT(event_register_listener(game, "test.event", serial_listener), Eq(1));
+	EXPECT_THAT(event->snapshot, NotNull());
+	event_unregister_all_listeners(event);
+	EXPECT_THAT(event->snapshot, IsNull());
+
+	/* retired snapshots are freed without any readers */
+	EXPECT_THAT(game->event_epoch.retired, IsNull());
+}
+
+TEST_F(NAME, unregistering_during_fire_affects_next_fire)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	/* whichever order the listeners end up in, the victim is called exactly once */
+	g_snapshot_game = game;
+	ASSERT_THAT(event_register_listener(game, "test.event", snapshot_unregisters_victim), Eq(1));
+	ASSERT_THAT(event_register_listener(game, "test.event", snapshot_victim), Eq(1));
+
+	g_snapshot_victim_calls = 0;
+	EVENT_FIRE0(event);
+	EXPECT_THAT(g_snapshot_victim_calls, Eq(1));
+	EVENT_FIRE0(event);
+	EXPECT_THAT(g_snapshot_victim_calls, Eq(1));
+	EXPECT_THAT(event->snapshot->serial_count, Eq(1u));
+}
+
+static int g_filtered_calls;
+static int g_unfiltered_calls;
+
+EVENT_LISTENER(filtered_listener)
+{
+	++g_filtered_calls;
+}
+
+EVENT_LISTENER(unfiltered_listener)
+{
+	++g_unfiltered_calls;
+}
+
+TEST_F(NAME, filtered_listeners_are_only_called_for_matching_values)
+{
+	struct event_t* event;
+	EVENT_CREATE2(plugin, event, "test.event", uint32_t, char);
+	ASSERT_THAT(event, NotNull());
+
+	ASSERT_THAT(event_register_listener(game, "test.event", unfiltered_listener), Eq(1));
+	ASSERT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 0, 5), Eq(1));
+	ASSERT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 0, 7), Eq(1));
+	ASSERT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 1, -1), Eq(1));
+	EXPECT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 0, 7), Eq(0));
+	ASSERT_THAT(event->snapshot, NotNull());
+	EXPECT_THAT(event->snapshot->filtered_count, Eq(3u));
+	EXPECT_THAT(event->snapshot->filter_args, Eq(3u));
+
+	uint32_t key;
+	char c = 0;
+	g_filtered_calls = 0;
+	g_unfiltered_calls = 0;
+	key = 5; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(1));
+	key = 7; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(2));
+	key = 9; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(2));
+	c = -1; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(3));
+	key = 5; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(5));
+	EXPECT_THAT(g_unfiltered_calls, Eq(5));
+
+	/* unfiltered unregistration leaves filtered registrations alone */
+	EXPECT_THAT(event_unregister_listener(game, "test.event", filtered_listener), Eq(0));
+	EXPECT_THAT(event_unregister_listener_filtered(game, "test.event", filtered_listener, 0, 5), Eq(1));
+	c = 0; EVENT_FIRE2(event, key, c);
+	EXPECT_THAT(g_filtered_calls, Eq(5));
+	EXPECT_THAT(event->snapshot->filtered_count, Eq(2u));
+}
+
+TEST_F(NAME, filtered_listeners_share_buckets_with_other_filters)
+{
+	struct event_t* event;
+	EVENT_CREATE1(plugin, event, "test.event", int32_t);
+	ASSERT_THAT(event, NotNull());
+
+	/* enough filters for some of them to share a bucket */
+	for(int i = 0; i != 40; ++i)
+		ASSERT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 0, i * 64), Eq(1));
+	ASSERT_THAT(event_register_listener_filtered(game, "test.event", unfiltered_listener, 0, 64), Eq(1));
+
+	g_filtered_calls = 0;
+	g_unfiltered_calls = 0;
+	for(int32_t i = 0; i != 40 * 64; ++i)
+		EVENT_FIRE1(event, i);
+	EXPECT_THAT(g_filtered_calls, Eq(40));
+	EXPECT_THAT(g_unfiltered_calls, Eq(1));
+}
+
+TEST_F(NAME, filtering_non_integer_arguments_fails)
+{
+	struct event_t* event;
+	EVENT_CREATE2(plugin, event, "test.event", float, const char*);
+	ASSERT_THAT(event, NotNull());
+
+	EXPECT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 0, 1), Eq(0));
+	EXPECT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 1, 1), Eq(0));
+	EXPECT_THAT(event_register_listener_filtered(game, "test.event", filtered_listener, 2, 1), Eq(0));
+	EXPECT_THAT(event->snapshot, IsNull());
+}
@@ -0,0 +1,89 @@
+#include "gmock/gmock.h"
+#include "framework/frame_pacer.h"
+
+#define NAME frame_pacer
+
+using namespace testing;
+
+/* 100 ticks and 50 renders per second, so the numbers are easy to follow */
+#define MS 1000000u
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        frame_pacer_init(&pacer);
+        frame_pacer_set_tick_rate(&pacer, 100);
+        frame_pacer_set_render_rate(&pacer, 50);
+        frame_pacer_set_max_frame_latency(&pacer, 100);
+        frame_pacer_reset(&pacer, 1000 * MS);
+    }
+
+    int count_ticks(uint64_t now)
+    {
+        int ticks = 0;
+        while(frame_pacer_should_tick(&pacer, now))
+            ++ticks;
+        return ticks;
+    }
+
+    struct frame_pacer_t pacer;
+};
+
+TEST_F(NAME, ticks_at_fixed_rate)
+{
+	EXPECT_THAT(count_ticks(1000 * MS), Eq(1));
+	EXPECT_THAT(count_ticks(1005 * MS), Eq(0));
+	EXPECT_THAT(count_ticks(1010 * MS), Eq(1));
+	EXPECT_THAT(count_ticks(1045 * MS), Eq(3));
+	EXPECT_THAT(count_ticks(1049 * MS), Eq(0));
+	EXPECT_THAT(pacer.ticks_dropped, Eq(0u));
+}
+
+TEST_F(NAME, backlog_beyond_max_latency_is_dropped)
+{
+	EXPECT_THAT(count_ticks(1000 * MS), Eq(1));
+	EXPECT_THAT(count_ticks(2000 * MS), Eq(1));
+	EXPECT_THAT(pacer.ticks_dropped, Eq(99u));
+	EXPECT_THAT(count_ticks(2010 * MS), Eq(1));
+}
+
+TEST_F(NAME, late_renders_are_not_caught_up_on)
+{
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1000 * MS), Eq(1));
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1010 * MS), Eq(0));
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1075 * MS), Eq(1));
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1080 * MS), Eq(0));
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1095 * MS), Eq(1));
+}
+
+TEST_F(NAME, unlimited_render_rate_never_sleeps)
+{
+	frame_pacer_set_render_rate(&pacer, 0);
+	count_ticks(1000 * MS);
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1000 * MS), Eq(1));
+	EXPECT_THAT(frame_pacer_should_render(&pacer, 1000 * MS), Eq(1));
+	EXPECT_THAT(frame_pacer_get_wake_time(&pacer), Eq(0u));
+}
+
+TEST_F(NAME, wakes_for_next_tick_or_render)
+{
+	count_ticks(1000 * MS);
+	frame_pacer_should_render(&pacer, 1000 * MS);
+	EXPECT_THAT(frame_pacer_get_wake_time(&pacer), Eq(1010 * MS));
+	count_ticks(1010 * MS);
+	EXPECT_THAT(frame_pacer_get_wake_time(&pacer), Eq(1020 * MS));
+	count_ticks(1020 * MS);
+	EXPECT_THAT(frame_pacer_get_wake_time(&pacer), Eq(1020 * MS));
+}
+
+TEST_F(NAME, alpha_is_position_between_ticks)
+{
+	count_ticks(1000 * MS);
+	EXPECT_THAT(frame_pacer_get_alpha(&pacer, 1000 * MS), FloatEq(0.0f));
+	EXPECT_THAT(frame_pacer_get_alpha(&pacer, 1000 * MS + 2500000), FloatEq(0.25f));
+	EXPECT_THAT(frame_pacer_get_alpha(&pacer, 1000 * MS + 7500000), FloatEq(0.75f));
+	EXPECT_THAT(frame_pacer_get_alpha(&pacer, 1020 * MS), FloatEq(1.0f));
+}
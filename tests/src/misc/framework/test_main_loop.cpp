@@ -0,0 +1,161 @@
+#include "gmock/gmock.h"
+#include "framework/main_loop.h"
+#include "framework/double_buffer.h"
+#include "framework/events.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include "util/thread.h"
+#include "util/time.h"
+
+#define NAME main_loop
+
+using namespace testing;
+
+static volatile int g_ticks;
+static volatile int g_renders;
+static volatile uintptr_t g_tick_thread;
+
+EVENT_LISTENER(main_loop_on_tick)
+{
+	g_tick_thread = get_thread_id();
+	++g_ticks;
+}
+
+EVENT_LISTENER(main_loop_on_render)
+{
+	++g_renders;
+}
+
+class NAME : public Test
+{
+public:
+
+	virtual void SetUp()
+	{
+		game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+		ASSERT_THAT(event_register_listener(game, "tick", main_loop_on_tick), Eq(1));
+		ASSERT_THAT(event_register_listener(game, "render", main_loop_on_render), Eq(1));
+		g_ticks = 0;
+		g_renders = 0;
+		g_tick_thread = 0;
+	}
+
+	virtual void TearDown()
+	{
+		game_destroy(game);
+	}
+
+	struct game_t* game;
+};
+
+TEST_F(NAME, games_have_independent_tick_rates)
+{
+	struct game_t* other = game_create("other", NULL, GAME_CLIENT);
+	ASSERT_THAT(other, NotNull());
+
+	frame_pacer_set_tick_rate(&game->main_loop.pacer, 1000);
+	frame_pacer_set_tick_rate(&other->main_loop.pacer, 10);
+	EXPECT_THAT(game->main_loop.pacer.tick_interval, Eq(1000000u));
+	EXPECT_THAT(other->main_loop.pacer.tick_interval, Eq(100000000u));
+
+	game_destroy(other);
+}
+
+TEST_F(NAME, do_loop_only_dispatches_its_own_game)
+{
+	struct game_t* other = game_create("other", NULL, GAME_CLIENT);
+	ASSERT_THAT(other, NotNull());
+
+	main_loop_reset_timer(other);
+	main_loop_do_loop(other);
+	EXPECT_THAT(g_ticks, Eq(0));
+	EXPECT_THAT(g_renders, Eq(0));
+
+	main_loop_reset_timer(game);
+	main_loop_do_loop(game);
+	EXPECT_THAT(g_ticks, Eq(1));
+	EXPECT_THAT(g_renders, Eq(1));
+
+	game_destroy(other);
+}
+
+TEST_F(NAME, do_loop_returns_next_due_time)
+{
+	uint64_t wake_time;
+
+	frame_pacer_set_tick_rate(&game->main_loop.pacer, 100);
+	frame_pacer_set_render_rate(&game->main_loop.pacer, 50);
+	main_loop_reset_timer(game);
+	wake_time = main_loop_do_loop(game);
+	EXPECT_THAT(wake_time, Eq((uint64_t)game->main_loop.time_begin + 10000000u));
+}
+
+#ifdef ENABLE_MULTITHREADING
+TEST_F(NAME, loop_runs_on_own_thread)
+{
+	uint64_t deadline;
+
+	frame_pacer_set_tick_rate(&game->main_loop.pacer, 1000);
+	ASSERT_THAT(main_loop_start_thread(game), Eq(1));
+	EXPECT_THAT(main_loop_is_threaded(game), Eq(1));
+
+	deadline = get_time_ns() + 2000000000u;
+	while(g_ticks < 10 && get_time_ns() < deadline)
+		sleep_until_ns(get_time_ns() + 1000000u);
+
+	main_loop_stop_thread(game);
+	EXPECT_THAT(main_loop_is_threaded(game), Eq(0));
+	EXPECT_THAT(g_ticks, Ge(10));
+	EXPECT_THAT(g_tick_thread, Ne(get_thread_id()));
+	EXPECT_THAT(game->thread_id, Eq(get_thread_id()));
+}
+#endif
+
+#ifdef ENABLE_THREAD_POOL
+static struct double_buffer_t* g_tick_state;
+static volatile int g_rendered_state;
+static volatile uintptr_t g_render_thread;
+
+EVENT_LISTENER(main_loop_on_pipelined_tick)
+{
+	g_tick_thread = get_thread_id();
+	++*(int*)double_buffer_write(g_tick_state);
+	++g_ticks;
+}
+
+EVENT_LISTENER(main_loop_on_pipelined_render)
+{
+	g_render_thread = get_thread_id();
+	g_rendered_state = *(const int*)double_buffer_read(g_tick_state);
+}
+
+TEST_F(NAME, pipelined_render_sees_previous_ticks)
+{
+	event_unregister_listener(game, "tick", main_loop_on_tick);
+	event_unregister_listener(game, "render", main_loop_on_render);
+	ASSERT_THAT(event_register_listener(game, "tick", main_loop_on_pipelined_tick), Eq(1));
+	ASSERT_THAT(event_register_listener(game, "render", main_loop_on_pipelined_render), Eq(1));
+	ASSERT_THAT(g_tick_state = double_buffer_create(game, sizeof(int)), NotNull());
+	g_rendered_state = -1;
+
+	game->main_loop.pipelined = 1;
+	frame_pacer_set_tick_rate(&game->main_loop.pacer, 1);
+	main_loop_reset_timer(game);
+
+	/* the first frame's tick runs while the first frame renders */
+	main_loop_do_loop(game);
+	EXPECT_THAT(g_rendered_state, Eq(0));
+
+	/* the second render sees the first tick */
+	game->main_loop.pacer.next_render = 0;
+	main_loop_do_loop(game);
+	EXPECT_THAT(g_rendered_state, Eq(1));
+	EXPECT_THAT(g_ticks, Eq(1));
+	EXPECT_THAT(g_render_thread, Eq(get_thread_id()));
+	EXPECT_THAT(g_tick_thread, Ne(get_thread_id()));
+
+	main_loop_deinit(game);
+	double_buffer_destroy(g_tick_state);
+}
+#endif
@@ -0,0 +1,89 @@
+#include "gmock/gmock.h"
+#include "framework/plugin_index.h"
+#include "framework/plugin.h"
+
+#define NAME plugin_index
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+	virtual void SetUp()
+	{
+		plugin_index_init(&index);
+		ASSERT_THAT(plugin_index_build(&index, "tests/test_dir/plugins/"), Eq(1));
+	}
+
+	virtual void TearDown()
+	{
+		plugin_index_deinit(&index);
+	}
+
+	const struct plugin_index_entry_t* find(const char* name,
+											uint32_t major,
+											uint32_t minor,
+											uint32_t patch,
+											plugin_search_criteria_e criteria)
+	{
+		struct plugin_info_t info;
+		info.name = (char*)name;
+		info.version.major = major;
+		info.version.minor = minor;
+		info.version.patch = patch;
+		return plugin_index_find(&index, &info, criteria);
+	}
+
+	struct plugin_index_t index;
+};
+
+TEST_F(NAME, files_not_following_naming_scheme_are_ignored)
+{
+	/* ".", "..", readme.txt and plugin_noversion.dll */
+	EXPECT_THAT(index.entries.count, Eq(5u));
+	EXPECT_THAT(find("noversion", 0, 0, 0, PLUGIN_VERSION_MINIMUM), IsNull());
+}
+
+TEST_F(NAME, minimum_version_returns_newest)
+{
+	const struct plugin_index_entry_t* entry;
+
+	ASSERT_THAT((entry = find("foo", 0, 1, 0, PLUGIN_VERSION_MINIMUM)), NotNull());
+	EXPECT_THAT(entry->file_name, StrEq("tests/test_dir/plugins/plugin_foo-1.0.0.dll"));
+	EXPECT_THAT(entry->major, Eq(1u));
+	EXPECT_THAT(entry->minor, Eq(0u));
+	EXPECT_THAT(entry->patch, Eq(0u));
+}
+
+TEST_F(NAME, minimum_version_too_high_fails)
+{
+	EXPECT_THAT(find("foo", 1, 0, 1, PLUGIN_VERSION_MINIMUM), IsNull());
+}
+
+TEST_F(NAME, exact_version)
+{
+	const struct plugin_index_entry_t* entry;
+
+	ASSERT_THAT((entry = find("foo", 0, 2, 0, PLUGIN_VERSION_EXACT)), NotNull());
+	EXPECT_THAT(entry->file_name, StrEq("tests/test_dir/plugins/plugin_foo-0.2.0.dll"));
+	EXPECT_THAT(find("foo", 0, 1, 0, PLUGIN_VERSION_EXACT), IsNull());
+}
+
+TEST_F(NAME, names_must_match_exactly)
+{
+	const struct plugin_index_entry_t* entry;
+
+	ASSERT_THAT((entry = find("foobar", 0, 0, 0, PLUGIN_VERSION_MINIMUM)), NotNull());
+	EXPECT_THAT(entry->name, StrEq("foobar"));
+	ASSERT_THAT((entry = find("bar", 0, 0, 0, PLUGIN_VERSION_MINIMUM)), NotNull());
+	EXPECT_THAT(entry->file_name, StrEq("tests/test_dir/plugins/plugin_bar-0.1.0.dll"));
+	EXPECT_THAT(find("fo", 0, 0, 0, PLUGIN_VERSION_MINIMUM), IsNull());
+}
+
+TEST_F(NAME, invalid_directory_fails)
+{
+	EXPECT_THAT(plugin_index_build(&index, "tests/test_dir/invalid/"), Eq(0));
+	EXPECT_THAT(index.is_built, Eq(0));
+	EXPECT_THAT(index.entries.count, Eq(0u));
+}
@@ -0,0 +1,192 @@
+#include "gmock/gmock.h"
+#include "framework/profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include "framework/events.h"
+#include "framework/main_loop.h"
+#include "framework/services.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include "util/file.h"
+#include "util/memory.h"
+#include <stdio.h>
+#include <string>
+
+#define NAME profiler
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+        plugin = plugin_create(game, "test", "test", "test", "test", "test");
+		ASSERT_THAT(plugin, NotNull());
+		profiler_clear();
+    }
+
+    virtual void TearDown()
+    {
+        plugin_destroy(plugin);
+        game_destroy(game);
+    }
+
+    struct game_t* game;
+    struct plugin_t* plugin;
+};
+
+EVENT_LISTENER(profiler_test_listener)
+{
+}
+
+TEST_F(NAME, nested_zones_form_a_tree)
+{
+	struct profiler_stats_t stats;
+
+	for(int frame = 0; frame != 10; ++frame)
+	{
+		PROFILE_BEGIN("outer");
+			PROFILE_BEGIN("inner");
+			PROFILE_END();
+		PROFILE_END();
+		profiler_end_frame();
+	}
+
+	EXPECT_THAT(profiler_get_frame_count(), Eq(10u));
+	ASSERT_THAT(profiler_get_stats("outer", &stats), Eq(1));
+	EXPECT_THAT(stats.frames, Eq(10u));
+	ASSERT_THAT(profiler_get_stats("outer/inner", &stats), Eq(1));
+	EXPECT_THAT(stats.frames, Eq(10u));
+	EXPECT_THAT(stats.calls, Eq(10u));
+	EXPECT_THAT(profiler_get_stats("inner", &stats), Eq(0));
+	EXPECT_THAT(profiler_get_stats("outer/missing", &stats), Eq(0));
+	EXPECT_THAT(profiler_get_stats("outer/inner/", &stats), Eq(0));
+}
+
+TEST_F(NAME, calls_are_summed_per_frame)
+{
+	struct profiler_stats_t stats;
+
+	for(int frame = 0; frame != 5; ++frame)
+	{
+		for(int i = 0; i != 3; ++i)
+			PROFILE_SCOPE("repeated", (void)0);
+		profiler_end_frame();
+	}
+
+	/* frames the zone isn't entered in don't count */
+	profiler_end_frame();
+
+	ASSERT_THAT(profiler_get_stats("repeated", &stats), Eq(1));
+	EXPECT_THAT(stats.frames, Eq(5u));
+	EXPECT_THAT(stats.calls, Eq(15u));
+	EXPECT_THAT(stats.min_ns, Le(stats.mean_ns));
+	EXPECT_THAT(stats.mean_ns, Le(stats.max_ns));
+	EXPECT_THAT(stats.p99_ns, Le(stats.max_ns));
+	EXPECT_THAT(stats.p99_ns, Ge(stats.min_ns));
+}
+
+TEST_F(NAME, zones_with_equal_names_are_merged)
+{
+	struct profiler_stats_t stats;
+	char name[] = "copied";
+
+	/* a different address, but the same name and path */
+	PROFILE_SCOPE("copied", (void)0);
+	PROFILE_BEGIN_KEY((uintptr_t)name, name);
+	PROFILE_END();
+	profiler_end_frame();
+
+	ASSERT_THAT(profiler_get_stats("copied", &stats), Eq(1));
+	EXPECT_THAT(stats.calls, Eq(2u));
+}
+
+TEST_F(NAME, unbalanced_end_is_ignored)
+{
+	struct profiler_stats_t stats;
+
+	PROFILE_END();
+	PROFILE_SCOPE("balanced", (void)0);
+	PROFILE_END();
+	profiler_end_frame();
+
+	ASSERT_THAT(profiler_get_stats("balanced", &stats), Eq(1));
+	EXPECT_THAT(stats.calls, Eq(1u));
+}
+
+TEST_F(NAME, events_and_listeners_are_zones)
+{
+	struct profiler_stats_t stats;
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	ASSERT_THAT(event_register_listener(game, "test.event", profiler_test_listener), Eq(1));
+
+	PROFILE_BEGIN("firing");
+	for(int i = 0; i != 4; ++i)
+		EVENT_FIRE0(event);
+	PROFILE_END();
+	profiler_end_frame();
+
+	ASSERT_THAT(profiler_get_stats("firing/test.event", &stats), Eq(1));
+	EXPECT_THAT(stats.calls, Eq(4u));
+}
+
+TEST_F(NAME, main_loops_of_all_games_share_a_frame)
+{
+	struct profiler_stats_t stats;
+
+	/* games_run_all() ends the frame, not the game's loop */
+	main_loop_do_loop(game);
+	main_loop_do_loop(game);
+	EXPECT_THAT(profiler_get_frame_count(), Eq(0u));
+	profiler_end_frame();
+
+	EXPECT_THAT(profiler_get_frame_count(), Eq(1u));
+	ASSERT_THAT(profiler_get_stats("main_loop", &stats), Eq(1));
+	EXPECT_THAT(stats.frames, Eq(1u));
+	EXPECT_THAT(stats.calls, Eq(2u));
+	EXPECT_THAT(profiler_get_stats("main_loop/dispatch_events", &stats), Eq(1));
+}
+
+TEST_F(NAME, stats_are_available_as_a_service)
+{
+	struct profiler_stats_t stats;
+	char ret = 0;
+
+	PROFILE_SCOPE("served", (void)0);
+	profiler_end_frame();
+
+	ASSERT_THAT(game->service.profiler_get_stats, NotNull());
+	SERVICE_CALL2(game->service.profiler_get_stats, &ret, PTR("served"), PTR(&stats));
+	EXPECT_THAT(ret, Eq(1));
+	EXPECT_THAT(stats.calls, Eq(1u));
+}
+
+TEST_F(NAME, chrome_trace_is_written)
+{
+	const char* file_name = "profiler_test.json";
+	void* buffer;
+	uint32_t size;
+
+	PROFILE_SCOPE("dumped \"zone\"", (void)0);
+
+	ASSERT_THAT(profiler_dump_chrome(file_name), Eq(1));
+	size = file_load_into_memory(file_name, &buffer, FILE_BINARY);
+	ASSERT_THAT(buffer, NotNull());
+
+	std::string json((const char*)buffer, size);
+	EXPECT_THAT(json, HasSubstr("\"traceEvents\":["));
+	EXPECT_THAT(json, HasSubstr("\"name\":\"dumped \\\"zone\\\"\""));
+	EXPECT_THAT(json, HasSubstr("\"ph\":\"X\""));
+
+	free_file(buffer);
+	remove(file_name);
+}
+
+#endif /* ENABLE_PROFILER */
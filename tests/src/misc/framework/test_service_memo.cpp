@@ -0,0 +1,183 @@
+#include "gmock/gmock.h"
+#include "framework/services.h"
+#include "framework/service_memo.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include <string.h>
+
+#define NAME service_memo
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+        plugin = plugin_create(game, "test", "test", "test", "test", "test");
+		ASSERT_THAT(plugin, NotNull());
+		g_calls = 0;
+    }
+
+    virtual void TearDown()
+    {
+        plugin_destroy(plugin);
+        game_destroy(game);
+    }
+
+    struct game_t* game;
+    struct plugin_t* plugin;
+    static int g_calls;
+};
+
+int NAME::g_calls;
+
+SERVICE(memo_square)
+{
+	EXTRACT_ARGUMENT(0, a, int, int);
+	++NAME::g_calls;
+	RETURN(a * a, int);
+}
+
+SERVICE(memo_length)
+{
+	EXTRACT_ARGUMENT_PTR(0, str, const char*);
+	++NAME::g_calls;
+	RETURN((uint32_t)strlen(str), uint32_t);
+}
+
+SERVICE(memo_square_invalidating)
+{
+	EXTRACT_ARGUMENT(0, a, int, int);
+	++NAME::g_calls;
+	/* as if another thread invalidated the cache while this was running */
+	service_invalidate_cache(service);
+	RETURN(a * a, int);
+}
+
+SERVICE(memo_unknown)
+{
+}
+
+TEST_F(NAME, repeated_calls_are_cached)
+{
+	struct service_t* service;
+	const struct service_memo_stats_t* stats;
+	int a = 3, b = 4, ret = 0;
+
+	SERVICE_CREATE1(plugin, service, "test.square", memo_square, int, int);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 8), Eq(1));
+
+	SERVICE_CALL1(service, &ret, a); EXPECT_THAT(ret, Eq(9));
+	SERVICE_CALL1(service, &ret, a); EXPECT_THAT(ret, Eq(9));
+	SERVICE_CALL1(service, &ret, b); EXPECT_THAT(ret, Eq(16));
+	SERVICE_CALL1(service, &ret, a); EXPECT_THAT(ret, Eq(9));
+	EXPECT_THAT(g_calls, Eq(2));
+
+	ASSERT_THAT(stats = service_get_cache_stats(service), NotNull());
+	EXPECT_THAT(stats->hits, Eq(2u));
+	EXPECT_THAT(stats->misses, Eq(2u));
+	EXPECT_THAT(stats->count, Eq(2u));
+}
+
+TEST_F(NAME, strings_are_keyed_by_contents)
+{
+	struct service_t* service;
+	char str[16];
+	uint32_t ret = 0;
+
+	SERVICE_CREATE1(plugin, service, "test.length", memo_length, uint32_t, const char*);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 8), Eq(1));
+
+	strcpy(str, "hello");
+	SERVICE_CALL1(service, &ret, PTR(str)); EXPECT_THAT(ret, Eq(5u));
+	strcpy(str, "hi");
+	SERVICE_CALL1(service, &ret, PTR(str)); EXPECT_THAT(ret, Eq(2u));
+	SERVICE_CALL1(service, &ret, PTR("hello")); EXPECT_THAT(ret, Eq(5u));
+	EXPECT_THAT(g_calls, Eq(2));
+}
+
+TEST_F(NAME, least_recently_used_result_is_evicted)
+{
+	struct service_t* service;
+	int a = 1, b = 2, c = 3, ret = 0;
+
+	SERVICE_CREATE1(plugin, service, "test.square", memo_square, int, int);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 2), Eq(1));
+
+	SERVICE_CALL1(service, &ret, a);
+	SERVICE_CALL1(service, &ret, b);
+	SERVICE_CALL1(service, &ret, a);  /* b is now least recently used */
+	SERVICE_CALL1(service, &ret, c);  /* evicts b */
+	EXPECT_THAT(g_calls, Eq(3));
+	EXPECT_THAT(service_get_cache_stats(service)->evictions, Eq(1u));
+
+	SERVICE_CALL1(service, &ret, a);
+	EXPECT_THAT(g_calls, Eq(3));
+	SERVICE_CALL1(service, &ret, b);
+	EXPECT_THAT(g_calls, Eq(4));
+	EXPECT_THAT(ret, Eq(4));
+}
+
+TEST_F(NAME, invalidate_discards_results)
+{
+	struct service_t* service;
+	int a = 5, ret = 0;
+
+	SERVICE_CREATE1(plugin, service, "test.square", memo_square, int, int);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 8), Eq(1));
+
+	SERVICE_CALL1(service, &ret, a);
+	service_invalidate_cache(service);
+	EXPECT_THAT(service_get_cache_stats(service)->count, Eq(0u));
+	SERVICE_CALL1(service, &ret, a);
+	EXPECT_THAT(g_calls, Eq(2));
+	EXPECT_THAT(ret, Eq(25));
+	EXPECT_THAT(service_get_cache_stats(service)->invalidations, Eq(1u));
+}
+
+TEST_F(NAME, results_invalidated_during_the_call_are_not_cached)
+{
+	struct service_t* service;
+	int a = 5, ret = 0;
+
+	SERVICE_CREATE1(plugin, service, "test.square", memo_square_invalidating, int, int);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 8), Eq(1));
+
+	SERVICE_CALL1(service, &ret, a);
+	EXPECT_THAT(ret, Eq(25));
+	EXPECT_THAT(service_get_cache_stats(service)->count, Eq(0u));
+	SERVICE_CALL1(service, &ret, a);
+	EXPECT_THAT(g_calls, Eq(2));
+}
+
+TEST_F(NAME, disabling_restores_exec)
+{
+	struct service_t* service;
+
+	SERVICE_CREATE1(plugin, service, "test.square", memo_square, int, int);
+	ASSERT_THAT(service, NotNull());
+	ASSERT_THAT(service_set_pure(service, 8), Eq(1));
+	EXPECT_THAT(service->exec, Ne((service_func)memo_square));
+	ASSERT_THAT(service_set_pure(service, 0), Eq(1));
+	EXPECT_THAT(service->exec, Eq((service_func)memo_square));
+	EXPECT_THAT(service_get_cache_stats(service), IsNull());
+}
+
+TEST_F(NAME, unknown_argument_types_are_rejected)
+{
+	struct service_t* service;
+
+	SERVICE_CREATE1(plugin, service, "test.unknown", memo_unknown, int, struct foo_t*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(service_set_pure(service, 8), Eq(0));
+	EXPECT_THAT(service->memo, IsNull());
+}
@@ -0,0 +1,182 @@
+#include "gmock/gmock.h"
+#include "framework/services.h"
+#include "framework/service_queue.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include <string.h>
+
+#ifdef ENABLE_MULTITHREADING
+#   include <thread>
+#endif
+
+#define NAME service_queue
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+        plugin = plugin_create(game, "test", "test", "test", "test", "test");
+		ASSERT_THAT(plugin, NotNull());
+    }
+
+    virtual void TearDown()
+    {
+        plugin_destroy(plugin);
+        game_destroy(game);
+    }
+
+    struct game_t* game;
+    struct plugin_t* plugin;
+};
+
+static int g_calls;
+static char g_string[32];
+
+SERVICE(service_queue_add)
+{
+	EXTRACT_ARGUMENT(0, a, int, int);
+	EXTRACT_ARGUMENT(1, b, int, int);
+	++g_calls;
+	RETURN(a + b, int);
+}
+
+SERVICE(service_queue_set_string)
+{
+	EXTRACT_ARGUMENT_PTR(0, str, const char*);
+	++g_calls;
+	strcpy(g_string, str);
+}
+
+static void
+on_done(struct service_future_t* future, struct service_t* service, void* ret)
+{
+	*(int*)future->user_data = *(int*)ret;
+}
+
+TEST_F(NAME, async_calls_are_executed_on_dispatch)
+{
+	struct service_t* service;
+	struct service_future_t future;
+	int ret = 0, done_ret = 0;
+	int a = 2, b = 3;
+
+	SERVICE_CREATE2(plugin, service, "test.add", service_queue_add, int, int, int);
+	ASSERT_THAT(service, NotNull());
+	service_set_affinity(service, SERVICE_AFFINITY_GAME_THREAD);
+
+	g_calls = 0;
+	memset(&future, 0, sizeof(future));
+	future.on_done = on_done;
+	future.user_data = &done_ret;
+	SERVICE_CALL_ASYNC2(service, &ret, &future, a, b);
+	EXPECT_THAT(g_calls, Eq(0));
+	EXPECT_THAT(service_future_is_done(&future), Eq(0));
+
+	service_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(ret, Eq(5));
+	EXPECT_THAT(done_ret, Eq(5));
+	EXPECT_THAT(service_future_is_done(&future), Eq(1));
+}
+
+TEST_F(NAME, async_calls_are_executed_in_order)
+{
+	struct service_t* service;
+	int ret[3] = {0, 0, 0};
+	int one = 1, two = 2, three = 3;
+
+	SERVICE_CREATE2(plugin, service, "test.add", service_queue_add, int, int, int);
+	ASSERT_THAT(service, NotNull());
+
+	g_calls = 0;
+	SERVICE_CALL_ASYNC2(service, &ret[0], NULL, one, one);
+	SERVICE_CALL_ASYNC2(service, &ret[1], NULL, two, two);
+	SERVICE_CALL_ASYNC2(service, &ret[2], NULL, three, three);
+	service_queue_dispatch(game);
+
+	EXPECT_THAT(g_calls, Eq(3));
+	EXPECT_THAT(ret[0], Eq(2));
+	EXPECT_THAT(ret[1], Eq(4));
+	EXPECT_THAT(ret[2], Eq(6));
+}
+
+TEST_F(NAME, async_calls_copy_strings)
+{
+	struct service_t* service;
+	char str[32];
+
+	SERVICE_CREATE1(plugin, service, "test.set_string", service_queue_set_string, void, const char*);
+	ASSERT_THAT(service, NotNull());
+
+	strcpy(str, "hello");
+	SERVICE_CALL_ASYNC1(service, NULL, NULL, PTR(str));
+	strcpy(str, "overwritten");
+	service_queue_dispatch(game);
+
+	EXPECT_THAT(g_string, StrEq("hello"));
+}
+
+TEST_F(NAME, sync_call_on_game_thread_is_direct)
+{
+	struct service_t* service;
+	int ret = 0;
+	int a = 4, b = 5;
+
+	SERVICE_CREATE2(plugin, service, "test.add", service_queue_add, int, int, int);
+	ASSERT_THAT(service, NotNull());
+	service_set_affinity(service, SERVICE_AFFINITY_GAME_THREAD);
+
+	SERVICE_CALL_SYNC2(service, &ret, a, b);
+	EXPECT_THAT(ret, Eq(9));
+}
+
+TEST_F(NAME, destroying_service_discards_queued_calls)
+{
+	struct service_t* service;
+	struct service_future_t future;
+	int a = 1, b = 2;
+
+	SERVICE_CREATE2(plugin, service, "test.add", service_queue_add, int, int, int);
+	ASSERT_THAT(service, NotNull());
+
+	g_calls = 0;
+	memset(&future, 0, sizeof(future));
+	SERVICE_CALL_ASYNC2(service, NULL, &future, a, b);
+	service_destroy(service);
+
+	EXPECT_THAT(service_future_is_done(&future), Eq(1));
+	service_queue_dispatch(game);
+	EXPECT_THAT(g_calls, Eq(0));
+}
+
+#ifdef ENABLE_MULTITHREADING
+TEST_F(NAME, sync_call_from_other_thread_is_marshalled)
+{
+	struct service_t* service;
+	int ret = 0;
+	int a = 20, b = 22;
+	volatile bool finished = false;
+
+	SERVICE_CREATE2(plugin, service, "test.add", service_queue_add, int, int, int);
+	ASSERT_THAT(service, NotNull());
+	service_set_affinity(service, SERVICE_AFFINITY_GAME_THREAD);
+
+	g_calls = 0;
+	std::thread caller([&]() {
+		SERVICE_CALL_SYNC2(service, &ret, a, b);
+		finished = true;
+	});
+	while(!finished)
+		service_queue_dispatch(game);
+	caller.join();
+
+	EXPECT_THAT(g_calls, Eq(1));
+	EXPECT_THAT(ret, Eq(42));
+}
+#endif
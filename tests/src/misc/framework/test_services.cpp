@@ -17,6 +17,33 @@ SERVICE(callback1)
 	RETURN(a + b + strlen(str), int);
 }
 
+static uint32_t g_batch_calls = 0;
+SERVICE_BATCH(batch_callback1)
+{
+	EXTRACT_ARGUMENT_COLUMN(0, a, int);
+	EXTRACT_ARGUMENT_COLUMN(1, b, double);
+	EXTRACT_ARGUMENT_COLUMN(2, str, const char*);
+	int* out = (int*)ret;
+	for(uint32_t i = 0; i != count; ++i)
+		out[i] = (int)(a[i] + b[i] + strlen(str[i])) * 2;
+	++g_batch_calls;
+}
+
+SERVICE_TYPED_DECLARE3(typed_callback, int, VAL, int, VAL, double, PTR, const char*);
+SERVICE_TYPED_ADAPTER3(typed_callback, int, VAL, int, VAL, double, PTR, const char*)
+int typed_callback(struct service_t* service, int a, double b, const char* str)
+{
+	return (int)(a + b + strlen(str));
+}
+
+static int g_typed_void_calls = 0;
+SERVICE_TYPED_DECLARE1(typed_void_callback, void, VAL, int);
+SERVICE_TYPED_ADAPTER_VOID1(typed_void_callback, VAL, int)
+void typed_void_callback(struct service_t* service, int a)
+{
+	g_typed_void_calls += a;
+}
+
 class NAME : public Test
 {
 public:
@@ -162,3 +189,164 @@ TEST_F(NAME, call_service)
 	SERVICE_CALL3(service, &ret, a, b, PTR("test string"));
 	EXPECT_THAT(ret, Eq(19));
 }
+
+TEST_F(NAME, handle_is_bound_when_service_is_created_and_destroyed)
+{
+	struct service_t* service;
+	struct service_handle_t* handle = service_handle_acquire(game, "test.service");
+	ASSERT_THAT(handle, NotNull());
+	EXPECT_THAT(handle->service, IsNull());
+
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(handle->service, Eq(service));
+
+	int ret;
+	int a = 6; double b = 2.4;
+	SERVICE_CALL3(handle->service, &ret, a, b, PTR("test string"));
+	EXPECT_THAT(ret, Eq(19));
+
+	service_destroy(service);
+	EXPECT_THAT(handle->service, IsNull());
+
+	/* re-creating the service re-binds the handle */
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(handle->service, Eq(service));
+
+	service_handle_release(handle);
+}
+
+TEST_F(NAME, handles_are_shared_and_refcounted)
+{
+	struct service_handle_t* handle1 = service_handle_acquire(game, "test.service");
+	struct service_handle_t* handle2 = service_handle_acquire(game, "test.service");
+	ASSERT_THAT(handle1, NotNull());
+	EXPECT_THAT(handle2, Eq(handle1));
+	EXPECT_THAT(handle1->refcount, Eq(2u));
+
+	service_handle_release(handle2);
+	EXPECT_THAT(handle1->refcount, Eq(1u));
+	EXPECT_THAT(bsthv_find(&game->service_handles, "test.service"), Eq(handle1));
+	service_handle_release(handle1);
+	EXPECT_THAT(bsthv_find(&game->service_handles, "test.service"), IsNull());
+}
+
+TEST_F(NAME, cached_lookup_notices_recreated_service)
+{
+	struct service_call_cache_t cache;
+	struct service_t* service;
+	const char* directory = "test.service";
+	memset(&cache, 0, sizeof(cache));
+
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(service_get_cached(game, directory, &cache), Eq(service));
+	EXPECT_THAT(service_get_cached(game, directory, &cache), Eq(service));
+
+	service_destroy(service);
+	EXPECT_THAT(service_get_cached(game, directory, &cache), IsNull());
+
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(service_get_cached(game, directory, &cache), Eq(service));
+}
+
+TEST_F(NAME, call_service_by_name)
+{
+	struct service_t* service;
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+
+	int ret = 0;
+	int a = 6; double b = 2.4;
+	for(int i = 0; i != 3; ++i)
+	{
+		SERVICE_CALL_NAME3(game, "test.service", &ret, a, b, PTR("test string"));
+		EXPECT_THAT(ret, Eq(19));
+	}
+}
+
+TEST_F(NAME, typed_service_can_be_called_directly_and_boxed)
+{
+	struct service_t* service;
+	SERVICE_CREATE_TYPED3(plugin, service, "test.service", typed_callback, int, VAL, int, VAL, double, PTR, const char*);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(service->exec, Eq((service_func)typed_callback_boxed));
+	EXPECT_THAT(service->native, Eq((service_native_func)typed_callback));
+	EXPECT_THAT(service->type_info->argc, Eq(3u));
+	EXPECT_THAT(service->type_info->argv_type[2], Eq(TYPE_STRING));
+
+	EXPECT_THAT(SERVICE_CALL_TYPED3(typed_callback, service, 6, 2.4, "test string"), Eq(19));
+
+	int ret = 0;
+	int a = 6; double b = 2.4;
+	SERVICE_CALL3(service, &ret, a, b, PTR("test string"));
+	EXPECT_THAT(ret, Eq(19));
+}
+
+TEST_F(NAME, typed_void_service_ignores_return_value)
+{
+	struct service_t* service;
+	SERVICE_CREATE_TYPED1(plugin, service, "test.service", typed_void_callback, void, VAL, int);
+	ASSERT_THAT(service, NotNull());
+
+	g_typed_void_calls = 0;
+	int a = 2;
+	SERVICE_CALL_TYPED1(typed_void_callback, service, 3);
+	SERVICE_CALL1(service, NULL, a);
+	EXPECT_THAT(g_typed_void_calls, Eq(5));
+}
+
+TEST_F(NAME, untyped_service_has_no_native_entry_point)
+{
+	struct service_t* service;
+	SERVICE_CREATE0(plugin, service, "test.service", (service_func)callback1, void);
+	ASSERT_THAT(service, NotNull());
+	EXPECT_THAT(service->native, IsNull());
+}
+
+TEST_F(NAME, batch_call_without_batch_implementation_loops)
+{
+	struct service_t* service;
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+
+	int a[3] = {6, 1, 0};
+	double b[3] = {2.4, 1.0, 0.0};
+	const char* str[3] = {"test string", "ab", ""};
+	int ret[3] = {0, 0, 0};
+	SERVICE_CALL_BATCH3(service, ret, 3, a, b, str);
+	EXPECT_THAT(ret[0], Eq(19));
+	EXPECT_THAT(ret[1], Eq(4));
+	EXPECT_THAT(ret[2], Eq(0));
+}
+
+TEST_F(NAME, batch_call_uses_batch_implementation)
+{
+	struct service_t* service;
+	SERVICE_CREATE3(plugin, service, "test.service", (service_func)callback1, int, int, double, const char*);
+	ASSERT_THAT(service, NotNull());
+	service_set_batch(service, batch_callback1);
+
+	int a[2] = {6, 1};
+	double b[2] = {2.4, 1.0};
+	const char* str[2] = {"test string", "ab"};
+	int ret[2] = {0, 0};
+	g_batch_calls = 0;
+	SERVICE_CALL_BATCH3(service, ret, 2, a, b, str);
+	EXPECT_THAT(g_batch_calls, Eq(1u));
+	EXPECT_THAT(ret[0], Eq(38));
+	EXPECT_THAT(ret[1], Eq(8));
+}
+
+TEST_F(NAME, batch_call_with_unknown_argument_type_fails)
+{
+	struct service_t* service;
+	SERVICE_CREATE1(plugin, service, "test.service", (service_func)callback1, void, struct service_t*);
+	ASSERT_THAT(service, NotNull());
+
+	struct service_t* column[1] = {service};
+	const void* columns[1] = {column};
+	EXPECT_THAT(service_call_batch(service, NULL, 1, columns), Eq(0));
+}
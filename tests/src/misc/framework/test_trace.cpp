@@ -0,0 +1,159 @@
+#include "gmock/gmock.h"
+#include "framework/trace.h"
+
+#ifdef ENABLE_TRACING
+
+#include "framework/events.h"
+#include "framework/services.h"
+#include "framework/plugin.h"
+#include "framework/game.h"
+#include "util/file.h"
+#include "util/memory.h"
+#include "util/thread.h"
+#include <stdio.h>
+#include <string>
+
+#define NAME trace
+
+using namespace testing;
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        game = game_create("test", NULL, GAME_CLIENT);
+		ASSERT_THAT(game, NotNull());
+        plugin = plugin_create(game, "test", "test", "test", "test", "test");
+		ASSERT_THAT(plugin, NotNull());
+		trace_clear();
+    }
+
+    virtual void TearDown()
+    {
+        plugin_destroy(plugin);
+        game_destroy(game);
+    }
+
+    struct game_t* game;
+    struct plugin_t* plugin;
+};
+
+EVENT_LISTENER(trace_test_listener)
+{
+}
+
+SERVICE(trace_test_service)
+{
+}
+
+#ifdef ENABLE_MULTITHREADING
+static volatile int g_recorder_step;
+
+static void
+recorder_thread(void* arg)
+{
+	trace_record(TRACE_EVENT, 1, NULL, trace_now());
+	g_recorder_step = 1;
+	while(g_recorder_step != 2)
+	{
+	}
+	trace_record(TRACE_EVENT, 1, NULL, trace_now());
+}
+#endif
+
+TEST_F(NAME, fires_and_listener_calls_are_counted)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	ASSERT_THAT(event_register_listener(game, "test.event", trace_test_listener), Eq(1));
+
+	for(int i = 0; i != 10; ++i)
+		EVENT_FIRE0(event);
+
+	EXPECT_THAT(trace_get_count(TRACE_EVENT, (uintptr_t)event), Eq(10u));
+	EXPECT_THAT(trace_get_count(TRACE_LISTENER, (uintptr_t)trace_test_listener), Eq(10u));
+}
+
+TEST_F(NAME, service_calls_are_counted)
+{
+	struct service_t* service;
+	SERVICE_CREATE0(plugin, service, "test.service", trace_test_service, void);
+	ASSERT_THAT(service, NotNull());
+
+	for(int i = 0; i != 5; ++i)
+		SERVICE_CALL0(service, NULL);
+
+	EXPECT_THAT(trace_get_count(TRACE_SERVICE, (uintptr_t)service), Eq(5u));
+}
+
+TEST_F(NAME, clear_discards_counters)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+
+	EVENT_FIRE0(event);
+	ASSERT_THAT(trace_get_count(TRACE_EVENT, (uintptr_t)event), Eq(1u));
+	trace_clear();
+	EXPECT_THAT(trace_get_count(TRACE_EVENT, (uintptr_t)event), Eq(0u));
+}
+
+TEST_F(NAME, report_service_logs_counters)
+{
+	struct event_t* event;
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	ASSERT_THAT(event_register_listener(game, "test.event", trace_test_listener), Eq(1));
+	EVENT_FIRE0(event);
+
+	SERVICE_CALL0(game->service.trace_report, NULL);
+}
+
+TEST_F(NAME, dump_service_writes_chrome_trace)
+{
+	struct event_t* event;
+	char* buffer;
+	uint32_t size;
+	char result = 0;
+
+	EVENT_CREATE0(plugin, event, "test.event");
+	ASSERT_THAT(event, NotNull());
+	EVENT_FIRE0(event);
+
+	SERVICE_CALL1(game->service.trace_dump, &result, PTR("trace_test.json"));
+	ASSERT_THAT(result, Eq(1));
+
+	size = file_load_into_memory("trace_test.json", (void**)&buffer, FILE_BINARY);
+	ASSERT_THAT(size, Gt(0u));
+	std::string json(buffer, size);
+	free_file(buffer);
+	EXPECT_THAT(json, StartsWith("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+	EXPECT_THAT(json, HasSubstr("{\"name\":\"test.event\",\"cat\":\"event\",\"ph\":\"X\""));
+	remove("trace_test.json");
+}
+
+#ifdef ENABLE_MULTITHREADING
+TEST_F(NAME, threads_record_into_new_buffers_after_deinit)
+{
+	uintptr_t handle;
+
+	g_recorder_step = 0;
+	ASSERT_THAT(thread_start(&handle, recorder_thread, NULL), Eq(1));
+	while(g_recorder_step != 1)
+	{
+	}
+	EXPECT_THAT(trace_get_count(TRACE_EVENT, 1), Eq(1u));
+
+	/* the thread's buffer is freed while it's still running */
+	trace_deinit();
+	trace_init();
+	g_recorder_step = 2;
+	thread_join(handle);
+	EXPECT_THAT(trace_get_count(TRACE_EVENT, 1), Eq(1u));
+}
+#endif
+
+#endif /* ENABLE_TRACING */
@@ -0,0 +1,72 @@
+#include "gmock/gmock.h"
+#include "plugin_renderer_gl/sprite_size.h"
+
+#define NAME sprite_size
+
+using namespace testing;
+
+TEST(NAME, longer_axis_is_one)
+{
+	struct sprite_size_t size;
+	float width, height;
+
+	sprite_size_init(&size);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(1.0f));
+	EXPECT_THAT(height, FloatEq(1.0f));
+
+	sprite_size_set_aspect_ratio(&size, 2.0f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(1.0f));
+	EXPECT_THAT(height, FloatEq(0.5f));
+
+	sprite_size_set_aspect_ratio(&size, 0.5f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(0.5f));
+	EXPECT_THAT(height, FloatEq(1.0f));
+}
+
+TEST(NAME, scale_before_image_is_loaded_is_kept)
+{
+	struct sprite_size_t size;
+	float width, height;
+
+	/* the placeholder is shown until the 200x100 image arrives */
+	sprite_size_init(&size);
+	sprite_size_scale(&size, 0.5f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(0.5f));
+	EXPECT_THAT(height, FloatEq(0.5f));
+
+	sprite_size_set_aspect_ratio(&size, 2.0f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(0.5f));
+	EXPECT_THAT(height, FloatEq(0.25f));
+}
+
+TEST(NAME, explicit_size_before_image_is_loaded_is_kept)
+{
+	struct sprite_size_t size;
+	float width, height;
+
+	sprite_size_init(&size);
+	sprite_size_set(&size, 0.4f, 0.2f);
+	sprite_size_scale(&size, 2.0f);
+	sprite_size_set_aspect_ratio(&size, 0.5f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(0.8f));
+	EXPECT_THAT(height, FloatEq(0.4f));
+}
+
+TEST(NAME, explicit_size_replaces_scale)
+{
+	struct sprite_size_t size;
+	float width, height;
+
+	sprite_size_init(&size);
+	sprite_size_scale(&size, 3.0f);
+	sprite_size_set(&size, 0.4f, 0.2f);
+	sprite_size_get(&size, &width, &height);
+	EXPECT_THAT(width, FloatEq(0.4f));
+	EXPECT_THAT(height, FloatEq(0.2f));
+}
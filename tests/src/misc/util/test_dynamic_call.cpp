@@ -1,6 +1,7 @@
 #include "gmock/gmock.h"
 #include "util/dynamic_call.h"
 #include "util/ordered_vector.h"
+#include <string>
 
 #define NAME dynamic_call
 
@@ -92,6 +93,47 @@ TEST(NAME, create_type_info_unknown_argv_type)
     dynamic_call_destroy_type_info(t);
 }
 
+TEST(NAME, type_infos_with_same_signature_are_shared)
+{
+    const char* argv1[] = {"int", "float"};
+    const char* argv2[] = {"int32_t", "const float"};
+    const char* argv3[] = {"float", "int"};
+    struct type_info_t* a = dynamic_call_create_type_info("void", 2, argv1);
+    struct type_info_t* b = dynamic_call_create_type_info("void", 2, argv2);
+    struct type_info_t* c = dynamic_call_create_type_info("void", 2, argv3);
+    ASSERT_THAT(a, NotNull());
+    ASSERT_THAT(b, NotNull());
+    ASSERT_THAT(c, NotNull());
+
+    EXPECT_THAT(a, Eq(b));
+    EXPECT_THAT(a->refcount, Eq(2u));
+    EXPECT_THAT(a, Ne(c));
+    EXPECT_THAT(dynamic_call_type_info_equal(a, b), Eq(1));
+    EXPECT_THAT(dynamic_call_type_info_equal(a, c), Eq(0));
+
+    dynamic_call_destroy_type_info(b);
+    EXPECT_THAT(a->refcount, Eq(1u));
+    dynamic_call_destroy_type_info(a);
+    dynamic_call_destroy_type_info(c);
+}
+
+TEST(NAME, typecheck)
+{
+    const char* argv[] = {"char*", "uint32_t"};
+    const char* argv_same[] = {"const char*", "unsigned int"};
+    const char* argv_other[] = {"char*", "int32_t"};
+    struct type_info_t* t = dynamic_call_create_type_info("int", 2, argv);
+    ASSERT_THAT(t, NotNull());
+
+    EXPECT_THAT(dynamic_call_do_typecheck(t, "int", 2, argv), Eq(1));
+    EXPECT_THAT(dynamic_call_do_typecheck(t, "int32_t", 2, argv_same), Eq(1));
+    EXPECT_THAT(dynamic_call_do_typecheck(t, "int", 2, argv_other), Eq(0));
+    EXPECT_THAT(dynamic_call_do_typecheck(t, "void", 2, argv), Eq(0));
+    EXPECT_THAT(dynamic_call_do_typecheck(t, "int", 1, argv), Eq(0));
+
+    dynamic_call_destroy_type_info(t);
+}
+
 TEST(NAME, callback_raw)
 {
     /* create type_info for function */
@@ -213,6 +255,209 @@ TEST(NAME, callback_create_argument_vector_from_strings)
     dynamic_call_destroy_type_info(t);
 }
 
+TEST(NAME, destroyed_argument_vectors_are_reused)
+{
+    const char* argvstr[] = {"char*", "double"};
+    struct type_info_t* t = dynamic_call_create_type_info("void", 2, argvstr);
+    ASSERT_THAT(t, NotNull());
+
+    const char* a = "test";
+    double b = 2.5;
+    void** first = dynamic_call_create_argument_vector_from_varargs(t, a, b);
+    ASSERT_THAT(first, NotNull());
+    EXPECT_THAT((const char*)first[0], StrEq("test"));
+    EXPECT_THAT((const void*)first[0], Ne((const void*)a));
+    EXPECT_THAT(*(double*)first[1], DoubleEq(2.5));
+    dynamic_call_destroy_argument_vector(t, first);
+
+    void** second = dynamic_call_create_argument_vector_from_varargs(t, a, b);
+    EXPECT_THAT(second, Eq(first));
+    EXPECT_THAT(t->argv_pool_count, Eq(0u));
+    dynamic_call_destroy_argument_vector(t, second);
+    EXPECT_THAT(t->argv_pool_count, Eq(1u));
+
+    dynamic_call_destroy_type_info(t);
+}
+
+TEST(NAME, long_strings_are_not_pooled)
+{
+    const char* argvstr[] = {"char*"};
+    struct type_info_t* t = dynamic_call_create_type_info("void", 1, argvstr);
+    ASSERT_THAT(t, NotNull());
+
+    std::string str(1000, 'x');
+    void** argv = dynamic_call_create_argument_vector_from_varargs(t, str.c_str());
+    ASSERT_THAT(argv, NotNull());
+    EXPECT_THAT((const char*)argv[0], StrEq(str.c_str()));
+    dynamic_call_destroy_argument_vector(t, argv);
+    EXPECT_THAT(t->argv_pool_count, Eq(0u));
+
+    dynamic_call_destroy_type_info(t);
+}
+
+TEST(NAME, init_argument_vector_from_strings_in_caller_storage)
+{
+    const char* argvstr[] = {"int", "wchar_t*", "double"};
+    struct type_info_t* t = dynamic_call_create_type_info("void", 3, argvstr);
+    ASSERT_THAT(t, NotNull());
+
+    struct ordered_vector_t strings;
+    const char* args[] = {"42", "hello", "1.5"};
+    ordered_vector_init_vector(&strings, sizeof(char*));
+    for(int i = 0; i != 3; ++i)
+        ordered_vector_push(&strings, &args[i]);
+
+    double storage[16];
+    uint32_t size = dynamic_call_get_argument_vector_size_from_strings(t, &strings);
+    ASSERT_THAT(size, Le(sizeof(storage)));
+    EXPECT_THAT(dynamic_call_init_argument_vector_from_strings(t, &strings, storage, size - 1), IsNull());
+
+    void** argv = dynamic_call_init_argument_vector_from_strings(t, &strings, storage, sizeof(storage));
+    ASSERT_THAT(argv, Eq((void**)storage));
+    EXPECT_THAT(*(int*)argv[0], Eq(42));
+    EXPECT_THAT((const wchar_t*)argv[1], StrEq(L"hello"));
+    EXPECT_THAT(*(double*)argv[2], DoubleEq(1.5));
+
+    ordered_vector_clear_free(&strings);
+    dynamic_call_destroy_type_info(t);
+}
+
+TEST(NAME, init_argument_vector_from_varargs_in_caller_storage)
+{
+    const char* argvstr[] = {"int64_t", "char*"};
+    struct type_info_t* t = dynamic_call_create_type_info("void", 2, argvstr);
+    ASSERT_THAT(t, NotNull());
+
+    double storage[8];
+    int64_t a = 1234567890123ll;
+    const char* b = "text";
+    void** argv = dynamic_call_init_argument_vector_from_varargs(t, storage, sizeof(storage), a, b);
+    ASSERT_THAT(argv, Eq((void**)storage));
+    EXPECT_THAT(*(int64_t*)argv[0], Eq(a));
+    EXPECT_THAT((const char*)argv[1], StrEq("text"));
+
+    dynamic_call_destroy_type_info(t);
+}
+
+TEST(NAME, set_argument_vector_on_created_vector_frees_copies)
+{
+    const char* argvstr[] = {"char*"};
+    struct type_info_t* t = dynamic_call_create_type_info("void", 1, argvstr);
+    ASSERT_THAT(t, NotNull());
+
+    const char* a = "first";
+    const char* b = "second";
+    void** argv = dynamic_call_create_argument_vector_from_varargs(t, a);
+    ASSERT_THAT(argv, NotNull());
+    ASSERT_THAT(dynamic_call_set_argument_vector_from_varargs(t, argv, b), Eq(1));
+    EXPECT_THAT((const char*)argv[0], StrEq("second"));
+    dynamic_call_destroy_argument_vector(t, argv);
+
+    dynamic_call_destroy_type_info(t);
+}
+
+/* every spelling listed in scripts/gen-type-name-hash.py */
+/* same as TYPE_NAME_INT() in dynamic_call.c */
+#define INT_TYPE_OF_SIZE(size) (type_e)(                                    \
+        (size) == 1 ? TYPE_INT8 : (size) == 2 ? TYPE_INT16 :                \
+        (size) == 4 ? TYPE_INT32 : TYPE_INT64)
+#define UINT_TYPE_OF_SIZE(size) (type_e)(INT_TYPE_OF_SIZE(size) + 1)
+
+static const struct { const char* name; type_e type; } type_name_aliases[] = {
+    {"void",              TYPE_VOID},
+    {"char",              TYPE_INT8},
+    {"signed char",       TYPE_INT8},
+    {"int8_t",            TYPE_INT8},
+    {"int8",              TYPE_INT8},
+    {"unsigned char",     TYPE_UINT8},
+    {"uint8_t",           TYPE_UINT8},
+    {"uint8",             TYPE_UINT8},
+    {"unsigned int8_t",   TYPE_UINT8},
+    {"int16_t",           TYPE_INT16},
+    {"int16",             TYPE_INT16},
+    {"uint16_t",          TYPE_UINT16},
+    {"uint16",            TYPE_UINT16},
+    {"unsigned int16_t",  TYPE_UINT16},
+    {"short int",         TYPE_INT16},
+    {"signed short int",  TYPE_INT16},
+    {"unsigned short int", TYPE_UINT16},
+    {"int",               TYPE_INT32},
+    {"signed",            TYPE_INT32},
+    {"signed int",        TYPE_INT32},
+    {"int32_t",           TYPE_INT32},
+    {"int32",             TYPE_INT32},
+    {"unsigned",          TYPE_UINT32},
+    {"unsigned int",      TYPE_UINT32},
+    {"uint32_t",          TYPE_UINT32},
+    {"uint32",            TYPE_UINT32},
+    {"unsigned int32_t",  TYPE_UINT32},
+    {"uint",              TYPE_UINT32},
+    {"int64_t",           TYPE_INT64},
+    {"int64",             TYPE_INT64},
+    {"uint64_t",          TYPE_UINT64},
+    {"uint64",            TYPE_UINT64},
+    {"unsigned int64_t",  TYPE_UINT64},
+    {"long long int",     TYPE_INT64},
+    {"signed long long int", TYPE_INT64},
+    {"unsigned long long int", TYPE_UINT64},
+    {"long int",          INT_TYPE_OF_SIZE(sizeof(long))},
+    {"signed long int",   INT_TYPE_OF_SIZE(sizeof(long))},
+    {"unsigned long int", UINT_TYPE_OF_SIZE(sizeof(long))},
+    {"int_least8_t",      INT_TYPE_OF_SIZE(sizeof(int_least8_t))},
+    {"int_least16_t",     INT_TYPE_OF_SIZE(sizeof(int_least16_t))},
+    {"int_least32_t",     INT_TYPE_OF_SIZE(sizeof(int_least32_t))},
+    {"int_least64_t",     INT_TYPE_OF_SIZE(sizeof(int_least64_t))},
+    {"uint_least8_t",     UINT_TYPE_OF_SIZE(sizeof(uint_least8_t))},
+    {"uint_least16_t",    UINT_TYPE_OF_SIZE(sizeof(uint_least16_t))},
+    {"uint_least32_t",    UINT_TYPE_OF_SIZE(sizeof(uint_least32_t))},
+    {"uint_least64_t",    UINT_TYPE_OF_SIZE(sizeof(uint_least64_t))},
+    {"int_fast8_t",       INT_TYPE_OF_SIZE(sizeof(int_fast8_t))},
+    {"int_fast16_t",      INT_TYPE_OF_SIZE(sizeof(int_fast16_t))},
+    {"int_fast32_t",      INT_TYPE_OF_SIZE(sizeof(int_fast32_t))},
+    {"int_fast64_t",      INT_TYPE_OF_SIZE(sizeof(int_fast64_t))},
+    {"uint_fast8_t",      UINT_TYPE_OF_SIZE(sizeof(uint_fast8_t))},
+    {"uint_fast16_t",     UINT_TYPE_OF_SIZE(sizeof(uint_fast16_t))},
+    {"uint_fast32_t",     UINT_TYPE_OF_SIZE(sizeof(uint_fast32_t))},
+    {"uint_fast64_t",     UINT_TYPE_OF_SIZE(sizeof(uint_fast64_t))},
+    {"intptr_t",          TYPE_INTPTR},
+    {"uintptr_t",         TYPE_UINTPTR},
+    {"float",             TYPE_FLOAT},
+    {"double",            TYPE_DOUBLE},
+    {"char*",             TYPE_STRING},
+    {"signed char*",      TYPE_STRING},
+    {"unsigned char*",    TYPE_STRING},
+    {"wchar_t*",          TYPE_WSTRING},
+    {"char16_t*",         sizeof(wchar_t) == 2 ? TYPE_WSTRING : TYPE_UNKNOWN},
+    {"char32_t*",         sizeof(wchar_t) == 4 ? TYPE_WSTRING : TYPE_UNKNOWN}
+};
+
+TEST(NAME, get_type_from_string_accepts_all_aliases)
+{
+    for(unsigned i = 0; i != sizeof(type_name_aliases) / sizeof(*type_name_aliases); ++i)
+    {
+        std::string name = type_name_aliases[i].name;
+        EXPECT_THAT(dynamic_call_get_type_from_string(name.c_str()), Eq(type_name_aliases[i].type)) << name;
+        EXPECT_THAT(dynamic_call_get_type_from_string(("const " + name).c_str()), Eq(type_name_aliases[i].type)) << name;
+        EXPECT_THAT(dynamic_call_get_type_from_string(("  " + name + " ").c_str()), Eq(type_name_aliases[i].type)) << name;
+        EXPECT_THAT(dynamic_call_get_type_from_string((name + "x").c_str()), Eq(TYPE_UNKNOWN)) << name;
+        EXPECT_THAT(dynamic_call_get_type_from_string((name + "**").c_str()), Eq(TYPE_UNKNOWN)) << name;
+    }
+}
+
+TEST(NAME, get_type_from_string_normalises_spelling)
+{
+    EXPECT_THAT(dynamic_call_get_type_from_string("const char *"),          Eq(TYPE_STRING));
+    EXPECT_THAT(dynamic_call_get_type_from_string("char const*"),           Eq(TYPE_STRING));
+    EXPECT_THAT(dynamic_call_get_type_from_string("const char* const"),     Eq(TYPE_STRING));
+    EXPECT_THAT(dynamic_call_get_type_from_string("const  wchar_t  *"),     Eq(TYPE_WSTRING));
+    EXPECT_THAT(dynamic_call_get_type_from_string("volatile\tunsigned\tint"), Eq(TYPE_UINT32));
+    EXPECT_THAT(dynamic_call_get_type_from_string("unsignedint"),           Eq(TYPE_UNKNOWN));
+    EXPECT_THAT(dynamic_call_get_type_from_string("char * *"),              Eq(TYPE_UNKNOWN));
+    EXPECT_THAT(dynamic_call_get_type_from_string("struct point_t"),        Eq(TYPE_UNKNOWN));
+    EXPECT_THAT(dynamic_call_get_type_from_string("a_very_long_type_name_t"), Eq(TYPE_UNKNOWN));
+    EXPECT_THAT(dynamic_call_get_type_from_string(""),                      Eq(TYPE_UNKNOWN));
+}
+
 TEST(NAME, get_type_from_string_test_strings)
 {
     EXPECT_THAT(dynamic_call_get_type_from_string("char"),           Eq(TYPE_INT8));
@@ -240,6 +485,9 @@ TEST(NAME, get_type_from_string_test_integers)
     EXPECT_THAT(dynamic_call_get_type_from_string("unsigned int16_t"),Eq(TYPE_UINT16));
     EXPECT_THAT(dynamic_call_get_type_from_string("unsigned int32_t"),Eq(TYPE_UINT32));
     EXPECT_THAT(dynamic_call_get_type_from_string("unsigned int64_t"),Eq(TYPE_UINT64));
+    EXPECT_THAT(dynamic_call_get_type_from_string("short int"),      Eq(TYPE_INT16));
+    EXPECT_THAT(dynamic_call_get_type_from_string("unsigned long long int"), Eq(TYPE_UINT64));
+    EXPECT_THAT(dynamic_call_get_type_from_string("uint_least8_t"),  Eq(TYPE_UINT8));
 
     EXPECT_THAT(dynamic_call_get_type_from_string("int*"),           Eq(TYPE_UNKNOWN));
     EXPECT_THAT(dynamic_call_get_type_from_string("int8_t*"),        Eq(TYPE_UNKNOWN));
@@ -0,0 +1,155 @@
+#include "gmock/gmock.h"
+#include "util/pack.h"
+#include "util/vfs.h"
+#include "util/file.h"
+#include "util/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NAME pack
+
+using namespace testing;
+
+#define PACK_FILE "tests/test_dir/test.pak"
+#define SOURCE_FILE "tests/test_dir/files/file_a.txt"
+#define SOURCE_CONTENT "Some Random Message\n"
+#define REPEATING_FILE "tests/test_dir/repeating.txt"
+
+static void
+write_repeating_file(void)
+{
+    FILE* fp = fopen(REPEATING_FILE, "wb");
+    ASSERT_THAT(fp, NotNull());
+    for(int i = 0; i != 200; ++i)
+        fputs("this line repeats over and over again\n", fp);
+    fclose(fp);
+}
+
+TEST(NAME, write_and_find_uncompressed_entry)
+{
+    const char* sources[] = {SOURCE_FILE};
+    const char* names[] = {"file_a.txt"};
+    struct pack_t* pack;
+    const struct pack_entry_t* entry;
+
+    ASSERT_THAT(pack_write(PACK_FILE, 1, sources, names, 0), Eq(1));
+    ASSERT_THAT((pack = pack_open(PACK_FILE)), NotNull());
+
+    ASSERT_THAT((entry = pack_find(pack, "file_a.txt")), NotNull());
+    EXPECT_THAT(pack_entry_name(pack, entry), StrEq("file_a.txt"));
+    EXPECT_THAT(entry->flags & PACK_ENTRY_COMPRESSED, Eq(0u));
+    EXPECT_THAT(entry->size, Eq(strlen(SOURCE_CONTENT)));
+    EXPECT_THAT(entry->offset % PACK_ALIGNMENT, Eq(0u));
+    EXPECT_THAT(memcmp(pack_entry_data(pack, entry), SOURCE_CONTENT, entry->size), Eq(0));
+
+    EXPECT_THAT(pack_find(pack, "file_b.txt"), IsNull());
+
+    pack_close(pack);
+    remove(PACK_FILE);
+}
+
+TEST(NAME, compressed_entry_round_trip)
+{
+    const char* sources[] = {REPEATING_FILE, SOURCE_FILE};
+    const char* names[] = {"repeating.txt", "file_a.txt"};
+    struct pack_t* pack;
+    const struct pack_entry_t* entry;
+    void* original;
+    void* buffer;
+    uint32_t size;
+
+    write_repeating_file();
+    ASSERT_THAT((size = file_load_into_memory(REPEATING_FILE, &original, FILE_BINARY)), Ne(0u));
+    ASSERT_THAT(pack_write(PACK_FILE, 2, sources, names, 1), Eq(1));
+    ASSERT_THAT((pack = pack_open(PACK_FILE)), NotNull());
+
+    ASSERT_THAT((entry = pack_find(pack, "repeating.txt")), NotNull());
+    EXPECT_THAT(entry->flags & PACK_ENTRY_COMPRESSED, Eq((uint32_t)PACK_ENTRY_COMPRESSED));
+    EXPECT_THAT(entry->size, Eq(size));
+    EXPECT_THAT(entry->stored_size, Lt(size));
+    buffer = MALLOC(entry->size);
+    EXPECT_THAT(pack_read(pack, entry, buffer), Eq(1));
+    EXPECT_THAT(memcmp(buffer, original, size), Eq(0));
+    FREE(buffer);
+
+    /* entries that don't shrink are stored as is */
+    ASSERT_THAT((entry = pack_find(pack, "file_a.txt")), NotNull());
+    EXPECT_THAT(entry->flags & PACK_ENTRY_COMPRESSED, Eq(0u));
+
+    free_file(original);
+    pack_close(pack);
+    remove(PACK_FILE);
+    remove(REPEATING_FILE);
+}
+
+TEST(NAME, duplicate_entry_names_are_rejected)
+{
+    const char* sources[] = {SOURCE_FILE, SOURCE_FILE};
+    const char* names[] = {"same.txt", "same.txt"};
+
+    EXPECT_THAT(pack_write(PACK_FILE, 2, sources, names, 0), Eq(0));
+    remove(PACK_FILE);
+}
+
+TEST(NAME, open_invalid_pack_fails)
+{
+    EXPECT_THAT(pack_open(SOURCE_FILE), IsNull());
+    EXPECT_THAT(pack_open("tests/test_dir/does_not_exist.pak"), IsNull());
+}
+
+TEST(NAME, entries_larger_than_their_blob_are_rejected)
+{
+    const char* sources[] = {SOURCE_FILE};
+    const char* names[] = {"file_a.txt"};
+    struct pack_header_t header;
+    struct pack_entry_t entry;
+    FILE* fp;
+
+    ASSERT_THAT(pack_write(PACK_FILE, 1, sources, names, 0), Eq(1));
+
+    /* claim the entry is larger than what is stored, but still inside the file */
+    ASSERT_THAT((fp = fopen(PACK_FILE, "r+b")), NotNull());
+    ASSERT_THAT(fread(&header, sizeof(header), 1, fp), Eq(1u));
+    fseek(fp, header.toc_offset, SEEK_SET);
+    ASSERT_THAT(fread(&entry, sizeof(entry), 1, fp), Eq(1u));
+    entry.size = entry.stored_size + 1;
+    fseek(fp, header.toc_offset, SEEK_SET);
+    ASSERT_THAT(fwrite(&entry, sizeof(entry), 1, fp), Eq(1u));
+    fclose(fp);
+
+    EXPECT_THAT(pack_open(PACK_FILE), IsNull());
+    remove(PACK_FILE);
+}
+
+TEST(NAME, vfs_reads_from_mounted_pack)
+{
+    const char* sources[] = {SOURCE_FILE};
+    const char* names[] = {"packed/only.txt"};
+    struct vfs_file_t file;
+    void* buffer;
+
+    ASSERT_THAT(pack_write(PACK_FILE, 1, sources, names, 0), Eq(1));
+    ASSERT_THAT(vfs_mount(PACK_FILE), Eq(1));
+    EXPECT_THAT(vfs_mount_count(), Eq(1u));
+
+    /* uncompressed entries are not copied */
+    ASSERT_THAT(vfs_open(&file, "./packed/only.txt"), Eq(1));
+    EXPECT_THAT(file.buffer, IsNull());
+    EXPECT_THAT(file.size, Eq(strlen(SOURCE_CONTENT)));
+    EXPECT_THAT(memcmp(file.data, SOURCE_CONTENT, file.size), Eq(0));
+    vfs_close(&file);
+
+    /* file_load_into_memory() sees packed files as well */
+    ASSERT_THAT(file_load_into_memory("packed/only.txt", &buffer, (file_opts_e)0), Eq(strlen(SOURCE_CONTENT)));
+    EXPECT_THAT((char*)buffer, StrEq(SOURCE_CONTENT));
+    free_file(buffer);
+
+    /* loose files are still found */
+    ASSERT_THAT(vfs_open(&file, SOURCE_FILE), Eq(1));
+    EXPECT_THAT(file.buffer, NotNull());
+    vfs_close(&file);
+
+    vfs_deinit();
+    vfs_init();
+    remove(PACK_FILE);
+}
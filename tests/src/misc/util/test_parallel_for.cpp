@@ -0,0 +1,121 @@
+#include "gmock/gmock.h"
+#include "thread_pool/parallel_for.h"
+#include "util/atomic.h"
+#include <string.h>
+
+#define NAME parallel_for
+
+using namespace testing;
+
+struct visits_t
+{
+    int count[10000];
+    int calls;
+    uint32_t last_begin;
+    uint32_t last_end;
+};
+
+static void
+visit(uint32_t begin, uint32_t end, void* user)
+{
+    struct visits_t* visits = (struct visits_t*)user;
+    ATOMIC_ADD(visits->calls, 1);
+    visits->last_begin = begin;
+    visits->last_end = end;
+    for(uint32_t i = begin; i != end; ++i)
+        ATOMIC_ADD(visits->count[i], 1);
+}
+
+static void
+sum(uint32_t begin, uint32_t end, void* partial, void* user)
+{
+    for(uint32_t i = begin; i != end; ++i)
+        *(uint64_t*)partial += i;
+}
+
+static void
+join_sum(void* result, const void* partial, void* user)
+{
+    *(uint64_t*)result += *(const uint64_t*)partial;
+}
+
+static void
+visit_nested(uint32_t begin, uint32_t end, void* user)
+{
+    struct thread_pool_t* pool = (struct thread_pool_t*)user;
+    for(uint32_t i = begin; i != end; ++i)
+    {
+        uint64_t result;
+        uint64_t zero = 0;
+        thread_pool_parallel_reduce(pool, 0, 1000, 10, &zero, &result, sizeof(result), sum, join_sum, NULL);
+        EXPECT_THAT(result, Eq(999u * 1000u / 2u));
+    }
+}
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        pool = thread_pool_create(4, 0);
+        ASSERT_THAT(pool, NotNull());
+        memset(&visits, 0, sizeof(visits));
+    }
+
+    virtual void TearDown()
+    {
+        thread_pool_destroy(pool);
+    }
+
+    struct thread_pool_t* pool;
+    struct visits_t visits;
+};
+
+TEST_F(NAME, every_index_is_visited_once)
+{
+    thread_pool_parallel_for(pool, 0, 10000, 7, visit, &visits);
+    for(int i = 0; i != 10000; ++i)
+        ASSERT_THAT(visits.count[i], Eq(1)) << "index " << i;
+}
+
+TEST_F(NAME, sub_range_is_visited)
+{
+    thread_pool_parallel_for(pool, 100, 9000, 64, visit, &visits);
+    for(int i = 0; i != 10000; ++i)
+        ASSERT_THAT(visits.count[i], Eq(i >= 100 && i < 9000 ? 1 : 0)) << "index " << i;
+}
+
+TEST_F(NAME, range_within_one_grain_is_not_split)
+{
+    thread_pool_parallel_for(pool, 10, 20, 10, visit, &visits);
+    EXPECT_THAT(visits.calls, Eq(1));
+    EXPECT_THAT(visits.last_begin, Eq(10u));
+    EXPECT_THAT(visits.last_end, Eq(20u));
+}
+
+TEST_F(NAME, empty_range_does_nothing)
+{
+    thread_pool_parallel_for(pool, 20, 20, 1, visit, &visits);
+    thread_pool_parallel_for(pool, 30, 20, 1, visit, &visits);
+    EXPECT_THAT(visits.calls, Eq(0));
+}
+
+TEST_F(NAME, reduce_joins_all_partial_results)
+{
+    uint64_t result = 1, zero = 0;
+    thread_pool_parallel_reduce(pool, 0, 100000, 100, &zero, &result, sizeof(result), sum, join_sum, NULL);
+    EXPECT_THAT(result, Eq(99999ull * 100000ull / 2ull));
+}
+
+TEST_F(NAME, reduce_of_empty_range_is_identity)
+{
+    uint64_t result = 1, zero = 0;
+    thread_pool_parallel_reduce(pool, 5, 5, 100, &zero, &result, sizeof(result), sum, join_sum, NULL);
+    EXPECT_THAT(result, Eq(0u));
+}
+
+TEST_F(NAME, loops_can_be_nested)
+{
+    thread_pool_parallel_for(pool, 0, 64, 1, visit_nested, pool);
+}
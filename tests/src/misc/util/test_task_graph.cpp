@@ -0,0 +1,150 @@
+#include "gmock/gmock.h"
+#include "thread_pool/task_graph.h"
+#include "util/atomic.h"
+
+#define NAME task_graph
+
+using namespace testing;
+
+struct order_t
+{
+    int next;
+    int position[8];
+};
+
+struct step_t
+{
+    struct order_t* order;
+    int index;
+};
+
+static void
+record_step(void* data)
+{
+    struct step_t* step = (struct step_t*)data;
+    step->order->position[step->index] = ATOMIC_INCREMENT(step->order->next) - 1;
+}
+
+class NAME : public Test
+{
+public:
+
+    virtual void SetUp()
+    {
+        pool = thread_pool_create(4, 0);
+        ASSERT_THAT(pool, NotNull());
+        graph = task_graph_create(pool);
+        ASSERT_THAT(graph, NotNull());
+        order.next = 0;
+        for(int i = 0; i != 8; ++i)
+        {
+            order.position[i] = -1;
+            step[i].order = &order;
+            step[i].index = i;
+        }
+    }
+
+    virtual void TearDown()
+    {
+        task_graph_destroy(graph);
+        thread_pool_destroy(pool);
+    }
+
+    struct thread_pool_t* pool;
+    struct task_graph_t* graph;
+    struct order_t order;
+    struct step_t step[8];
+};
+
+TEST_F(NAME, dependencies_are_respected)
+{
+    /* diamond: 0 before 1 and 2, both before 3 */
+    struct task_t* a = task_graph_add(graph, record_step, &step[0]);
+    struct task_t* b = task_graph_add(graph, record_step, &step[1]);
+    struct task_t* c = task_graph_add(graph, record_step, &step[2]);
+    struct task_t* d = task_graph_add(graph, record_step, &step[3]);
+    ASSERT_THAT(task_depends_on(b, a), Eq(1));
+    ASSERT_THAT(task_depends_on(c, a), Eq(1));
+    ASSERT_THAT(task_depends_on(d, b), Eq(1));
+    ASSERT_THAT(task_depends_on(d, c), Eq(1));
+
+    EXPECT_THAT(task_graph_run(graph), Eq(1));
+    EXPECT_THAT(order.position[0], Eq(0));
+    EXPECT_THAT(order.position[1], AnyOf(Eq(1), Eq(2)));
+    EXPECT_THAT(order.position[2], AnyOf(Eq(1), Eq(2)));
+    EXPECT_THAT(order.position[3], Eq(3));
+}
+
+TEST_F(NAME, continuations_run_in_order)
+{
+    struct task_t* task = task_graph_add(graph, record_step, &step[0]);
+    for(int i = 1; i != 8; ++i)
+        ASSERT_THAT(task = task_then(graph, task, record_step, &step[i]), NotNull());
+
+    EXPECT_THAT(task_graph_run(graph), Eq(1));
+    for(int i = 0; i != 8; ++i)
+        EXPECT_THAT(order.position[i], Eq(i));
+}
+
+TEST_F(NAME, graphs_can_be_run_again)
+{
+    struct task_t* a = task_graph_add(graph, record_step, &step[0]);
+    ASSERT_THAT(task_then(graph, a, record_step, &step[1]), NotNull());
+
+    EXPECT_THAT(task_graph_run(graph), Eq(1));
+    order.next = 0;
+    EXPECT_THAT(task_graph_run(graph), Eq(1));
+    EXPECT_THAT(order.next, Eq(2));
+    EXPECT_THAT(order.position[1], Eq(1));
+}
+
+TEST_F(NAME, cycles_are_reported)
+{
+    struct task_t* a = task_graph_add(graph, record_step, &step[0]);
+    struct task_t* b = task_graph_add(graph, record_step, &step[1]);
+    struct task_t* c = task_graph_add(graph, record_step, &step[2]);
+    ASSERT_THAT(task_depends_on(b, c), Eq(1));
+    ASSERT_THAT(task_depends_on(c, b), Eq(1));
+
+    EXPECT_THAT(task_graph_run(graph), Eq(0));
+    EXPECT_THAT(order.position[0], Eq(0));
+    EXPECT_THAT(order.position[1], Eq(-1));
+    (void)a;
+}
+
+TEST_F(NAME, tasks_of_different_graphs_cant_be_linked)
+{
+    struct task_graph_t* other = task_graph_create(pool);
+    ASSERT_THAT(other, NotNull());
+    struct task_t* a = task_graph_add(graph, record_step, &step[0]);
+    struct task_t* b = task_graph_add(other, record_step, &step[1]);
+
+    EXPECT_THAT(task_depends_on(b, a), Eq(0));
+    EXPECT_THAT(task_then(other, a, record_step, &step[2]), IsNull());
+
+    task_graph_destroy(other);
+}
+
+static void
+run_nested_graph(void* data)
+{
+    EXPECT_THAT(task_graph_run((struct task_graph_t*)data), Eq(1));
+}
+
+TEST_F(NAME, tasks_can_wait_for_other_graphs)
+{
+    struct task_graph_t* nested = task_graph_create(pool);
+    ASSERT_THAT(nested, NotNull());
+    struct task_t* task = task_graph_add(nested, record_step, &step[0]);
+    for(int i = 1; i != 4; ++i)
+        task = task_then(nested, task, record_step, &step[i]);
+
+    task = task_graph_add(graph, run_nested_graph, nested);
+    task_then(graph, task, record_step, &step[4]);
+
+    EXPECT_THAT(task_graph_run(graph), Eq(1));
+    for(int i = 0; i != 5; ++i)
+        EXPECT_THAT(order.position[i], Eq(i));
+
+    task_graph_destroy(nested);
+}
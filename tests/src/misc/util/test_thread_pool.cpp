@@ -0,0 +1,222 @@
+#include "gmock/gmock.h"
+#include "thread_pool/thread_pool.h"
+
+#ifdef ENABLE_THREAD_POOL
+
+#include "util/time.h"
+#include "util/atomic.h"
+
+#define NAME thread_pool
+
+using namespace testing;
+
+static void
+count_job(void* data)
+{
+    ATOMIC_ADD(*(int*)data, 1);
+}
+
+struct recurse_t
+{
+    struct thread_pool_t* pool;
+    int depth;
+    int count;
+};
+
+static void
+recurse_job(void* data)
+{
+    struct recurse_t* r = (struct recurse_t*)data;
+    int depth = ATOMIC_LOAD(r->depth);
+    ATOMIC_ADD(r->count, 1);
+    if(depth < 1000 && ATOMIC_CAS(r->depth, depth, depth + 1))
+    {
+        thread_pool_queue(r->pool, recurse_job, r);
+        thread_pool_queue(r->pool, recurse_job, r);
+    }
+}
+
+struct steal_t
+{
+    struct thread_pool_t* pool;
+    volatile int child_ran;
+    volatile int timed_out;
+};
+
+static void
+steal_child_job(void* data)
+{
+    ((struct steal_t*)data)->child_ran = 1;
+}
+
+static void
+steal_parent_job(void* data)
+{
+    struct steal_t* s = (struct steal_t*)data;
+    uint64_t timeout = get_time_ns() + 5000000000ull;
+
+    /* the child is pushed to this worker's deque, only a thief can run it */
+    thread_pool_queue(s->pool, steal_child_job, s);
+    while(!s->child_ran)
+    {
+        if(get_time_ns() > timeout)
+        {
+            s->timed_out = 1;
+            break;
+        }
+    }
+}
+
+static void
+block_job(void* data)
+{
+    uint64_t timeout = get_time_ns() + 5000000000ull;
+    while(!*(volatile int*)data && get_time_ns() < timeout)
+    {
+    }
+}
+
+TEST(NAME, all_jobs_are_executed)
+{
+    struct thread_pool_t* pool = thread_pool_create(4, 0);
+    int count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    for(int i = 0; i != 10000; ++i)
+        thread_pool_queue(pool, count_job, &count);
+    thread_pool_wait_for_jobs(pool);
+    EXPECT_THAT(count, Eq(10000));
+
+    thread_pool_destroy(pool);
+}
+
+TEST(NAME, jobs_can_queue_jobs)
+{
+    struct recurse_t r = {NULL, 0, 0};
+    r.pool = thread_pool_create(4, 0);
+    ASSERT_THAT(r.pool, NotNull());
+
+    thread_pool_queue(r.pool, recurse_job, &r);
+    thread_pool_wait_for_jobs(r.pool);
+    EXPECT_THAT(r.depth, Eq(1000));
+    EXPECT_THAT(r.count, Eq(2001));
+
+    thread_pool_destroy(r.pool);
+}
+
+TEST(NAME, idle_workers_steal_jobs)
+{
+    struct steal_t s = {NULL, 0, 0};
+    s.pool = thread_pool_create(2, 0);
+    ASSERT_THAT(s.pool, NotNull());
+
+    thread_pool_queue(s.pool, steal_parent_job, &s);
+    thread_pool_wait_for_jobs(s.pool);
+    EXPECT_THAT(s.child_ran, Eq(1));
+    EXPECT_THAT(s.timed_out, Eq(0));
+
+    thread_pool_destroy(s.pool);
+}
+
+TEST(NAME, injection_queue_grows)
+{
+    /* room for two jobs in each deque and initially in the injection queue */
+    struct thread_pool_t* pool = thread_pool_create(2, 32);
+    int count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    thread_pool_suspend(pool);
+    for(int i = 0; i != 1000; ++i)
+        thread_pool_queue(pool, count_job, &count);
+    thread_pool_resume(pool);
+    thread_pool_wait_for_jobs(pool);
+    EXPECT_THAT(count, Eq(1000));
+
+    thread_pool_destroy(pool);
+}
+
+TEST(NAME, suspended_pool_keeps_queued_jobs)
+{
+    struct thread_pool_t* pool = thread_pool_create(2, 0);
+    int count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    thread_pool_suspend(pool);
+    for(int i = 0; i != 100; ++i)
+        thread_pool_queue(pool, count_job, &count);
+    EXPECT_THAT(count, Eq(0));
+
+    thread_pool_resume(pool);
+    thread_pool_wait_for_jobs(pool);
+    EXPECT_THAT(count, Eq(100));
+
+    thread_pool_destroy(pool);
+}
+
+TEST(NAME, sleeping_workers_are_woken_up)
+{
+    struct thread_pool_t* pool = thread_pool_create(2, 0);
+    int count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    for(int i = 0; i != 3; ++i)
+    {
+        /* long enough for the workers to stop spinning */
+        uint64_t timeout = get_time_ns() + 20000000ull;
+        while(get_time_ns() < timeout)
+        {
+        }
+
+        /* don't wait for the job, the waiting thread would execute it itself */
+        thread_pool_queue(pool, count_job, &count);
+        timeout = get_time_ns() + 5000000000ull;
+        while(ATOMIC_LOAD(count) == i && get_time_ns() < timeout)
+        {
+        }
+        ASSERT_THAT(count, Eq(i + 1));
+    }
+
+    thread_pool_destroy(pool);
+}
+
+TEST(NAME, counter_waits_only_for_its_own_jobs)
+{
+    struct thread_pool_t* pool = thread_pool_create(2, 0);
+    struct thread_pool_counter_t counter = {0};
+    int release = 0, count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    thread_pool_queue(pool, block_job, &release);
+    for(int i = 0; i != 100; ++i)
+        thread_pool_queue_counted(pool, &counter, count_job, &count);
+    thread_pool_wait_for_counter(pool, &counter);
+    EXPECT_THAT(count, Eq(100));
+    EXPECT_THAT(counter.value, Eq(0));
+
+    /* the blocking job can't have finished */
+    release = 1;
+    thread_pool_wait_for_jobs(pool);
+
+    thread_pool_destroy(pool);
+}
+
+TEST(NAME, waiting_threads_execute_jobs)
+{
+    struct thread_pool_t* pool = thread_pool_create(1, 0);
+    struct thread_pool_counter_t counter = {0};
+    int count = 0;
+    ASSERT_THAT(pool, NotNull());
+
+    /* with the only worker gone, the waiting thread has to do everything */
+    thread_pool_suspend(pool);
+    for(int i = 0; i != 100; ++i)
+        thread_pool_queue_counted(pool, &counter, count_job, &count);
+    thread_pool_wait_for_counter(pool, &counter);
+    EXPECT_THAT(count, Eq(100));
+    EXPECT_THAT(thread_pool_help(pool), Eq(0));
+
+    thread_pool_resume(pool);
+    thread_pool_destroy(pool);
+}
+
+#endif /* ENABLE_THREAD_POOL */
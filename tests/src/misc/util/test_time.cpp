@@ -0,0 +1,53 @@
+#include "gmock/gmock.h"
+#include "util/time.h"
+
+#define NAME time
+
+using namespace testing;
+
+TEST(NAME, time_ns_is_monotonic)
+{
+    uint64_t last = get_time_ns();
+    for(int i = 0; i != 10000; ++i)
+    {
+        uint64_t now = get_time_ns();
+        ASSERT_THAT(now, Ge(last));
+        last = now;
+    }
+}
+
+TEST(NAME, time_in_microseconds_matches_time_ns)
+{
+    uint64_t ns = get_time_ns();
+    int64_t us = get_time_in_microseconds();
+    EXPECT_THAT(us, Ge((int64_t)(ns / 1000)));
+    EXPECT_THAT(us, Lt((int64_t)(ns / 1000) + 100000));
+}
+
+TEST(NAME, cycles_convert_to_elapsed_time)
+{
+    uint64_t start_ns, start_cycles, elapsed_ns, converted_ns;
+
+    cycle_counter_calibrate();
+
+    start_ns = get_time_ns();
+    start_cycles = cycle_counter();
+    while(get_time_ns() - start_ns < 20000000) {}
+    converted_ns = cycles_to_ns(cycle_counter() - start_cycles);
+    elapsed_ns = get_time_ns() - start_ns;
+
+    /* the readings are taken a few ns apart, allow for scheduling noise */
+    EXPECT_THAT(converted_ns, Gt(elapsed_ns * 9 / 10));
+    EXPECT_THAT(converted_ns, Lt(elapsed_ns * 11 / 10));
+}
+
+TEST(NAME, sleep_until_ns_does_not_wake_up_early)
+{
+    uint64_t deadline = get_time_ns() + 5000000;
+    sleep_until_ns(deadline);
+    uint64_t now = get_time_ns();
+    EXPECT_THAT(now, Ge(deadline));
+
+    /* only catches sleeping far too long, a loaded machine can be late */
+    EXPECT_THAT(now, Lt(deadline + 100000000));
+}
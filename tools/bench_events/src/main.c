@@ -0,0 +1,155 @@
+/*!
+ * @file main.c
+ * @brief Measures how long firing a tick event takes when its listeners are
+ * called serially compared to when they are marked thread safe, for an
+ * increasing number of worker threads.
+ *
+ * Usage: lightship_bench_events [iterations] [work per listener]
+ *
+ * Every listener simulates one plugin updating its own state and doesn't
+ * share anything with other listeners.
+ */
+
+#include "framework/game.h"
+#include "framework/plugin.h"
+#include "framework/events.h"
+#include "util/memory.h"
+#include "util/time.h"
+#include "thread_pool/thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LISTENER_COUNT 32
+
+static uint32_t g_work = 20000;
+static volatile uint32_t g_state[LISTENER_COUNT * 16]; /* one cache line per listener */
+
+#define BENCH_LISTENER(n)                                                   \
+	EVENT_LISTENER(on_tick##n)                                              \
+	{                                                                       \
+		uint32_t i, x = g_state[n * 16];                                    \
+		for(i = 0; i != g_work; ++i)                                        \
+			x = x * 1664525u + 1013904223u;                                 \
+		g_state[n * 16] = x;                                                \
+	}
+BENCH_LISTENER(0)  BENCH_LISTENER(1)  BENCH_LISTENER(2)  BENCH_LISTENER(3)
+BENCH_LISTENER(4)  BENCH_LISTENER(5)  BENCH_LISTENER(6)  BENCH_LISTENER(7)
+BENCH_LISTENER(8)  BENCH_LISTENER(9)  BENCH_LISTENER(10) BENCH_LISTENER(11)
+BENCH_LISTENER(12) BENCH_LISTENER(13) BENCH_LISTENER(14) BENCH_LISTENER(15)
+BENCH_LISTENER(16) BENCH_LISTENER(17) BENCH_LISTENER(18) BENCH_LISTENER(19)
+BENCH_LISTENER(20) BENCH_LISTENER(21) BENCH_LISTENER(22) BENCH_LISTENER(23)
+BENCH_LISTENER(24) BENCH_LISTENER(25) BENCH_LISTENER(26) BENCH_LISTENER(27)
+BENCH_LISTENER(28) BENCH_LISTENER(29) BENCH_LISTENER(30) BENCH_LISTENER(31)
+
+static event_callback_func g_listeners[LISTENER_COUNT] = {
+	on_tick0,  on_tick1,  on_tick2,  on_tick3,  on_tick4,  on_tick5,  on_tick6,  on_tick7,
+	on_tick8,  on_tick9,  on_tick10, on_tick11, on_tick12, on_tick13, on_tick14, on_tick15,
+	on_tick16, on_tick17, on_tick18, on_tick19, on_tick20, on_tick21, on_tick22, on_tick23,
+	on_tick24, on_tick25, on_tick26, on_tick27, on_tick28, on_tick29, on_tick30, on_tick31
+};
+
+/* ------------------------------------------------------------------------- */
+static double
+measure(struct event_t* tick, uint32_t iterations)
+{
+	int64_t start;
+	uint32_t i;
+
+	start = get_time_in_microseconds();
+	for(i = 0; i != iterations; ++i)
+		EVENT_FIRE0(tick);
+	return (double)(get_time_in_microseconds() - start) / iterations;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+register_listeners(struct game_t* game, struct event_t* tick, uint32_t flags)
+{
+	int i;
+	event_unregister_all_listeners(tick);
+	for(i = 0; i != LISTENER_COUNT; ++i)
+		event_register_listener_ex(game, "bench.tick", g_listeners[i], flags);
+}
+
+/* ------------------------------------------------------------------------- */
+int
+main(int argc, char** argv)
+{
+	struct game_t* game;
+	struct plugin_t* plugin;
+	struct event_t* tick;
+	uint32_t iterations = 200;
+	double serial_us;
+
+	if(argc > 1)
+		iterations = (uint32_t)atoi(argv[1]);
+	if(argc > 2)
+		g_work = (uint32_t)atoi(argv[2]);
+	if(!iterations)
+		iterations = 1;
+
+	memory_init();
+	game_init();
+
+	for(;;)
+	{
+		if(!(game = game_create("bench", NULL, GAME_CLIENT)))
+			break;
+		if(!(plugin = plugin_create(game, "bench", "bench", "bench", "bench", "bench")))
+		{
+			game_destroy(game);
+			break;
+		}
+		EVENT_CREATE0(plugin, tick, "bench.tick");
+		if(!tick)
+		{
+			plugin_destroy(plugin);
+			game_destroy(game);
+			break;
+		}
+
+		printf("%d listeners, %u iterations, %u work per listener\n",
+			   LISTENER_COUNT, iterations, g_work);
+
+		register_listeners(game, tick, EVENT_LISTENER_DEFAULT);
+		serial_us = measure(tick, iterations);
+		printf("serial:                %7.1f us/tick\n", serial_us);
+
+#ifdef ENABLE_THREAD_POOL
+		register_listeners(game, tick, EVENT_LISTENER_THREAD_SAFE);
+		{
+			uint32_t threads, cores = get_number_of_cores();
+			for(threads = 1; ; threads *= 2)
+			{
+				double parallel_us;
+
+				/* 1, 2, 4, ... and finally the number of cores */
+				if(threads > cores)
+					threads = cores;
+
+				/* swap the game's pool for one with the requested size */
+				thread_pool_wait_for_jobs(game->thread_pool);
+				thread_pool_destroy(game->thread_pool);
+				game->thread_pool = thread_pool_create(threads, 0);
+
+				parallel_us = measure(tick, iterations);
+				printf("parallel, %3u threads: %7.1f us/tick (%.2fx)\n",
+					   threads, parallel_us, serial_us / parallel_us);
+
+				if(threads == cores)
+					break;
+			}
+		}
+#else
+		printf("built without ENABLE_THREAD_POOL, thread safe listeners are called serially\n");
+#endif
+
+		plugin_destroy(plugin);
+		game_destroy(game);
+		break;
+	}
+
+	game_deinit();
+	memory_deinit();
+	return 0;
+}
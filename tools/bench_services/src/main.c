@@ -0,0 +1,117 @@
+/*!
+ * @file main.c
+ * @brief Measures the cost of calling a service with five arguments through
+ * SERVICE_CALL5(), which boxes the arguments into a void* vector, compared to
+ * SERVICE_CALL_TYPED5(), which calls the service's native entry point.
+ *
+ * Usage: lightship_bench_services [iterations]
+ */
+
+#include "framework/game.h"
+#include "framework/plugin.h"
+#include "framework/services.h"
+#include "util/memory.h"
+#include "util/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+SERVICE_TYPED_DECLARE5(bench_add, int, VAL, int, VAL, int, VAL, int, VAL, int, VAL, int);
+SERVICE_TYPED_ADAPTER5(bench_add, int, VAL, int, VAL, int, VAL, int, VAL, int, VAL, int)
+int
+bench_add(struct service_t* service, int a, int b, int c, int d, int e)
+{
+	return a + b + c + d + e;
+}
+
+/* ------------------------------------------------------------------------- */
+static double
+measure_boxed(struct service_t* service, uint32_t iterations, int* result)
+{
+	int64_t start;
+	int ret, sum = 0;
+	uint32_t i;
+
+	start = get_time_in_microseconds();
+	for(i = 0; i != iterations; ++i)
+	{
+		int a = (int)i;
+		int b = 1, c = 2, d = 3, e = 4;
+		SERVICE_CALL5(service, &ret, a, b, c, d, e);
+		sum += ret;
+	}
+	*result = sum;
+	return (double)(get_time_in_microseconds() - start) * 1000.0 / iterations;
+}
+
+/* ------------------------------------------------------------------------- */
+static double
+measure_typed(struct service_t* service, uint32_t iterations, int* result)
+{
+	int64_t start;
+	int sum = 0;
+	uint32_t i;
+
+	start = get_time_in_microseconds();
+	for(i = 0; i != iterations; ++i)
+		sum += SERVICE_CALL_TYPED5(bench_add, service, (int)i, 1, 2, 3, 4);
+	*result = sum;
+	return (double)(get_time_in_microseconds() - start) * 1000.0 / iterations;
+}
+
+/* ------------------------------------------------------------------------- */
+int
+main(int argc, char** argv)
+{
+	struct game_t* game;
+	struct plugin_t* plugin;
+	struct service_t* service;
+	uint32_t iterations = 10000000;
+	double boxed_ns, typed_ns;
+	int boxed_result, typed_result;
+
+	if(argc > 1)
+		iterations = (uint32_t)atoi(argv[1]);
+	if(!iterations)
+		iterations = 1;
+
+	memory_init();
+	game_init();
+
+	for(;;)
+	{
+		if(!(game = game_create("bench", NULL, GAME_CLIENT)))
+			break;
+		if(!(plugin = plugin_create(game, "bench", "bench", "bench", "bench", "bench")))
+		{
+			game_destroy(game);
+			break;
+		}
+		SERVICE_CREATE_TYPED5(plugin, service, "bench.add", bench_add,
+							  int, VAL, int, VAL, int, VAL, int, VAL, int, VAL, int);
+		if(!service)
+		{
+			plugin_destroy(plugin);
+			game_destroy(game);
+			break;
+		}
+
+		printf("%u iterations\n", iterations);
+
+		boxed_ns = measure_boxed(service, iterations, &boxed_result);
+		printf("SERVICE_CALL5:       %6.2f ns/call\n", boxed_ns);
+		typed_ns = measure_typed(service, iterations, &typed_result);
+		printf("SERVICE_CALL_TYPED5: %6.2f ns/call (%.2fx)\n",
+			   typed_ns, boxed_ns / typed_ns);
+
+		if(boxed_result != typed_result)
+			printf("results differ: %d != %d\n", boxed_result, typed_result);
+
+		plugin_destroy(plugin);
+		game_destroy(game);
+		break;
+	}
+
+	game_deinit();
+	memory_deinit();
+	return 0;
+}
@@ -0,0 +1,276 @@
+/*!
+ * @file main.c
+ * @brief Measures how long the thread pool takes to run workloads of
+ * different job sizes, for an increasing number of worker threads.
+ *
+ * Usage: lightship_bench_thread_pool [jobs]
+ *
+ * The workloads are the ones from thread_test.c: Empty jobs and jobs
+ * spinning for 10 to 100,000 iterations, all queued from the main thread,
+ * a mix of those sizes, jobs which queue more jobs from inside the pool and
+ * one job per pixel of a Mandelbrot set, where the cost of a job depends on
+ * how quickly its pixel escapes. The same Mandelbrot set and a sum over it
+ * are also computed with thread_pool_parallel_for() and
+ * thread_pool_parallel_reduce().
+ *
+ * The speedup of every workload is relative to the pool with 1 thread.
+ *
+ * Finally, the time from queuing a job to the job starting is measured,
+ * once with jobs queued back to back and once with the pool idle long
+ * enough for its workers to go to sleep.
+ */
+
+#include "thread_pool/thread_pool.h"
+#include "thread_pool/parallel_for.h"
+#include "util/memory.h"
+#include "util/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#ifdef ENABLE_THREAD_POOL
+
+#define MANDEL_WIDTH 256
+#define MANDEL_HEIGHT 256
+#define MANDEL_MAX_ITERATIONS 512
+
+/* grain of the parallel loops, a row of pixels */
+#define MANDEL_GRAIN MANDEL_WIDTH
+
+#define WORKLOAD_COUNT 11
+
+#define LATENCY_SAMPLES 1000
+
+static struct thread_pool_t* g_pool;
+static uint32_t g_pixels[MANDEL_WIDTH * MANDEL_HEIGHT];
+static uint64_t g_single_thread_ns[WORKLOAD_COUNT];
+static uint64_t g_latency_ns[LATENCY_SAMPLES];
+static volatile uint64_t g_started_ns;
+
+static void work_empty(void* p) { (void)p; }
+static void work1(void* p) { volatile int i; for(i = 0; i != 10; ++i) {} }
+static void work2(void* p) { volatile int i; for(i = 0; i != 100; ++i) {} }
+static void work3(void* p) { volatile int i; for(i = 0; i != 1000; ++i) {} }
+static void work4(void* p) { volatile int i; for(i = 0; i != 10000; ++i) {} }
+static void work5(void* p) { volatile int i; for(i = 0; i != 100000; ++i) {} }
+
+static thread_pool_job_func g_mixed[] = {
+	work1, work2, work1, work3, work1, work2, work4, work1,
+	work2, work1, work3, work2, work1, work2, work1, work5
+};
+
+/* ------------------------------------------------------------------------- */
+static void
+work_recurse(void* p)
+{
+	/* every job queues 10 more, down to the depth passed in */
+	intptr_t i, depth = (intptr_t)p;
+	if(!depth)
+		return;
+	for(i = 0; i != 10; ++i)
+		thread_pool_queue(g_pool, work_recurse, (void*)(depth - 1));
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+work_mandel(void* p)
+{
+	intptr_t pixel = (intptr_t)p;
+	double pr, pi, re = 0, im = 0, tmp;
+	int i;
+
+	pr = 3.0 * (pixel % MANDEL_WIDTH) / MANDEL_WIDTH - 2.0;
+	pi = 2.0 * (pixel / MANDEL_WIDTH) / MANDEL_HEIGHT - 1.0;
+	for(i = 0; i != MANDEL_MAX_ITERATIONS && re * re + im * im <= 4.0; ++i)
+	{
+		tmp = re * re - im * im + pr;
+		im = 2 * re * im + pi;
+		re = tmp;
+	}
+	g_pixels[pixel] = (uint32_t)i;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+mandel_range(uint32_t begin, uint32_t end, void* user)
+{
+	uint32_t pixel;
+	for(pixel = begin; pixel != end; ++pixel)
+		work_mandel((void*)(intptr_t)pixel);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+mandel_sum(uint32_t begin, uint32_t end, void* partial, void* user)
+{
+	uint32_t pixel;
+	for(pixel = begin; pixel != end; ++pixel)
+	{
+		work_mandel((void*)(intptr_t)pixel);
+		*(uint64_t*)partial += g_pixels[pixel];
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+join_sum(void* result, const void* partial, void* user)
+{
+	*(uint64_t*)result += *(const uint64_t*)partial;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+work_timestamp(void* p)
+{
+	g_started_ns = get_time_ns();
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+compare_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+measure_latency(const char* name, uint32_t threads, uint64_t idle_ns)
+{
+	uint64_t queued, until;
+	int i;
+
+	for(i = 0; i != LATENCY_SAMPLES; ++i)
+	{
+		/* give workers time to go to sleep */
+		until = get_time_ns() + idle_ns;
+		while(get_time_ns() < until)
+			sched_yield();
+
+		/* don't wait for the job, the waiting thread would run it itself */
+		g_started_ns = 0;
+		queued = get_time_ns();
+		thread_pool_queue(g_pool, work_timestamp, NULL);
+		while(!g_started_ns)
+			sched_yield();
+		g_latency_ns[i] = g_started_ns - queued;
+	}
+
+	qsort(g_latency_ns, LATENCY_SAMPLES, sizeof(*g_latency_ns), compare_u64);
+	printf("%-9s %3u threads: median %8.1f us, p99 %8.1f us\n",
+		   name, threads,
+		   g_latency_ns[LATENCY_SAMPLES / 2] / 1e3,
+		   g_latency_ns[LATENCY_SAMPLES * 99 / 100] / 1e3);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+run_flat(thread_pool_job_func func, uint32_t jobs)
+{
+	uint32_t i;
+	for(i = 0; i != jobs; ++i)
+		thread_pool_queue(g_pool, func, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+report(int workload, const char* name, uint32_t threads, uint32_t jobs, uint64_t start_ns)
+{
+	uint64_t elapsed = get_time_ns() - start_ns;
+	if(threads == 1)
+		g_single_thread_ns[workload] = elapsed;
+	printf("%-9s %3u threads: %9.1f ms, %8.1f ns/job, %5.2fx\n",
+		   name, threads, elapsed / 1e6, (double)elapsed / jobs,
+		   (double)g_single_thread_ns[workload] / elapsed);
+}
+
+/* ------------------------------------------------------------------------- */
+int
+main(int argc, char** argv)
+{
+	uint32_t jobs = 100000, threads, cores, i;
+	uint64_t start, total, zero = 0;
+
+	if(argc > 1)
+		jobs = (uint32_t)atoi(argv[1]);
+	if(!jobs)
+		jobs = 1;
+
+	memory_init();
+
+	/* large enough for every job of a workload to be queued at once */
+	thread_pool_set_max_buffer_size(0x4000000);
+
+	cores = get_number_of_cores();
+	for(threads = 1; ; threads *= 2)
+	{
+		/* 1, 2, 4, ... and finally the number of cores */
+		if(threads > cores)
+			threads = cores;
+		if(!(g_pool = thread_pool_create(threads, 0)))
+			break;
+
+#define BENCH_FLAT(workload, name, func, count)                             \
+		start = get_time_ns();                                              \
+		run_flat(func, count);                                              \
+		thread_pool_wait_for_jobs(g_pool);                                  \
+		report(workload, name, threads, count, start);
+
+		BENCH_FLAT(0, "empty", work_empty, jobs)
+		BENCH_FLAT(1, "work1", work1, jobs)
+		BENCH_FLAT(2, "work2", work2, jobs)
+		BENCH_FLAT(3, "work3", work3, jobs)
+		BENCH_FLAT(4, "work4", work4, jobs / 10)
+		BENCH_FLAT(5, "work5", work5, jobs / 100)
+#undef BENCH_FLAT
+
+		start = get_time_ns();
+		for(i = 0; i != jobs; ++i)
+			thread_pool_queue(g_pool, g_mixed[i % (sizeof(g_mixed) / sizeof(*g_mixed))], NULL);
+		thread_pool_wait_for_jobs(g_pool);
+		report(6, "mixed", threads, jobs, start);
+
+		/* 1 + 10 + 100 + ... + 100,000 jobs */
+		start = get_time_ns();
+		thread_pool_queue(g_pool, work_recurse, (void*)5);
+		thread_pool_wait_for_jobs(g_pool);
+		report(7, "recurse", threads, 111111, start);
+
+		start = get_time_ns();
+		for(i = 0; i != MANDEL_WIDTH * MANDEL_HEIGHT; ++i)
+			thread_pool_queue(g_pool, work_mandel, (void*)(intptr_t)i);
+		thread_pool_wait_for_jobs(g_pool);
+		report(8, "mandel", threads, MANDEL_WIDTH * MANDEL_HEIGHT, start);
+
+		start = get_time_ns();
+		thread_pool_parallel_for(g_pool, 0, MANDEL_WIDTH * MANDEL_HEIGHT, MANDEL_GRAIN, mandel_range, NULL);
+		report(9, "mandel_pf", threads, MANDEL_WIDTH * MANDEL_HEIGHT, start);
+
+		start = get_time_ns();
+		thread_pool_parallel_reduce(g_pool, 0, MANDEL_WIDTH * MANDEL_HEIGHT, MANDEL_GRAIN,
+									&zero, &total, sizeof(total), mandel_sum, join_sum, NULL);
+		report(10, "mandel_pr", threads, MANDEL_WIDTH * MANDEL_HEIGHT, start);
+
+		measure_latency("busy", threads, 0);
+		measure_latency("idle", threads, 1000000);
+
+		thread_pool_destroy(g_pool);
+		if(threads == cores)
+			break;
+	}
+
+	memory_deinit();
+
+	return 0;
+}
+
+#else /* ENABLE_THREAD_POOL */
+
+int
+main(int argc, char** argv)
+{
+	puts("lightship_util was built without ENABLE_THREAD_POOL");
+	return 0;
+}
+
+#endif /* ENABLE_THREAD_POOL */
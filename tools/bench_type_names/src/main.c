@@ -0,0 +1,81 @@
+/*!
+ * @file main.c
+ * @brief Measures the cost of parsing type names with
+ * dynamic_call_get_type_from_string() and of creating type infos the way
+ * SERVICE_CREATEn() does, for a mix of spellings found in the plugins.
+ *
+ * Usage: lightship_bench_type_names [iterations]
+ */
+
+#include "util/dynamic_call.h"
+#include "util/memory.h"
+#include "util/time.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char* g_spellings[] = {
+	"void", "int", "uint32_t", "float", "const char*", "double", "uint16_t",
+	"char", "unsigned int", "int32_t", "uintptr_t", "const wchar_t*",
+	"wchar_t*", "unsigned char*", "struct vec2_t*", "int32"
+};
+#define SPELLING_COUNT (sizeof(g_spellings) / sizeof(*g_spellings))
+
+/* ------------------------------------------------------------------------- */
+static double
+measure_parse(uint32_t iterations, uint32_t* checksum)
+{
+	int64_t start;
+	uint32_t i, sum = 0;
+
+	start = get_time_in_microseconds();
+	for(i = 0; i != iterations; ++i)
+		sum += (uint32_t)dynamic_call_get_type_from_string(g_spellings[i % SPELLING_COUNT]);
+	*checksum = sum;
+	return (double)(get_time_in_microseconds() - start) * 1000.0 / iterations;
+}
+
+/* ------------------------------------------------------------------------- */
+static double
+measure_create_type_info(uint32_t iterations)
+{
+	int64_t start;
+	uint32_t i;
+
+	start = get_time_in_microseconds();
+	for(i = 0; i != iterations; ++i)
+	{
+		const char* argv[3];
+		struct type_info_t* type_info;
+		argv[0] = g_spellings[(i + 1) % SPELLING_COUNT];
+		argv[1] = g_spellings[(i + 2) % SPELLING_COUNT];
+		argv[2] = g_spellings[(i + 3) % SPELLING_COUNT];
+		if((type_info = dynamic_call_create_type_info(g_spellings[i % SPELLING_COUNT], 3, argv)))
+			dynamic_call_destroy_type_info(type_info);
+	}
+	return (double)(get_time_in_microseconds() - start) * 1000.0 / iterations;
+}
+
+/* ------------------------------------------------------------------------- */
+int
+main(int argc, char** argv)
+{
+	uint32_t iterations = 10000000;
+	uint32_t checksum;
+
+	if(argc > 1)
+		iterations = (uint32_t)atoi(argv[1]);
+	if(!iterations)
+		iterations = 1;
+
+	memory_init();
+
+	printf("%u iterations\n", iterations);
+	printf("dynamic_call_get_type_from_string(): %6.2f ns/call\n",
+		   measure_parse(iterations, &checksum));
+	printf("create and destroy type info (3 args): %6.2f ns/call\n",
+		   measure_create_type_info(iterations / 10 ? iterations / 10 : 1));
+	printf("checksum: %u\n", checksum);
+
+	memory_deinit();
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*!
+ * @file main.c
+ * @brief Command line tool for creating pack files, see util/pack.h
+ *
+ * Usage: lightship_pack [-z] <output.pak> <file> [file...]
+ *
+ * Files are stored under the name they were passed with, so run the tool from
+ * the directory the game is started from, e.g.
+ *   lightship_pack -z data.pak fx/sprite.vsh fx/sprite.fsh ttf/DejaVuSans.ttf
+ */
+
+#include "util/pack.h"
+#include "util/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+static void
+print_usage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-z] <output.pak> <file> [file...]\n", program);
+	fprintf(stderr, "  -z  compress entries where it makes them smaller\n");
+}
+
+/* ------------------------------------------------------------------------- */
+int
+main(int argc, char** argv)
+{
+	char compress = 0;
+	int arg = 1;
+	char success;
+
+	if(arg < argc && strcmp(argv[arg], "-z") == 0)
+	{
+		compress = 1;
+		++arg;
+	}
+
+	/* need an output file and at least one input file */
+	if(argc - arg < 2)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	memory_init();
+	success = pack_write(argv[arg],
+						 (uint32_t)(argc - arg - 1),
+						 (const char**)&argv[arg + 1],
+						 NULL,
+						 compress);
+	memory_deinit();
+
+	if(!success)
+	{
+		fprintf(stderr, "Failed to write pack file \"%s\"\n", argv[arg]);
+		return 1;
+	}
+
+	printf("Wrote %d entries to \"%s\"\n", argc - arg - 1, argv[arg]);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*!
+ * @file parallel_for.h
+ * @brief Splits loops over a range of indices into jobs on a thread pool.
+ *
+ * The range is split recursively: The calling thread halves its range and
+ * queues the upper half whenever no other job is queued in the pool, which
+ * means some thread is looking for work. Otherwise it processes the next
+ * grain of its own range. Jobs split their ranges the same way, so a range
+ * is only divided into as many pieces as there are threads taking them,
+ * and the pieces get smaller as the range runs out.
+ *
+ * Ranges no larger than one grain are processed on the calling thread
+ * without involving the pool. Without ENABLE_THREAD_POOL, the whole range is
+ * processed on the calling thread.
+ */
+
+#ifndef LIGHTSHIP_UTIL_PARALLEL_FOR_H
+#define LIGHTSHIP_UTIL_PARALLEL_FOR_H
+
+#include "thread_pool/thread_pool.h"
+
+C_HEADER_BEGIN
+
+/*!
+ * @brief Processes the indices begin to end - 1.
+ */
+typedef void (*parallel_for_func)(uint32_t begin, uint32_t end, void* user);
+
+/*!
+ * @brief Processes the indices begin to end - 1 and accumulates into partial.
+ */
+typedef void (*parallel_reduce_func)(uint32_t begin, uint32_t end, void* partial, void* user);
+
+/*!
+ * @brief Combines two partial results, storing the combination in result.
+ * Partial results are joined in no particular order, so the operation must
+ * be associative and commutative.
+ */
+typedef void (*parallel_join_func)(void* result, const void* partial, void* user);
+
+/*!
+ * @brief Calls func for consecutive sub-ranges of [begin, end) on the pool
+ * and returns when all of them have been processed.
+ * @param grain The smallest number of indices worth a job of its own. 0 is
+ * treated as 1.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+thread_pool_parallel_for(struct thread_pool_t* pool,
+						 uint32_t begin,
+						 uint32_t end,
+						 uint32_t grain,
+						 parallel_for_func func,
+						 void* user);
+
+/*!
+ * @brief Like thread_pool_parallel_for(), but every sub-range accumulates
+ * into a partial result and the partial results are joined into one.
+ * @param[in] identity A partial result every piece starts with, e.g. 0 for
+ * sums.
+ * @param[out] result Receives the joined result.
+ * @param size The size of a result in bytes.
+ * @note If memory for more partial results can't be allocated, the range is
+ * split less.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+thread_pool_parallel_reduce(struct thread_pool_t* pool,
+							uint32_t begin,
+							uint32_t end,
+							uint32_t grain,
+							const void* identity,
+							void* result,
+							uint32_t size,
+							parallel_reduce_func func,
+							parallel_join_func join,
+							void* user);
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_PARALLEL_FOR_H */
@@ -0,0 +1,124 @@
+/*!
+ * @file task_graph.h
+ * @brief Runs groups of jobs with dependencies between them on a thread
+ * pool.
+ *
+ * A task graph is built once and can then be run any number of times:
+ * ```
+ * struct task_graph_t* graph = task_graph_create(pool);
+ * struct task_t* load = task_graph_add(graph, load_func, data);
+ * struct task_t* parse = task_then(graph, load, parse_func, data);
+ * task_graph_run(graph);
+ * ```
+ * Running a graph queues every task without prerequisites. Whenever a task
+ * returns, the tasks depending on it whose last prerequisite that was are
+ * queued in turn. Tasks can't be added or linked while the graph is running.
+ *
+ * Waiting for a graph only waits for its own tasks, and the waiting thread
+ * executes queued jobs until they are done, so a task may run and wait for
+ * another graph.
+ *
+ * Without ENABLE_THREAD_POOL, tasks are executed on the thread running the
+ * graph, still in an order satisfying all dependencies.
+ */
+
+#ifndef LIGHTSHIP_UTIL_TASK_GRAPH_H
+#define LIGHTSHIP_UTIL_TASK_GRAPH_H
+
+#include "thread_pool/thread_pool.h"
+#include "util/unordered_vector.h"
+
+C_HEADER_BEGIN
+
+struct task_graph_t;
+
+struct task_t
+{
+	struct task_graph_t* graph;
+	thread_pool_job_func func;
+	void* data;
+	int prerequisite_count;         /* number of tasks this task depends on */
+	int remaining;                  /* unfinished prerequisites in the current run - use atomics to modify */
+	struct unordered_vector_t successors; /* struct task_t*, tasks depending on this one */
+};
+
+struct task_graph_t
+{
+	struct thread_pool_t* pool;
+	struct unordered_vector_t tasks;  /* struct task_t* */
+	struct thread_pool_counter_t counter; /* tasks queued and not yet finished */
+	int executed;                   /* tasks finished in the current run - use atomics to modify */
+};
+
+/*!
+ * @brief Creates an empty task graph.
+ * @param pool The pool to execute tasks on.
+ * @return Returns NULL if memory couldn't be allocated.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API struct task_graph_t*
+task_graph_create(struct thread_pool_t* pool);
+
+/*!
+ * @brief Destroys a graph and all of its tasks. The graph must not be
+ * running.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+task_graph_destroy(struct task_graph_t* graph);
+
+/*!
+ * @brief Adds a task without any dependencies to the graph.
+ * @return Returns a handle the task can be linked to other tasks with, or
+ * NULL if memory couldn't be allocated. The handle is valid until the graph
+ * is destroyed.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API struct task_t*
+task_graph_add(struct task_graph_t* graph, thread_pool_job_func func, void* data);
+
+/*!
+ * @brief Makes a task wait for another task to finish before it starts.
+ * @param task The task depending on the prerequisite.
+ * @param prerequisite The task to execute first. Must belong to the same
+ * graph.
+ * @return Returns 0 if memory couldn't be allocated or the tasks belong to
+ * different graphs, 1 if otherwise.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+task_depends_on(struct task_t* task, struct task_t* prerequisite);
+
+/*!
+ * @brief Adds a continuation, a task which starts after another task has
+ * finished.
+ * @return Returns the continuation, or NULL if memory couldn't be allocated.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API struct task_t*
+task_then(struct task_graph_t* graph,
+		  struct task_t* task,
+		  thread_pool_job_func func,
+		  void* data);
+
+/*!
+ * @brief Queues all tasks without prerequisites and returns. The graph must
+ * not already be running.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+task_graph_dispatch(struct task_graph_t* graph);
+
+/*!
+ * @brief Waits for a dispatched graph to finish, executing queued jobs in
+ * the meantime.
+ * @return Returns 0 if some tasks didn't run because their dependencies form
+ * a cycle, 1 if otherwise.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+task_graph_wait(struct task_graph_t* graph);
+
+/*!
+ * @brief Dispatches a graph and waits for it to finish.
+ * @return See task_graph_wait().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+task_graph_run(struct task_graph_t* graph);
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_TASK_GRAPH_H */
@@ -1,10 +1,24 @@
+#ifndef LIGHTSHIP_UTIL_THREAD_POOL_H
+#define LIGHTSHIP_UTIL_THREAD_POOL_H
+
 #include "util/pstdint.h"
 #include "util/config.h"
 
+C_HEADER_BEGIN
+
 struct thread_pool_t;
 
 typedef void (*thread_pool_job_func)(void*);
 
+/*!
+ * @brief Counts the unfinished jobs of a group, so a thread can wait for
+ * that group instead of for every job in the pool. Initialise with {0}.
+ */
+struct thread_pool_counter_t
+{
+	int value;                  /* number of unfinished jobs - use atomics to modify */
+};
+
 #ifdef ENABLE_THREAD_POOL
 
 LIGHTSHIP_UTIL_PUBLIC_API uint32_t
@@ -22,32 +36,80 @@ thread_pool_destroy(struct thread_pool_t* pool);
 LIGHTSHIP_UTIL_PUBLIC_API void
 thread_pool_queue(struct thread_pool_t* pool, thread_pool_job_func func, void* data);
 
+/*!
+ * @brief Queues a job and adds it to the group counted by the counter.
+ * @param counter Incremented before the job is queued and decremented after
+ * the job has returned. Can be NULL.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+thread_pool_queue_counted(struct thread_pool_t* pool,
+						  struct thread_pool_counter_t* counter,
+						  thread_pool_job_func func,
+						  void* data);
+
 LIGHTSHIP_UTIL_PUBLIC_API void
 thread_pool_suspend(struct thread_pool_t* pool);
 
 LIGHTSHIP_UTIL_PUBLIC_API void
 thread_pool_resume(struct thread_pool_t* pool);
 
+/*!
+ * @brief Waits for every job in the pool to finish. The calling thread
+ * executes queued jobs while it waits.
+ */
 LIGHTSHIP_UTIL_PUBLIC_API void
 thread_pool_wait_for_jobs(struct thread_pool_t* pool);
 
+/*!
+ * @brief Waits for every job of the group counted by the counter to finish.
+ * The calling thread executes queued jobs while it waits, so this can be
+ * called from within a job.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+thread_pool_wait_for_counter(struct thread_pool_t* pool,
+							 struct thread_pool_counter_t* counter);
+
+/*!
+ * @brief Returns the number of jobs queued and not yet taken by any thread.
+ * If it's 0, splitting work into more jobs may keep idle threads busy.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint32_t
+thread_pool_queued_jobs(struct thread_pool_t* pool);
+
+/*!
+ * @brief Executes one queued job on the calling thread.
+ * @return Returns 0 if no job was queued, 1 if otherwise.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+thread_pool_help(struct thread_pool_t* pool);
+
 #else /* ENABLE_THREAD_POOL */
 	/* return 1 for single threaded */
 #   define get_number_of_cores() 1
 	/* nop */
 #   define thread_pool_set_max_buffer_size(maximum_buffer_size)
 	/* must return a non-zero value for success */
-#   define thread_pool_create(num_threads, buffer_size_in_bytes) (struct thread_pool_t*) 1;
+#   define thread_pool_create(num_threads, buffer_size_in_bytes) (struct thread_pool_t*) 1
 	/* nop */
 #   define thread_pool_destroy(pool)
 	/* directly call the job being queued */
 #   define thread_pool_queue(pool, func, data) do { \
 						thread_pool_job_func f = func; \
 						f(data); } while(0)
+#   define thread_pool_queue_counted(pool, counter, func, data) \
+						thread_pool_queue(pool, func, data)
 	/* nop */
 #   define thread_pool_suspend(pool)
 	/* nop */
 #   define thread_pool_resume(pool)
 	/* no need to wait for jobs, nop */
 #   define thread_pool_wait_for_jobs(pool)
+#   define thread_pool_wait_for_counter(pool, counter)
+	/* there are never any queued jobs */
+#   define thread_pool_queued_jobs(pool) 0
+#   define thread_pool_help(pool) ((char)0)
 #endif /* ENABLE_THREAD_POOL */
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_THREAD_POOL_H */
@@ -0,0 +1,63 @@
+#ifndef LIGHTSHIP_UTIL_ATOMIC_H
+#define LIGHTSHIP_UTIL_ATOMIC_H
+
+#include "util/config.h"
+
+/*
+ * Atomic operations on variables shared between threads. All of them take
+ * the variable itself, not its address.
+ *
+ * ATOMIC_LOAD/ATOMIC_STORE/ATOMIC_CAS are full barriers. ATOMIC_PUBLISH is a
+ * release store, use it when writes only need to be visible before the value
+ * being stored, and ATOMIC_LOAD_ACQUIRE is the load pairing with it. Both
+ * fall back to full barriers where the compiler lacks the __atomic builtins.
+ * ATOMIC_INCREMENT and ATOMIC_DECREMENT return the new value. The result of
+ * ATOMIC_ADD differs between the two configurations and shouldn't be used.
+ *
+ * Without multithreading everything runs on one thread and these are plain
+ * accesses. The spinlocks disappear entirely.
+ */
+#ifdef ENABLE_MULTITHREADING
+#   if defined(_MSC_VER)
+#       define THREAD_LOCAL __declspec(thread)
+#   else
+#       define THREAD_LOCAL __thread
+#   endif
+#   define ATOMIC_LOAD(x) __sync_fetch_and_add(&(x), 0)
+#   define ATOMIC_LOAD_PTR(x) __sync_val_compare_and_swap(&(x), NULL, NULL)
+#   define ATOMIC_STORE(x, value) do { __sync_synchronize(); (x) = (value); __sync_synchronize(); } while(0)
+#   if defined(__ATOMIC_RELEASE)
+#       define ATOMIC_PUBLISH(x, value) __atomic_store_n(&(x), value, __ATOMIC_RELEASE)
+#       define ATOMIC_LOAD_ACQUIRE(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#   else
+#       define ATOMIC_PUBLISH(x, value) do { __sync_synchronize(); (x) = (value); } while(0)
+#       define ATOMIC_LOAD_ACQUIRE(x) __sync_fetch_and_add(&(x), 0)
+#   endif
+#   define ATOMIC_ADD(x, value) __sync_fetch_and_add(&(x), value)
+#   define ATOMIC_INCREMENT(x) __sync_add_and_fetch(&(x), 1)
+#   define ATOMIC_DECREMENT(x) __sync_sub_and_fetch(&(x), 1)
+#   define ATOMIC_CAS(x, expected, value) __sync_bool_compare_and_swap(&(x), expected, value)
+#   define SPIN_LOCK(x) while(__sync_lock_test_and_set(&(x), 1)) {}
+#   define SPIN_UNLOCK(x) __sync_lock_release(&(x))
+#   if defined(__i386__) || defined(__x86_64__)
+#       define CPU_RELAX() __builtin_ia32_pause()
+#   else
+#       define CPU_RELAX() __sync_synchronize()
+#   endif
+#else
+#   define THREAD_LOCAL
+#   define ATOMIC_LOAD(x) (x)
+#   define ATOMIC_LOAD_PTR(x) (x)
+#   define ATOMIC_STORE(x, value) do { (x) = (value); } while(0)
+#   define ATOMIC_PUBLISH(x, value) do { (x) = (value); } while(0)
+#   define ATOMIC_LOAD_ACQUIRE(x) (x)
+#   define ATOMIC_ADD(x, value) ((x) += (value))
+#   define ATOMIC_INCREMENT(x) (++(x))
+#   define ATOMIC_DECREMENT(x) (--(x))
+#   define ATOMIC_CAS(x, expected, value) ((x) == (expected) ? ((x) = (value), 1) : 0)
+#   define SPIN_LOCK(x)
+#   define SPIN_UNLOCK(x)
+#   define CPU_RELAX()
+#endif
+
+#endif /* LIGHTSHIP_UTIL_ATOMIC_H */
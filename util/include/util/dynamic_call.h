@@ -150,6 +150,16 @@ typedef enum type_e
 	TYPE_WSTRING
 } type_e;
 
+/*!
+ * @brief Describes the signature of a function.
+ *
+ * Type info objects are interned. Every distinct signature exists exactly
+ * once, and creating a type info with a signature that already exists
+ * returns the existing object with its reference count incremented. Type
+ * infos with the same signature can therefore be compared with
+ * dynamic_call_type_info_equal(), which is a single pointer compare. The
+ * objects are shared and must not be modified.
+ */
 struct type_info_t
 {
 	type_e* argv_type;          /* argument types */
@@ -158,6 +168,12 @@ struct type_info_t
 	char has_unknown_types;     /* stores whether or not any of the arguments
 								 * or return type are unknown after being
 								 * parsed */
+	uint32_t hash;              /* hash of the signature */
+	uint32_t refcount;
+	struct type_info_t* next_interned; /* next object with the same hash */
+	void* argv_pool;            /* free argument vector blocks of this signature */
+	uint32_t argv_pool_count;
+	int argv_pool_lock;         /* use atomics */
 };
 
 /*!
@@ -178,6 +194,9 @@ struct type_info_t
  * @param argc The number of argument types.
  * @param argv An array of stringified argument types.
  * @note The number of strings in argv must equal ```argc```.
+ * @note If an object with the same signature exists, it is returned instead
+ * of creating a new one. Either way, it must be released with
+ * dynamic_call_destroy_type_info().
  */
 LIGHTSHIP_UTIL_PUBLIC_API struct type_info_t*
 dynamic_call_create_type_info(const char* ret_type,
@@ -185,7 +204,9 @@ dynamic_call_create_type_info(const char* ret_type,
 							  const char** argv);
 
 /*!
- * @brief Destroys a previously created type info object.
+ * @brief Releases a type info object previously returned by
+ * dynamic_call_create_type_info(). It is destroyed once every creator
+ * released it.
  * @param type_info The type info object to destroy.
  */
 LIGHTSHIP_UTIL_PUBLIC_API void
@@ -197,6 +218,11 @@ dynamic_call_destroy_type_info(struct type_info_t* type_info);
  * @param type_info The type information to use in order to deduce the types of
  * the variadic arguments.
  *
+ * The pointers, the values and copies of the strings are stored in a single
+ * block. Blocks are recycled through a small pool kept by the type info, so
+ * creating and destroying an argument vector usually doesn't allocate at
+ * all, and never more than once.
+ *
  * The types of the arguments passed to this variadic function are deduced
  * according to what the type_info object specifies. The arguments are inserted
  * into the returned argument vector accordingly.
@@ -222,6 +248,34 @@ LIGHTSHIP_UTIL_PUBLIC_API void**
 vdynamic_call_create_argument_vector_from_varargs(
 		const struct type_info_t* type_info, va_list ap);
 
+/*!
+ * @brief Same as dynamic_call_create_argument_vector_from_varargs(), but
+ * builds the argument vector in memory provided by the caller, e.g. on the
+ * stack or in an arena. Nothing is allocated.
+ * @param storage Where to build the argument vector. Must be aligned for
+ * doubles.
+ * @param storage_size Size of storage in bytes.
+ * @return Returns the argument vector, which points to storage, or NULL if
+ * storage is too small or a type can't be passed. The returned vector must
+ * not be passed to dynamic_call_destroy_argument_vector().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void**
+dynamic_call_init_argument_vector_from_varargs(
+		const struct type_info_t* type_info,
+		void* storage,
+		uint32_t storage_size,
+		...);
+
+/*!
+ * @brief @see dynamic_call_init_argument_vector_from_varargs().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void**
+vdynamic_call_init_argument_vector_from_varargs(
+		const struct type_info_t* type_info,
+		void* storage,
+		uint32_t storage_size,
+		va_list ap);
+
 /*!
  * @brief Writes new values into an existing argument vector from varargs.
  * @param type_info The type information to use in order to deduce the types of
@@ -278,6 +332,35 @@ dynamic_call_create_argument_vector_from_strings(
 		const struct type_info_t* type_info,
 		const struct ordered_vector_t* argv);
 
+/*!
+ * @brief Returns the number of bytes needed to build an argument vector from
+ * a list of strings with dynamic_call_init_argument_vector_from_strings(), or
+ * 0 if the number of strings doesn't match the type info.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint32_t
+dynamic_call_get_argument_vector_size_from_strings(
+		const struct type_info_t* type_info,
+		const struct ordered_vector_t* strings);
+
+/*!
+ * @brief Same as dynamic_call_create_argument_vector_from_strings(), but
+ * builds the argument vector in memory provided by the caller, e.g. on the
+ * stack or in an arena. Nothing is allocated.
+ * @param storage Where to build the argument vector. Must be aligned for
+ * doubles.
+ * @param storage_size Size of storage in bytes, see
+ * dynamic_call_get_argument_vector_size_from_strings().
+ * @return Returns the argument vector, which points to storage, or NULL if
+ * storage is too small or a string can't be parsed. The returned vector must
+ * not be passed to dynamic_call_destroy_argument_vector().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void**
+dynamic_call_init_argument_vector_from_strings(
+		const struct type_info_t* type_info,
+		const struct ordered_vector_t* strings,
+		void* storage,
+		uint32_t storage_size);
+
 /*!
  * @brief Writes new values to an existing argument vector from a list of strings.
  * @param type_info The type information to use in order to know how to parse
@@ -304,7 +387,8 @@ dynamic_call_set_argument_vector_from_strings(
 	const struct ordered_vector_t* strings);
 
 /*!
- * @brief Destroys a previously created argument vector.
+ * @brief Destroys an argument vector created with one of the
+ * dynamic_call_create_argument_vector_*() functions.
  * @param type_info The type info object that was used when creating the
  * argument vector.
  * @param argv The argument vector to destroy.
@@ -314,7 +398,9 @@ dynamic_call_destroy_argument_vector(const struct type_info_t* type_info,
 									 void** argv);
 
 /*!
- * @brief
+ * @brief Checks if a type info object has the specified stringified
+ * signature. Allocates nothing.
+ * @return Returns 1 if the signatures match, 0 if otherwise.
  */
 LIGHTSHIP_UTIL_PUBLIC_API char
 dynamic_call_do_typecheck(const struct type_info_t* type_info,
@@ -322,6 +408,20 @@ dynamic_call_do_typecheck(const struct type_info_t* type_info,
 						  uint32_t argc,
 						  const char** argv);
 
+/*!
+ * @brief Checks if two type info objects describe the same signature.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+dynamic_call_type_info_equal(const struct type_info_t* a,
+							 const struct type_info_t* b);
+
+/*!
+ * @brief Returns the size in bytes of a value of the specified type. Strings
+ * are the size of a pointer. Returns 0 for TYPE_VOID and TYPE_UNKNOWN.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint32_t
+dynamic_call_get_type_size(type_e type);
+
 /*!
  * @brief Parses a stringified type and returns its type according to the enum
  * ```type_e```.
@@ -31,6 +31,27 @@ file_load_into_memory(const char* file_name, void** buffer, file_opts_e opts);
 LIGHTSHIP_UTIL_PUBLIC_API void
 free_file(void* ptr);
 
+/*!
+ * @brief Maps the contents of a file into memory for reading.
+ *
+ * As opposed to file_load_into_memory(), nothing is copied. Pages are read
+ * from disk by the operating system as they are accessed.
+ * @param[in] file_name The file to map.
+ * @param[out] size Set to the size of the mapping in bytes.
+ * @return Returns a pointer to the read-only mapping, or NULL if the file
+ * could not be mapped. Empty files can't be mapped.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API const void*
+file_map(const char* file_name, uint32_t* size);
+
+/*!
+ * @brief Unmaps a file previously mapped with file_map().
+ * @param ptr The pointer returned by file_map().
+ * @param size The size returned by file_map().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+file_unmap(const void* ptr, uint32_t size);
+
 C_HEADER_END
 
 #endif /* LIGHTSHIP_UTIL_FILE_H */
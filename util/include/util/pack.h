@@ -0,0 +1,141 @@
+/*!
+ * @file pack.h
+ * @brief Archive format for shipping many small files as one.
+ *
+ * Layout of a pack file
+ * ---------------------
+ * ```
+ * +--------------------+  0
+ * | pack_header_t      |
+ * +--------------------+  header.toc_offset
+ * | pack_entry_t[]     |  sorted by hash
+ * +--------------------+  header.names_offset
+ * | entry names        |  null terminated, referenced by pack_entry_t
+ * +--------------------+  aligned to PACK_ALIGNMENT
+ * | blob               |  each blob is aligned to PACK_ALIGNMENT
+ * | blob               |
+ * | ...                |
+ * +--------------------+
+ * ```
+ * All integers are stored in native byte order (little endian on every
+ * supported platform). The whole file is mapped into memory when opened, so
+ * looking up an entry is a binary search over the table of contents and
+ * reading an uncompressed entry is a pointer into the mapping.
+ *
+ * Entries may optionally be compressed with a small LZ77 style codec. Such
+ * entries have to be decompressed into a separate buffer before use.
+ */
+
+#ifndef LIGHTSHIP_UTIL_PACK_H
+#define LIGHTSHIP_UTIL_PACK_H
+
+#include "util/pstdint.h"
+#include "util/config.h"
+
+C_HEADER_BEGIN
+
+#define PACK_MAGIC "LSPK"
+#define PACK_VERSION 1
+#define PACK_ALIGNMENT 16
+
+typedef enum pack_entry_flags_e
+{
+	PACK_ENTRY_COMPRESSED = 0x01
+} pack_entry_flags_e;
+
+struct pack_header_t
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t toc_offset;
+	uint32_t names_offset;
+	uint32_t names_size;
+};
+
+struct pack_entry_t
+{
+	uint32_t hash;          /* hash_jenkins_oaat() of the entry name */
+	uint32_t name_offset;   /* relative to header.names_offset */
+	uint32_t flags;         /* pack_entry_flags_e */
+	uint32_t offset;        /* offset of the blob from the start of the file */
+	uint32_t size;          /* size of the entry in bytes */
+	uint32_t stored_size;   /* size of the blob in bytes, differs from size if compressed */
+};
+
+struct pack_t
+{
+	const void* mapping;
+	uint32_t mapping_size;
+	const struct pack_header_t* header;
+	const struct pack_entry_t* toc;
+	const char* names;
+};
+
+/*!
+ * @brief Maps a pack file into memory and validates it.
+ * @param[in] file_name The pack file to open.
+ * @return Returns the pack object, or NULL if the file doesn't exist or is
+ * not a valid pack file.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API struct pack_t*
+pack_open(const char* file_name);
+
+/*!
+ * @brief Unmaps a pack file. Pointers returned by pack_entry_data() become
+ * invalid.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+pack_close(struct pack_t* pack);
+
+/*!
+ * @brief Looks up an entry by name.
+ * @return Returns the entry, or NULL if it doesn't exist.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API const struct pack_entry_t*
+pack_find(const struct pack_t* pack, const char* name);
+
+/*!
+ * @brief Returns the name of an entry.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API const char*
+pack_entry_name(const struct pack_t* pack, const struct pack_entry_t* entry);
+
+/*!
+ * @brief Returns a pointer to the entry's blob inside the mapping.
+ * @note If the entry is compressed, this is the compressed data. Use
+ * pack_read() instead.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API const void*
+pack_entry_data(const struct pack_t* pack, const struct pack_entry_t* entry);
+
+/*!
+ * @brief Copies the entry into the specified buffer, decompressing it if
+ * necessary.
+ * @param[out] buffer Must be at least entry->size bytes large.
+ * @return Returns 1 if successful, 0 if the data is corrupt.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+pack_read(const struct pack_t* pack, const struct pack_entry_t* entry, void* buffer);
+
+/*!
+ * @brief Creates a pack file from a list of files.
+ * @param[in] file_name The pack file to write.
+ * @param[in] count Number of entries.
+ * @param[in] source_files The files to read the data of each entry from.
+ * @param[in] entry_names The name to store each entry under. If NULL, the
+ * source file names are used.
+ * @param[in] compress If non-zero, entries are compressed when doing so makes
+ * them smaller.
+ * @return Returns 1 if successful, 0 if otherwise.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+pack_write(const char* file_name,
+		   uint32_t count,
+		   const char** source_files,
+		   const char** entry_names,
+		   char compress);
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_PACK_H */
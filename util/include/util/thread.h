@@ -0,0 +1,59 @@
+#ifndef LIGHTSHIP_UTIL_THREAD_H
+#define LIGHTSHIP_UTIL_THREAD_H
+
+#include "util/config.h"
+#include "util/pstdint.h"
+
+C_HEADER_BEGIN
+
+typedef void (*thread_func)(void* arg);
+
+/*!
+ * @brief Returns an identifier of the calling thread. No two threads running
+ * at the same time have the same identifier.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uintptr_t
+get_thread_id(void);
+
+/*!
+ * @brief Starts a new thread calling func(arg).
+ * @param[out] handle Receives the handle to pass to thread_join().
+ * @return Returns 0 if the thread couldn't be created, 1 if otherwise.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+thread_start(uintptr_t* handle, thread_func func, void* arg);
+
+/*!
+ * @brief Blocks until the specified thread has returned from its function
+ * and releases its resources.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+thread_join(uintptr_t handle);
+
+/*!
+ * @brief Blocks the calling thread as long as the value at the specified
+ * address equals *expected*.
+ *
+ * This may return spuriously, so it should be called in a loop re-checking
+ * the condition.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+futex_wait(int* address, int expected);
+
+/*!
+ * @brief Wakes up at most count threads blocked in futex_wait() on the
+ * specified address. The value should be changed before calling this.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+futex_wake(int* address, int count);
+
+/*!
+ * @brief Wakes up all threads blocked in futex_wait() on the specified
+ * address. The value should be changed before calling this.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+futex_wake_all(int* address);
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_THREAD_H */
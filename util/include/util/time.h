@@ -4,7 +4,59 @@
 #include "util/config.h"
 #include "util/pstdint.h"
 
+C_HEADER_BEGIN
+
+/*!
+ * @brief Returns the time in nanoseconds since an unspecified point in the
+ * past. The clock is monotonic and isn't affected by changes to the system
+ * time, so it's suitable for measuring intervals.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint64_t
+get_time_ns(void);
+
+/*!
+ * @brief Returns get_time_ns() in microseconds.
+ */
 LIGHTSHIP_UTIL_PUBLIC_API int64_t
 get_time_in_microseconds(void);
 
+/*!
+ * @brief Blocks the calling thread until get_time_ns() reaches the specified
+ * time.
+ *
+ * The thread sleeps in the OS for most of the time and spins for the last
+ * few hundred microseconds, since waking up from a sleep is only accurate to
+ * about the timer slack. Returns immediately if the time has passed.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+sleep_until_ns(uint64_t deadline);
+
+/*!
+ * @brief Reads the CPU's cycle counter (rdtsc on x86, cntvct on ARM64).
+ *
+ * This is a lot cheaper than get_time_ns() but its unit depends on the
+ * machine. Only use differences of two readings taken on the same machine
+ * and convert them with cycles_to_ns(). On CPUs without a usable counter
+ * this falls back to get_time_ns().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint64_t
+cycle_counter(void);
+
+/*!
+ * @brief Measures the frequency of cycle_counter() against get_time_ns().
+ *
+ * This busy waits for a few milliseconds, so call it once at startup. If it
+ * was never called, the first call to cycles_to_ns() does it.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+cycle_counter_calibrate(void);
+
+/*!
+ * @brief Converts a number of cycle_counter() cycles to nanoseconds.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint64_t
+cycles_to_ns(uint64_t cycles);
+
+C_HEADER_END
+
 #endif /* LIGHTSHIP_UTIL_TIME_H */
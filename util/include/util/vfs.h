@@ -0,0 +1,83 @@
+/*!
+ * @file vfs.h
+ * @brief Virtual file system layered on top of pack files.
+ *
+ * Pack files (see pack.h) can be mounted at startup. From then on, files are
+ * looked up in the mounted packs before falling back to the disk. Packs
+ * mounted later take precedence over packs mounted earlier.
+ *
+ * file_load_into_memory() and yaml_load() go through the virtual file system
+ * automatically. Code that only needs to read a file should prefer
+ * vfs_open(), which hands out a pointer directly into the pack's mapping
+ * when the entry isn't compressed.
+ *
+ * @note Mounting and unmounting is not thread safe. Mount packs before
+ * any threads start loading files.
+ */
+
+#ifndef LIGHTSHIP_UTIL_VFS_H
+#define LIGHTSHIP_UTIL_VFS_H
+
+#include "util/pstdint.h"
+#include "util/config.h"
+#include "util/file.h"
+
+C_HEADER_BEGIN
+
+struct vfs_file_t
+{
+	const void* data;   /* contents of the file */
+	uint32_t size;      /* size of the file in bytes */
+	void* buffer;       /* non-NULL if data had to be copied (loose or compressed files) */
+};
+
+LIGHTSHIP_UTIL_PUBLIC_API void
+vfs_init(void);
+
+/*!
+ * @brief Unmounts all packs.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+vfs_deinit(void);
+
+/*!
+ * @brief Maps a pack file and adds it to the search path.
+ * @return Returns 1 if successful, 0 if the pack doesn't exist or is invalid.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+vfs_mount(const char* pack_file_name);
+
+/*!
+ * @brief Returns the number of mounted packs.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint32_t
+vfs_mount_count(void);
+
+/*!
+ * @brief Opens a file for reading.
+ * @param[out] file Receives the file contents. Must be closed with
+ * vfs_close() if successful.
+ * @param[in] file_name The file to open.
+ * @return Returns 1 if successful, 0 if the file doesn't exist in any of the
+ * mounted packs nor on disk.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API char
+vfs_open(struct vfs_file_t* file, const char* file_name);
+
+/*!
+ * @brief Releases a file opened with vfs_open().
+ */
+LIGHTSHIP_UTIL_PUBLIC_API void
+vfs_close(struct vfs_file_t* file);
+
+/*!
+ * @brief Same as file_load_into_memory(), but only searches mounted packs.
+ * @return Returns the size of the buffer in bytes, or 0 if the file isn't in
+ * any of the mounted packs.
+ */
+LIGHTSHIP_UTIL_PUBLIC_API uint32_t
+vfs_load_into_memory(const char* file_name, void** buffer, file_opts_e opts);
+
+C_HEADER_END
+
+#endif /* LIGHTSHIP_UTIL_VFS_H */
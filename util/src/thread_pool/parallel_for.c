@@ -0,0 +1,252 @@
+#include "thread_pool/parallel_for.h"
+#include "util/memory.h"
+#include "util/atomic.h"
+#include <string.h>
+
+#ifdef ENABLE_THREAD_POOL
+
+struct parallel_context_t
+{
+	struct thread_pool_t* pool;
+	struct thread_pool_counter_t counter; /* queued ranges not yet finished */
+	uint32_t grain;
+	parallel_for_func for_func;         /* either this is set... */
+	parallel_reduce_func reduce_func;   /* ...or this and join */
+	parallel_join_func join;
+	const void* identity;
+	void* result;
+	uint32_t size;
+	void* user;
+	int lock;                           /* locks result - use atomics to modify */
+};
+
+struct parallel_range_t
+{
+	struct parallel_context_t* context;
+	uint32_t begin;
+	uint32_t end;
+	/* followed by context->size bytes of partial result */
+};
+
+/* partial results start at the alignment malloc() guarantees */
+#define PARALLEL_RANGE_SIZE ((sizeof(struct parallel_range_t) + 15) & ~(size_t)15)
+#define PARALLEL_RANGE_PARTIAL(range) ((void*)((char*)(range) + PARALLEL_RANGE_SIZE))
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Allocates a range with a partial result initialised to the
+ * identity.
+ * @return Returns NULL if memory couldn't be allocated.
+ */
+static struct parallel_range_t*
+parallel_range_create(struct parallel_context_t* context, uint32_t begin, uint32_t end);
+
+/*!
+ * @brief Processes a range, splitting it while other threads are out of
+ * work.
+ */
+static void
+parallel_range_process(struct parallel_range_t* range);
+
+/*!
+ * @brief Joins the partial result of a range into the result and frees the
+ * range.
+ */
+static void
+parallel_range_finish(struct parallel_range_t* range);
+
+/*!
+ * @brief Job processing a range split off another one.
+ * @param data The range.
+ */
+static void
+parallel_range_job(void* data);
+
+/*!
+ * @brief Splits a range in two and runs everything from start to finish.
+ */
+static void
+parallel_run(struct parallel_context_t* context, uint32_t begin, uint32_t end);
+
+#endif /* ENABLE_THREAD_POOL */
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_parallel_for(struct thread_pool_t* pool,
+						 uint32_t begin,
+						 uint32_t end,
+						 uint32_t grain,
+						 parallel_for_func func,
+						 void* user)
+{
+	if(begin >= end)
+		return;
+	if(!grain)
+		grain = 1;
+
+#ifdef ENABLE_THREAD_POOL
+	if(end - begin > grain)
+	{
+		struct parallel_context_t context;
+		memset(&context, 0, sizeof(context));
+		context.pool = pool;
+		context.grain = grain;
+		context.for_func = func;
+		context.user = user;
+		parallel_run(&context, begin, end);
+		return;
+	}
+#endif
+
+	func(begin, end, user);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_parallel_reduce(struct thread_pool_t* pool,
+							uint32_t begin,
+							uint32_t end,
+							uint32_t grain,
+							const void* identity,
+							void* result,
+							uint32_t size,
+							parallel_reduce_func func,
+							parallel_join_func join,
+							void* user)
+{
+	memcpy(result, identity, size);
+	if(begin >= end)
+		return;
+	if(!grain)
+		grain = 1;
+
+#ifdef ENABLE_THREAD_POOL
+	if(end - begin > grain)
+	{
+		struct parallel_context_t context;
+		memset(&context, 0, sizeof(context));
+		context.pool = pool;
+		context.grain = grain;
+		context.reduce_func = func;
+		context.join = join;
+		context.identity = identity;
+		context.result = result;
+		context.size = size;
+		context.user = user;
+		parallel_run(&context, begin, end);
+		return;
+	}
+#endif
+
+	func(begin, end, result, user);
+}
+
+#ifdef ENABLE_THREAD_POOL
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+parallel_run(struct parallel_context_t* context, uint32_t begin, uint32_t end)
+{
+	struct parallel_range_t* range;
+
+	/* without memory for splitting, the calling thread does everything */
+	if(!(range = parallel_range_create(context, begin, end)))
+	{
+		if(context->for_func)
+			context->for_func(begin, end, context->user);
+		else
+			context->reduce_func(begin, end, context->result, context->user);
+		return;
+	}
+
+	parallel_range_process(range);
+	parallel_range_finish(range);
+
+	/* the ranges reference the context on this stack */
+	thread_pool_wait_for_counter(context->pool, &context->counter);
+}
+
+/* ------------------------------------------------------------------------- */
+static struct parallel_range_t*
+parallel_range_create(struct parallel_context_t* context, uint32_t begin, uint32_t end)
+{
+	struct parallel_range_t* range;
+	if(!(range = (struct parallel_range_t*)MALLOC(PARALLEL_RANGE_SIZE + context->size)))
+		return NULL;
+	range->context = context;
+	range->begin = begin;
+	range->end = end;
+	if(context->size)
+		memcpy(PARALLEL_RANGE_PARTIAL(range), context->identity, context->size);
+	return range;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+parallel_range_process(struct parallel_range_t* range)
+{
+	struct parallel_context_t* context = range->context;
+	struct parallel_range_t* split;
+	uint32_t next;
+
+	while(range->end - range->begin > context->grain)
+	{
+		/*
+		 * Nothing queued means a thread could be looking for work, hand it
+		 * the upper half. Otherwise, keep going on our own.
+		 */
+		if(!thread_pool_queued_jobs(context->pool) &&
+		   (split = parallel_range_create(context,
+										  range->begin + (range->end - range->begin) / 2,
+										  range->end)))
+		{
+			range->end = split->begin;
+			thread_pool_queue_counted(context->pool, &context->counter, parallel_range_job, split);
+			continue;
+		}
+
+		next = range->begin + context->grain;
+		if(context->for_func)
+			context->for_func(range->begin, next, context->user);
+		else
+			context->reduce_func(range->begin, next, PARALLEL_RANGE_PARTIAL(range), context->user);
+		range->begin = next;
+	}
+
+	if(context->for_func)
+		context->for_func(range->begin, range->end, context->user);
+	else
+		context->reduce_func(range->begin, range->end, PARALLEL_RANGE_PARTIAL(range), context->user);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+parallel_range_finish(struct parallel_range_t* range)
+{
+	struct parallel_context_t* context = range->context;
+
+	if(context->join)
+	{
+		SPIN_LOCK(context->lock);
+		context->join(context->result, PARALLEL_RANGE_PARTIAL(range), context->user);
+		SPIN_UNLOCK(context->lock);
+	}
+
+	FREE(range);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+parallel_range_job(void* data)
+{
+	struct parallel_range_t* range = (struct parallel_range_t*)data;
+	parallel_range_process(range);
+	parallel_range_finish(range);
+}
+
+#endif /* ENABLE_THREAD_POOL */
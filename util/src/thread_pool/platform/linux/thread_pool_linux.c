@@ -1,10 +1,21 @@
 /*!
  * @file thread_pool_linux.c
- * @brief Thread pool using a lock-free, dynamically resizable ring buffer
- * implementation for job storage.
+ * @brief Thread pool using work-stealing deques for job storage.
  *
  * Overview of implementation
  * ==========================
+ * Every worker owns a Chase-Lev deque of jobs. Jobs queued by a worker of
+ * the pool are pushed to the bottom of its own deque, and the worker pops
+ * jobs from the bottom again, so recently queued (and likely still cached)
+ * jobs run first. Jobs queued by any other thread go to a shared injection
+ * queue. A worker whose deque is empty takes the oldest job of the injection
+ * queue or, if that's empty as well, steals the oldest job from the top of
+ * the deque of a randomly chosen worker.
+ *
+ * Threads waiting for jobs to finish execute queued jobs in the meantime,
+ * the same way an idle worker does. Waiting for a thread_pool_counter_t
+ * only waits for the jobs queued with that counter, which makes it possible
+ * to wait from within a job without stalling the pool.
  *
  *
  * Requirements, Design Decisions, Problems and Solutions Explained
@@ -12,10 +23,8 @@
  * 1. Requirements
  * ------------
  * A thread pool supporting a user defined number of threads. Inserting jobs
- * must be thread safe and fast.
- *
- * In order for jobs to be inserted and erased, an underlying thread safe
- * container must be created in order to hold pending job objects.
+ * must be thread safe and fast. Workers must not sit idle while jobs are
+ * waiting, no matter which thread queued them or how long the jobs take.
  *
  * Job objects hold a function pointer and a data pointer, making it possible
  * for workers to call said functions with a single, user-defined argument.
@@ -24,27 +33,66 @@
  * 2. Design Decisions
  * ----------------
  * Worker threads with nothing to do shall be suspended, freeing CPU resources.
- * This will be achieved with condition variables.
+ * Jobs are often only microseconds apart though, and going to sleep and
+ * being woken up costs a few microseconds of system calls each. Idle
+ * workers therefore spin for a while first, executing pause instructions
+ * and watching the number of queued jobs. How long a worker spins adapts to
+ * whether spinning found a job the last times. On single core machines,
+ * spinning only delays the thread which would queue the next job, so
+ * workers go to sleep right away.
+ *
+ * Sleeping threads wait on an event count with futex_wait(), the value
+ * being the number of wakeups so far. Queuing a job only makes a system
+ * call if a worker is actually asleep, and then wakes up a single one. This
+ * replaces a mutex and condition variable, which every queue operation
+ * would have had to lock.
+ *
+ * The owner of a deque pushes and pops without any atomic read-modify-write
+ * operation, except when taking the very last job, which it may have to
+ * race a thief for. Thieves claim jobs with a CAS on the top index. See
+ * "Dynamic Circular Work-Stealing Deque" by Chase and Lev, and "Correct and
+ * Efficient Work-Stealing for Weak Memory Models" by Le et al. for the
+ * barriers required.
  *
- * The most optimal container to use for storing job objects is a ring buffer,
- * since it fulfills the requirement of an ordered container, and it doesn't
- * require for elements to be shifted around when inserting or deleting.
+ * Deques have a fixed size. Thieves may still be reading a slot the owner
+ * would reuse, so a full deque isn't grown. Jobs that don't fit go to the
+ * injection queue instead, which is protected by a mutex and grows up to the
+ * size set with thread_pool_set_max_buffer_size().
  *
- * The ring buffer is especially suited for this job, as it can utilise atomic
- * operations for incrementing and decrementing the read/write positions.
+ * Picking victims at random spreads thieves over the deques instead of
+ * having all of them contend on the first one.
  *
  *
  * 3. Problems and Solutions
  * -------------------------
+ * A worker may decide to go to sleep at the same time a job is queued. The
+ * number of queued jobs is incremented before a job is inserted, and the
+ * number of sleeping workers is incremented before a worker checks for jobs
+ * one last time. Both are full barriers, so either the worker sees the job
+ * or the queuing thread sees the sleeping worker and wakes it up. The worker
+ * reads the event count before checking, so if the wakeup happens between
+ * its check and futex_wait(), the value has changed and futex_wait()
+ * returns immediately.
  *
+ * Threads waiting for a counter are woken up when a counter drops to 0, or
+ * when a job is queued that they could help with. Like workers, they count
+ * themselves as waiting before checking the counter one last time.
+ *
+ * If both the injection queue is at its maximum size and the deque is full,
+ * or memory can't be allocated, the job is executed by the queuing thread.
  */
 
-#include "thread_pool.h"
+#include "thread_pool/thread_pool.h"
+#include "util/memory.h"
+#include "util/thread.h"
+#include "util/atomic.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 
 #ifdef _WIN32
 #   include <windows.h>
@@ -55,66 +103,39 @@
 #   include <unistd.h>
 #endif
 
-#ifdef DATA_POINTER_TYPE
-#   undef DATA_POINTER_TYPE
-#endif
-#define DATA_POINTER_TYPE unsigned char
+/* default size of each worker's deque and of the injection queue, configured in CMakeLists.txt */
+#define DEFAULT_BUFFER_SIZE RING_BUFFER_FIXED_SIZE
 
-/*!
- * @brief Ring buffer object.
- *
- *
- */
-struct ring_buffer_t
+/* bounds of the number of pause instructions an idle thread spins for before sleeping */
+#define SPIN_COUNT_MIN 64
+#define SPIN_COUNT_MAX 4096
+
+struct thread_pool_job_t
 {
-	intptr_t job_slots;
-	intptr_t job_size_in_bytes;
-	intptr_t write_pos;
-	intptr_t read_pos;
-	DATA_POINTER_TYPE* obj_buffer;
-	DATA_POINTER_TYPE* flg_buffer;
+	thread_pool_job_func func;
+	void* data;
+	struct thread_pool_counter_t* counter; /* decremented when the job has returned, can be NULL */
 };
 
 /*!
- * @brief Flag buffer values.
+ * @brief Chase-Lev work-stealing deque.
  *
- * Meaning:
- * + FLAG_FREE_SLOT         : The corresponding read/write position is empty.
- *                            It is ready to accept data. Before writing data,
- *                            the flag must be changed to FLAG_WRITE_IN_PROGRESS.
- * + FLAG_WRITE_IN_PROGRESS : The corresponding read/write position is in the
- *                            process of being written to. Once writing is
- *                            finished, the flag must be changed to
- *                            FLAG_READ_ME.
- * + FLAG_FILLED_SLOT       : The corresponding read/write position contains
- *                            data ready for reading. Before reading data, the
- *                            flag must be changed to FLAG_READ_IN_PROGRESS.
- * + FLAG_READ_IN_PROGRESS  : The corresponding read/write position is currently
- *                            being read from. Once reading is complete, the
- *                            flag must be changed back to FLAG_FREE_SLOT so it
- *                            can be written to again.
- * + FLAG_INVALID_JOB       : The corresponding read/write position has been
- *                            skipped and the data that exists at this location
- *                            is garbage. This flag will be set when a ring
- *                            buffer overflows and the job is executed by the
- *                            inserting thread instead.
+ * Only the owning worker pushes to and pops from the bottom, any worker may
+ * steal from the top. The number of jobs is bottom - top.
  */
-typedef enum ring_buffer_flags_e
+struct thread_pool_deque_t
 {
-	FLAG_FREE_SLOT = 0,
-	FLAG_WRITE_IN_PROGRESS = 1,
-	FLAG_FILLED_SLOT = 2,
-	FLAG_READ_IN_PROGRESS = 3,
-	FLAG_INVALID_JOB = 4
-} ring_buffer_flags_e;
+	volatile intptr_t top;          /* index of the oldest job - use atomics to modify */
+	volatile intptr_t bottom;       /* index after the newest job, only written by the owner */
+	intptr_t mask;                  /* number of slots - 1, the number of slots is a power of two */
+	struct thread_pool_job_t* job;
+};
 
 struct thread_pool_worker_t
 {
-	int                  timer;       /* counters for each thread - used for work balancing - use atomics to modify */
-	pthread_t            thread;      /* vector of worker thread handles */
-	pthread_cond_t       wakeup_cv;   /* condition variables for waking up a worker thread - lock worker_mutex for access */
-	pthread_mutex_t      mutex;       /* locks for worker_wakeup_cv */
-	struct ring_buffer_t ring_buffer; /* ring buffers for storing jobs, 1 for each thread */
+	struct thread_pool_deque_t deque; /* jobs queued by this worker */
+	pthread_t            thread;      /* worker thread handle */
+	int                  spin_count;  /* current number of pause instructions to spin for */
 	struct thread_pool_t* pool;       /* the pool that owns this worker */
 };
 
@@ -122,55 +143,140 @@ struct thread_pool_t
 {
 	int             num_threads;        /* number of worker threads to spawn on resume */
 	int             num_jobs;           /* number of jobs queued or actively being executed - use atomics to modify */
-	int             selected_worker;    /* index of the worker to give an incoming job - NOTE: doesn't wrap, use modulo - use atomics to modify */
+	int             num_queued;         /* number of jobs not yet taken by a worker - use atomics to modify */
+	int             num_sleeping;       /* number of workers waiting on work_event - use atomics to modify */
+	int             num_waiting;        /* number of threads waiting on finished_event - use atomics to modify */
+	int             max_spin_count;     /* 0 on single core machines, SPIN_COUNT_MAX otherwise */
 	char            active;             /* whether or not the pool is active - use atomics to modify */
 
 	struct thread_pool_worker_t* worker;/* vector of workers */
 
-	pthread_mutex_t mutex;              /* pool mutex - used for num_jobs and active */
-	pthread_cond_t  job_finished_cv;    /* condition variable for waking up threads waiting on finished jobs - lock mutex for access */
-};
+	int             work_event;         /* event count for waking up idle workers - use atomics to modify */
+	int             finished_event;     /* event count for waking up threads waiting on finished jobs - use atomics to modify */
 
-struct thread_pool_job_t
-{
-	thread_pool_job_func func;
-	void* data;
+	pthread_mutex_t inject_mutex;       /* locks the injection queue */
+	struct thread_pool_job_t* inject_job; /* ring of jobs queued by other threads */
+	intptr_t        inject_mask;        /* number of slots - 1, the number of slots is a power of two */
+	intptr_t        inject_read;        /* index of the oldest job */
+	intptr_t        inject_count;       /* number of jobs in the ring - use atomics to read without the lock */
 };
 
+/* the worker running on the calling thread, NULL if it isn't a worker */
+static THREAD_LOCAL struct thread_pool_worker_t* t_worker = NULL;
+
+/* xorshift state of the calling thread for choosing victims to steal from */
+static THREAD_LOCAL uint32_t t_random = 2463534242u;
+
+/* maximum size of the injection queue in bytes */
+static uint32_t g_max_buffer_size = RING_BUFFER_MAX_SIZE;
+
+/*!
+ * @brief Returns the number of job slots fitting into the specified number
+ * of bytes, rounded down to a power of two.
+ */
+static intptr_t
+thread_pool_slots_for_size(uint32_t size_in_bytes);
+
+/*!
+ * @brief Allocates the deque's slots.
+ * @return Returns 0 if memory couldn't be allocated, 1 if otherwise.
+ */
+static char
+thread_pool_deque_init(struct thread_pool_deque_t* deque, uint32_t size_in_bytes);
+
 /*!
- * @brief Initialises the specified ring buffer object.
- * @param rb The ring buffer object to initialise.
- * @param job_slots The number of jobs to allocate space for in the ring
- * buffer. If 0 is specified then the number of jobs will equal
- * RING_BUFFER_DEFAULT_SLOT_COUNT which can be configured in CMakeLists.txt.
- * @param job_size_in_bytes The size of the objects this ring buffer will be
- * storing in bytes. One can pass the return value of sizeof().
+ * @brief Pushes a job to the bottom of the deque. Only the owner may call
+ * this.
+ * @return Returns 0 if the deque is full, 1 if otherwise.
+ */
+static char
+thread_pool_deque_push(struct thread_pool_deque_t* deque,
+					   const struct thread_pool_job_t* job);
+
+/*!
+ * @brief Pops the newest job from the bottom of the deque. Only the owner
+ * may call this.
+ * @return Returns 0 if the deque is empty, 1 if otherwise.
+ */
+static char
+thread_pool_deque_pop(struct thread_pool_deque_t* deque,
+					  struct thread_pool_job_t* job);
+
+/*!
+ * @brief Steals the oldest job from the top of the deque.
+ * @return Returns 0 if the deque is empty or another thread took the job
+ * first, 1 if otherwise.
+ */
+static char
+thread_pool_deque_steal(struct thread_pool_deque_t* deque,
+						struct thread_pool_job_t* job);
+
+/*!
+ * @brief Appends a job to the injection queue, growing it if necessary.
+ * @return Returns 0 if the queue is full and can't grow, 1 if otherwise.
+ */
+static char
+thread_pool_inject(struct thread_pool_t* pool,
+				   const struct thread_pool_job_t* job);
+
+/*!
+ * @brief Removes the oldest job from the injection queue.
+ * @return Returns 0 if the queue is empty, 1 if otherwise.
+ */
+static char
+thread_pool_take_injected(struct thread_pool_t* pool,
+						  struct thread_pool_job_t* job);
+
+/*!
+ * @brief Finds a job for the calling thread: The newest job of its own
+ * deque, the oldest injected job or the oldest job of another worker, in
+ * that order.
+ * @param worker The worker running on the calling thread, or NULL if the
+ * thread isn't a worker of the pool.
+ * @return Returns 0 if no job was found, 1 if otherwise.
+ */
+static char
+thread_pool_find_job(struct thread_pool_t* pool,
+					 struct thread_pool_worker_t* worker,
+					 struct thread_pool_job_t* job);
+
+/*!
+ * @brief Executes a job taken from a deque or the injection queue.
+ */
+static void
+thread_pool_run_job(struct thread_pool_t* pool, const struct thread_pool_job_t* job);
+
+/*!
+ * @brief Decrements the number of jobs and the job's counter and wakes up
+ * waiting threads if either of them drops to 0.
  */
 static void
-ring_buffer_init_buffer(struct ring_buffer_t* rb,
-						uint32_t job_slots,
-						intptr_t job_size_in_bytes);
+thread_pool_job_done(struct thread_pool_t* pool, struct thread_pool_counter_t* counter);
 
 /*!
- * @brief De-initialises the specified ring buffer object.
- * @note Threads shall not access the ring buffer during or after this call.
- * @param rb The ring buffer object to de-initialise.
+ * @brief Spins until a job is queued and, if value is NULL, until the pool
+ * is suspended or, if otherwise, until the value drops to 0.
+ * @return Returns 0 if none of that happened, 1 if otherwise.
+ */
+static char
+thread_pool_spin(struct thread_pool_t* pool, int* value, int spin_count);
+
+/*!
+ * @brief Advances an event count and wakes up count threads waiting on it.
  */
 static void
-ring_buffer_deinit_buffer(struct ring_buffer_t* rb);
+thread_pool_signal(int* event, int count);
 
 /*!
- * @brief Resizes the ring buffer to the specified size.
- * @note Threads shall not access the ring buffer during this call.
- * @param rb The ring buffer to resize.
- * @param new_size Size in bytes to resize the buffer to.
+ * @brief Executes queued jobs until the value drops to 0, sleeping if there
+ * is nothing to do.
  */
 static void
-ring_buffer_resize(struct ring_buffer_t* rb, intptr_t new_size);
+thread_pool_wait_for_zero(struct thread_pool_t* pool, int* value);
 
 /*!
  * @brief This is the entry point for worker threads.
- * @param pool The pool the launched thread should work for.
+ * @param worker The worker the launched thread should run as.
  */
 static void*
 thread_pool_worker(struct thread_pool_worker_t* worker);
@@ -181,15 +287,16 @@ thread_pool_worker(struct thread_pool_worker_t* worker);
  * @note This includes launching all of the worker threads.
  * @param pool The pool object to initialise.
  * @param num_threads The number of worker threads to launch.
- * @param buffer_size_in_bytes The initial size of the ring buffer in bytes.
- * If a value of 0 is specified, then the size of the buffer shall be
- * initialised to RING_BUFFER_FIXED_SIZE. This value can be configured in
- * CMakeLists.txt.
+ * @param buffer_size_in_bytes The size of each worker's deque and the
+ * initial size of the injection queue in bytes. If a value of 0 is
+ * specified, then RING_BUFFER_FIXED_SIZE is used. This value can be
+ * configured in CMakeLists.txt.
+ * @return Returns 0 if memory couldn't be allocated, 1 if otherwise.
  */
-static void
+static char
 thread_pool_init_pool(struct thread_pool_t* pool,
 					  uint32_t num_threads,
-					  uint32_t job_slots);
+					  uint32_t buffer_size_in_bytes);
 
 /* ------------------------------------------------------------------------- */
 uint32_t
@@ -220,44 +327,34 @@ get_number_of_cores()
 #endif
 }
 
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_set_max_buffer_size(uint32_t maximum_buffer_size)
+{
+	g_max_buffer_size = maximum_buffer_size;
+}
+
 /* ------------------------------------------------------------------------- */
 struct thread_pool_t*
 thread_pool_create(uint32_t num_threads, uint32_t buffer_size_in_bytes)
 {
 	/* create and init thread pool object */
 	struct thread_pool_t* pool = (struct thread_pool_t*)MALLOC(sizeof(struct thread_pool_t));
-	thread_pool_init_pool(pool, num_threads, buffer_size_in_bytes);
+	if(!pool)
+		return NULL;
+	if(!thread_pool_init_pool(pool, num_threads, buffer_size_in_bytes))
+	{
+		FREE(pool);
+		return NULL;
+	}
 	return pool;
 }
 
 /* ------------------------------------------------------------------------- */
-static void
-thread_pool_init_worker(struct thread_pool_worker_t* worker,
-						uint32_t job_slots)
-{
-	ring_buffer_init_buffer(&worker->ring_buffer,
-							job_slots,
-							sizeof worker->ring_buffer);
-
-	pthread_mutex_init(&worker->mutex, NULL);
-	pthread_cond_init(&worker->wakeup_cv, NULL);
-}
-
-/* ------------------------------------------------------------------------- */
-static void
-thread_pool_deinit_worker(struct thread_pool_worker_t* worker)
-{
-	pthread_cond_destroy(&worker->wakeup_cv);
-	pthread_mutex_destroy(&worker->mutex);
-
-	ring_buffer_deinit_buffer(&worker->ring_buffer);
-}
-
-/* ------------------------------------------------------------------------- */
-static void
+static char
 thread_pool_init_pool(struct thread_pool_t* pool,
 					  uint32_t num_threads,
-					  uint32_t job_slots)
+					  uint32_t buffer_size_in_bytes)
 {
 	int i;
 
@@ -274,25 +371,46 @@ thread_pool_init_pool(struct thread_pool_t* pool,
 		pool->num_threads = num_threads;
 	else
 		pool->num_threads = get_number_of_cores();
+	if(!buffer_size_in_bytes)
+		buffer_size_in_bytes = DEFAULT_BUFFER_SIZE;
 
 	/* allocate num_threads workers */
 	pool->worker = (struct thread_pool_worker_t*)
 			MALLOC(sizeof(*pool->worker) * pool->num_threads);
+	if(!pool->worker)
+		return 0;
 	memset(pool->worker, 0, sizeof(*pool->worker) * pool->num_threads);
 
 	/* initialise workers */
 	for(i = 0; i != pool->num_threads; ++i)
 	{
-		thread_pool_init_worker(&pool->worker[i], job_slots);
+		if(!thread_pool_deque_init(&pool->worker[i].deque, buffer_size_in_bytes))
+			break;
 		pool->worker[i].pool = pool;
 	}
 
-	/* conditional variable and mutex for when workers go to sleep */
-	pthread_mutex_init(&pool->mutex, NULL);
-	pthread_cond_init(&pool->job_finished_cv, NULL);
+	/* injection queue */
+	pool->inject_mask = thread_pool_slots_for_size(buffer_size_in_bytes) - 1;
+	if(i != pool->num_threads ||
+	   !(pool->inject_job = (struct thread_pool_job_t*)MALLOC((pool->inject_mask + 1) * sizeof(struct thread_pool_job_t))))
+	{
+		while(i--)
+			FREE(pool->worker[i].deque.job);
+		FREE(pool->worker);
+		return 0;
+	}
+
+	/* spinning only makes sense if another core can queue a job meanwhile */
+	pool->max_spin_count = (get_number_of_cores() > 1 ? SPIN_COUNT_MAX : 0);
+	for(i = 0; i != pool->num_threads; ++i)
+		pool->worker[i].spin_count = (pool->max_spin_count ? SPIN_COUNT_MIN : 0);
+
+	pthread_mutex_init(&pool->inject_mutex, NULL);
 
 	/* launches all worker threads */
 	thread_pool_resume(pool);
+
+	return 1;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -304,14 +422,13 @@ thread_pool_destroy(struct thread_pool_t* pool)
 	/* Shut down worker threads. */
 	thread_pool_suspend(pool);
 
-	pthread_cond_destroy(&pool->job_finished_cv);
-	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->inject_mutex);
 
 	for(i = 0; i != pool->num_threads; ++i)
-	{
-		thread_pool_deinit_worker(&pool->worker[i]);
-	}
+		FREE(pool->worker[i].deque.job);
 
+	FREE(pool->inject_job);
+	FREE(pool->worker);
 	FREE(pool);
 }
 
@@ -319,88 +436,49 @@ thread_pool_destroy(struct thread_pool_t* pool)
 void
 thread_pool_queue(struct thread_pool_t* pool, thread_pool_job_func func, void* data)
 {
-	int selected_worker;
-	intptr_t write_pos;
-	struct thread_pool_job_t* job;
-	struct ring_buffer_t* ring_buffer;
-	DATA_POINTER_TYPE* flag_ptr;
+	thread_pool_queue_counted(pool, NULL, func, data);
+}
 
-	/* Get target worker: This is some primitive load balancing but should work for now */
-	selected_worker = __sync_fetch_and_add(&pool->selected_worker, 1) % pool->num_threads;
+/* ------------------------------------------------------------------------- */
+void
+thread_pool_queue_counted(struct thread_pool_t* pool,
+						  struct thread_pool_counter_t* counter,
+						  thread_pool_job_func func,
+						  void* data)
+{
+	struct thread_pool_worker_t* worker = t_worker;
+	struct thread_pool_job_t job;
 
-	/* get the worker thread's ring buffer */
-	ring_buffer = &pool->worker[selected_worker].ring_buffer;
+	job.func = func;
+	job.data = data;
+	job.counter = counter;
 
-	/*
-	 * Fetch, increment and wrap write position of target ring buffer. This
-	 * operation will acquire an unused, unique position in the ring buffer in
-	 * which to insert a new job.
-	 */
-	write_pos = __sync_fetch_and_add(&ring_buffer->write_pos, 1) %
-			ring_buffer->job_slots;
+	/* job is considered active until it has been executed */
+	if(counter)
+		__sync_fetch_and_add(&counter->value, 1);
+	__sync_fetch_and_add(&pool->num_jobs, 1);
 
-	/* cache flag buffer pointer, it's used multiple times */
-	flag_ptr = ring_buffer->flg_buffer + write_pos;
+	/* counted before it's inserted, so no worker falls asleep while it exists */
+	__sync_fetch_and_add(&pool->num_queued, 1);
 
-	/*
-	 * Try to set the flag to "write in progress" in flag buffer. This
-	 * operation will fail if the current flag is not FLAG_FREE_SLOT and will mean
-	 * the buffer has overflown.
-	 */
-	if(!__sync_bool_compare_and_swap(flag_ptr, FLAG_FREE_SLOT, FLAG_WRITE_IN_PROGRESS))
+	/* workers of this pool keep their own jobs, everyone else injects */
+	if(!(worker && worker->pool == pool && thread_pool_deque_push(&worker->deque, &job)) &&
+	   !thread_pool_inject(pool, &job))
 	{
-		/*
-		 * The buffer has overflown.
-		 *
-		 * At this point there are two possible things that have happened.
-		 *  1) The job at write_pos is pending to be executed by the thread
-		 *     we're currently in. Spin-locking until the job is free would
-		 *     result in a deadlock and is therefore not an option.
-		 *  2) The job at write_pos is pending or currently being processed by
-		 *     another thread, in which case it would be possible to wait
-		 *     until the slot frees up.
-		 *
-		 * The easiest thing to do here is to execute this job directly.
-		 */
+		/* no space left anywhere, the easiest thing to do is to execute it directly */
+		__sync_fetch_and_sub(&pool->num_queued, 1);
 		func(data);
-
-		/*
-		 * If in the meantime the job at write_pos has completed (and maybe
-		 * there are even more jobs queued up after write_pos, which is
-		 * entirely possible seeing as any proceeding calls to this function
-		 * will acquire a write_pos after this one), the thread which processed
-		 * the job will be dependent on the state of this job.
-		 *
-		 * We have an obligation to mark this slot as "invalid" - indicating
-		 * that this job slot has already been executed - and informing the
-		 * worker thread about it.
-		 *
-		 * If the job is still being processed then there is no need to set
-		 * this job as invalid. The worker thread will have no knowledge of
-		 * this job ever existing.
-		 */
-		__sync_bool_compare_and_swap(flag_ptr, FLAG_FREE_SLOT, FLAG_INVALID_JOB);
+		thread_pool_job_done(pool, counter);
+		return;
 	}
-	else
-	{
-		/*
-		 * Flag has been set to "write in progress", so the job can now be safely
-		 * copied into the target buffer.
-		 */
-		job = (struct thread_pool_job_t*)(ring_buffer->obj_buffer +
-				write_pos * ring_buffer->job_size_in_bytes);
 
-		job->func = func;
-		job->data = data;
+	/* one job needs one worker, spinning ones would have stolen it anyway */
+	if(__sync_fetch_and_add(&pool->num_sleeping, 0))
+		thread_pool_signal(&pool->work_event, 1);
 
-		/* buffer is ready for reading, update flag */
-		__sync_bool_compare_and_swap(flag_ptr, FLAG_WRITE_IN_PROGRESS, FLAG_FILLED_SLOT);
-	}
-
-	/* wake up all worker threads TODO: Slow as shit, use dummy work loads */
-	pthread_mutex_lock(&pool->worker[selected_worker].mutex);
-	pthread_cond_broadcast(&pool->worker[selected_worker].wakeup_cv);
-	pthread_mutex_unlock(&pool->worker[selected_worker].mutex);
+	/* waiting threads can help, too */
+	if(__sync_fetch_and_add(&pool->num_waiting, 0))
+		thread_pool_signal(&pool->finished_event, INT_MAX);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -408,81 +486,68 @@ thread_pool_queue(struct thread_pool_t* pool, thread_pool_job_func func, void* d
 static void*
 thread_pool_worker(struct thread_pool_worker_t* worker)
 {
-	struct thread_pool_job_t* job;
-	intptr_t read_pos;
-	DATA_POINTER_TYPE* flag_ptr;
+	struct thread_pool_t* pool = worker->pool;
+	struct thread_pool_job_t job;
+	int event;
+
+	t_worker = worker;
+	t_random = (uint32_t)(worker - pool->worker + 1) * 2654435761u;
 
 	/* keep executing jobs until the pool becomes inactive */
-	while(__sync_fetch_and_add(&worker->pool->active, 0))
+	while(__sync_fetch_and_add(&pool->active, 0))
 	{
-		/*
-		 * Fetch, increment and wrap read position of target ring buffer. This
-		 * operation will acquire a unique position in the ring buffer in which
-		 * to insert a new job.
-		 */
-		read_pos = __sync_fetch_and_add(&worker->ring_buffer.read_pos, 1) %
-				worker->ring_buffer.job_slots;
-
-		/* cache flag pointer, as it's used multiple times */
-		flag_ptr = worker->ring_buffer.flg_buffer + read_pos;
+		if(thread_pool_find_job(pool, worker, &job))
+		{
+			thread_pool_run_job(pool, &job);
+			continue;
+		}
 
 		/*
-		 * If the job at read_pos is filled, swap the flag with a
-		 * "read in progress". This operation will fail if there are no more
-		 * jobs.
+		 * A job was counted but not found. It's either being inserted right
+		 * now or another thief won the race for it, look again.
 		 */
-		if(!__sync_bool_compare_and_swap(flag_ptr, FLAG_FILLED_SLOT, FLAG_READ_IN_PROGRESS))
+		if(__sync_fetch_and_add(&pool->num_queued, 0) > 0)
 		{
-			/* signal that a job has been finished */
-			pthread_mutex_lock(&worker->pool->mutex);
-			pthread_cond_broadcast(&worker->pool->job_finished_cv);
-			pthread_mutex_unlock(&worker->pool->mutex);
-
-			/*
-			 * Wait for wakeup signal.
-			 * Wakeup should only occur if either the pool is shutting down,
-			 * or a job is available. Go back to sleep if a wakeup flag was
-			 * set by accident.
-			 */
-			pthread_mutex_lock(&worker->mutex);
-			while(__sync_fetch_and_add(&worker->pool->active, 0) &&
-			     !__sync_bool_compare_and_swap(flag_ptr, FLAG_FILLED_SLOT, FLAG_READ_IN_PROGRESS))
-			{
-				pthread_cond_wait(&worker->wakeup_cv, &worker->mutex);
-			}
+			sched_yield();
+			continue;
+		}
 
-			/* if the pool is no longer active, don't process the job */
-			if(!__sync_fetch_and_add(&worker->pool->active, 0))
+		/* spin for a while, for longer if that paid off the last time */
+		if(worker->spin_count)
+		{
+			if(thread_pool_spin(pool, NULL, worker->spin_count))
 			{
-				/*
-				 * Restore unprocessed job - required for suspend/resume.
-				 * Decrementing the read position doesn't mean the job was
-				 * lost, it just means this thread is giving up ownership
-				 * for this particular read position. When the pool is
-				 * resumed, the pending jobs will be picked up again.
-				 */
-				__sync_fetch_and_sub(&worker->ring_buffer.read_pos, 1);
-
-				pthread_mutex_unlock(&worker->mutex);
-				break;
+				if(worker->spin_count < pool->max_spin_count)
+					worker->spin_count *= 2;
+				continue;
 			}
-
-			pthread_mutex_unlock(&worker->mutex);
+			if(worker->spin_count > SPIN_COUNT_MIN)
+				worker->spin_count /= 2;
 		}
 
-		/* exec job and set flag to free once done */
-		job = (struct thread_pool_job_t*)(worker->ring_buffer.obj_buffer +
-				read_pos * worker->ring_buffer.job_size_in_bytes);
-
-		job->func(job->data);
-
-		/* job done, flag as free slot */
-		__sync_bool_compare_and_swap(flag_ptr, FLAG_READ_IN_PROGRESS, FLAG_FREE_SLOT);
+		/*
+		 * Wait for wakeup signal.
+		 * Wakeup should only occur if either the pool is shutting down,
+		 * or a job is available. The loop checks again if a wakeup
+		 * happened by accident.
+		 */
+		event = __sync_fetch_and_add(&pool->work_event, 0);
+		__sync_fetch_and_add(&pool->num_sleeping, 1);
+		if(__sync_fetch_and_add(&pool->active, 0) &&
+		   __sync_fetch_and_add(&pool->num_queued, 0) <= 0)
+		{
+			futex_wait(&pool->work_event, event);
+		}
+		__sync_fetch_and_sub(&pool->num_sleeping, 1);
 	}
 
-	pthread_mutex_lock(&worker->pool->mutex);
-	pthread_cond_broadcast(&worker->pool->job_finished_cv);
-	pthread_mutex_unlock(&worker->pool->mutex);
+	/*
+	 * Unprocessed jobs stay in the deques and the injection queue - required
+	 * for suspend/resume. When the pool is resumed, they will be picked up
+	 * again.
+	 */
+	t_worker = NULL;
+	thread_pool_signal(&pool->finished_event, INT_MAX);
 	pthread_exit(NULL);
 }
 
@@ -497,15 +562,12 @@ thread_pool_suspend(struct thread_pool_t* pool)
 		return;
 	__sync_and_and_fetch(&pool->active, 0); /* set to inactive */
 
+	/* sleeping workers check pool->active, which has now been set to 0 atomically */
+	thread_pool_signal(&pool->work_event, INT_MAX);
+
 	/* join worker threads */
 	for(i = 0; i != pool->num_threads; ++i)
-	{
-		pthread_mutex_lock(&pool->worker[i].mutex);
-		/* cv flag is pool->active, which has now been set to 0 atomically */
-		pthread_cond_broadcast(&pool->worker[i].wakeup_cv);
-		pthread_mutex_unlock(&pool->worker[i].mutex);
 		pthread_join(pool->worker[i].thread, NULL);
-	}
 }
 
 /* ------------------------------------------------------------------------- */
@@ -542,38 +604,300 @@ void
 thread_pool_wait_for_jobs(struct thread_pool_t* pool)
 {
 	/* wait for number of active jobs to drop to 0 */
-	pthread_mutex_lock(&pool->mutex);
-	while(__sync_fetch_and_add(&pool->num_jobs, 0))
-		pthread_cond_wait(&pool->job_finished_cv, &pool->mutex);
-	pthread_mutex_unlock(&pool->mutex);
+	thread_pool_wait_for_zero(pool, &pool->num_jobs);
 }
 
 /* ------------------------------------------------------------------------- */
 void
-ring_buffer_init_buffer(struct ring_buffer_t* rb,
-						uint32_t job_slots,
-						intptr_t job_size_in_bytes)
+thread_pool_wait_for_counter(struct thread_pool_t* pool,
+							 struct thread_pool_counter_t* counter)
+{
+	thread_pool_wait_for_zero(pool, &counter->value);
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+thread_pool_queued_jobs(struct thread_pool_t* pool)
 {
-	memset(rb, 0, sizeof(struct ring_buffer_t));
+	int queued = __sync_fetch_and_add(&pool->num_queued, 0);
+	return (queued > 0 ? (uint32_t)queued : 0);
+}
 
-	rb->job_slots = (job_slots != 0 ? job_slots : RING_BUFFER_DEFAULT_SLOT_COUNT);
-	rb->job_size_in_bytes = job_size_in_bytes;
+/* ------------------------------------------------------------------------- */
+char
+thread_pool_help(struct thread_pool_t* pool)
+{
+	struct thread_pool_worker_t* worker = t_worker;
+	struct thread_pool_job_t job;
+
+	if(worker && worker->pool != pool)
+		worker = NULL;
+	if(!thread_pool_find_job(pool, worker, &job))
+		return 0;
+	thread_pool_run_job(pool, &job);
+	return 1;
+}
 
-	/*
-	 * Allocate memory and set up pointers.
-	 * Flag buffer stores job_slots number of flags of type DATA_POINTER_TYPE
-	 * Object buffer stores job_slots number of jobs
-	 */
-	rb->flg_buffer = (DATA_POINTER_TYPE*)MALLOC(
-			rb->job_slots * sizeof(DATA_POINTER_TYPE) +                         /* flg buffer */
-			rb->job_slots * sizeof(DATA_POINTER_TYPE) * rb->job_size_in_bytes); /* obj buffer */
-	rb->obj_buffer = rb->flg_buffer + rb->job_slots;
+/* ------------------------------------------------------------------------- */
+static intptr_t
+thread_pool_slots_for_size(uint32_t size_in_bytes)
+{
+	intptr_t slots = 2;
+	while(slots * 2 * (intptr_t)sizeof(struct thread_pool_job_t) <= (intptr_t)size_in_bytes)
+		slots *= 2;
+	return slots;
 }
 
 /* ------------------------------------------------------------------------- */
-void
-ring_buffer_deinit_buffer(struct ring_buffer_t* rb)
+static char
+thread_pool_deque_init(struct thread_pool_deque_t* deque, uint32_t size_in_bytes)
+{
+	deque->top = 0;
+	deque->bottom = 0;
+	deque->mask = thread_pool_slots_for_size(size_in_bytes) - 1;
+	deque->job = (struct thread_pool_job_t*)MALLOC((deque->mask + 1) * sizeof(struct thread_pool_job_t));
+	return (deque->job != NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_deque_push(struct thread_pool_deque_t* deque,
+					   const struct thread_pool_job_t* job)
+{
+	intptr_t bottom = deque->bottom;
+
+	/* a thief may still be reading the slot of the oldest job */
+	if(bottom - deque->top > deque->mask)
+		return 0;
+
+	deque->job[bottom & deque->mask] = *job;
+
+	/* the job has to be visible before thieves can see it in the deque */
+	__sync_synchronize();
+	deque->bottom = bottom + 1;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_deque_pop(struct thread_pool_deque_t* deque,
+					  struct thread_pool_job_t* job)
+{
+	intptr_t bottom, top;
+
+	/* claim the newest job, then check whether a thief got there first */
+	bottom = deque->bottom - 1;
+	deque->bottom = bottom;
+	__sync_synchronize();
+	top = deque->top;
+
+	if(top > bottom)
+	{
+		/* empty */
+		deque->bottom = bottom + 1;
+		return 0;
+	}
+
+	*job = deque->job[bottom & deque->mask];
+	if(top != bottom)
+		return 1;
+
+	/* last job, race the thieves for it */
+	if(!__sync_bool_compare_and_swap(&deque->top, top, top + 1))
+	{
+		deque->bottom = bottom + 1;
+		return 0;
+	}
+	deque->bottom = bottom + 1;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_deque_steal(struct thread_pool_deque_t* deque,
+						struct thread_pool_job_t* job)
+{
+	intptr_t top, bottom;
+
+	top = deque->top;
+	__sync_synchronize();
+	bottom = deque->bottom;
+	if(top >= bottom)
+		return 0;
+
+	/* the owner can't reuse the slot before top moves past it */
+	*job = deque->job[top & deque->mask];
+	return __sync_bool_compare_and_swap(&deque->top, top, top + 1);
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_inject(struct thread_pool_t* pool,
+				   const struct thread_pool_job_t* job)
+{
+	struct thread_pool_job_t* ring;
+	intptr_t i, slots;
+
+	pthread_mutex_lock(&pool->inject_mutex);
+
+	if(pool->inject_count > pool->inject_mask)
+	{
+		/* full, double the size and unwrap the jobs into the new ring */
+		slots = (pool->inject_mask + 1) * 2;
+		if(slots * (intptr_t)sizeof(struct thread_pool_job_t) > (intptr_t)g_max_buffer_size ||
+		   !(ring = (struct thread_pool_job_t*)MALLOC(slots * sizeof(struct thread_pool_job_t))))
+		{
+			pthread_mutex_unlock(&pool->inject_mutex);
+			return 0;
+		}
+		for(i = 0; i != pool->inject_count; ++i)
+			ring[i] = pool->inject_job[(pool->inject_read + i) & pool->inject_mask];
+		FREE(pool->inject_job);
+		pool->inject_job = ring;
+		pool->inject_mask = slots - 1;
+		pool->inject_read = 0;
+	}
+
+	pool->inject_job[(pool->inject_read + pool->inject_count) & pool->inject_mask] = *job;
+	__sync_fetch_and_add(&pool->inject_count, 1);
+
+	pthread_mutex_unlock(&pool->inject_mutex);
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_take_injected(struct thread_pool_t* pool,
+						  struct thread_pool_job_t* job)
+{
+	/* don't bother locking an empty queue */
+	if(!__sync_fetch_and_add(&pool->inject_count, 0))
+		return 0;
+
+	pthread_mutex_lock(&pool->inject_mutex);
+	if(!pool->inject_count)
+	{
+		pthread_mutex_unlock(&pool->inject_mutex);
+		return 0;
+	}
+	*job = pool->inject_job[pool->inject_read & pool->inject_mask];
+	pool->inject_read = (pool->inject_read + 1) & pool->inject_mask;
+	__sync_fetch_and_sub(&pool->inject_count, 1);
+	pthread_mutex_unlock(&pool->inject_mutex);
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_find_job(struct thread_pool_t* pool,
+					 struct thread_pool_worker_t* worker,
+					 struct thread_pool_job_t* job)
+{
+	uint32_t first, i;
+
+	if(worker && thread_pool_deque_pop(&worker->deque, job))
+		return 1;
+	if(thread_pool_take_injected(pool, job))
+		return 1;
+
+	/* try every other worker once, starting at a random one */
+	t_random ^= t_random << 13;
+	t_random ^= t_random >> 17;
+	t_random ^= t_random << 5;
+	first = t_random % (uint32_t)pool->num_threads;
+	for(i = 0; i != (uint32_t)pool->num_threads; ++i)
+	{
+		struct thread_pool_worker_t* victim = pool->worker + (first + i) % (uint32_t)pool->num_threads;
+		if(victim != worker && thread_pool_deque_steal(&victim->deque, job))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+thread_pool_run_job(struct thread_pool_t* pool, const struct thread_pool_job_t* job)
 {
-	FREE(rb->flg_buffer);
-	memset(rb, 0, sizeof *rb);
+	__sync_fetch_and_sub(&pool->num_queued, 1);
+	job->func(job->data);
+	thread_pool_job_done(pool, job->counter);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+thread_pool_job_done(struct thread_pool_t* pool, struct thread_pool_counter_t* counter)
+{
+	char finished = 0;
+
+	if(counter && __sync_sub_and_fetch(&counter->value, 1) == 0)
+		finished = 1;
+	if(__sync_sub_and_fetch(&pool->num_jobs, 1) == 0)
+		finished = 1;
+
+	/* notify threads waiting for the last job of a group to finish */
+	if(finished && __sync_fetch_and_add(&pool->num_waiting, 0))
+		thread_pool_signal(&pool->finished_event, INT_MAX);
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+thread_pool_spin(struct thread_pool_t* pool, int* value, int spin_count)
+{
+	int i;
+
+	/* plain reads, so spinning threads don't fight over the cache lines */
+	for(i = 0; i != spin_count; ++i)
+	{
+		if(*(volatile int*)&pool->num_queued > 0 ||
+		   (value ? !*(volatile int*)value : !*(volatile char*)&pool->active))
+		{
+			return 1;
+		}
+		CPU_RELAX();
+	}
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+thread_pool_signal(int* event, int count)
+{
+	__sync_fetch_and_add(event, 1);
+	if(count == INT_MAX)
+		futex_wake_all(event);
+	else
+		futex_wake(event, count);
+}
+
+/* ------------------------------------------------------------------------- */
+static void
+thread_pool_wait_for_zero(struct thread_pool_t* pool, int* value)
+{
+	int event;
+
+	while(__sync_fetch_and_add(value, 0))
+	{
+		/* help out instead of blocking */
+		if(thread_pool_help(pool))
+			continue;
+
+		/*
+		 * Nothing left to take, the remaining jobs are being executed by
+		 * other threads. Sleep until one of them finishes or a new job can
+		 * be helped with.
+		 */
+		if(thread_pool_spin(pool, value, pool->max_spin_count))
+			continue;
+		event = __sync_fetch_and_add(&pool->finished_event, 0);
+		__sync_fetch_and_add(&pool->num_waiting, 1);
+		if(__sync_fetch_and_add(value, 0) &&
+		   __sync_fetch_and_add(&pool->num_queued, 0) <= 0)
+		{
+			futex_wait(&pool->finished_event, event);
+		}
+		__sync_fetch_and_sub(&pool->num_waiting, 1);
+	}
 }
@@ -0,0 +1,150 @@
+#include "thread_pool/task_graph.h"
+#include "util/memory.h"
+#include "util/atomic.h"
+#include <string.h>
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Job executing a task and queuing the tasks depending on it.
+ * @param data The task.
+ */
+static void
+task_execute(void* data);
+
+/* ------------------------------------------------------------------------- */
+struct task_graph_t*
+task_graph_create(struct thread_pool_t* pool)
+{
+	struct task_graph_t* graph;
+	if(!(graph = (struct task_graph_t*)MALLOC(sizeof(struct task_graph_t))))
+		return NULL;
+	memset(graph, 0, sizeof(struct task_graph_t));
+	graph->pool = pool;
+	unordered_vector_init_vector(&graph->tasks, sizeof(struct task_t*));
+	return graph;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+task_graph_destroy(struct task_graph_t* graph)
+{
+	UNORDERED_VECTOR_FOR_EACH(&graph->tasks, struct task_t*, task)
+		unordered_vector_clear_free(&(*task)->successors);
+		FREE(*task);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear_free(&graph->tasks);
+	FREE(graph);
+}
+
+/* ------------------------------------------------------------------------- */
+struct task_t*
+task_graph_add(struct task_graph_t* graph, thread_pool_job_func func, void* data)
+{
+	struct task_t* task;
+	if(!(task = (struct task_t*)MALLOC(sizeof(struct task_t))))
+		return NULL;
+	memset(task, 0, sizeof(struct task_t));
+	task->graph = graph;
+	task->func = func;
+	task->data = data;
+	unordered_vector_init_vector(&task->successors, sizeof(struct task_t*));
+
+	if(!unordered_vector_push(&graph->tasks, &task))
+	{
+		FREE(task);
+		return NULL;
+	}
+	return task;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+task_depends_on(struct task_t* task, struct task_t* prerequisite)
+{
+	if(task->graph != prerequisite->graph)
+		return 0;
+	if(!unordered_vector_push(&prerequisite->successors, &task))
+		return 0;
+	++task->prerequisite_count;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+struct task_t*
+task_then(struct task_graph_t* graph,
+		  struct task_t* task,
+		  thread_pool_job_func func,
+		  void* data)
+{
+	struct task_t* continuation;
+	if(!(continuation = task_graph_add(graph, func, data)))
+		return NULL;
+	if(!task_depends_on(continuation, task))
+	{
+		/* it was the last task pushed */
+		unordered_vector_pop(&graph->tasks);
+		unordered_vector_clear_free(&continuation->successors);
+		FREE(continuation);
+		return NULL;
+	}
+	return continuation;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+task_graph_dispatch(struct task_graph_t* graph)
+{
+	/* reset all counts before the first task can release any successors */
+	ATOMIC_STORE(graph->executed, 0);
+	UNORDERED_VECTOR_FOR_EACH(&graph->tasks, struct task_t*, task)
+		ATOMIC_STORE((*task)->remaining, (*task)->prerequisite_count);
+	UNORDERED_VECTOR_END_EACH
+
+	UNORDERED_VECTOR_FOR_EACH(&graph->tasks, struct task_t*, task)
+		if(!(*task)->prerequisite_count)
+			thread_pool_queue_counted(graph->pool, &graph->counter, task_execute, *task);
+	UNORDERED_VECTOR_END_EACH
+}
+
+/* ------------------------------------------------------------------------- */
+char
+task_graph_wait(struct task_graph_t* graph)
+{
+	thread_pool_wait_for_counter(graph->pool, &graph->counter);
+
+	/* tasks in a cycle are never released */
+	return (ATOMIC_LOAD(graph->executed) == (int)unordered_vector_count(&graph->tasks));
+}
+
+/* ------------------------------------------------------------------------- */
+char
+task_graph_run(struct task_graph_t* graph)
+{
+	task_graph_dispatch(graph);
+	return task_graph_wait(graph);
+}
+
+/* ----------------------------------------------------------------------------
+ * Static functions
+ * ------------------------------------------------------------------------- */
+static void
+task_execute(void* data)
+{
+	struct task_t* task = (struct task_t*)data;
+	struct task_graph_t* graph = task->graph;
+
+	task->func(task->data);
+	ATOMIC_INCREMENT(graph->executed);
+
+	/*
+	 * The counter still includes this task, so the graph can't be considered
+	 * finished before its successors are queued.
+	 */
+	UNORDERED_VECTOR_FOR_EACH(&task->successors, struct task_t*, successor)
+		if(ATOMIC_DECREMENT((*successor)->remaining) == 0)
+			thread_pool_queue_counted(graph->pool, &graph->counter, task_execute, *successor);
+	UNORDERED_VECTOR_END_EACH
+}
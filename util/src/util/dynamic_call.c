@@ -1,4 +1,6 @@
 #include "util/dynamic_call.h"
+#include "util/atomic.h"
+#include "util/bst_vector.h"
 #include "util/memory.h"
 #include "util/ordered_vector.h"
 #include "util/string.h"
@@ -6,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 
 /*!
  * If the type being inserted into the argument vector is equal or smaller
@@ -64,72 +67,372 @@
 		argv[i] = MALLOC(sizeof(value_t));                                  \
 		*(value_t*)argv[i] = (value_t)extract_func; } while(0)
 
+/*!
+ * The layout above is what the dynamic_call_set_argument_vector_*() functions
+ * expect. Argument vectors made by the create and init functions are a
+ * superset of it: Everything lives in a single block, so building one costs
+ * at most one allocation, and destroying it at most one free. Every value
+ * gets an 8 byte slot, so no type ever needs its own allocation, and strings
+ * are copied to the end of the block:
+ *
+ *     |argv[0..argc-1]|value slots|string bytes|
+ *
+ * Blocks allocated by the create functions are preceded by a header. Blocks
+ * with room for a few short strings are kept in a small free list on the
+ * type info once destroyed, so vectors built over and over for the same
+ * signature (menu actions, script calls) don't allocate at all.
+ */
+#define VALUE_SLOT_SIZE 8
+#define ALIGN_UP(x, alignment) (((x) + (alignment) - 1) / (alignment) * (alignment))
+
+/* blocks with up to this many string bytes are pooled */
+#define ARGV_POOL_STRING_SIZE 128
+#define ARGV_POOL_MAX_BLOCKS 4
+
+/* writes an argument of a known type into its slot */
+#define STORE_ARGUMENT_IN_SLOT(value_t, extract_func) do {                  \
+		argv[i] = values + i * VALUE_SLOT_SIZE;                             \
+		*(value_t*)argv[i] = (value_t)extract_func; } while(0)
+
+union argv_block_t
+{
+	struct
+	{
+		union argv_block_t* next_free;
+		uint32_t size;      /* bytes available after the header */
+		char pooled;        /* size is the pool's block size */
+	} info;
+	double align_double;
+	int64_t align_int64;
+};
+
+/*
+ * Type info objects are interned: Every distinct signature exists exactly
+ * once and is shared by everyone who creates it, so two type infos with the
+ * same signature are the same object. They are indexed by signature hash.
+ * Signatures with colliding hashes are chained through next_interned.
+ */
+static struct bstv_t g_type_infos;
+static char g_type_infos_initialised = 0;
+
+/* creating and destroying events and services isn't limited to one thread */
+#ifdef ENABLE_MULTITHREADING
+static int g_type_infos_lock = 0;
+#endif
+#define TYPE_INFOS_LOCK() SPIN_LOCK(g_type_infos_lock)
+#define TYPE_INFOS_UNLOCK() SPIN_UNLOCK(g_type_infos_lock)
+
+/* the pool is a cache and therefore modified through const type infos */
+#define ARGV_POOL_LOCK(type_info) SPIN_LOCK(((struct type_info_t*)(type_info))->argv_pool_lock)
+#define ARGV_POOL_UNLOCK(type_info) SPIN_UNLOCK(((struct type_info_t*)(type_info))->argv_pool_lock)
+
+/* Jenkins one at a time hash, fed one type at a time */
+#define SIGNATURE_HASH_ADD(hash, value) do {                                \
+		(hash) += (uint32_t)(value);                                        \
+		(hash) += ((hash) << 10);                                           \
+		(hash) ^= ((hash) >> 6); } while(0)
+#define SIGNATURE_HASH_FINISH(hash) do {                                    \
+		(hash) += ((hash) << 3);                                            \
+		(hash) ^= ((hash) >> 11);                                           \
+		(hash) += ((hash) << 15); } while(0)
+
+/*
+ * Type names are looked up in a minimal perfect hash table: The hash of the
+ * normalised name selects a bucket, and the bucket's seed scrambles the same
+ * hash into the only slot the name can be in. The tables are generated by
+ * scripts/gen-type-name-hash.py, which also lists all accepted spellings.
+ */
+struct type_name_t
+{
+	const char* name;
+	type_e type;
+};
+
+#define IS_TYPE_NAME_CHAR(c) (                                              \
+		((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') ||         \
+		((c) >= '0' && (c) <= '9') || (c) == '_')
+
+/* 32-bit FNV-1a, must match type_name_hash() in the script */
+#define TYPE_NAME_HASH_INIT 2166136261u
+#define TYPE_NAME_HASH_ADD(hash, c) do {                                    \
+		(hash) ^= (unsigned char)(c);                                       \
+		(hash) *= 16777619u; } while(0)
+
+/* murmur3 finaliser, must match type_name_slot() in the script */
+#define TYPE_NAME_SLOT(slot, hash, seed) do {                               \
+		(slot) = (hash) ^ (uint32_t)(seed);                                 \
+		(slot) ^= (slot) >> 16;                                             \
+		(slot) *= 0x85EBCA6Bu;                                              \
+		(slot) ^= (slot) >> 13;                                             \
+		(slot) *= 0xC2B2AE35u;                                              \
+		(slot) ^= (slot) >> 16;                                             \
+		(slot) %= TYPE_NAME_COUNT; } while(0)
+
+/* for types whose size depends on the platform */
+#define TYPE_NAME_INT(size) (                                               \
+		(size) == 1 ? TYPE_INT8 : (size) == 2 ? TYPE_INT16 :                \
+		(size) == 4 ? TYPE_INT32 : TYPE_INT64)
+#define TYPE_NAME_UINT(size) (TYPE_NAME_INT(size) + 1)
+#define TYPE_NAME_WSTRING(char_size) (                                      \
+		sizeof(wchar_t) == (char_size) ? TYPE_WSTRING : TYPE_UNKNOWN)
+
+/* generated by scripts/gen-type-name-hash.py - do not edit */
+#define TYPE_NAME_MAX_LENGTH 22
+#define TYPE_NAME_COUNT 65
+static const uint8_t g_type_name_seeds[TYPE_NAME_COUNT] = {
+	0, 0, 0, 0, 4, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0, 0,
+	8, 0, 0, 4, 0, 1, 8, 1, 0, 0, 1, 0, 0, 0, 0, 0,
+	0, 1, 0, 5, 0, 0, 24, 4, 13, 4, 5, 0, 0, 1, 0, 0,
+	12, 3, 0, 0, 0, 0, 2, 0, 3, 18, 10, 48, 28, 0, 1, 32,
+	20,
+};
+static const struct type_name_t g_type_names[TYPE_NAME_COUNT] = {
+	{"unsigned short int",      TYPE_UINT16},
+	{"double",                  TYPE_DOUBLE},
+	{"unsigned int32_t",        TYPE_UINT32},
+	{"char16_t*",               TYPE_NAME_WSTRING(2)},
+	{"char*",                   TYPE_STRING},
+	{"signed char",             TYPE_INT8},
+	{"unsigned int64_t",        TYPE_UINT64},
+	{"int16",                   TYPE_INT16},
+	{"unsigned int8_t",         TYPE_UINT8},
+	{"int8_t",                  TYPE_INT8},
+	{"signed long long int",    TYPE_INT64},
+	{"int",                     TYPE_INT32},
+	{"int64_t",                 TYPE_INT64},
+	{"long long int",           TYPE_INT64},
+	{"int32_t",                 TYPE_INT32},
+	{"int_fast32_t",            TYPE_NAME_INT(sizeof(int_fast32_t))},
+	{"signed char*",            TYPE_STRING},
+	{"signed long int",         TYPE_NAME_INT(sizeof(long))},
+	{"unsigned char",           TYPE_UINT8},
+	{"uint",                    TYPE_UINT32},
+	{"uint_fast16_t",           TYPE_NAME_UINT(sizeof(uint_fast16_t))},
+	{"uint16_t",                TYPE_UINT16},
+	{"uint_fast32_t",           TYPE_NAME_UINT(sizeof(uint_fast32_t))},
+	{"int16_t",                 TYPE_INT16},
+	{"unsigned long long int",  TYPE_UINT64},
+	{"void",                    TYPE_VOID},
+	{"signed short int",        TYPE_INT16},
+	{"char32_t*",               TYPE_NAME_WSTRING(4)},
+	{"char",                    TYPE_INT8},
+	{"uint_least64_t",          TYPE_NAME_UINT(sizeof(uint_least64_t))},
+	{"intptr_t",                TYPE_INTPTR},
+	{"uint_fast8_t",            TYPE_NAME_UINT(sizeof(uint_fast8_t))},
+	{"int_fast64_t",            TYPE_NAME_INT(sizeof(int_fast64_t))},
+	{"long int",                TYPE_NAME_INT(sizeof(long))},
+	{"int_fast8_t",             TYPE_NAME_INT(sizeof(int_fast8_t))},
+	{"int_least32_t",           TYPE_NAME_INT(sizeof(int_least32_t))},
+	{"uint64_t",                TYPE_UINT64},
+	{"unsigned long int",       TYPE_NAME_UINT(sizeof(long))},
+	{"int_fast16_t",            TYPE_NAME_INT(sizeof(int_fast16_t))},
+	{"unsigned int16_t",        TYPE_UINT16},
+	{"float",                   TYPE_FLOAT},
+	{"uint64",                  TYPE_UINT64},
+	{"int_least16_t",           TYPE_NAME_INT(sizeof(int_least16_t))},
+	{"unsigned int",            TYPE_UINT32},
+	{"int_least8_t",            TYPE_NAME_INT(sizeof(int_least8_t))},
+	{"uint_least8_t",           TYPE_NAME_UINT(sizeof(uint_least8_t))},
+	{"uint8",                   TYPE_UINT8},
+	{"int64",                   TYPE_INT64},
+	{"unsigned char*",          TYPE_STRING},
+	{"wchar_t*",                TYPE_WSTRING},
+	{"int_least64_t",           TYPE_NAME_INT(sizeof(int_least64_t))},
+	{"signed int",              TYPE_INT32},
+	{"int32",                   TYPE_INT32},
+	{"short int",               TYPE_INT16},
+	{"uint8_t",                 TYPE_UINT8},
+	{"uintptr_t",               TYPE_UINTPTR},
+	{"uint_least16_t",          TYPE_NAME_UINT(sizeof(uint_least16_t))},
+	{"unsigned",                TYPE_UINT32},
+	{"uint_least32_t",          TYPE_NAME_UINT(sizeof(uint_least32_t))},
+	{"uint32_t",                TYPE_UINT32},
+	{"uint16",                  TYPE_UINT16},
+	{"uint32",                  TYPE_UINT32},
+	{"uint_fast64_t",           TYPE_NAME_UINT(sizeof(uint_fast64_t))},
+	{"int8",                    TYPE_INT8},
+	{"signed",                  TYPE_INT32},
+};
+/* end of generated code */
+
+/* ------------------------------------------------------------------------- */
+/* Static functions */
+/* ------------------------------------------------------------------------- */
+
+/*!
+ * @brief Computes the hash of a stringified signature.
+ */
+static uint32_t
+dynamic_call_hash_signature(const char* ret_type, int argc, const char** argv);
+
+/*!
+ * @brief Returns the interned type info matching a stringified signature, or
+ * NULL if it doesn't exist. The lock must be held.
+ */
+static struct type_info_t*
+dynamic_call_find_type_info(uint32_t hash, const char* ret_type, int argc, const char** argv);
+
+/*!
+ * @brief Returns the size of the pointers and value slots of a block.
+ */
+static uint32_t
+dynamic_call_get_fixed_size(const struct type_info_t* type_info);
+
+/*!
+ * @brief Returns the size of the block the varargs would need, or 0 if one
+ * of the types can't be passed.
+ */
+static uint32_t
+dynamic_call_get_size_from_varargs(const struct type_info_t* type_info, va_list ap);
+
+/*!
+ * @brief Builds an argument vector into a block at least as large as
+ * returned by the matching size function.
+ * @return Returns 0 if one of the types can't be passed, 1 if otherwise.
+ */
+static char
+dynamic_call_fill_from_strings(const struct type_info_t* type_info,
+							   void** argv,
+							   const struct ordered_vector_t* strings);
+static char
+dynamic_call_fill_from_varargs(const struct type_info_t* type_info,
+							   void** argv,
+							   va_list ap);
+
+/*!
+ * @brief Takes a block from the type info's pool, or allocates one.
+ * @return Returns the argument vector stored in the block.
+ */
+static void**
+dynamic_call_alloc_argument_vector(const struct type_info_t* type_info, uint32_t size);
+
 /* ------------------------------------------------------------------------- */
 struct type_info_t*
 dynamic_call_create_type_info(const char* ret_type, int argc, const char** argv)
 {
 	struct type_info_t* type_info;
+	uint32_t hash;
 
 	assert(ret_type);
 	if(argc)
 		assert(argv);
 
-	/* allocate and initialise type info object */
-	if(!(type_info = (struct type_info_t*)MALLOC(sizeof(struct type_info_t))))
+	hash = dynamic_call_hash_signature(ret_type, argc, argv);
+
+	TYPE_INFOS_LOCK();
+	if(!g_type_infos_initialised)
 	{
+		bstv_init_bstv(&g_type_infos);
+		g_type_infos_initialised = 1;
+	}
+
+	/* share the existing object if the signature is known */
+	if((type_info = dynamic_call_find_type_info(hash, ret_type, argc, argv)))
+	{
+		++type_info->refcount;
+		TYPE_INFOS_UNLOCK();
+		return type_info;
+	}
+
+	/* the argument types are stored in the same block, after the object */
+	type_info = (struct type_info_t*)MALLOC(sizeof(struct type_info_t) + argc * sizeof(type_e));
+	if(!type_info)
+	{
+		TYPE_INFOS_UNLOCK();
 		fprintf(stderr, "malloc() failed in dynamic_call_create_type_info() -- not enough memory\n");
 		return NULL;
 	}
-	memset(type_info, 0, sizeof(struct type_info_t));
+	memset(type_info, 0, sizeof(struct type_info_t) + argc * sizeof(type_e));
+	type_info->argv_type = (type_e*)(type_info + 1);
+	type_info->hash = hash;
+	type_info->refcount = 1;
 
-	for(;;) /* break from here if something goes wrong */
-	{
-		type_info->has_unknown_types = 0; /* will be set to 1 during parsing
-		                                   * if an unknown type is found */
-
-		/*
-		 * The return type string is parsed to determine if the type is known
-		 * or not and the result is stored.
-		 */
-		type_info->ret_type = dynamic_call_get_type_from_string(ret_type);
-		if(type_info->ret_type == TYPE_UNKNOWN)
-			type_info->has_unknown_types = 1;
-
-		/*
-		 * Each argument type string is parsed and it is determined if the type
-		 * is known or not. The results are stored in an array.
-		 */
-		if(!(type_info->argv_type = (type_e*)MALLOC(argc * sizeof(type_e))))
-			break;
-		memset(type_info->argv_type, 0, argc * sizeof(type_e));
-		{   int i;
-			for(i = 0; i != argc; ++i)
-			{
-				type_info->argv_type[i] = dynamic_call_get_type_from_string(argv[i]);
-				if(type_info->argv_type[i] == TYPE_UNKNOWN)
-					type_info->has_unknown_types = 1;
+	/* will be set to 1 during parsing if an unknown type is found */
+	type_info->has_unknown_types = 0;
 
-				++type_info->argc;
-			}
-		}
+	/*
+	 * The return type string is parsed to determine if the type is known
+	 * or not and the result is stored.
+	 */
+	type_info->ret_type = dynamic_call_get_type_from_string(ret_type);
+	if(type_info->ret_type == TYPE_UNKNOWN)
+		type_info->has_unknown_types = 1;
 
-		/* success! */
-		return type_info;
+	/*
+	 * Each argument type string is parsed and it is determined if the type
+	 * is known or not. The results are stored in an array.
+	 */
+	{   int i;
+		for(i = 0; i != argc; ++i)
+		{
+			type_info->argv_type[i] = dynamic_call_get_type_from_string(argv[i]);
+			if(type_info->argv_type[i] == TYPE_UNKNOWN)
+				type_info->has_unknown_types = 1;
+
+			++type_info->argc;
+		}
 	}
 
-	/* something went wrong, clean up everything */
-	dynamic_call_destroy_type_info(type_info);
+	/* chain to objects with the same hash, if any */
+	if((type_info->next_interned = (struct type_info_t*)bstv_find(&g_type_infos, hash)))
+		bstv_set(&g_type_infos, hash, type_info);
+	else if(!bstv_insert(&g_type_infos, hash, type_info))
+	{
+		TYPE_INFOS_UNLOCK();
+		FREE(type_info);
+		fprintf(stderr, "malloc() failed in dynamic_call_create_type_info() -- not enough memory\n");
+		return NULL;
+	}
 
-	return NULL;
+	TYPE_INFOS_UNLOCK();
+	return type_info;
 }
 
 /* ------------------------------------------------------------------------- */
 void
 dynamic_call_destroy_type_info(struct type_info_t* type_info)
 {
-	/* free argument type info array */
-	if(type_info->argv_type)
-		FREE(type_info->argv_type);
+	struct type_info_t** link;
+
+	assert(type_info);
+
+	TYPE_INFOS_LOCK();
+	if(--type_info->refcount)
+	{
+		TYPE_INFOS_UNLOCK();
+		return;
+	}
+
+	/* unlink from the chain of objects with the same hash */
+	if(bstv_find(&g_type_infos, type_info->hash) == type_info)
+	{
+		if(type_info->next_interned)
+			bstv_set(&g_type_infos, type_info->hash, type_info->next_interned);
+		else
+			bstv_erase(&g_type_infos, type_info->hash);
+	}
+	else
+	{
+		for(link = &((struct type_info_t*)bstv_find(&g_type_infos, type_info->hash))->next_interned;
+			*link != type_info;
+			link = &(*link)->next_interned) {}
+		*link = type_info->next_interned;
+	}
+
+	/* release the table's memory once nothing is interned anymore */
+	if(!g_type_infos.vector.count)
+	{
+		bstv_clear_free(&g_type_infos);
+		g_type_infos_initialised = 0;
+	}
+	TYPE_INFOS_UNLOCK();
+
+	while(type_info->argv_pool)
+	{
+		union argv_block_t* block = (union argv_block_t*)type_info->argv_pool;
+		type_info->argv_pool = block->info.next_free;
+		FREE(block);
+	}
 
 	FREE(type_info);
 }
@@ -141,31 +444,22 @@ dynamic_call_create_argument_vector_from_strings(
 		const struct ordered_vector_t* strings)
 {
 	void** ret;
+	uint32_t size;
 
 	assert(type_info);
 	assert(strings);
 
-	/* check argument count */
-	if(type_info->argc != strings->count)
-	{
-		fprintf(stderr, "Cannot create argument list: Wrong number of arguments\n");
-		fprintf(stderr, "    Required: %d\n", type_info->argc);
-		fprintf(stderr, "    Provided: %d\n", strings->count);
+	if(!(size = dynamic_call_get_argument_vector_size_from_strings(type_info, strings)))
 		return NULL;
-	}
 
-	/* create void** argument vector */
-	/* reserve double the space for when values smaller than the size of void*
-	 * are copied into the argument vector directly */
-	ret = (void**)MALLOC(type_info->argc * sizeof(void*) * 2);
-	if(!ret)
+	if(!(ret = dynamic_call_alloc_argument_vector(type_info, size)))
 	{
 		fprintf(stderr, "malloc() failed in dynamic_call_create_argument_vector_from_strings() -- not enough memory\n");
 		return NULL;
 	}
 
 	/* fill out argument vector with the arguments in the string vector */
-	if(!dynamic_call_set_argument_vector_from_strings(type_info, ret, strings))
+	if(!dynamic_call_fill_from_strings(type_info, ret, strings))
 	{
 		dynamic_call_destroy_argument_vector(type_info, ret);
 		return NULL;
@@ -174,6 +468,70 @@ dynamic_call_create_argument_vector_from_strings(
 	return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+uint32_t
+dynamic_call_get_argument_vector_size_from_strings(
+		const struct type_info_t* type_info,
+		const struct ordered_vector_t* strings)
+{
+	uint32_t i, size;
+
+	assert(type_info);
+	assert(strings);
+
+	/* check argument count */
+	if(type_info->argc != strings->count)
+	{
+		fprintf(stderr, "Cannot create argument list: Wrong number of arguments\n");
+		fprintf(stderr, "    Required: %d\n", type_info->argc);
+		fprintf(stderr, "    Provided: %d\n", strings->count);
+		return 0;
+	}
+
+	size = dynamic_call_get_fixed_size(type_info);
+	i = 0;
+	ORDERED_VECTOR_FOR_EACH(strings, const char*, str_p)
+		switch(type_info->argv_type[i++])
+		{
+			case TYPE_STRING:
+				size += (uint32_t)strlen(*str_p) + 1;
+				break;
+			case TYPE_WSTRING:
+				size = ALIGN_UP(size, sizeof(wchar_t));
+				size += ((uint32_t)strlen(*str_p) + 1) * sizeof(wchar_t);
+				break;
+			default:
+				break;
+		}
+	ORDERED_VECTOR_END_EACH
+
+	/* an empty vector still needs a non-zero size to tell it from failure */
+	return size ? size : 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void**
+dynamic_call_init_argument_vector_from_strings(
+		const struct type_info_t* type_info,
+		const struct ordered_vector_t* strings,
+		void* storage,
+		uint32_t storage_size)
+{
+	uint32_t size;
+
+	assert(type_info);
+	assert(strings);
+	assert(storage);
+
+	if(!(size = dynamic_call_get_argument_vector_size_from_strings(type_info, strings)))
+		return NULL;
+	if(size > storage_size)
+		return NULL;
+	if(!dynamic_call_fill_from_strings(type_info, (void**)storage, strings))
+		return NULL;
+	return (void**)storage;
+}
+
 /* ------------------------------------------------------------------------- */
 char
 dynamic_call_set_argument_vector_from_strings(
@@ -281,21 +639,26 @@ vdynamic_call_create_argument_vector_from_varargs(
 		const struct type_info_t* type_info, va_list ap)
 {
 	void** ret;
+	uint32_t size;
+	va_list size_ap;
 
 	assert(type_info);
 
-	/* create void** argument vector */
-	/* reserve double the space for when values smaller than the size of void*
-	 * are copied into the argument vector directly */
-	ret = (void**)MALLOC(type_info->argc * sizeof(void*) * 2);
-	if(!ret)
+	/* the strings have to be measured before anything can be copied */
+	va_copy(size_ap, ap);
+	size = dynamic_call_get_size_from_varargs(type_info, size_ap);
+	va_end(size_ap);
+	if(!size)
+		return NULL;
+
+	if(!(ret = dynamic_call_alloc_argument_vector(type_info, size)))
 	{
-		fprintf(stderr, "malloc() failed in dynamic_call_create_argument_vector_from_strings() -- not enough memory\n");
+		fprintf(stderr, "malloc() failed in dynamic_call_create_argument_vector_from_varargs() -- not enough memory\n");
 		return NULL;
 	}
 
 	/* fill out argument vector with the arguments in the va_list */
-	if(!vdynamic_call_set_argument_vector_from_varargs(type_info, ret, ap))
+	if(!dynamic_call_fill_from_varargs(type_info, ret, ap))
 	{
 		dynamic_call_destroy_argument_vector(type_info, ret);
 		return NULL;
@@ -304,6 +667,45 @@ vdynamic_call_create_argument_vector_from_varargs(
 	return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+void**
+dynamic_call_init_argument_vector_from_varargs(
+		const struct type_info_t* type_info,
+		void* storage,
+		uint32_t storage_size,
+		...)
+{
+	va_list ap;
+	void** ret;
+	va_start(ap, storage_size);
+	ret = vdynamic_call_init_argument_vector_from_varargs(type_info, storage, storage_size, ap);
+	va_end(ap);
+	return ret;
+}
+
+void**
+vdynamic_call_init_argument_vector_from_varargs(
+		const struct type_info_t* type_info,
+		void* storage,
+		uint32_t storage_size,
+		va_list ap)
+{
+	uint32_t size;
+	va_list size_ap;
+
+	assert(type_info);
+	assert(storage);
+
+	va_copy(size_ap, ap);
+	size = dynamic_call_get_size_from_varargs(type_info, size_ap);
+	va_end(size_ap);
+	if(!size || size > storage_size)
+		return NULL;
+	if(!dynamic_call_fill_from_varargs(type_info, (void**)storage, ap))
+		return NULL;
+	return (void**)storage;
+}
+
 /* ------------------------------------------------------------------------- */
 char
 dynamic_call_set_argument_vector_from_varargs(
@@ -409,50 +811,46 @@ void
 dynamic_call_destroy_argument_vector(const struct type_info_t* type_info,
 									 void** argv)
 {
+	union argv_block_t* block = (union argv_block_t*)argv - 1;
+	const char* begin = (const char*)argv;
+	const char* end = begin + block->info.size;
 	uint32_t i;
+
+	/*
+	 * Arguments that point outside of the block were written by one of the
+	 * dynamic_call_set_argument_vector_*() functions and are on the heap.
+	 */
 	for(i = 0; i != type_info->argc; ++i)
 	{
+		if(!argv[i] || ((const char*)argv[i] >= begin && (const char*)argv[i] < end))
+			continue;
 		switch(type_info->argv_type[i])
 		{
-			/* free strings */
 			case TYPE_STRING:
 			case TYPE_WSTRING:
 				free_string(argv[i]);
 				break;
-
-			/* nothing to free */
-			case TYPE_INT8:
-			case TYPE_UINT8:
-				break;
-
-			/* free 16-64 bit integers, floats, and doubles */
-#if SIZEOF_VOID_PTR < 2
-			case TYPE_INT16:
-			case TYPE_UINT16:
-#endif
-#if SIZEOF_VOID_PTR < 4
-			case TYPE_INT32:
-			case TYPE_UINT32:
-#endif
-#if SIZEOF_VOID_PTR < 8
-			case TYPE_INT64:
-			case TYPE_UINT64:
-#endif
-#if SIZEOF_VOID_PTR < SIZEOF_FLOAT
-			case TYPE_FLOAT:
-#endif
-#if SIZEOF_VOID_PTR < SIZEOF_DOUBLE
-			case TYPE_DOUBLE:
-#endif
+			default:
 				FREE(argv[i]);
 				break;
+		}
+	}
 
-			default:
-				break;
+	if(block->info.pooled)
+	{
+		ARGV_POOL_LOCK(type_info);
+		if(type_info->argv_pool_count < ARGV_POOL_MAX_BLOCKS)
+		{
+			block->info.next_free = (union argv_block_t*)type_info->argv_pool;
+			((struct type_info_t*)type_info)->argv_pool = block;
+			++((struct type_info_t*)type_info)->argv_pool_count;
+			block = NULL;
 		}
+		ARGV_POOL_UNLOCK(type_info);
 	}
 
-	FREE(argv);
+	if(block)
+		FREE(block);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -462,33 +860,97 @@ dynamic_call_do_typecheck(const struct type_info_t* type_info,
 						  uint32_t argc,
 						  const char** argv)
 {
+	const struct type_info_t* expected;
 	uint32_t i;
 
-	/* verify argument count */
-	if(argc != type_info->argc)
-	{
+	if(!ret_type)
 		return 0;
-	}
+	for(i = 0; i != argc; ++i)
+		if(!argv[i])
+			return 0;
+
+	/* type infos are interned, so the signatures match if the objects do */
+	TYPE_INFOS_LOCK();
+	expected = (g_type_infos_initialised ?
+		dynamic_call_find_type_info(dynamic_call_hash_signature(ret_type, argc, argv),
+									ret_type, argc, argv) :
+		NULL);
+	TYPE_INFOS_UNLOCK();
 
-	/* verify return type */
-	if(!ret_type ||
-		dynamic_call_get_type_from_string(ret_type) != type_info->ret_type)
+	return dynamic_call_type_info_equal(type_info, expected);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+dynamic_call_type_info_equal(const struct type_info_t* a,
+							 const struct type_info_t* b)
+{
+	return a == b;
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+dynamic_call_get_type_size(type_e type)
+{
+	switch(type)
 	{
-		return 0;
+		case TYPE_INT8:    return sizeof(int8_t);
+		case TYPE_UINT8:   return sizeof(uint8_t);
+		case TYPE_INT16:   return sizeof(int16_t);
+		case TYPE_UINT16:  return sizeof(uint16_t);
+		case TYPE_INT32:   return sizeof(int32_t);
+		case TYPE_UINT32:  return sizeof(uint32_t);
+		case TYPE_INT64:   return sizeof(int64_t);
+		case TYPE_UINT64:  return sizeof(uint64_t);
+		case TYPE_INTPTR:  return sizeof(intptr_t);
+		case TYPE_UINTPTR: return sizeof(uintptr_t);
+		case TYPE_FLOAT:   return sizeof(float);
+		case TYPE_DOUBLE:  return sizeof(double);
+		case TYPE_STRING:  return sizeof(char*);
+		case TYPE_WSTRING: return sizeof(wchar_t*);
+		default:           return 0;
 	}
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+dynamic_call_hash_signature(const char* ret_type, int argc, const char** argv)
+{
+	uint32_t hash = 0;
+	int i;
 
-	/* verify argument types */
+	SIGNATURE_HASH_ADD(hash, dynamic_call_get_type_from_string(ret_type));
+	SIGNATURE_HASH_ADD(hash, argc);
 	for(i = 0; i != argc; ++i)
+		SIGNATURE_HASH_ADD(hash, dynamic_call_get_type_from_string(argv[i]));
+	SIGNATURE_HASH_FINISH(hash);
+
+	return hash;
+}
+
+/* ------------------------------------------------------------------------- */
+static struct type_info_t*
+dynamic_call_find_type_info(uint32_t hash, const char* ret_type, int argc, const char** argv)
+{
+	struct type_info_t* type_info;
+	int i;
+
+	for(type_info = (struct type_info_t*)bstv_find(&g_type_infos, hash);
+		type_info;
+		type_info = type_info->next_interned)
 	{
-		if(!argv[i] ||
-			dynamic_call_get_type_from_string(argv[i]) != type_info->argv_type[i])
-		{
-			return 0;
-		}
+		if(type_info->argc != (uint32_t)argc)
+			continue;
+		if(type_info->ret_type != dynamic_call_get_type_from_string(ret_type))
+			continue;
+		for(i = 0; i != argc; ++i)
+			if(type_info->argv_type[i] != dynamic_call_get_type_from_string(argv[i]))
+				break;
+		if(i == argc)
+			return type_info;
 	}
 
-	/* valid! */
-	return 1;
+	return NULL;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -497,107 +959,273 @@ dynamic_call_do_typecheck(const struct type_info_t* type_info,
 type_e
 dynamic_call_get_type_from_string(const char* type)
 {
-	/* integers */
-	if(strstr(type, "int"))
+	char name[TYPE_NAME_MAX_LENGTH + 1];
+	const struct type_name_t* entry;
+	uint32_t len = 0, hash = TYPE_NAME_HASH_INIT, slot;
+
+	/*
+	 * Normalise and hash the spelling in one pass: Qualifiers are dropped,
+	 * words are separated by exactly one space and there is no space before
+	 * a '*'. Anything too long to be one of the accepted spellings is
+	 * unknown.
+	 */
+	while(*type)
 	{
-		/*
-		 * Here we inspect the string to be any of the following:
-		 * int, int8_t, int16_t, int32_t, int64_t, intptr_t and all of their
-		 * unsigned counterparts.
-		 */
-
-		/* default to an int32 */
-		type_e ret = TYPE_INT32;
-
-		/* reject pointer types */
-		if(strchr(type, '*'))
-			return TYPE_UNKNOWN;
-		/* intptr_t */
-		if(strstr(type, "intptr"))
-			ret = TYPE_INTPTR;
-		/* number of bits */
-		else if(strchr(type, '8'))
-			ret = TYPE_INT8;
-		else if(strstr(type, "16"))
-			ret = TYPE_INT16;
-		else if(strstr(type, "32"))
-			ret = TYPE_INT32;
-		else if(strstr(type, "64"))
-			ret = TYPE_INT64;
-
-		/* sign */
-		if(strchr(type, 'u'))
-			++ret; /* see enum in header file on why this works */
-		return ret;
+		if(IS_TYPE_NAME_CHAR(*type))
+		{
+			const char* word = type;
+			uint32_t word_len;
+			while(IS_TYPE_NAME_CHAR(*type))
+				++type;
+			word_len = (uint32_t)(type - word);
+			if((word_len == 5 && memcmp(word, "const", 5) == 0) ||
+			   (word_len == 8 && memcmp(word, "volatile", 8) == 0))
+				continue;
+			if(len + (len != 0) + word_len > TYPE_NAME_MAX_LENGTH)
+				return TYPE_UNKNOWN;
+			if(len)
+			{
+				name[len++] = ' ';
+				TYPE_NAME_HASH_ADD(hash, ' ');
+			}
+			for(; word != type; ++word)
+			{
+				name[len++] = *word;
+				TYPE_NAME_HASH_ADD(hash, *word);
+			}
+		}
+		else if(*type == ' ' || *type == '\t' || *type == '\n' || *type == '\r')
+			++type;
+		else
+		{
+			if(len == TYPE_NAME_MAX_LENGTH)
+				return TYPE_UNKNOWN;
+			name[len++] = *type;
+			TYPE_NAME_HASH_ADD(hash, *type);
+			++type;
+		}
 	}
+	name[len] = '\0';
 
-	/* strings (or an int8/uint8) */
+	/* single probe into the minimal perfect hash table */
+	TYPE_NAME_SLOT(slot, hash, g_type_name_seeds[hash % TYPE_NAME_COUNT]);
+	entry = &g_type_names[slot];
+	if(strcmp(entry->name, name) == 0)
+		return entry->type;
+
+	return TYPE_UNKNOWN;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+dynamic_call_get_fixed_size(const struct type_info_t* type_info)
+{
+	return ALIGN_UP(type_info->argc * (uint32_t)sizeof(void*), VALUE_SLOT_SIZE) +
+		type_info->argc * VALUE_SLOT_SIZE;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+dynamic_call_get_size_from_varargs(const struct type_info_t* type_info, va_list ap)
+{
+	uint32_t i, size;
+
+	size = dynamic_call_get_fixed_size(type_info);
+	for(i = 0; i != type_info->argc; ++i)
 	{
-		/* any form of wchar_t* is acceptable */
-		if(strstr(type, "wchar_t"))
+		/* every argument has to be consumed with its promoted type */
+		switch(type_info->argv_type[i])
 		{
-			/* make sure it's not actually a wchar_t** */
-			int num_chrs = 0;
-			const char* str = type;
-			/* one-liner for counting the number of '*' characters in a string
-			 * NOTE: modifies "str" */
-			for(num_chrs = 0; str[num_chrs]; str[num_chrs] == '*' ? num_chrs++ : *str++);
-			/* make sure it is a wchar_t* */
-			if(num_chrs == 1)
-				return TYPE_WSTRING;
-			return TYPE_UNKNOWN;
+			case TYPE_STRING:
+				size += (uint32_t)strlen(va_arg(ap, char*)) + 1;
+				break;
+			case TYPE_WSTRING:
+				size = ALIGN_UP(size, sizeof(wchar_t));
+				size += ((uint32_t)wcslen(va_arg(ap, wchar_t*)) + 1) * sizeof(wchar_t);
+				break;
+			case TYPE_INT8:
+			case TYPE_UINT8:
+			case TYPE_INT16:
+			case TYPE_UINT16:
+			case TYPE_INT32:   (void)va_arg(ap, int);          break;
+			case TYPE_UINT32:  (void)va_arg(ap, unsigned int); break;
+			case TYPE_INT64:   (void)va_arg(ap, int64_t);      break;
+			case TYPE_UINT64:  (void)va_arg(ap, uint64_t);     break;
+			case TYPE_INTPTR:  (void)va_arg(ap, intptr_t);     break;
+			case TYPE_UINTPTR: (void)va_arg(ap, uintptr_t);    break;
+			case TYPE_FLOAT:
+			case TYPE_DOUBLE:  (void)va_arg(ap, double);       break;
+			case TYPE_VOID:
+				fprintf(stderr, "Cannot create argument in vector: Invalid type!\n");
+				return 0;
+			default:
+				fprintf(stderr, "Cannot create argument in vector: Unknown type!\n");
+				return 0;
 		}
+	}
+
+	return size ? size : 1;
+}
 
-		/* any form of char* is acceptable */
-		if(strstr(type, "char"))
+/* ------------------------------------------------------------------------- */
+static char
+dynamic_call_fill_from_strings(const struct type_info_t* type_info,
+							   void** argv,
+							   const struct ordered_vector_t* strings)
+{
+	char* values = (char*)argv + ALIGN_UP(type_info->argc * (uint32_t)sizeof(void*), VALUE_SLOT_SIZE);
+	char* string_bytes = values + type_info->argc * VALUE_SLOT_SIZE;
+	uint32_t i = 0;
+
+	ORDERED_VECTOR_FOR_EACH(strings, const char*, str_p)
+		const char* str = *str_p;
+
+		switch(type_info->argv_type[i])
 		{
-			/* make sure it's not actually a char** */
-			int num_chrs = 0;
-			const char* str = type;
-			/* one-liner for counting the number of '*' characters in a string
-			 * NOTE: modifies "str" */
-			for(num_chrs = 0; str[num_chrs]; str[num_chrs] == '*' ? num_chrs++ : *str++);
-			if(num_chrs >= 2)
-				return TYPE_UNKNOWN;
-			/* make sure it is a char* */
-			if(num_chrs == 1)
-				return TYPE_STRING;
-
-			/* it's only a char - determine if signed or unsigned, and return
-			 * either int8 or uint8 */
-			if(strchr(type, 'u'))
-				return TYPE_UINT8;
-			return TYPE_INT8;
+			case TYPE_STRING:
+			{
+				uint32_t len = (uint32_t)strlen(str) + 1;
+				memcpy(string_bytes, str, len);
+				argv[i] = string_bytes;
+				string_bytes += len;
+				break;
+			}
+			case TYPE_WSTRING:
+			{
+				/* same conversion as strtowcs() */
+				wchar_t* wcs = (wchar_t*)((char*)argv + ALIGN_UP((uint32_t)(string_bytes - (char*)argv), sizeof(wchar_t)));
+				argv[i] = wcs;
+				for(; *str; ++str)
+					*wcs++ = (wchar_t)*str;
+				*wcs++ = L'\0';
+				string_bytes = (char*)wcs;
+				break;
+			}
+
+			/* TODO: atoi only supports 32-bit ints. Find a solution for 64 bit */
+			case TYPE_INT8:    STORE_ARGUMENT_IN_SLOT(int8_t,    atoi(str)); break;
+			case TYPE_UINT8:   STORE_ARGUMENT_IN_SLOT(uint8_t,   atoi(str)); break;
+			case TYPE_INT16:   STORE_ARGUMENT_IN_SLOT(int16_t,   atoi(str)); break;
+			case TYPE_UINT16:  STORE_ARGUMENT_IN_SLOT(uint16_t,  atoi(str)); break;
+			case TYPE_INT32:   STORE_ARGUMENT_IN_SLOT(int32_t,   atoi(str)); break;
+			case TYPE_UINT32:  STORE_ARGUMENT_IN_SLOT(uint32_t,  atoi(str)); break;
+			case TYPE_INT64:   STORE_ARGUMENT_IN_SLOT(int64_t,   atoi(str)); break;
+			case TYPE_UINT64:  STORE_ARGUMENT_IN_SLOT(uint64_t,  atoi(str)); break;
+			case TYPE_INTPTR:  STORE_ARGUMENT_IN_SLOT(intptr_t,  atoi(str)); break;
+			case TYPE_UINTPTR: STORE_ARGUMENT_IN_SLOT(uintptr_t, atoi(str)); break;
+			case TYPE_FLOAT:   STORE_ARGUMENT_IN_SLOT(float,     atof(str)); break;
+			case TYPE_DOUBLE:  STORE_ARGUMENT_IN_SLOT(double,    atof(str)); break;
+
+			/* void types can't be passed as an argument */
+			case TYPE_VOID:
+				fprintf(stderr, "Cannot create argument in vector: Invalid "
+				                "type \"%s\"\n", str);
+				return 0;
+			default:
+				fprintf(stderr, "Cannot create argument in vector: Unknown "
+				                "type \"%s\"\n", str);
+				return 0;
 		}
-	}
 
-	/* floats */
-	if(strstr(type, "float"))
+		++i;
+	ORDERED_VECTOR_END_EACH
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+dynamic_call_fill_from_varargs(const struct type_info_t* type_info,
+							   void** argv,
+							   va_list ap)
+{
+	char* values = (char*)argv + ALIGN_UP(type_info->argc * (uint32_t)sizeof(void*), VALUE_SLOT_SIZE);
+	char* string_bytes = values + type_info->argc * VALUE_SLOT_SIZE;
+	uint32_t i;
+
+	for(i = 0; i != type_info->argc; ++i)
 	{
-		/* make sure it's not actually a float* */
-		if(strchr(type, '*'))
-			return TYPE_UNKNOWN;
-		return TYPE_FLOAT;
+		/* see vdynamic_call_set_argument_vector_from_varargs() about promotion */
+		switch(type_info->argv_type[i])
+		{
+			case TYPE_STRING:
+			{
+				const char* str = va_arg(ap, char*);
+				uint32_t len = (uint32_t)strlen(str) + 1;
+				memcpy(string_bytes, str, len);
+				argv[i] = string_bytes;
+				string_bytes += len;
+				break;
+			}
+			case TYPE_WSTRING:
+			{
+				const wchar_t* wcs = va_arg(ap, wchar_t*);
+				uint32_t len = ((uint32_t)wcslen(wcs) + 1) * sizeof(wchar_t);
+				string_bytes = (char*)argv + ALIGN_UP((uint32_t)(string_bytes - (char*)argv), sizeof(wchar_t));
+				memcpy(string_bytes, wcs, len);
+				argv[i] = string_bytes;
+				string_bytes += len;
+				break;
+			}
+
+			case TYPE_INT8:    STORE_ARGUMENT_IN_SLOT(int8_t,    va_arg(ap, int)); break;
+			case TYPE_UINT8:   STORE_ARGUMENT_IN_SLOT(uint8_t,   va_arg(ap, int)); break;
+			case TYPE_INT16:   STORE_ARGUMENT_IN_SLOT(int16_t,   va_arg(ap, int)); break;
+			case TYPE_UINT16:  STORE_ARGUMENT_IN_SLOT(uint16_t,  va_arg(ap, int)); break;
+			case TYPE_INT32:   STORE_ARGUMENT_IN_SLOT(int32_t,   va_arg(ap, int)); break;
+			case TYPE_UINT32:  STORE_ARGUMENT_IN_SLOT(uint32_t,  va_arg(ap, unsigned int)); break;
+			case TYPE_INT64:   STORE_ARGUMENT_IN_SLOT(int64_t,   va_arg(ap, int64_t)); break;
+			case TYPE_UINT64:  STORE_ARGUMENT_IN_SLOT(uint64_t,  va_arg(ap, uint64_t)); break;
+			case TYPE_INTPTR:  STORE_ARGUMENT_IN_SLOT(intptr_t,  va_arg(ap, intptr_t)); break;
+			case TYPE_UINTPTR: STORE_ARGUMENT_IN_SLOT(uintptr_t, va_arg(ap, uintptr_t)); break;
+			case TYPE_FLOAT:   STORE_ARGUMENT_IN_SLOT(float,     va_arg(ap, double)); break;
+			case TYPE_DOUBLE:  STORE_ARGUMENT_IN_SLOT(double,    va_arg(ap, double)); break;
+
+			case TYPE_VOID:
+				fprintf(stderr, "Cannot create argument in vector: Invalid type!\n");
+				return 0;
+			default:
+				fprintf(stderr, "Cannot create argument in vector: Unknown type!\n");
+				return 0;
+		}
 	}
 
-	/* doubles */
-	if(strstr(type, "double"))
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+static void**
+dynamic_call_alloc_argument_vector(const struct type_info_t* type_info, uint32_t size)
+{
+	union argv_block_t* block = NULL;
+	uint32_t pool_size;
+
+	pool_size = dynamic_call_get_fixed_size(type_info) + ARGV_POOL_STRING_SIZE;
+	if(size <= pool_size)
 	{
-		/* make sure it's not actually a float* */
-		if(strchr(type, '*'))
-			return TYPE_UNKNOWN;
-		return TYPE_DOUBLE;
+		ARGV_POOL_LOCK(type_info);
+		if((block = (union argv_block_t*)type_info->argv_pool))
+		{
+			((struct type_info_t*)type_info)->argv_pool = block->info.next_free;
+			--((struct type_info_t*)type_info)->argv_pool_count;
+		}
+		ARGV_POOL_UNLOCK(type_info);
+
+		/* allocate the pool's size so the block can be returned to it later */
+		size = pool_size;
 	}
 
-	/* void */
-	if(strstr(type, "void"))
+	if(!block)
 	{
-		/* reject pointer types */
-		if(strchr(type, '*'))
-			return TYPE_UNKNOWN;
-		return TYPE_VOID;
+		if(!(block = (union argv_block_t*)MALLOC(sizeof(union argv_block_t) + size)))
+			return NULL;
+		block->info.size = size;
+		block->info.pooled = (size == pool_size);
 	}
 
-	/* unknown */
-	return TYPE_UNKNOWN;
+	/* cleanup can detect which arguments were written */
+	memset(block + 1, 0, type_info->argc * sizeof(void*));
+	block->info.next_free = NULL;
+
+	return (void**)(block + 1);
 }
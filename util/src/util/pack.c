@@ -0,0 +1,523 @@
+#include "util/pack.h"
+#include "util/file.h"
+#include "util/hash.h"
+#include "util/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Compressed blobs are a sequence of tokens. Each token starts with a byte
+ * holding the number of literals in the upper 4 bits and the match length
+ * minus PACK_LZ_MIN_MATCH in the lower 4 bits. A value of 15 means the length
+ * continues in the following bytes, each adding up to 255. The literals
+ * follow, then a 2 byte offset pointing back into the output and the
+ * extended match length. The last token only contains literals.
+ */
+#define PACK_LZ_MIN_MATCH 4
+#define PACK_LZ_MAX_OFFSET 0xFFFF
+#define PACK_LZ_HASH_BITS 12
+
+#define PACK_ALIGN(x) (((x) + (PACK_ALIGNMENT - 1)) & ~(uint32_t)(PACK_ALIGNMENT - 1))
+
+struct pack_write_item_t
+{
+	const char* name;
+	void* data;
+	void* compressed;
+	struct pack_entry_t entry;
+};
+
+static uint32_t
+pack_compress(const unsigned char* src, uint32_t src_size, unsigned char* dst, uint32_t dst_capacity);
+
+static char
+pack_decompress(const unsigned char* src, uint32_t src_size, unsigned char* dst, uint32_t dst_size);
+
+static int
+pack_write_item_compare(const void* a, const void* b);
+
+/* ------------------------------------------------------------------------- */
+struct pack_t*
+pack_open(const char* file_name)
+{
+	struct pack_t* pack;
+	const unsigned char* base;
+	uint32_t i;
+
+	assert(file_name);
+
+	if(!(pack = (struct pack_t*)MALLOC(sizeof(struct pack_t))))
+	{
+		fprintf(stderr, "malloc() failed in pack_open() -- not enough memory\n");
+		return NULL;
+	}
+	memset(pack, 0, sizeof(struct pack_t));
+
+	for(;;)
+	{
+		if(!(pack->mapping = file_map(file_name, &pack->mapping_size)))
+			break;
+		base = (const unsigned char*)pack->mapping;
+
+		/* validate header */
+		if(pack->mapping_size < sizeof(struct pack_header_t))
+			break;
+		pack->header = (const struct pack_header_t*)base;
+		if(memcmp(pack->header->magic, PACK_MAGIC, 4) != 0)
+		{
+			fprintf(stderr, "File \"%s\" is not a pack file\n", file_name);
+			break;
+		}
+		if(pack->header->version != PACK_VERSION)
+		{
+			fprintf(stderr, "Pack file \"%s\" has unsupported version %d\n",
+					file_name, pack->header->version);
+			break;
+		}
+
+		/* validate table of contents and names */
+		if(pack->header->toc_offset > pack->mapping_size ||
+		   pack->header->entry_count > (pack->mapping_size - pack->header->toc_offset) / sizeof(struct pack_entry_t))
+			break;
+		if(pack->header->names_offset > pack->mapping_size ||
+		   pack->header->names_size > pack->mapping_size - pack->header->names_offset ||
+		   pack->header->names_size == 0 ||
+		   base[pack->header->names_offset + pack->header->names_size - 1] != '\0')
+			break;
+		pack->toc = (const struct pack_entry_t*)(base + pack->header->toc_offset);
+		pack->names = (const char*)(base + pack->header->names_offset);
+
+		/* validate entries */
+		for(i = 0; i != pack->header->entry_count; ++i)
+		{
+			const struct pack_entry_t* entry = pack->toc + i;
+			if(entry->name_offset >= pack->header->names_size ||
+			   entry->offset > pack->mapping_size ||
+			   entry->stored_size > pack->mapping_size - entry->offset)
+				break;
+
+			/* uncompressed entries are read straight from the mapping */
+			if(!(entry->flags & PACK_ENTRY_COMPRESSED) && entry->size != entry->stored_size)
+				break;
+		}
+		if(i != pack->header->entry_count)
+		{
+			fprintf(stderr, "Pack file \"%s\" is corrupt\n", file_name);
+			break;
+		}
+
+		return pack;
+	}
+
+	pack_close(pack);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+pack_close(struct pack_t* pack)
+{
+	assert(pack);
+
+	if(pack->mapping)
+		file_unmap(pack->mapping, pack->mapping_size);
+	FREE(pack);
+}
+
+/* ------------------------------------------------------------------------- */
+const struct pack_entry_t*
+pack_find(const struct pack_t* pack, const char* name)
+{
+	uint32_t hash;
+	uint32_t lo, hi, mid;
+
+	assert(pack);
+	assert(name);
+
+	hash = hash_jenkins_oaat(name, strlen(name));
+
+	/* find first entry with a matching hash */
+	lo = 0;
+	hi = pack->header->entry_count;
+	while(lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if(pack->toc[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* resolve hash collisions by comparing names */
+	for(; lo != pack->header->entry_count && pack->toc[lo].hash == hash; ++lo)
+	{
+		if(strcmp(pack->names + pack->toc[lo].name_offset, name) == 0)
+			return pack->toc + lo;
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+const char*
+pack_entry_name(const struct pack_t* pack, const struct pack_entry_t* entry)
+{
+	return pack->names + entry->name_offset;
+}
+
+/* ------------------------------------------------------------------------- */
+const void*
+pack_entry_data(const struct pack_t* pack, const struct pack_entry_t* entry)
+{
+	return (const unsigned char*)pack->mapping + entry->offset;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+pack_read(const struct pack_t* pack, const struct pack_entry_t* entry, void* buffer)
+{
+	assert(pack);
+	assert(entry);
+	assert(buffer);
+
+	if(entry->flags & PACK_ENTRY_COMPRESSED)
+	{
+		return pack_decompress((const unsigned char*)pack_entry_data(pack, entry),
+							   entry->stored_size,
+							   (unsigned char*)buffer,
+							   entry->size);
+	}
+
+	/* pack_open() made sure size and stored_size are the same */
+	memcpy(buffer, pack_entry_data(pack, entry), entry->size);
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+pack_write(const char* file_name,
+		   uint32_t count,
+		   const char** source_files,
+		   const char** entry_names,
+		   char compress)
+{
+	struct pack_write_item_t* items;
+	struct pack_header_t header;
+	FILE* fp = NULL;
+	uint32_t i;
+	uint32_t offset;
+	char success = 0;
+	static const unsigned char padding[PACK_ALIGNMENT] = {0};
+
+	assert(file_name);
+	assert(source_files);
+
+	if(!(items = (struct pack_write_item_t*)MALLOC(sizeof(struct pack_write_item_t) * (count ? count : 1))))
+	{
+		fprintf(stderr, "malloc() failed in pack_write() -- not enough memory\n");
+		return 0;
+	}
+	memset(items, 0, sizeof(struct pack_write_item_t) * (count ? count : 1));
+
+	for(;;)
+	{
+		/* load every source file and compress it if requested */
+		for(i = 0; i != count; ++i)
+		{
+			struct pack_write_item_t* item = items + i;
+			item->name = (entry_names ? entry_names[i] : source_files[i]);
+			item->entry.hash = hash_jenkins_oaat(item->name, strlen(item->name));
+			if(!(item->entry.size = file_load_into_memory(source_files[i], &item->data, FILE_BINARY)))
+			{
+				fprintf(stderr, "Failed to read \"%s\"\n", source_files[i]);
+				break;
+			}
+			item->entry.stored_size = item->entry.size;
+
+			if(compress)
+			{
+				uint32_t compressed_size;
+				if(!(item->compressed = MALLOC(item->entry.size)))
+					break;
+				compressed_size = pack_compress((const unsigned char*)item->data,
+												item->entry.size,
+												(unsigned char*)item->compressed,
+												item->entry.size);
+				/* only keep compressed data if it actually saves space */
+				if(compressed_size != 0 && compressed_size < item->entry.size)
+				{
+					item->entry.flags |= PACK_ENTRY_COMPRESSED;
+					item->entry.stored_size = compressed_size;
+				}
+				else
+				{
+					FREE(item->compressed);
+					item->compressed = NULL;
+				}
+			}
+		}
+		if(i != count)
+			break;
+
+		/* table of contents must be sorted by hash for binary search */
+		qsort(items, count, sizeof(struct pack_write_item_t), pack_write_item_compare);
+		for(i = 1; i < count; ++i)
+		{
+			if(pack_write_item_compare(items + i - 1, items + i) == 0)
+			{
+				fprintf(stderr, "Entry \"%s\" was specified more than once\n", items[i].name);
+				break;
+			}
+		}
+		if(i < count)
+			break;
+
+		/* lay out file */
+		memset(&header, 0, sizeof(struct pack_header_t));
+		memcpy(header.magic, PACK_MAGIC, 4);
+		header.version = PACK_VERSION;
+		header.entry_count = count;
+		header.toc_offset = sizeof(struct pack_header_t);
+		header.names_offset = header.toc_offset + count * sizeof(struct pack_entry_t);
+		header.names_size = 0;
+		for(i = 0; i != count; ++i)
+		{
+			items[i].entry.name_offset = header.names_size;
+			header.names_size += strlen(items[i].name) + 1;
+		}
+		if(header.names_size == 0)
+			header.names_size = 1; /* empty packs store a single null terminator */
+		offset = PACK_ALIGN(header.names_offset + header.names_size);
+		for(i = 0; i != count; ++i)
+		{
+			items[i].entry.offset = offset;
+			offset = PACK_ALIGN(offset + items[i].entry.stored_size);
+		}
+
+		/* write everything */
+		if(!(fp = fopen(file_name, "wb")))
+		{
+			fprintf(stderr, "fopen() failed for file \"%s\"\n", file_name);
+			break;
+		}
+		fwrite(&header, sizeof(struct pack_header_t), 1, fp);
+		for(i = 0; i != count; ++i)
+			fwrite(&items[i].entry, sizeof(struct pack_entry_t), 1, fp);
+		for(i = 0; i != count; ++i)
+			fwrite(items[i].name, strlen(items[i].name) + 1, 1, fp);
+		if(count == 0)
+			fwrite(padding, 1, 1, fp);
+		offset = header.names_offset + header.names_size;
+		for(i = 0; i != count; ++i)
+		{
+			fwrite(padding, items[i].entry.offset - offset, 1, fp);
+			fwrite(items[i].compressed ? items[i].compressed : items[i].data,
+				   items[i].entry.stored_size, 1, fp);
+			offset = items[i].entry.offset + items[i].entry.stored_size;
+		}
+		if(ferror(fp))
+		{
+			fprintf(stderr, "Failed to write to file \"%s\"\n", file_name);
+			break;
+		}
+
+		success = 1;
+		break;
+	}
+
+	/* clean up */
+	if(fp)
+		fclose(fp);
+	for(i = 0; i != count; ++i)
+	{
+		if(items[i].data)
+			free_file(items[i].data);
+		if(items[i].compressed)
+			FREE(items[i].compressed);
+	}
+	FREE(items);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+static int
+pack_write_item_compare(const void* a, const void* b)
+{
+	const struct pack_write_item_t* item_a = (const struct pack_write_item_t*)a;
+	const struct pack_write_item_t* item_b = (const struct pack_write_item_t*)b;
+	if(item_a->entry.hash < item_b->entry.hash)
+		return -1;
+	if(item_a->entry.hash > item_b->entry.hash)
+		return 1;
+	return strcmp(item_a->name, item_b->name);
+}
+
+/* ------------------------------------------------------------------------- */
+static unsigned char*
+pack_compress_write_length(unsigned char* op, const unsigned char* oend, uint32_t length)
+{
+	for(; length >= 255; length -= 255)
+	{
+		if(op == oend)
+			return NULL;
+		*op++ = 255;
+	}
+	if(op == oend)
+		return NULL;
+	*op++ = (unsigned char)length;
+	return op;
+}
+
+/* ------------------------------------------------------------------------- */
+static unsigned char*
+pack_compress_write_token(unsigned char* op,
+						  const unsigned char* oend,
+						  const unsigned char* literals,
+						  uint32_t literal_count,
+						  uint32_t offset,
+						  uint32_t match_length)
+{
+	unsigned char* token;
+	uint32_t match_code = (match_length ? match_length - PACK_LZ_MIN_MATCH : 0);
+
+	if(op == oend)
+		return NULL;
+	token = op++;
+	*token = (unsigned char)(((literal_count < 15 ? literal_count : 15) << 4) |
+							 (match_code < 15 ? match_code : 15));
+	if(literal_count >= 15 && !(op = pack_compress_write_length(op, oend, literal_count - 15)))
+		return NULL;
+	if((uint32_t)(oend - op) < literal_count)
+		return NULL;
+	memcpy(op, literals, literal_count);
+	op += literal_count;
+
+	/* last token has no match */
+	if(!match_length)
+		return op;
+
+	if(oend - op < 2)
+		return NULL;
+	*op++ = (unsigned char)(offset & 0xFF);
+	*op++ = (unsigned char)(offset >> 8);
+	if(match_code >= 15 && !(op = pack_compress_write_length(op, oend, match_code - 15)))
+		return NULL;
+
+	return op;
+}
+
+/* ------------------------------------------------------------------------- */
+static uint32_t
+pack_compress(const unsigned char* src, uint32_t src_size, unsigned char* dst, uint32_t dst_capacity)
+{
+	uint32_t table[1 << PACK_LZ_HASH_BITS];
+	const unsigned char* oend = dst + dst_capacity;
+	unsigned char* op = dst;
+	uint32_t anchor = 0;
+	uint32_t pos = 0;
+
+	memset(table, 0xFF, sizeof(table));
+
+	while(pos + PACK_LZ_MIN_MATCH <= src_size)
+	{
+		uint32_t sequence, h, candidate, length;
+
+		memcpy(&sequence, src + pos, 4);
+		h = (sequence * 2654435761u) >> (32 - PACK_LZ_HASH_BITS);
+		candidate = table[h];
+		table[h] = pos;
+
+		if(candidate == 0xFFFFFFFF ||
+		   pos - candidate > PACK_LZ_MAX_OFFSET ||
+		   memcmp(src + candidate, src + pos, PACK_LZ_MIN_MATCH) != 0)
+		{
+			++pos;
+			continue;
+		}
+
+		/* extend match as far as possible */
+		length = PACK_LZ_MIN_MATCH;
+		while(pos + length < src_size && src[candidate + length] == src[pos + length])
+			++length;
+
+		if(!(op = pack_compress_write_token(op, oend, src + anchor, pos - anchor, pos - candidate, length)))
+			return 0;
+		pos += length;
+		anchor = pos;
+	}
+
+	/* remaining literals */
+	if(!(op = pack_compress_write_token(op, oend, src + anchor, src_size - anchor, 0, 0)))
+		return 0;
+
+	return (uint32_t)(op - dst);
+}
+
+/* ------------------------------------------------------------------------- */
+static char
+pack_decompress(const unsigned char* src, uint32_t src_size, unsigned char* dst, uint32_t dst_size)
+{
+	const unsigned char* ip = src;
+	const unsigned char* iend = src + src_size;
+	unsigned char* op = dst;
+	unsigned char* oend = dst + dst_size;
+
+	while(ip != iend)
+	{
+		uint32_t literal_count, match_length, offset;
+		unsigned char token = *ip++;
+
+		/* literals */
+		literal_count = token >> 4;
+		if(literal_count == 15)
+		{
+			unsigned char b;
+			do
+			{
+				if(ip == iend)
+					return 0;
+				b = *ip++;
+				literal_count += b;
+			} while(b == 255);
+		}
+		if((uint32_t)(iend - ip) < literal_count || (uint32_t)(oend - op) < literal_count)
+			return 0;
+		memcpy(op, ip, literal_count);
+		ip += literal_count;
+		op += literal_count;
+
+		/* last token has no match */
+		if(ip == iend)
+			break;
+
+		/* match */
+		if(iend - ip < 2)
+			return 0;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		match_length = (token & 0x0F);
+		if(match_length == 15)
+		{
+			unsigned char b;
+			do
+			{
+				if(ip == iend)
+					return 0;
+				b = *ip++;
+				match_length += b;
+			} while(b == 255);
+		}
+		match_length += PACK_LZ_MIN_MATCH;
+		if(offset == 0 || offset > (uint32_t)(op - dst) || (uint32_t)(oend - op) < match_length)
+			return 0;
+
+		/* matches may overlap the output, copy byte by byte */
+		for(; match_length; --match_length, ++op)
+			*op = *(op - offset);
+	}
+
+	return op == oend;
+}
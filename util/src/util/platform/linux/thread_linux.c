@@ -0,0 +1,80 @@
+#include "util/thread.h"
+#include "util/memory.h"
+#include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/* pthreads expects a function returning void* */
+struct thread_start_t
+{
+	thread_func func;
+	void* arg;
+};
+
+/* ------------------------------------------------------------------------- */
+static void*
+thread_entry(void* data)
+{
+	struct thread_start_t start = *(struct thread_start_t*)data;
+	FREE(data);
+	start.func(start.arg);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+get_thread_id(void)
+{
+	return (uintptr_t)syscall(SYS_gettid);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+thread_start(uintptr_t* handle, thread_func func, void* arg)
+{
+	struct thread_start_t* start;
+	pthread_t thread;
+
+	if(!(start = (struct thread_start_t*)MALLOC(sizeof(struct thread_start_t))))
+		return 0;
+	start->func = func;
+	start->arg = arg;
+
+	if(pthread_create(&thread, NULL, thread_entry, start) != 0)
+	{
+		FREE(start);
+		return 0;
+	}
+	*handle = (uintptr_t)thread;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_join(uintptr_t handle)
+{
+	pthread_join((pthread_t)handle, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wait(int* address, int expected)
+{
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake(int* address, int count)
+{
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake_all(int* address)
+{
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
@@ -1,12 +1,50 @@
 #include "util/time.h"
-#include <sys/time.h>
-#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+
+/* CLOCK_MONOTONIC_RAW isn't slewed by NTP either */
+#ifdef CLOCK_MONOTONIC_RAW
+#   define CLOCK_ID CLOCK_MONOTONIC_RAW
+#else
+#   define CLOCK_ID CLOCK_MONOTONIC
+#endif
+
+/* sleeping is only accurate to the timer slack (50 us by default), spin the rest */
+#define SLEEP_SPIN_NS 200000
 
 /* ------------------------------------------------------------------------- */
-int64_t
-get_time_in_microseconds(void)
+uint64_t
+get_time_ns(void)
 {
-	struct timeval time;
-	gettimeofday(&time, NULL);
-	return time.tv_usec + time.tv_sec*1000000;
+	struct timespec time;
+	clock_gettime(CLOCK_ID, &time);
+	return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sleep_until_ns(uint64_t deadline)
+{
+	uint64_t now = get_time_ns();
+
+	/*
+	 * clock_nanosleep() doesn't support CLOCK_MONOTONIC_RAW. The two clocks
+	 * only drift apart by a few ppm, so the deadline is translated to
+	 * CLOCK_MONOTONIC. Sleeping to an absolute time means being interrupted
+	 * by a signal doesn't push the wake up time back.
+	 */
+	if(deadline > now + SLEEP_SPIN_NS)
+	{
+		struct timespec wake;
+		uint64_t wake_ns;
+
+		clock_gettime(CLOCK_MONOTONIC, &wake);
+		wake_ns = (uint64_t)wake.tv_sec * 1000000000u + (uint64_t)wake.tv_nsec +
+			(deadline - now - SLEEP_SPIN_NS);
+		wake.tv_sec = (time_t)(wake_ns / 1000000000u);
+		wake.tv_nsec = (long)(wake_ns % 1000000000u);
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {}
+	}
+
+	while(get_time_ns() < deadline) {}
 }
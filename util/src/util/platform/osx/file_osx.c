@@ -1,8 +1,11 @@
 #include "util/file.h"
+#include "util/vfs.h"
 #include "util/memory.h"
 #include "framework/log.h"
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <stdio.h>
 
 /* ------------------------------------------------------------------------- */
@@ -13,6 +16,11 @@ file_load_into_memory(const char* file_name, void** buffer, file_opts_e opts)
 	int fd;
 	struct stat stbuf;
 	uintptr_t buffer_size;
+	uint32_t packed_size;
+
+	/* files in mounted packs take precedence over loose files */
+	if((packed_size = vfs_load_into_memory(file_name, buffer, opts)))
+		return packed_size;
 
 	/* get file pointer */
 	if(opts & FILE_BINARY)
@@ -89,3 +97,57 @@ free_file(void* ptr)
 {
 	FREE(ptr);
 }
+
+/* ------------------------------------------------------------------------- */
+const void*
+file_map(const char* file_name, uint32_t* size)
+{
+	int fd;
+	struct stat stbuf;
+	void* ptr;
+
+	fd = open(file_name, O_RDONLY);
+	if(fd == -1)
+		return NULL;
+
+	for(;;)
+	{
+		if(fstat(fd, &stbuf) != 0)
+		{
+			fprintf(stderr, "fstat() failed for file \"%s\"\n", file_name);
+			break;
+		}
+
+		/* ensure file is regular file, as stbuf.st_size is only valid for regular files */
+		if(!S_ISREG(stbuf.st_mode) || stbuf.st_size == 0)
+			break;
+		if((uint64_t)stbuf.st_size > (uint64_t)0xFFFFFFFF)
+		{
+			fprintf(stderr, "File \"%s\" is too large to be mapped\n", file_name);
+			break;
+		}
+
+		ptr = mmap(NULL, (size_t)stbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(ptr == MAP_FAILED)
+		{
+			fprintf(stderr, "mmap() failed for file \"%s\"\n", file_name);
+			break;
+		}
+
+		/* the mapping stays valid after the descriptor is closed */
+		close(fd);
+
+		*size = (uint32_t)stbuf.st_size;
+		return ptr;
+	}
+
+	close(fd);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+file_unmap(const void* ptr, uint32_t size)
+{
+	munmap((void*)ptr, size);
+}
@@ -0,0 +1,93 @@
+#include "util/thread.h"
+#include "util/memory.h"
+#include <pthread.h>
+#include <errno.h>
+
+/*
+ * There is no public futex API, but libc++ implements std::atomic::wait()
+ * with these since OS X 10.12.
+ */
+#define UL_COMPARE_AND_WAIT 1
+#define ULF_WAKE_ALL        0x00000100
+#define ULF_NO_ERRNO        0x01000000
+
+extern int
+__ulock_wait(uint32_t operation, void* address, uint64_t value, uint32_t timeout_us);
+extern int
+__ulock_wake(uint32_t operation, void* address, uint64_t wake_value);
+
+/* pthreads expects a function returning void* */
+struct thread_start_t
+{
+	thread_func func;
+	void* arg;
+};
+
+/* ------------------------------------------------------------------------- */
+static void*
+thread_entry(void* data)
+{
+	struct thread_start_t start = *(struct thread_start_t*)data;
+	FREE(data);
+	start.func(start.arg);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+get_thread_id(void)
+{
+	return (uintptr_t)pthread_self();
+}
+
+/* ------------------------------------------------------------------------- */
+char
+thread_start(uintptr_t* handle, thread_func func, void* arg)
+{
+	struct thread_start_t* start;
+	pthread_t thread;
+
+	if(!(start = (struct thread_start_t*)MALLOC(sizeof(struct thread_start_t))))
+		return 0;
+	start->func = func;
+	start->arg = arg;
+
+	if(pthread_create(&thread, NULL, thread_entry, start) != 0)
+	{
+		FREE(start);
+		return 0;
+	}
+	*handle = (uintptr_t)thread;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_join(uintptr_t handle)
+{
+	pthread_join((pthread_t)handle, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wait(int* address, int expected)
+{
+	__ulock_wait(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, address, (uint32_t)expected, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake(int* address, int count)
+{
+	/* only one or all waiters can be woken, stop once nobody is left */
+	while(count-- > 0)
+		if(__ulock_wake(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, address, 0) == -ENOENT)
+			break;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake_all(int* address)
+{
+	__ulock_wake(UL_COMPARE_AND_WAIT | ULF_WAKE_ALL | ULF_NO_ERRNO, address, 0);
+}
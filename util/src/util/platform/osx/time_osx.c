@@ -1,12 +1,33 @@
 #include "util/time.h"
-#include <sys/time.h>
-#include <stdio.h>
+#include <mach/mach_time.h>
+
+/* waking up from a sleep is only accurate to a few tens of microseconds */
+#define SLEEP_SPIN_NS 200000
 
 /* ------------------------------------------------------------------------- */
-int64_t
-get_time_in_microseconds(void)
+uint64_t
+get_time_ns(void)
 {
-	struct timeval time;
-	gettimeofday(&time, NULL);
-	return time.tv_usec + time.tv_sec*1000000;
+	static mach_timebase_info_data_t timebase = {0, 0};
+	if(timebase.denom == 0)
+		mach_timebase_info(&timebase);
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sleep_until_ns(uint64_t deadline)
+{
+	mach_timebase_info_data_t timebase;
+	uint64_t now = get_time_ns();
+
+	/* mach_wait_until() takes an absolute time in mach ticks */
+	if(deadline > now + SLEEP_SPIN_NS)
+	{
+		mach_timebase_info(&timebase);
+		mach_wait_until(mach_absolute_time() +
+			(deadline - now - SLEEP_SPIN_NS) * timebase.denom / timebase.numer);
+	}
+
+	while(get_time_ns() < deadline) {}
 }
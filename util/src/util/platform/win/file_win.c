@@ -1,4 +1,5 @@
 #include "util/file.h"
+#include "util/vfs.h"
 #include "framework/log.h"
 #include "util/memory.h"
 #include <windows.h>
@@ -12,6 +13,11 @@ file_load_into_memory(const char* file_name, void** buffer, file_opts_e opts)
 	HANDLE hFile;
 	LARGE_INTEGER buffer_size;
 	DWORD bytes_read;
+	uint32_t packed_size;
+
+	/* files in mounted packs take precedence over loose files */
+	if((packed_size = vfs_load_into_memory(file_name, buffer, opts)))
+		return packed_size;
 
 	/* open file */
 	hFile = CreateFile(TEXT(file_name), GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -88,3 +94,64 @@ free_file(void* ptr)
 {
 	FREE(ptr);
 }
+
+/* ------------------------------------------------------------------------- */
+const void*
+file_map(const char* file_name, uint32_t* size)
+{
+	HANDLE hFile;
+	HANDLE hMapping;
+	LARGE_INTEGER file_size;
+	void* ptr;
+
+	hFile = CreateFile(TEXT(file_name), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	for(;;)
+	{
+#ifdef ENABLE_WINDOWS_EX
+		if(!GetFileSizeEx(hFile, &file_size))
+			break;
+#else
+		DWORD high_part;
+		if((file_size.LowPart = GetFileSize(hFile, &high_part)) == INVALID_FILE_SIZE)
+			break;
+		file_size.HighPart = (LONG)high_part;
+#endif
+		if(file_size.HighPart != 0 || file_size.LowPart == 0)
+			break;
+
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(hMapping == NULL)
+		{
+			fprintf(stderr, "CreateFileMapping() failed for file \"%s\"\n", file_name);
+			break;
+		}
+
+		ptr = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+		/* the view keeps the mapping alive */
+		CloseHandle(hMapping);
+		if(ptr == NULL)
+		{
+			fprintf(stderr, "MapViewOfFile() failed for file \"%s\"\n", file_name);
+			break;
+		}
+
+		CloseHandle(hFile);
+
+		*size = (uint32_t)file_size.LowPart;
+		return ptr;
+	}
+
+	CloseHandle(hFile);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+file_unmap(const void* ptr, uint32_t size)
+{
+	UnmapViewOfFile(ptr);
+}
@@ -0,0 +1,84 @@
+#include "util/thread.h"
+#include "util/memory.h"
+
+/* WaitOnAddress() and friends require Windows 8 */
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0602
+#	undef _WIN32_WINNT
+#	define _WIN32_WINNT 0x0602
+#endif
+#include <windows.h>
+
+/* CreateThread() expects a WINAPI function returning DWORD */
+struct thread_start_t
+{
+	thread_func func;
+	void* arg;
+};
+
+/* ------------------------------------------------------------------------- */
+static DWORD WINAPI
+thread_entry(LPVOID data)
+{
+	struct thread_start_t start = *(struct thread_start_t*)data;
+	FREE(data);
+	start.func(start.arg);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+uintptr_t
+get_thread_id(void)
+{
+	return (uintptr_t)GetCurrentThreadId();
+}
+
+/* ------------------------------------------------------------------------- */
+char
+thread_start(uintptr_t* handle, thread_func func, void* arg)
+{
+	struct thread_start_t* start;
+	HANDLE thread;
+
+	if(!(start = (struct thread_start_t*)MALLOC(sizeof(struct thread_start_t))))
+		return 0;
+	start->func = func;
+	start->arg = arg;
+
+	if(!(thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL)))
+	{
+		FREE(start);
+		return 0;
+	}
+	*handle = (uintptr_t)thread;
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+thread_join(uintptr_t handle)
+{
+	WaitForSingleObject((HANDLE)handle, INFINITE);
+	CloseHandle((HANDLE)handle);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wait(int* address, int expected)
+{
+	WaitOnAddress(address, &expected, sizeof(int), INFINITE);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake(int* address, int count)
+{
+	while(count-- > 0)
+		WakeByAddressSingle(address);
+}
+
+/* ------------------------------------------------------------------------- */
+void
+futex_wake_all(int* address)
+{
+	WakeByAddressAll(address);
+}
@@ -1,8 +1,33 @@
 #include "util/time.h"
+#include <windows.h>
 
-int64_t
-get_time_in_microseconds(void)
+/* Sleep() is only accurate to the timer resolution, usually 1 to 16 ms */
+#define SLEEP_SPIN_NS 2000000
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+get_time_ns(void)
 {
-	/* TODO */
-	return 0;
+	static LARGE_INTEGER frequency = {0};
+	LARGE_INTEGER counter;
+	if(frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	/* split to avoid overflowing when multiplying by 10^9 */
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000u +
+		(uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000u / (uint64_t)frequency.QuadPart;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+sleep_until_ns(uint64_t deadline)
+{
+	uint64_t now = get_time_ns();
+
+	/* Sleep() has a granularity of one scheduler quantum */
+	if(deadline > now + SLEEP_SPIN_NS)
+		Sleep((DWORD)((deadline - now - SLEEP_SPIN_NS) / 1000000u));
+
+	while(get_time_ns() < deadline) {}
 }
@@ -0,0 +1,73 @@
+#include "util/time.h"
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#   include <intrin.h>
+#   define READ_CYCLES() __rdtsc()
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#   include <x86intrin.h>
+#   define READ_CYCLES() __rdtsc()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#   define READ_CYCLES() read_cntvct()
+static uint64_t
+read_cntvct(void)
+{
+	uint64_t value;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (value));
+	return value;
+}
+#else
+#   define READ_CYCLES() get_time_ns()
+#   define CYCLES_ARE_NS
+#endif
+
+/* long enough for the clock's jitter to not matter, short enough for startup */
+#define CALIBRATION_TIME_NS 5000000
+
+static double g_ns_per_cycle = 0.0;
+
+/* ------------------------------------------------------------------------- */
+int64_t
+get_time_in_microseconds(void)
+{
+	return (int64_t)(get_time_ns() / 1000u);
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+cycle_counter(void)
+{
+	return READ_CYCLES();
+}
+
+/* ------------------------------------------------------------------------- */
+void
+cycle_counter_calibrate(void)
+{
+#ifdef CYCLES_ARE_NS
+	g_ns_per_cycle = 1.0;
+#else
+	uint64_t start_ns, start_cycles, end_ns, end_cycles;
+
+	start_ns = get_time_ns();
+	start_cycles = READ_CYCLES();
+	do
+		end_ns = get_time_ns();
+	while(end_ns - start_ns < CALIBRATION_TIME_NS);
+	end_cycles = READ_CYCLES();
+
+	/* a counter that doesn't tick is useless, pretend it counts ns */
+	if(end_cycles <= start_cycles)
+		g_ns_per_cycle = 1.0;
+	else
+		g_ns_per_cycle = (double)(end_ns - start_ns) / (double)(end_cycles - start_cycles);
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+uint64_t
+cycles_to_ns(uint64_t cycles)
+{
+	if(g_ns_per_cycle == 0.0)
+		cycle_counter_calibrate();
+	return (uint64_t)((double)cycles * g_ns_per_cycle);
+}
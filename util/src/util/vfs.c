@@ -0,0 +1,172 @@
+#include "util/vfs.h"
+#include "util/pack.h"
+#include "util/unordered_vector.h"
+#include "util/memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+static struct unordered_vector_t g_packs;
+
+/*!
+ * @brief Searches the mounted packs for the specified file, starting with the
+ * most recently mounted pack.
+ */
+static const struct pack_entry_t*
+vfs_find(const char* file_name, const struct pack_t** pack);
+
+/* ------------------------------------------------------------------------- */
+void
+vfs_init(void)
+{
+	unordered_vector_init_vector(&g_packs, sizeof(struct pack_t*));
+}
+
+/* ------------------------------------------------------------------------- */
+void
+vfs_deinit(void)
+{
+	UNORDERED_VECTOR_FOR_EACH(&g_packs, struct pack_t*, pack)
+		pack_close(*pack);
+	UNORDERED_VECTOR_END_EACH
+	unordered_vector_clear_free(&g_packs);
+}
+
+/* ------------------------------------------------------------------------- */
+char
+vfs_mount(const char* pack_file_name)
+{
+	struct pack_t* pack;
+
+	assert(pack_file_name);
+
+	if(!(pack = pack_open(pack_file_name)))
+		return 0;
+	if(!unordered_vector_push(&g_packs, &pack))
+	{
+		pack_close(pack);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+vfs_mount_count(void)
+{
+	return g_packs.count;
+}
+
+/* ------------------------------------------------------------------------- */
+char
+vfs_open(struct vfs_file_t* file, const char* file_name)
+{
+	const struct pack_t* pack;
+	const struct pack_entry_t* entry;
+	void* buffer;
+
+	assert(file);
+	assert(file_name);
+
+	memset(file, 0, sizeof(struct vfs_file_t));
+
+	/* fall back to loose files */
+	if(!(entry = vfs_find(file_name, &pack)))
+	{
+		if(!(file->size = file_load_into_memory(file_name, &file->buffer, FILE_BINARY)))
+			return 0;
+		file->data = file->buffer;
+		return 1;
+	}
+
+	/* uncompressed entries are handed out directly from the mapping */
+	if(!(entry->flags & PACK_ENTRY_COMPRESSED))
+	{
+		file->data = pack_entry_data(pack, entry);
+		file->size = entry->size;
+		return 1;
+	}
+
+	if(!(buffer = MALLOC(entry->size ? entry->size : 1)))
+	{
+		fprintf(stderr, "malloc() failed in vfs_open() -- not enough memory\n");
+		return 0;
+	}
+	if(!pack_read(pack, entry, buffer))
+	{
+		FREE(buffer);
+		return 0;
+	}
+	file->buffer = buffer;
+	file->data = buffer;
+	file->size = entry->size;
+
+	return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+void
+vfs_close(struct vfs_file_t* file)
+{
+	assert(file);
+
+	if(file->buffer)
+		FREE(file->buffer);
+	memset(file, 0, sizeof(struct vfs_file_t));
+}
+
+/* ------------------------------------------------------------------------- */
+uint32_t
+vfs_load_into_memory(const char* file_name, void** buffer, file_opts_e opts)
+{
+	const struct pack_t* pack;
+	const struct pack_entry_t* entry;
+
+	if(!(entry = vfs_find(file_name, &pack)) || entry->size == 0)
+		return 0;
+
+	/* text mode appends a null terminator, see file_load_into_memory() */
+	if(opts & FILE_BINARY)
+		*buffer = MALLOC(entry->size);
+	else
+		*buffer = MALLOC(entry->size + sizeof(char));
+	if(*buffer == NULL)
+	{
+		fprintf(stderr, "malloc() failed in vfs_load_into_memory() -- not enough memory\n");
+		return 0;
+	}
+
+	if(!pack_read(pack, entry, *buffer))
+	{
+		FREE(*buffer);
+		*buffer = NULL;
+		return 0;
+	}
+
+	if((opts & FILE_BINARY) == 0)
+		((char*)(*buffer))[entry->size] = '\0';
+
+	return entry->size;
+}
+
+/* ------------------------------------------------------------------------- */
+static const struct pack_entry_t*
+vfs_find(const char* file_name, const struct pack_t** pack)
+{
+	const struct pack_entry_t* entry;
+	uint32_t i;
+
+	/* entries are stored relative to the pack's root */
+	while(file_name[0] == '.' && file_name[1] == '/')
+		file_name += 2;
+
+	for(i = g_packs.count; i-- != 0;)
+	{
+		*pack = *(struct pack_t**)unordered_vector_get_element(&g_packs, i);
+		if((entry = pack_find(*pack, file_name)))
+			return entry;
+	}
+
+	return NULL;
+}
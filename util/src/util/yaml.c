@@ -5,6 +5,7 @@
 #include "util/string.h"
 #include "util/ptree.h"
 #include "util/unordered_vector.h"
+#include "util/vfs.h"
 #include <assert.h>
 
 #ifdef LIGHTSHIP_UTIL_PLATFORM_MACOSX
@@ -19,6 +20,9 @@ yaml_load_into_ptree(struct ptree_t* tree,
 					 yaml_parser_t* parser,
 					 char is_sequence);
 
+static struct ptree_t*
+yaml_load_from_parser(yaml_parser_t* parser);
+
 static char*
 yaml_dup_node_value_func(char* value);
 
@@ -58,6 +62,29 @@ yaml_load(const char* filename)
 
 	assert(filename);
 
+	/* files in mounted packs are parsed straight out of the mapping */
+	if(vfs_mount_count())
+	{
+		struct vfs_file_t file;
+		yaml_parser_t parser;
+
+		if(!vfs_open(&file, filename))
+		{
+			fprintf(stderr, "Failed to open file \"%s\"\n", filename);
+			return NULL;
+		}
+		if(!yaml_parser_initialize(&parser))
+		{
+			vfs_close(&file);
+			return NULL;
+		}
+		yaml_parser_set_input_string(&parser, (const unsigned char*)file.data, file.size);
+		doc = yaml_load_from_parser(&parser);
+		vfs_close(&file);
+
+		return doc;
+	}
+
 	/* try to open the file */
 	fp = fopen(filename, "rb");
 	if(!fp)
@@ -101,7 +128,6 @@ struct ptree_t*
 yaml_load_from_stream(FILE* stream)
 {
 	yaml_parser_t parser;
-	struct ptree_t* doc = NULL;
 
 	assert(stream);
 
@@ -110,13 +136,22 @@ yaml_load_from_stream(FILE* stream)
 		return NULL;
 	yaml_parser_set_input_file(&parser, stream);
 
+	return yaml_load_from_parser(&parser);
+}
+
+/* ------------------------------------------------------------------------- */
+static struct ptree_t*
+yaml_load_from_parser(yaml_parser_t* parser)
+{
+	struct ptree_t* doc = NULL;
+
 	for(;;)
 	{
 		/* parse file and load into tree */
 		if(!(doc = ptree_create(NULL)))
 			break;
 		yaml_init_node(doc);
-		if(!yaml_load_into_ptree(doc, doc, &parser, 0))
+		if(!yaml_load_into_ptree(doc, doc, parser, 0))
 		{
 			fprintf(stderr, "Syntax error: Failed to parse YAML.\n");
 			break;
@@ -126,13 +161,13 @@ yaml_load_from_stream(FILE* stream)
 		if(!list_push(&g_open_docs, doc))
 			break;
 
-		yaml_parser_delete(&parser);
+		yaml_parser_delete(parser);
 
 		return doc;
 	}
 
 	/* clean up */
-	yaml_parser_delete(&parser);
+	yaml_parser_delete(parser);
 	if(doc)
 		ptree_destroy(doc);
 